@@ -0,0 +1,125 @@
+/*
+
+Secure memory arena of Kalyna block cipher (DSTU 7624:2014) contexts
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+
+/* Size of a slab, also the huge page size on common systems. */
+#define kARENA_SLAB_BYTES (2 * 1024 * 1024)
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/* Free slots are linked through their first bytes. */
+typedef struct free_slot {
+    struct free_slot* next;
+} free_slot_t;
+
+static free_slot_t* free_slots = NULL;
+static int arena_locked = 1;
+static pthread_mutex_t arena_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+void SecureWipe(void* data, size_t length) {
+#if defined(__GNUC__)
+    memset(data, 0, length);
+    /* The compiler must assume the asm reads the memory. */
+    __asm__ __volatile__("" : : "r"(data) : "memory");
+#else
+    volatile uint8_t* bytes = (volatile uint8_t*)data;
+    while (length-- > 0)
+        *bytes++ = 0;
+#endif
+}
+
+/*!
+ * Map a new slab, preferring huge pages, and put its slots on the free list.
+ * Called with arena_lock held.
+ *
+ * @return Zero in case of success.
+ */
+static int GrowArena(void) {
+    size_t offset;
+    uint8_t* slab = MAP_FAILED;
+    free_slot_t* slot;
+#ifdef KALYNA_ARENA_GUARD
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    /* Slot pages followed by a guard page, the slot ends at the guard. */
+    size_t data_bytes = (kARENA_SLOT_BYTES + page - 1) / page * page;
+    size_t stride = data_bytes + page;
+    size_t start = data_bytes - kARENA_SLOT_BYTES;
+#else
+    size_t stride = kARENA_SLOT_BYTES;
+    size_t start = 0;
+#endif
+
+#if defined(MAP_HUGETLB) && !defined(KALYNA_ARENA_GUARD)
+    slab = (uint8_t*)mmap(NULL, kARENA_SLAB_BYTES, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (slab == MAP_FAILED) {
+        slab = (uint8_t*)mmap(NULL, kARENA_SLAB_BYTES, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (slab == MAP_FAILED)
+            return -1;
+#if defined(MADV_HUGEPAGE) && !defined(KALYNA_ARENA_GUARD)
+        madvise(slab, kARENA_SLAB_BYTES, MADV_HUGEPAGE);
+#endif
+    }
+#ifdef MADV_DONTDUMP
+    madvise(slab, kARENA_SLAB_BYTES, MADV_DONTDUMP);
+#endif
+    if (mlock(slab, kARENA_SLAB_BYTES) != 0)
+        arena_locked = 0;
+
+    for (offset = 0; offset + stride <= kARENA_SLAB_BYTES; offset += stride) {
+#ifdef KALYNA_ARENA_GUARD
+        mprotect(slab + offset + data_bytes, page, PROT_NONE);
+#endif
+        slot = (free_slot_t*)(slab + offset + start);
+        slot->next = free_slots;
+        free_slots = slot;
+    }
+    return 0;
+}
+
+void* ArenaAlloc(void) {
+    free_slot_t* slot;
+    pthread_mutex_lock(&arena_lock);
+    if (free_slots == NULL && GrowArena() != 0) {
+        pthread_mutex_unlock(&arena_lock);
+        return NULL;
+    }
+    slot = free_slots;
+    free_slots = slot->next;
+    pthread_mutex_unlock(&arena_lock);
+    slot->next = NULL;  /* The rest of a free slot is already zero. */
+    return slot;
+}
+
+void ArenaFree(void* slot) {
+    SecureWipe(slot, kARENA_SLOT_BYTES);
+    pthread_mutex_lock(&arena_lock);
+    ((free_slot_t*)slot)->next = free_slots;
+    free_slots = (free_slot_t*)slot;
+    pthread_mutex_unlock(&arena_lock);
+}
+
+int ArenaLocked(void) {
+    int locked;
+    pthread_mutex_lock(&arena_lock);
+    locked = arena_locked;
+    pthread_mutex_unlock(&arena_lock);
+    return locked;
+}
@@ -0,0 +1,59 @@
+/*
+
+Header file for the secure memory arena of Kalyna block cipher (DSTU 7624:2014) contexts
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef KALYNA_ARENA_H
+#define KALYNA_ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Contexts are carved out of large slabs mapped with mmap, backed by huge
+ * pages when the system provides them, locked in memory with mlock and
+ * excluded from core dumps. All slots have the size of the largest context,
+ * free slots are kept on a list so that allocation and release are O(1).
+ *
+ * Building with -DKALYNA_ARENA_GUARD places every slot on its own pages
+ * right before an inaccessible guard page, so that overruns of a context
+ * fault immediately; intended for debug builds.
+ */
+
+/* Bytes available in a slot, enough for a context of any variant. */
+#define kARENA_SLOT_BYTES 3072
+
+/*!
+ * Take a zero-filled slot of kARENA_SLOT_BYTES bytes, thread safe.
+ *
+ * @return Pointer aligned to 64 bytes or NULL if no memory could be mapped.
+ */
+void* ArenaAlloc(void);
+
+/*!
+ * Wipe a slot and return it to the free list, thread safe.
+ *
+ * @param slot Pointer returned by ArenaAlloc().
+ */
+void ArenaFree(void* slot);
+
+/*!
+ * Check whether arena memory is locked against swapping. Locking fails if
+ * RLIMIT_MEMLOCK is too low, the arena then works with unlocked memory.
+ *
+ * @return Nonzero if all slabs mapped so far are locked.
+ */
+int ArenaLocked(void);
+
+/*!
+ * Overwrite memory with zeros; unlike memset() the stores are never removed
+ * by the optimizer.
+ *
+ * @param data Memory to wipe.
+ * @param length Byte length.
+ */
+void SecureWipe(void* data, size_t length);
+
+#endif  /* KALYNA_ARENA_H */
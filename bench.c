@@ -0,0 +1,699 @@
+/*
+
+Benchmark of the Kalyna block cipher (DSTU 7624:2014) engines, all block and key length variants
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "kalyna.h"
+#include "transformations.h"
+#include "engine.h"
+#include "kalyna_ring.h"
+#include "kalyna_drbg.h"
+#include "kalyna_schedule.h"
+#include "kalyna_stream.h"
+#include "kalyna_tree_mac.h"
+#include "kalyna_gcm.h"
+#include "kalyna_feedback.h"
+#include "kalyna_block128.h"
+#include "kalyna_kdf.h"
+
+/* Size of the buffer processed by a single call. */
+#define kBUFFER_BYTES (16 * 1024)
+
+/* Block and key bit sizes of all Kalyna variants. */
+static const size_t variants[][2] = {
+    {128, 128}, {128, 256}, {256, 256}, {256, 512}, {512, 512}
+};
+
+#define kVARIANTS_NUM (sizeof(variants) / sizeof(variants[0]))
+
+/* Small message CTR case: message byte length and messages per ring batch. */
+#define kMESSAGE_BYTES 256
+#define kRING_BATCH 64
+
+/* Object and chunk sizes of the tree MAC case. */
+#define kMAC_OBJECT_BYTES (4 * 1024 * 1024)
+#define kMAC_CHUNK_BYTES (64 * 1024)
+
+/* Latency samples and chained calls timed per sample. */
+#define kLATENCY_SAMPLES 20000
+#define kLATENCY_CALLS 16
+
+/* Smallest and largest buffers of the bulk bandwidth curve. */
+#define kBULK_MIN_BYTES (16 * 1024)
+#define kBULK_MAX_BYTES (64 * 1024 * 1024)
+
+/* Contexts restored in the warm start case. */
+#define kWARM_KEYS 10000
+
+/* Minimum measured time of a single case, seconds. */
+static double min_time = 0.2;
+
+
+static double Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*!
+ * Run the engine routine over the buffer until the minimum time elapses.
+ *
+ * @return Throughput in megabytes per second.
+ */
+static double MeasureBlocks(kalyna_blocks_fn process, kalyna_t* ctx,
+        uint64_t* buffer) {
+    size_t blocks = kBUFFER_BYTES / (ctx->nb * sizeof(uint64_t));
+    unsigned long calls = 0;
+    double start, elapsed;
+
+    process(buffer, blocks, ctx, buffer);  /* Warm up caches. */
+    start = Now();
+    do {
+        process(buffer, blocks, ctx, buffer);
+        ++calls;
+        elapsed = Now() - start;
+    } while (elapsed < min_time);
+    return calls * (double)kBUFFER_BYTES / elapsed / 1e6;
+}
+
+/*!
+ * Open a counter of L1d read misses of the calling thread in user space.
+ *
+ * @return File descriptor or -1 if perf events are not available, e.g. on
+ * other systems, in containers or with a high perf_event_paranoid.
+ */
+static int OpenL1Counter(void) {
+#if defined(__linux__) && defined(SYS_perf_event_open)
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+/*!
+ * Count L1d read misses of the engine routine over the buffer, warm caches
+ * as in MeasureBlocks().
+ *
+ * @return Misses per block or a negative value if the counter is not open.
+ */
+static double MeasureL1Misses(int counter, kalyna_blocks_fn process, kalyna_t* ctx,
+        uint64_t* buffer) {
+#if defined(__linux__) && defined(SYS_perf_event_open)
+    size_t blocks = kBUFFER_BYTES / (ctx->nb * sizeof(uint64_t));
+    unsigned long calls;
+    uint64_t misses;
+
+    if (counter < 0)
+        return -1.0;
+    process(buffer, blocks, ctx, buffer);
+    ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+    ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    for (calls = 0; calls < 64; ++calls)
+        process(buffer, blocks, ctx, buffer);
+    ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(counter, &misses, sizeof(misses)) != sizeof(misses))
+        return -1.0;
+    return (double)misses / (calls * blocks);
+#else
+    return -1.0;
+#endif
+}
+
+/* Print a miss count or "n/a" if it could not be measured. */
+static void PrintMisses(double misses) {
+    if (misses < 0)
+        printf(" %14s\n", "n/a");
+    else
+        printf(" %14.2f\n", misses);
+}
+
+/*!
+ * Measure key expansion time.
+ *
+ * @return Microseconds per KalynaKeyExpand() call.
+ */
+static double MeasureKeyExpand(kalyna_t* ctx, uint64_t* key) {
+    unsigned long calls = 0;
+    double start, elapsed;
+
+    start = Now();
+    do {
+        KalynaKeyExpand(key, ctx);
+        ++calls;
+        elapsed = Now() - start;
+    } while (elapsed < min_time);
+    return elapsed / calls * 1e6;
+}
+
+/*!
+ * Encipher the buffer split into kLANES streams under different keys, either
+ * with the multi-buffer routine or key by key with the multi-block one.
+ *
+ * @return Throughput in megabytes per second.
+ */
+static double MeasureLanes(kalyna_t* const* ctxs, uint64_t* buffer, int interleave) {
+    size_t lane, blocks[kLANES];
+    size_t words = kBUFFER_BYTES / sizeof(uint64_t) / kLANES;
+    unsigned long calls = 0;
+    double start, elapsed;
+    const uint64_t* input[kLANES];
+    uint64_t* output[kLANES];
+    kalyna_lanes_t schedule;
+
+    for (lane = 0; lane < kLANES; ++lane) {
+        input[lane] = output[lane] = buffer + lane * words;
+        blocks[lane] = words / ctxs[lane]->nb;
+    }
+    start = Now();
+    do {
+        if (interleave) {
+            KalynaLanesLoad(ctxs, kLANES, &schedule);
+            KalynaEncipherLanes(&schedule, input, blocks, output);
+        } else {
+            for (lane = 0; lane < kLANES; ++lane)
+                KalynaEncipherBlocks(input[lane], blocks[lane], ctxs[lane], output[lane]);
+        }
+        ++calls;
+        elapsed = Now() - start;
+    } while (elapsed < min_time);
+    return calls * (double)kBUFFER_BYTES / elapsed / 1e6;
+}
+
+/*!
+ * Measure CTR encryption of short messages, either by one KalynaCtrBytes()
+ * call per message or through a ring that batches them. Messages use the
+ * keys in turn.
+ *
+ * @return Throughput in megabytes per second.
+ */
+static double MeasureMessages(kalyna_t* const* ctxs, size_t keys, uint8_t* buffer,
+        int use_ring) {
+    size_t i;
+    unsigned long batches = 0;
+    double start, elapsed;
+    kalyna_job_t job;
+    kalyna_completion_t completions[kRING_BATCH];
+    kalyna_ring_t* ring = KalynaRingInit(kRING_BATCH);
+
+    job.mode = KALYNA_JOB_CTR;
+    job.length = kMESSAGE_BYTES;
+    job.user_data = NULL;
+    start = Now();
+    do {
+        for (i = 0; i < kRING_BATCH; ++i) {
+            job.ctx = ctxs[i % keys];
+            job.input = job.output = buffer + i * kMESSAGE_BYTES;
+            job.iv = job.input;
+            if (use_ring)
+                KalynaRingSubmit(ring, &job);
+            else
+                KalynaCtrBytes(job.input, job.length, job.iv, job.ctx, job.output);
+        }
+        if (use_ring)
+            KalynaRingReap(ring, completions, kRING_BATCH, TRUE);
+        ++batches;
+        elapsed = Now() - start;
+    } while (elapsed < min_time);
+    KalynaRingDelete(ring);
+    return batches * (double)(kRING_BATCH * kMESSAGE_BYTES) / elapsed / 1e6;
+}
+
+/*!
+ * Measure random bytes generation in requests of `request` bytes, from a
+ * seeded generator or from the per-thread one.
+ *
+ * @return Throughput in megabytes per second.
+ */
+static double MeasureDrbg(kalyna_drbg_t* drbg, uint8_t* buffer, size_t request) {
+    size_t i;
+    double start, elapsed;
+    unsigned long calls = 0;
+
+    start = Now();
+    do {
+        for (i = 0; i + request <= kBUFFER_BYTES; i += request) {
+            if (drbg != NULL)
+                KalynaDrbgGenerate(drbg, buffer + i, request);
+            else
+                KalynaRandomBytes(buffer + i, request);
+        }
+        ++calls;
+        elapsed = Now() - start;
+    } while (elapsed < min_time);
+    return calls * (double)(kBUFFER_BYTES / request * request) / elapsed / 1e6;
+}
+
+/*!
+ * Pass the buffer through a Kalyna-256/512 stream, supplying the next key
+ * whenever the previous one has taken effect.
+ *
+ * @param rekey_blocks Blocks per key, 0 to keep the initial key.
+ * @return Throughput in megabytes per second.
+ */
+static double MeasureStream(uint8_t* buffer, uint64_t rekey_blocks) {
+    uint64_t key[kNK_512];
+    uint8_t iv[kNB_256 * sizeof(uint64_t)];
+    unsigned long calls = 0;
+    double start, elapsed;
+    kalyna_stream_position_t position;
+    kalyna_stream_t* stream;
+
+    memset(key, 0, sizeof(key));
+    memset(iv, 0, sizeof(iv));
+    stream = KalynaStreamInit(kBLOCK_256, kKEY_512, key, iv, rekey_blocks);
+    start = Now();
+    do {
+        KalynaStreamPosition(stream, &position);
+        if (rekey_blocks != 0 && !position.next_key_ready) {
+            key[0] = position.epoch + 1;
+            KalynaStreamNextKey(stream, key);
+        }
+        KalynaStreamCrypt(stream, buffer, kBUFFER_BYTES, buffer);
+        ++calls;
+        elapsed = Now() - start;
+    } while (elapsed < min_time);
+    KalynaStreamDelete(stream);
+    return calls * (double)kBUFFER_BYTES / elapsed / 1e6;
+}
+
+/*!
+ * Authenticate an object with the Kalyna-256/512 tree MAC.
+ *
+ * @param chunk_bytes Chunk size; the object size gives a plain CMAC chain.
+ * @return Throughput in megabytes per second.
+ */
+static double MeasureTreeMac(kalyna_t* ctx, const uint8_t* object, size_t chunk_bytes,
+        size_t threads) {
+    uint8_t tag[kNB_256 * sizeof(uint64_t)];
+    unsigned long calls = 0;
+    double start, elapsed;
+
+    start = Now();
+    do {
+        KalynaTreeMac(ctx, object, kMAC_OBJECT_BYTES, chunk_bytes, threads, tag);
+        ++calls;
+        elapsed = Now() - start;
+    } while (elapsed < min_time);
+    return calls * (double)kMAC_OBJECT_BYTES / elapsed / 1e6;
+}
+
+/*!
+ * Seal buffers with GCM under a fixed nonce and no additional data.
+ *
+ * @return Throughput in megabytes per second.
+ */
+static double MeasureGcm(kalyna_t* ctx, uint8_t* buffer) {
+    uint8_t nonce[kNB_512 * sizeof(uint64_t)], tag[kNB_512 * sizeof(uint64_t)];
+    unsigned long calls = 0;
+    double start, elapsed;
+
+    memset(nonce, 0, sizeof(nonce));
+    start = Now();
+    do {
+        KalynaGcmEncrypt(ctx, nonce, NULL, 0, buffer, kBUFFER_BYTES, buffer, tag);
+        ++calls;
+        elapsed = Now() - start;
+    } while (elapsed < min_time);
+    return calls * (double)kBUFFER_BYTES / elapsed / 1e6;
+}
+
+/*!
+ * Process buffers in a feedback mode: 0 for CFB encryption, 1 for CFB
+ * decryption, 2 for OFB.
+ *
+ * @return Throughput in megabytes per second.
+ */
+static double MeasureFeedback(kalyna_t* ctx, uint8_t* buffer, int mode) {
+    uint8_t iv[kNB_512 * sizeof(uint64_t)];
+    size_t block_bits = ctx->nb * kBITS_IN_WORD;
+    unsigned long calls = 0;
+    double start, elapsed;
+
+    memset(iv, 0, sizeof(iv));
+    start = Now();
+    do {
+        if (mode == 0)
+            KalynaCfbEncrypt(buffer, kBUFFER_BYTES, iv, block_bits, ctx, buffer);
+        else if (mode == 1)
+            KalynaCfbDecrypt(buffer, kBUFFER_BYTES, iv, block_bits, ctx, buffer);
+        else
+            KalynaOfbBytes(buffer, kBUFFER_BYTES, iv, ctx, buffer);
+        ++calls;
+        elapsed = Now() - start;
+    } while (elapsed < min_time);
+    return calls * (double)kBUFFER_BYTES / elapsed / 1e6;
+}
+
+/*!
+ * Process a buffer of `length` bytes with the bulk byte interface: 0 for
+ * ECB encryption, 1 for CTR. `output` may be `input`.
+ *
+ * @return Throughput in megabytes per second.
+ */
+static double MeasureBulk(kalyna_t* ctx, uint8_t* input, uint8_t* output, size_t length,
+        int mode) {
+    uint8_t iv[kNB_512 * sizeof(uint64_t)];
+    unsigned long calls = 0;
+    double start, elapsed;
+
+    memset(iv, 0, sizeof(iv));
+    start = Now();
+    do {
+        if (mode == 0)
+            KalynaEncryptBytes(input, length, ctx, output);
+        else
+            KalynaCtrBytes(input, length, iv, ctx, output);
+        ++calls;
+        elapsed = Now() - start;
+    } while (elapsed < min_time);
+    return calls * (double)length / elapsed / 1e6;
+}
+
+/*!
+ * Create kWARM_KEYS Kalyna-256/512 contexts, by key expansion into `ctxs` if
+ * `image` is NULL, otherwise by importing an image of `ctxs` written with
+ * the wrapping context `wrap` beforehand.
+ *
+ * @return Milliseconds taken.
+ */
+static double MeasureWarmStart(kalyna_t** ctxs, uint8_t* image, size_t length,
+        kalyna_t* wrap) {
+    size_t i;
+    uint64_t key[kNK_512];
+    kalyna_t** imported;
+    double start, elapsed;
+
+    if (image == NULL) {
+        memset(key, 0, sizeof(key));
+        start = Now();
+        for (i = 0; i < kWARM_KEYS; ++i) {
+            key[0] = i;
+            ctxs[i] = KalynaInit(kBLOCK_256, kKEY_512);
+            KalynaKeyExpand(key, ctxs[i]);
+        }
+        return (Now() - start) * 1e3;
+    }
+    imported = (kalyna_t**)malloc(kWARM_KEYS * sizeof(kalyna_t*));
+    KalynaScheduleExport(ctxs, kWARM_KEYS, wrap, image, length);
+    start = Now();
+    if (KalynaScheduleImport(image, length, wrap, imported) != 0) {
+        free(imported);
+        return -1;
+    }
+    elapsed = Now() - start;
+    for (i = 0; i < kWARM_KEYS; ++i)
+        KalynaDelete(imported[i]);
+    free(imported);
+    return elapsed * 1e3;
+}
+
+/*!
+ * Derive kWARM_KEYS Kalyna-256/512 contexts from a master context.
+ *
+ * @return Milliseconds taken.
+ */
+static double MeasureKdf(kalyna_t* master) {
+    size_t i;
+    kalyna_t** ctxs = (kalyna_t**)malloc(kWARM_KEYS * sizeof(kalyna_t*));
+    double start, elapsed;
+
+    start = Now();
+    if (KalynaKdfDeriveContexts(master, (const uint8_t*)"bench", 5, NULL, 0, 0,
+            kWARM_KEYS, kBLOCK_256, kKEY_512, ctxs) != 0) {
+        free(ctxs);
+        return -1;
+    }
+    elapsed = Now() - start;
+    for (i = 0; i < kWARM_KEYS; ++i)
+        KalynaDelete(ctxs[i]);
+    free(ctxs);
+    return elapsed * 1e3;
+}
+
+static int CompareDoubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+/*!
+ * Time chains of dependent single block calls on Kalyna-128: 0 for the
+ * reference KalynaEncipher(), 1 for KalynaEncryptBytes() on one block
+ * through the selected engine, 2 for KalynaBlock128Encipher().
+ *
+ * @param p50 Median nanoseconds per block.
+ * @param p99 99th percentile nanoseconds per block.
+ */
+static void MeasureLatency(kalyna_t* ctx, const kalyna_block128_t* fast, int path,
+        double* samples, double* p50, double* p99) {
+    size_t i, k;
+    uint64_t block[kNB_128] = {1, 2};
+    uint8_t bytes[kNB_128 * sizeof(uint64_t)];
+    double start;
+
+    memset(bytes, 1, sizeof(bytes));
+    for (i = 0; i < kLATENCY_SAMPLES; ++i) {
+        start = Now();
+        for (k = 0; k < kLATENCY_CALLS; ++k) {
+            if (path == 0)
+                KalynaEncipher(block, ctx, block);
+            else if (path == 1)
+                KalynaEncryptBytes(bytes, sizeof(bytes), ctx, bytes);
+            else
+                KalynaBlock128Encipher(fast, bytes, bytes);
+        }
+        samples[i] = (Now() - start) * 1e9 / kLATENCY_CALLS;
+    }
+    qsort(samples, kLATENCY_SAMPLES, sizeof(double), CompareDoubles);
+    *p50 = samples[kLATENCY_SAMPLES / 2];
+    *p99 = samples[kLATENCY_SAMPLES * 99 / 100];
+}
+
+int main(int argc, char** argv) {
+    size_t v, e, i, lane;
+    uint64_t key[kNK_512];
+    kalyna_t* lane_ctxs[kLANES];
+    kalyna_drbg_t* drbg;
+    kalyna_t** warm_ctxs;
+    uint8_t* object;
+    char label[32];
+    uint8_t* image;
+    size_t image_bytes;
+    uint64_t* buffer = (uint64_t*)malloc(kBUFFER_BYTES);
+    double* samples;
+    double p50, p99;
+    kalyna_block128_t fast;
+    const kalyna_engine_t* engine;
+    kalyna_t* ctx;
+    int counter;
+    uint8_t* bulk_in;
+    uint8_t* bulk_out;
+    size_t threshold;
+
+    if (argc > 1)
+        min_time = strtod(argv[1], NULL);
+    if (buffer == NULL) {
+        perror("Could not allocate benchmark buffer.");
+        return 1;
+    }
+    for (i = 0; i < kBUFFER_BYTES / sizeof(uint64_t); ++i)
+        buffer[i] = i * 0x9E3779B97F4A7C15ULL;
+    for (i = 0; i < kNK_512; ++i)
+        key[i] = i * 0x0101010101010101ULL;
+
+    printf("Selected engine: %s\n\n", KalynaEngineSelect()->name);
+    printf("%-16s %-16s %14s %14s %14s %14s\n", "engine", "variant",
+        "encipher MB/s", "decipher MB/s", "key setup us", "L1d miss/blk");
+    counter = OpenL1Counter();
+
+    for (v = 0; v < kVARIANTS_NUM; ++v) {
+        ctx = KalynaInit(variants[v][0], variants[v][1]);
+        KalynaKeyExpand(key, ctx);
+        for (e = 0; kalyna_engines[e] != NULL; ++e) {
+            engine = KalynaEngineFind(kalyna_engines[e]->name);
+            if (engine == NULL)
+                continue;
+            printf("%-16s Kalyna-%lu/%-6lu %14.1f %14.1f %14.2f", engine->name,
+                (unsigned long)variants[v][0], (unsigned long)variants[v][1],
+                MeasureBlocks(engine->encipher, ctx, buffer),
+                MeasureBlocks(engine->decipher, ctx, buffer),
+                MeasureKeyExpand(ctx, key));
+            PrintMisses(MeasureL1Misses(counter, engine->encipher, ctx, buffer));
+        }
+        KalynaDelete(ctx);
+    }
+#ifdef __linux__
+    if (counter >= 0)
+        close(counter);
+#endif
+
+    printf("\n%d keys, %d KiB per key, selected engine:\n", kLANES,
+        kBUFFER_BYTES / kLANES / 1024);
+    printf("%-16s %14s %14s\n", "variant", "per key MB/s", "lanes MB/s");
+    for (v = 0; v < kVARIANTS_NUM; ++v) {
+        for (lane = 0; lane < kLANES; ++lane) {
+            lane_ctxs[lane] = KalynaInit(variants[v][0], variants[v][1]);
+            key[0] = lane;
+            KalynaKeyExpand(key, lane_ctxs[lane]);
+        }
+        printf("Kalyna-%lu/%-6lu %14.1f %14.1f\n", (unsigned long)variants[v][0],
+            (unsigned long)variants[v][1], MeasureLanes(lane_ctxs, buffer, FALSE),
+            MeasureLanes(lane_ctxs, buffer, TRUE));
+        for (lane = 0; lane < kLANES; ++lane)
+            KalynaDelete(lane_ctxs[lane]);
+    }
+
+    printf("\nCTR, %d byte messages, selected engine:\n", kMESSAGE_BYTES);
+    printf("%-16s %14s %14s   ring, %d keys\n", "variant", "per call MB/s", "ring MB/s",
+        kLANES);
+    for (v = 0; v < kVARIANTS_NUM; ++v) {
+        for (lane = 0; lane < kLANES; ++lane) {
+            lane_ctxs[lane] = KalynaInit(variants[v][0], variants[v][1]);
+            key[0] = lane;
+            KalynaKeyExpand(key, lane_ctxs[lane]);
+        }
+        printf("Kalyna-%lu/%-6lu %14.1f %14.1f %14.1f\n", (unsigned long)variants[v][0],
+            (unsigned long)variants[v][1],
+            MeasureMessages(lane_ctxs, 1, (uint8_t*)buffer, FALSE),
+            MeasureMessages(lane_ctxs, 1, (uint8_t*)buffer, TRUE),
+            MeasureMessages(lane_ctxs, kLANES, (uint8_t*)buffer, TRUE));
+        for (lane = 0; lane < kLANES; ++lane)
+            KalynaDelete(lane_ctxs[lane]);
+    }
+
+    drbg = KalynaDrbgInit((uint8_t*)key, sizeof(key), NULL, 0);
+    printf("\nCTR DRBG (Kalyna-256/512), selected engine:\n");
+    printf("%-16s %14s %14s\n", "request bytes", "seeded MB/s", "thread MB/s");
+    for (i = 16; i <= kBUFFER_BYTES; i *= 32) {
+        printf("%-16lu %14.1f %14.1f\n", (unsigned long)i,
+            MeasureDrbg(drbg, (uint8_t*)buffer, i), MeasureDrbg(NULL, (uint8_t*)buffer, i));
+    }
+    KalynaDrbgDelete(drbg);
+
+    printf("\nCTR stream (Kalyna-256/512), selected engine:\n");
+    printf("%-16s %14s\n", "rekey every", "MB/s");
+    printf("%-16s %14.1f\n", "never", MeasureStream((uint8_t*)buffer, 0));
+    for (i = 64 * 1024; i <= 4 * 1024 * 1024; i *= 8) {
+        printf("%-10lu KiB %14.1f\n", (unsigned long)i / 1024,
+            MeasureStream((uint8_t*)buffer, i / (kNB_256 * sizeof(uint64_t))));
+    }
+
+    samples = (double*)malloc(kLATENCY_SAMPLES * sizeof(double));
+    printf("\nSingle block latency (Kalyna-128/128), ns per block:\n");
+    printf("%-24s %10s %10s\n", "path", "p50", "p99");
+    ctx = KalynaInit(kBLOCK_128, kKEY_128);
+    KalynaKeyExpand(key, ctx);
+    KalynaBlock128Load(&fast, ctx);
+    for (i = 0; i < 3; ++i) {
+        MeasureLatency(ctx, &fast, (int)i, samples, &p50, &p99);
+        printf("%-24s %10.1f %10.1f\n", i == 0 ? "KalynaEncipher" :
+            i == 1 ? "KalynaEncryptBytes" : "KalynaBlock128Encipher", p50, p99);
+    }
+    KalynaDelete(ctx);
+    free(samples);
+
+    object = (uint8_t*)calloc(kMAC_OBJECT_BYTES, 1);
+    ctx = KalynaInit(kBLOCK_256, kKEY_512);
+    KalynaKeyExpand(key, ctx);
+    printf("\nTree MAC (Kalyna-256/512), %d MiB object, selected engine:\n",
+        kMAC_OBJECT_BYTES / 1024 / 1024);
+    printf("%-16s %14s\n", "chunks", "MB/s");
+    printf("%-16s %14.1f\n", "one (CMAC)", MeasureTreeMac(ctx, object, kMAC_OBJECT_BYTES, 1));
+    for (i = 1; i <= 4; i *= 2) {
+        snprintf(label, sizeof(label), "%d KiB, %lu thr", kMAC_CHUNK_BYTES / 1024,
+            (unsigned long)i);
+        printf("%-16s %14.1f\n", label, MeasureTreeMac(ctx, object, kMAC_CHUNK_BYTES, i));
+    }
+    KalynaDelete(ctx);
+    free(object);
+
+    printf("\nGCM, %d KiB messages, selected engine:\n", kBUFFER_BYTES / 1024);
+    printf("%-16s %14s\n", "variant", "MB/s");
+    for (v = 0; v < kVARIANTS_NUM; ++v) {
+        ctx = KalynaInit(variants[v][0], variants[v][1]);
+        KalynaKeyExpand(key, ctx);
+        snprintf(label, sizeof(label), "Kalyna-%lu/%lu", (unsigned long)variants[v][0],
+            (unsigned long)variants[v][1]);
+        printf("%-16s %14.1f\n", label, MeasureGcm(ctx, (uint8_t*)buffer));
+        KalynaDelete(ctx);
+    }
+
+    printf("\nCFB and OFB, %d KiB messages, full block feedback, selected engine:\n",
+        kBUFFER_BYTES / 1024);
+    printf("%-16s %14s %14s %14s\n", "variant", "CFB enc MB/s", "CFB dec MB/s", "OFB MB/s");
+    for (v = 0; v < kVARIANTS_NUM; ++v) {
+        ctx = KalynaInit(variants[v][0], variants[v][1]);
+        KalynaKeyExpand(key, ctx);
+        snprintf(label, sizeof(label), "Kalyna-%lu/%lu", (unsigned long)variants[v][0],
+            (unsigned long)variants[v][1]);
+        printf("%-16s %14.1f %14.1f %14.1f\n", label, MeasureFeedback(ctx, (uint8_t*)buffer, 0),
+            MeasureFeedback(ctx, (uint8_t*)buffer, 1), MeasureFeedback(ctx, (uint8_t*)buffer, 2));
+        KalynaDelete(ctx);
+    }
+
+    bulk_in = (uint8_t*)calloc(kBULK_MAX_BYTES, 1);
+    bulk_out = (uint8_t*)calloc(kBULK_MAX_BYTES, 1);
+    if (bulk_in != NULL && bulk_out != NULL) {
+        ctx = KalynaInit(kBLOCK_128, kKEY_128);
+        KalynaKeyExpand(key, ctx);
+        threshold = StreamingThreshold(0);
+        printf("\nBulk Kalyna-128/128 by buffer size, MB/s, streaming from %lu KiB:\n",
+            (unsigned long)(threshold / 1024));
+        printf("%-10s %10s %10s %10s %10s %14s\n", "KiB", "ECB", "ECB in pl", "CTR",
+            "CTR in pl", "CTR cached");
+        for (i = kBULK_MIN_BYTES; i <= kBULK_MAX_BYTES; i *= 4) {
+            printf("%-10lu %10.1f %10.1f %10.1f %10.1f", (unsigned long)(i / 1024),
+                MeasureBulk(ctx, bulk_in, bulk_out, i, 0),
+                MeasureBulk(ctx, bulk_out, bulk_out, i, 0),
+                MeasureBulk(ctx, bulk_in, bulk_out, i, 1),
+                MeasureBulk(ctx, bulk_out, bulk_out, i, 1));
+            StreamingThreshold(SIZE_MAX);
+            printf(" %14.1f\n", MeasureBulk(ctx, bulk_in, bulk_out, i, 1));
+            StreamingThreshold(threshold);
+        }
+        KalynaDelete(ctx);
+    }
+    free(bulk_in);
+    free(bulk_out);
+
+    warm_ctxs = (kalyna_t**)malloc(kWARM_KEYS * sizeof(kalyna_t*));
+    printf("\nStarting %d Kalyna-256/512 contexts:\n", kWARM_KEYS);
+    printf("key expansion %14.1f ms\n", MeasureWarmStart(warm_ctxs, NULL, 0, NULL));
+    printf("KDF contexts  %14.1f ms\n", MeasureKdf(warm_ctxs[0]));
+    image_bytes = KalynaScheduleSize(warm_ctxs, kWARM_KEYS);
+    image = (uint8_t*)malloc(image_bytes);
+    printf("plain image   %14.1f ms\n",
+        MeasureWarmStart(warm_ctxs, image, image_bytes, NULL));
+    printf("wrapped image %14.1f ms\n",
+        MeasureWarmStart(warm_ctxs, image, image_bytes, warm_ctxs[0]));
+    for (i = 0; i < kWARM_KEYS; ++i)
+        KalynaDelete(warm_ctxs[i]);
+    free(warm_ctxs);
+    free(image);
+
+    free(buffer);
+    return 0;
+}
@@ -0,0 +1,2089 @@
+/*
+
+Randomized differential testing of the Kalyna block cipher (DSTU 7624:2014) engines against the reference implementation
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "kalyna.h"
+#include "transformations.h"
+#include "engine.h"
+#include "kalyna_ring.h"
+#include "kalyna_drbg.h"
+#include "kalyna_schedule.h"
+#include "kalyna_stream.h"
+#include "kalyna_tree_mac.h"
+#include "kalyna_gcm.h"
+#include "kalyna_container.h"
+#include "kalyna_feedback.h"
+#include "kalyna_block128.h"
+#include "kalyna_kdf.h"
+#include "kalyna_numa.h"
+#include "arena.h"
+
+
+/* Maximum number of blocks passed to an engine in one call. */
+#define kMAX_BATCH 64
+
+/* Jobs submitted to the ring per round and maximum job byte length. */
+#define kRING_JOBS 96
+#define kRING_MAX_LENGTH 600
+
+/* Contexts used by ring jobs, more per variant than there are lanes. */
+#define kRING_CONTEXTS (kVARIANTS_NUM * (kLANES + 2))
+
+/* Bytes generated by the DRBG check, spanning several internal refills. */
+#define kDRBG_CHECK_BYTES 40000
+
+/* Bytes passed through a rekeyed stream and maximum keys it uses. */
+#define kSTREAM_BYTES 3000
+#define kSTREAM_KEYS (kSTREAM_BYTES / 16 + 2)
+
+/* Maximum object byte length in the tree MAC check. */
+#define kTREE_MAC_BYTES 2500
+
+/* Maximum byte lengths of messages and additional data in the GCM check. */
+#define kGCM_BYTES 2000
+#define kGCM_AAD_BYTES 300
+
+/* Maximum plaintext byte length in the container check. */
+#define kCONTAINER_BYTES 6000
+
+/* Maximum byte length of messages in the CFB and OFB check. */
+#define kFEEDBACK_BYTES 3000
+
+/* Keys per variant written to a schedule image. */
+#define kSCHEDULE_KEYS 3
+
+/* Contexts alive at once in the arena check, more than fit in one slab. */
+#define kARENA_CONTEXTS 1000
+
+/* Upper bound of the engine tuning cache read back by the tuner check. */
+#define kTUNE_CACHE_BYTES 4096
+
+/* Block and key bit sizes of all Kalyna variants. */
+static const size_t variants[][2] = {
+    {128, 128}, {128, 256}, {256, 256}, {256, 512}, {512, 512}
+};
+
+#define kVARIANTS_NUM (sizeof(variants) / sizeof(variants[0]))
+
+
+#ifndef KALYNA_FUZZER
+
+/*!
+ * SplitMix64 generator, deterministic for a given seed so that failures are
+ * reproducible from the printed seed.
+ */
+static uint64_t NextRandom(uint64_t* seed) {
+    uint64_t z = (*seed += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+#endif  /* KALYNA_FUZZER */
+
+
+static void ReportMismatch(const char* what, const kalyna_engine_t* engine,
+        kalyna_t* ctx, uint64_t* key, uint64_t* input, size_t block) {
+    printf("Mismatch: %s of engine '%s', Kalyna (%lu, %lu), block %lu\n", what,
+        engine->name, (unsigned long)(ctx->nb * kBITS_IN_WORD),
+        (unsigned long)(ctx->nk * kBITS_IN_WORD), (unsigned long)block);
+    printf("Key:\n");
+    PrintState(ctx->nk, key);
+    printf("Input:\n");
+    PrintState(ctx->nb, input + block * ctx->nb);
+}
+
+/*!
+ * Compare two arrays of blocks and report the first differing one.
+ *
+ * @return Index of the first differing block or `count` if they are equal.
+ */
+static size_t FindMismatch(kalyna_t* ctx, uint64_t* a, uint64_t* b, size_t count) {
+    size_t i;
+    for (i = 0; i < count; ++i) {
+        if (memcmp(a + i * ctx->nb, b + i * ctx->nb, ctx->nb * sizeof(uint64_t)) != 0)
+            break;
+    }
+    return i;
+}
+
+/*!
+ * Run a batch of blocks through every available engine in a single call and
+ * compare the results with the reference applied block by block, also
+ * checking that deciphering inverts enciphering.
+ *
+ * @param ctx Context with round keys already expanded from `key`.
+ * @param key Enciphering key the round keys were computed from.
+ * @param blocks Blocks of ctx->nb words used both as plaintext and ciphertext.
+ * @param count Number of blocks, up to kMAX_BATCH.
+ * @return Number of detected mismatches.
+ */
+static int CheckBlocks(kalyna_t* ctx, uint64_t* key, uint64_t* blocks, size_t count) {
+    size_t e, i, bad;
+    int failures = 0;
+    size_t words = count * ctx->nb;
+    uint64_t expect_ct[kMAX_BATCH * kNB_512], expect_pt[kMAX_BATCH * kNB_512];
+    uint64_t out[kMAX_BATCH * kNB_512];
+    uint8_t buffer[kMAX_BATCH * kNB_512 * sizeof(uint64_t) + 1];
+    uint64_t counter[kNB_512];
+    const kalyna_engine_t* engine;
+
+    for (i = 0; i < words; i += ctx->nb) {
+        KalynaEncipher(blocks + i, ctx, expect_ct + i);
+        KalynaDecipher(blocks + i, ctx, expect_pt + i);
+    }
+
+    for (e = 0; kalyna_engines[e] != NULL; ++e) {
+        engine = kalyna_engines[e];
+        if (!engine->available())
+            continue;
+        engine->encipher(blocks, count, ctx, out);
+        if ((bad = FindMismatch(ctx, out, expect_ct, count)) != count) {
+            ReportMismatch("enciphering", engine, ctx, key, blocks, bad);
+            ++failures;
+        }
+        engine->decipher(blocks, count, ctx, out);
+        if ((bad = FindMismatch(ctx, out, expect_pt, count)) != count) {
+            ReportMismatch("deciphering", engine, ctx, key, blocks, bad);
+            ++failures;
+        }
+        engine->decipher(expect_ct, count, ctx, out);
+        if ((bad = FindMismatch(ctx, out, blocks, count)) != count) {
+            ReportMismatch("decipher(encipher(x)) identity", engine, ctx, key,
+                blocks, bad);
+            ++failures;
+        }
+    }
+
+    /* Byte interface on a deliberately misaligned buffer. */
+    WriteWords(words, blocks, buffer + 1);
+    KalynaEncryptBytes(buffer + 1, words * sizeof(uint64_t), ctx, buffer + 1);
+    ReadWords(words, buffer + 1, out);
+    if (FindMismatch(ctx, out, expect_ct, count) != count) {
+        printf("Mismatch: unaligned KalynaEncryptBytes\n");
+        ++failures;
+    }
+    KalynaDecryptBytes(buffer + 1, words * sizeof(uint64_t), ctx, buffer + 1);
+    ReadWords(words, buffer + 1, out);
+    if (FindMismatch(ctx, out, blocks, count) != count) {
+        printf("Mismatch: unaligned KalynaDecryptBytes\n");
+        ++failures;
+    }
+
+    /* CTR against gamma computed block by block, the last block cut short. */
+    WriteWords(words, blocks, buffer + 1);
+    KalynaCtrBytes(buffer + 1, words * sizeof(uint64_t) - 3, (uint8_t*)key, ctx,
+        buffer + 1);
+    ReadWords(ctx->nb, (uint8_t*)key, counter);
+    KalynaEncipher(counter, ctx, counter);
+    for (i = 0; i < words; i += ctx->nb) {
+        for (e = 0; e < ctx->nb && ++counter[e] == 0; ++e);
+        KalynaEncipher(counter, ctx, out + i);
+        for (e = 0; e < ctx->nb; ++e)
+            out[i + e] ^= blocks[i + e];
+    }
+    WriteWords(words, out, (uint8_t*)expect_ct);
+    if (memcmp(buffer + 1, expect_ct, words * sizeof(uint64_t) - 3) != 0) {
+        printf("Mismatch: KalynaCtrBytes\n");
+        ++failures;
+    }
+    return failures;
+}
+
+/*!
+ * Byte by byte rotation of the original key schedule: byte i of the result
+ * is byte (i + 2 * Nb + 3) of the source string.
+ */
+static void ModelRotateLeft(size_t nb, uint64_t* value) {
+    size_t i, src;
+    size_t rotate_bytes = 2 * nb + 3;
+    size_t bytes_num = nb * sizeof(uint64_t);
+    uint64_t rotated[kNB_512];
+
+    memset(rotated, 0, sizeof(rotated));
+    for (i = 0; i < bytes_num; ++i) {
+        src = (i + rotate_bytes) % bytes_num;
+        rotated[i / sizeof(uint64_t)] |=
+            (uint64_t)STATE_BYTE(value[src / sizeof(uint64_t)], src % sizeof(uint64_t))
+            << ((i % sizeof(uint64_t)) * kBITS_IN_BYTE);
+    }
+    memcpy(value, rotated, nb * sizeof(uint64_t));
+}
+
+/*!
+ * Two rounds of the key schedule on the state of `ctx`: add, round, xor,
+ * round, add, with the reference GF(2^8) round functions.
+ */
+static void ModelKeyRounds(uint64_t* value, kalyna_t* ctx) {
+    AddRoundKeyExpand(value, ctx);
+    EncipherRound(ctx);
+    XorRoundKeyExpand(value, ctx);
+    EncipherRound(ctx);
+    AddRoundKeyExpand(value, ctx);
+}
+
+/*!
+ * Key expansion as originally written, one round key at a time through the
+ * reference round functions. Uses the state of `ctx` as scratch.
+ */
+static void ModelKeyExpand(const uint64_t* key, kalyna_t* ctx) {
+    size_t i, round = 0;
+    uint64_t kt[kNB_512], kt_round[kNB_512], tmv[kNB_512];
+    uint64_t initial_data[kNK_512];
+    const uint64_t* k1 = ctx->nb == ctx->nk ? key : key + ctx->nb;
+
+    memset(ctx->state, 0, ctx->nb * sizeof(uint64_t));
+    ctx->state[0] += ctx->nb + ctx->nk + 1;
+    AddRoundKeyExpand((uint64_t*)key, ctx);
+    EncipherRound(ctx);
+    XorRoundKeyExpand((uint64_t*)k1, ctx);
+    EncipherRound(ctx);
+    AddRoundKeyExpand((uint64_t*)key, ctx);
+    EncipherRound(ctx);
+    memcpy(kt, ctx->state, ctx->nb * sizeof(uint64_t));
+
+    /* Even round keys, alternating key halves if Nk = 2 * Nb. */
+    memcpy(initial_data, key, ctx->nk * sizeof(uint64_t));
+    for (i = 0; i < ctx->nb; ++i)
+        tmv[i] = 0x0001000100010001ULL;
+    while (TRUE) {
+        for (i = 0; i < ctx->nb; ++i)
+            kt_round[i] = kt[i] + tmv[i];
+        memcpy(ctx->state, initial_data, ctx->nb * sizeof(uint64_t));
+        ModelKeyRounds(kt_round, ctx);
+        memcpy(ctx->round_keys[round], ctx->state, ctx->nb * sizeof(uint64_t));
+        if (round == ctx->nr)
+            break;
+        if (ctx->nk != ctx->nb) {
+            round += 2;
+            ShiftLeft(ctx->nb, tmv);
+            for (i = 0; i < ctx->nb; ++i)
+                kt_round[i] = kt[i] + tmv[i];
+            memcpy(ctx->state, initial_data + ctx->nb, ctx->nb * sizeof(uint64_t));
+            ModelKeyRounds(kt_round, ctx);
+            memcpy(ctx->round_keys[round], ctx->state, ctx->nb * sizeof(uint64_t));
+            if (round == ctx->nr)
+                break;
+        }
+        round += 2;
+        ShiftLeft(ctx->nb, tmv);
+        Rotate(ctx->nk, initial_data);
+    }
+
+    for (round = 1; round < ctx->nr; round += 2) {
+        memcpy(ctx->round_keys[round], ctx->round_keys[round - 1], ctx->nb * sizeof(uint64_t));
+        ModelRotateLeft(ctx->nb, ctx->round_keys[round]);
+    }
+    for (round = 0; round <= ctx->nr; ++round) {
+        memcpy(ctx->state, ctx->round_keys[round], ctx->nb * sizeof(uint64_t));
+        InvMixColumns(ctx);
+        memcpy(ctx->round_keys_dec[round], ctx->state, ctx->nb * sizeof(uint64_t));
+    }
+}
+
+/*!
+ * Compare round keys expanded from `key` by KalynaKeyExpand() with the model.
+ *
+ * @param ctx Context with round keys already expanded from `key`.
+ * @return Number of detected mismatches.
+ */
+static int CompareKeySchedule(kalyna_t* ctx, const uint64_t* key) {
+    size_t round;
+    int failures = 0;
+    kalyna_t* model = KalynaInit(ctx->nb * kBITS_IN_WORD, ctx->nk * kBITS_IN_WORD);
+
+    ModelKeyExpand(key, model);
+    for (round = 0; round <= ctx->nr; ++round) {
+        if (memcmp(ctx->round_keys[round], model->round_keys[round],
+                ctx->nb * sizeof(uint64_t)) != 0 ||
+                memcmp(ctx->round_keys_dec[round], model->round_keys_dec[round],
+                ctx->nb * sizeof(uint64_t)) != 0) {
+            printf("Mismatch: round key %lu, Kalyna (%lu, %lu)\n", (unsigned long)round,
+                (unsigned long)(ctx->nb * kBITS_IN_WORD),
+                (unsigned long)(ctx->nk * kBITS_IN_WORD));
+            printf("Key:\n");
+            PrintState(ctx->nk, (uint64_t*)key);
+            ++failures;
+            break;
+        }
+    }
+    KalynaDelete(model);
+    return failures;
+}
+
+
+#ifndef KALYNA_FUZZER
+
+/*!
+ * Run streams under kLANES different keys through the multi-buffer routine
+ * of every engine having one, and through the generic lane routines with
+ * streams of unequal length, comparing with the reference.
+ *
+ * @return Number of detected mismatches.
+ */
+static int CheckLanes(kalyna_t* const* ctxs, uint64_t* seed) {
+    size_t e, lane, i, lanes, common;
+    int failures = 0;
+    size_t nb = ctxs[0]->nb;
+    size_t blocks[kLANES];
+    uint64_t input[kLANES][kMAX_BATCH * kNB_512], expect_ct[kLANES][kMAX_BATCH * kNB_512];
+    uint64_t expect_pt[kLANES][kMAX_BATCH * kNB_512], out[kLANES][kMAX_BATCH * kNB_512];
+    const uint64_t* in_ptrs[kLANES];
+    uint64_t* out_ptrs[kLANES];
+    kalyna_lanes_t schedule;
+    const kalyna_engine_t* engine;
+
+    for (lane = 0; lane < kLANES; ++lane) {
+        blocks[lane] = 1 + NextRandom(seed) % kMAX_BATCH;
+        for (i = 0; i < blocks[lane] * nb; ++i)
+            input[lane][i] = NextRandom(seed);
+        for (i = 0; i < blocks[lane] * nb; i += nb) {
+            KalynaEncipher(input[lane] + i, ctxs[lane], expect_ct[lane] + i);
+            KalynaDecipher(input[lane] + i, ctxs[lane], expect_pt[lane] + i);
+        }
+        in_ptrs[lane] = input[lane];
+        out_ptrs[lane] = out[lane];
+    }
+
+    common = blocks[0];
+    for (lane = 1; lane < kLANES; ++lane)
+        common = blocks[lane] < common ? blocks[lane] : common;
+    KalynaLanesLoad(ctxs, kLANES, &schedule);
+    for (e = 0; kalyna_engines[e] != NULL; ++e) {
+        engine = kalyna_engines[e];
+        if (!engine->available() || engine->encipher_lanes == NULL)
+            continue;
+        engine->encipher_lanes(&schedule, in_ptrs, common, out_ptrs);
+        for (lane = 0; lane < kLANES; ++lane) {
+            if (memcmp(out[lane], expect_ct[lane], common * nb * sizeof(uint64_t)) != 0) {
+                printf("Mismatch: multi-buffer enciphering of engine '%s', lane %lu\n",
+                    engine->name, (unsigned long)lane);
+                ++failures;
+            }
+        }
+        engine->decipher_lanes(&schedule, in_ptrs, common, out_ptrs);
+        for (lane = 0; lane < kLANES; ++lane) {
+            if (memcmp(out[lane], expect_pt[lane], common * nb * sizeof(uint64_t)) != 0) {
+                printf("Mismatch: multi-buffer deciphering of engine '%s', lane %lu\n",
+                    engine->name, (unsigned long)lane);
+                ++failures;
+            }
+        }
+    }
+
+    /* Partial schedules and unequal streams through the dispatching routines. */
+    for (lanes = 1; lanes <= kLANES; ++lanes) {
+        KalynaLanesLoad(ctxs, lanes, &schedule);
+        KalynaEncipherLanes(&schedule, in_ptrs, blocks, out_ptrs);
+        for (lane = 0; lane < lanes; ++lane) {
+            if (memcmp(out[lane], expect_ct[lane], blocks[lane] * nb * sizeof(uint64_t)) != 0) {
+                printf("Mismatch: KalynaEncipherLanes, %lu lanes\n", (unsigned long)lanes);
+                ++failures;
+            }
+        }
+        KalynaDecipherLanes(&schedule, in_ptrs, blocks, out_ptrs);
+        for (lane = 0; lane < lanes; ++lane) {
+            if (memcmp(out[lane], expect_pt[lane], blocks[lane] * nb * sizeof(uint64_t)) != 0) {
+                printf("Mismatch: KalynaDecipherLanes, %lu lanes\n", (unsigned long)lanes);
+                ++failures;
+            }
+        }
+    }
+    return failures;
+}
+
+/*!
+ * Submit random jobs for random keys of all variants, several keys per
+ * variant, to a ring and compare
+ * the completed outputs with the direct byte interface.
+ *
+ * @param threaded Nonzero to process jobs by the ring worker thread.
+ * @return Number of detected mismatches.
+ */
+static int CheckRing(uint64_t* seed, int threaded) {
+    static uint8_t input[kRING_JOBS][kRING_MAX_LENGTH];
+    static uint8_t output[kRING_JOBS][kRING_MAX_LENGTH];
+    static uint8_t expect[kRING_MAX_LENGTH];
+    static uint8_t iv[kRING_JOBS][kNB_512 * sizeof(uint64_t)];
+    size_t v, i, j, reaped = 0;
+    int failures = 0;
+    uint64_t key[kNK_512];
+    kalyna_t* ctxs[kRING_CONTEXTS];
+    kalyna_job_t jobs[kRING_JOBS];
+    kalyna_completion_t completions[kRING_JOBS];
+    kalyna_ring_t* ring = KalynaRingInit(kRING_JOBS);
+
+    if (threaded)
+        KalynaRingStart(ring);
+    for (v = 0; v < kRING_CONTEXTS; ++v) {
+        ctxs[v] = KalynaInit(variants[v % kVARIANTS_NUM][0], variants[v % kVARIANTS_NUM][1]);
+        for (i = 0; i < ctxs[v]->nk; ++i)
+            key[i] = NextRandom(seed);
+        KalynaKeyExpand(key, ctxs[v]);
+    }
+
+    for (j = 0; j < kRING_JOBS; ++j) {
+        jobs[j].ctx = ctxs[NextRandom(seed) % kRING_CONTEXTS];
+        jobs[j].mode = (kalyna_job_mode_t)(NextRandom(seed) % 3);
+        jobs[j].length = NextRandom(seed) % kRING_MAX_LENGTH;
+        if (jobs[j].mode != KALYNA_JOB_CTR)
+            jobs[j].length -= jobs[j].length % (jobs[j].ctx->nb * sizeof(uint64_t));
+        for (i = 0; i < jobs[j].length; ++i)
+            input[j][i] = (uint8_t)NextRandom(seed);
+        for (i = 0; i < sizeof(iv[j]); ++i)
+            iv[j][i] = (uint8_t)NextRandom(seed);
+        jobs[j].iv = iv[j];
+        jobs[j].input = input[j];
+        jobs[j].output = output[j];
+        jobs[j].user_data = &jobs[j];
+        if (KalynaRingSubmit(ring, &jobs[j]) != 0) {
+            printf("Mismatch: ring rejected job %lu\n", (unsigned long)j);
+            ++failures;
+        }
+    }
+    if (KalynaRingSubmit(ring, &jobs[0]) == 0) {
+        printf("Mismatch: full ring accepted a job\n");
+        ++failures;
+    }
+
+    while (reaped < kRING_JOBS) {
+        j = KalynaRingReap(ring, completions + reaped, kRING_JOBS - reaped, TRUE);
+        if (j == 0)
+            break;
+        reaped += j;
+    }
+    if (reaped != kRING_JOBS) {
+        printf("Mismatch: %lu of %d ring jobs completed\n", (unsigned long)reaped,
+            kRING_JOBS);
+        ++failures;
+    }
+
+    for (i = 0; i < reaped; ++i) {
+        j = (kalyna_job_t*)completions[i].user_data - jobs;
+        if (jobs[j].mode == KALYNA_JOB_CTR)
+            KalynaCtrBytes(input[j], jobs[j].length, iv[j], jobs[j].ctx, expect);
+        else if (jobs[j].mode == KALYNA_JOB_ECB_ENCRYPT)
+            KalynaEncryptBytes(input[j], jobs[j].length, jobs[j].ctx, expect);
+        else
+            KalynaDecryptBytes(input[j], jobs[j].length, jobs[j].ctx, expect);
+        if (completions[i].result != 0 || memcmp(output[j], expect, jobs[j].length) != 0) {
+            printf("Mismatch: ring job %lu, mode %d, %lu bytes\n", (unsigned long)j,
+                (int)jobs[j].mode, (unsigned long)jobs[j].length);
+            ++failures;
+        }
+    }
+
+    KalynaRingDelete(ring);
+    for (v = 0; v < kRING_CONTEXTS; ++v)
+        KalynaDelete(ctxs[v]);
+    return failures;
+}
+
+/*!
+ * Expand random keys of every variant with KalynaKeyExpand() and with the
+ * model of the original key schedule, comparing all round keys.
+ *
+ * @return Number of detected mismatches.
+ */
+static int CheckKeySchedule(uint64_t* seed) {
+    size_t v, i;
+    int failures = 0;
+    uint64_t key[kNK_512];
+    kalyna_t* ctx;
+
+    for (v = 0; v < kVARIANTS_NUM; ++v) {
+        ctx = KalynaInit(variants[v][0], variants[v][1]);
+        for (i = 0; i < ctx->nk; ++i)
+            key[i] = NextRandom(seed);
+        KalynaKeyExpand(key, ctx);
+        failures += CompareKeySchedule(ctx, key);
+        KalynaDelete(ctx);
+    }
+    return failures;
+}
+
+/*!
+ * CTR_DRBG_Update of the DRBG model, one block at a time with the reference
+ * cipher.
+ */
+static void ModelDrbgUpdate(kalyna_t* ctx, uint64_t* v, const uint8_t* provided) {
+    size_t i;
+    uint64_t block[kNB_256], key[kNK_512];
+    uint8_t temp[KALYNA_DRBG_SEED_BYTES];
+
+    for (i = 0; i < KALYNA_DRBG_SEED_BYTES; i += sizeof(block)) {
+        CtrCounters(v, 1, kNB_256, block);
+        KalynaEncipher(block, ctx, block);
+        WriteWords(kNB_256, block, temp + i);
+    }
+    for (i = 0; i < KALYNA_DRBG_SEED_BYTES; ++i)
+        temp[i] ^= provided[i];
+    ReadWords(kNK_512, temp, key);
+    KalynaKeyExpand(key, ctx);
+    ReadWords(kNB_256, temp + sizeof(key), v);
+}
+
+/*!
+ * Model output of `length` bytes: refills of 16 KiB followed by an update.
+ */
+static void ModelDrbgGenerate(kalyna_t* ctx, uint64_t* v, uint8_t* output, size_t length) {
+    static const uint8_t zeros[KALYNA_DRBG_SEED_BYTES];
+    size_t i, refill;
+    uint64_t block[kNB_256];
+
+    for (refill = 0; refill < length; refill += 16 * 1024) {
+        for (i = refill; i < refill + 16 * 1024; i += sizeof(block)) {
+            CtrCounters(v, 1, kNB_256, block);
+            KalynaEncipher(block, ctx, block);
+            if (i < length)
+                WriteWords(kNB_256, block, output + i);
+        }
+        ModelDrbgUpdate(ctx, v, zeros);
+    }
+}
+
+/*!
+ * Compare the DRBG, read in requests of random sizes, with a block by block
+ * model of CTR_DRBG, before and after a reseed.
+ *
+ * @return Number of detected mismatches.
+ */
+static int CheckDrbg(uint64_t* seed) {
+    static uint8_t output[kDRBG_CHECK_BYTES + 1], expect[kDRBG_CHECK_BYTES + 1];
+    size_t i, chunk;
+    int failures = 0;
+    uint8_t entropy[40], personalization[20], material[KALYNA_DRBG_SEED_BYTES];
+    uint64_t key[kNK_512], v[kNB_256];
+    kalyna_t* ctx = KalynaInit(kBLOCK_256, kKEY_512);
+    kalyna_drbg_t* drbg;
+
+    for (i = 0; i < sizeof(entropy); ++i)
+        entropy[i] = (uint8_t)NextRandom(seed);
+    for (i = 0; i < sizeof(personalization); ++i)
+        personalization[i] = (uint8_t)NextRandom(seed);
+    memset(material, 0, sizeof(material));
+    for (i = 0; i < sizeof(entropy); ++i)
+        material[i] = entropy[i] ^ (i < sizeof(personalization) ? personalization[i] : 0);
+
+    memset(key, 0, sizeof(key));
+    memset(v, 0, sizeof(v));
+    KalynaKeyExpand(key, ctx);
+    ModelDrbgUpdate(ctx, v, material);
+    ModelDrbgGenerate(ctx, v, expect, kDRBG_CHECK_BYTES);
+
+    drbg = KalynaDrbgInit(entropy, sizeof(entropy), personalization,
+        sizeof(personalization));
+    for (i = 0; i < kDRBG_CHECK_BYTES; i += chunk) {
+        chunk = 1 + NextRandom(seed) % 3000;
+        chunk = chunk < kDRBG_CHECK_BYTES - i ? chunk : kDRBG_CHECK_BYTES - i;
+        KalynaDrbgGenerate(drbg, output + i, chunk);
+    }
+    if (memcmp(output, expect, kDRBG_CHECK_BYTES) != 0) {
+        printf("Mismatch: DRBG output\n");
+        ++failures;
+    }
+
+    /* Reseed with the personalization as additional input. */
+    ModelDrbgUpdate(ctx, v, material);
+    ModelDrbgGenerate(ctx, v, expect, 1000);
+    KalynaDrbgReseed(drbg, entropy, sizeof(entropy), personalization,
+        sizeof(personalization));
+    KalynaDrbgGenerate(drbg, output, 1000);
+    if (memcmp(output, expect, 1000) != 0) {
+        printf("Mismatch: DRBG output after reseed\n");
+        ++failures;
+    }
+
+    if (KalynaRandomBytes(output, 100) != 0 || KalynaRandomBytes(expect, 100) != 0 ||
+            memcmp(output, expect, 100) == 0) {
+        printf("Mismatch: KalynaRandomBytes\n");
+        ++failures;
+    }
+    KalynaDrbgDelete(drbg);
+    KalynaDelete(ctx);
+    return failures;
+}
+
+/*!
+ * CMAC computed byte by byte, with subkeys doubled byte by byte.
+ */
+static void ModelCmac(kalyna_t* ctx, const uint8_t* message, size_t length, uint8_t* tag) {
+    size_t i, j, block_len = ctx->nb * sizeof(uint64_t);
+    size_t blocks = length == 0 ? 1 : (length + block_len - 1) / block_len;
+    uint8_t subkey[2][kNB_512 * sizeof(uint64_t)], chain[kNB_512 * sizeof(uint64_t)];
+    uint8_t carry;
+    uint64_t words[kNB_512];
+
+    memset(words, 0, sizeof(words));
+    KalynaEncipher(words, ctx, words);
+    WriteWords(ctx->nb, words, chain);
+    for (j = 0; j < 2; ++j) {
+        carry = chain[block_len - 1] >> 7;
+        for (i = block_len - 1; i > 0; --i)
+            chain[i] = (uint8_t)(chain[i] << 1 | chain[i - 1] >> 7);
+        chain[0] = (uint8_t)(chain[0] << 1);
+        if (carry && block_len == 16) {
+            chain[0] ^= 0x87;
+        } else if (carry) {
+            chain[0] ^= 0x25;
+            chain[1] ^= block_len == 32 ? 0x04 : 0x01;
+        }
+        memcpy(subkey[j], chain, block_len);
+    }
+
+    memset(chain, 0, block_len);
+    for (i = 0; i < blocks; ++i) {
+        for (j = 0; j < block_len; ++j) {
+            if (i * block_len + j < length)
+                chain[j] ^= message[i * block_len + j];
+            else if (i * block_len + j == length)
+                chain[j] ^= 0x80;
+        }
+        if (i + 1 == blocks) {
+            for (j = 0; j < block_len; ++j)
+                chain[j] ^= subkey[length == blocks * block_len ? 0 : 1][j];
+        }
+        ReadWords(ctx->nb, chain, words);
+        KalynaEncipher(words, ctx, words);
+        WriteWords(ctx->nb, words, chain);
+    }
+    memcpy(tag, chain, block_len);
+}
+
+/*!
+ * Tree MAC computed from its description: CMAC of prefixed chunks, pairs
+ * combined level by level, prefixed root.
+ */
+static void ModelTreeMac(kalyna_t* ctx, const uint8_t* data, size_t length,
+        size_t chunk_bytes, uint8_t* tag) {
+    static uint8_t nodes[kTREE_MAC_BYTES + 1][kNB_512 * sizeof(uint64_t)];
+    static uint8_t message[kTREE_MAC_BYTES + 3 * kNB_512 * sizeof(uint64_t)];
+    size_t i, count, level, chunk, block_len = ctx->nb * sizeof(uint64_t);
+    uint64_t prefix[kNB_512];
+
+    count = length == 0 ? 1 : (length + chunk_bytes - 1) / chunk_bytes;
+    for (i = 0; i < count; ++i) {
+        memset(prefix, 0, sizeof(prefix));
+        prefix[1] = i;
+        WriteWords(ctx->nb, prefix, message);
+        chunk = length - i * chunk_bytes < chunk_bytes ? length - i * chunk_bytes : chunk_bytes;
+        memcpy(message + block_len, data + i * chunk_bytes, chunk);
+        ModelCmac(ctx, message, block_len + chunk, nodes[i]);
+    }
+    for (level = 1; count > 1; ++level) {
+        for (i = 0; 2 * i < count; ++i) {
+            if (2 * i + 1 == count) {
+                memcpy(nodes[i], nodes[2 * i], block_len);
+                continue;
+            }
+            memset(prefix, 0, sizeof(prefix));
+            prefix[0] = 1 | level << 8;
+            prefix[1] = i;
+            WriteWords(ctx->nb, prefix, message);
+            memcpy(message + block_len, nodes[2 * i], block_len);
+            memcpy(message + 2 * block_len, nodes[2 * i + 1], block_len);
+            ModelCmac(ctx, message, 3 * block_len, nodes[i]);
+        }
+        count = (count + 1) / 2;
+    }
+    memset(prefix, 0, sizeof(prefix));
+    prefix[0] = 2 | (uint64_t)chunk_bytes << 8;
+    prefix[1] = length;
+    WriteWords(ctx->nb, prefix, message);
+    memcpy(message + block_len, nodes[0], block_len);
+    ModelCmac(ctx, message, 2 * block_len, tag);
+}
+
+/*!
+ * Compare the tree MAC, one-shot with several threads and incremental with
+ * a replaced chunk, with the model.
+ *
+ * @return Number of detected mismatches.
+ */
+static int CheckTreeMac(uint64_t* seed) {
+    static uint8_t data[kTREE_MAC_BYTES];
+    size_t i, offset, count, chunks, threads;
+    int failures = 0;
+    uint64_t key[kNK_512];
+    uint8_t tag[kNB_512 * sizeof(uint64_t)], expect[kNB_512 * sizeof(uint64_t)];
+    size_t v = NextRandom(seed) % kVARIANTS_NUM;
+    kalyna_t* ctx = KalynaInit(variants[v][0], variants[v][1]);
+    size_t block_len = ctx->nb * sizeof(uint64_t);
+    size_t chunk_bytes = block_len * (1 + NextRandom(seed) % 5);
+    size_t length = NextRandom(seed) % 4 == 0 ? NextRandom(seed) % 3 * chunk_bytes :
+        NextRandom(seed) % kTREE_MAC_BYTES;
+    kalyna_tree_mac_t* tree;
+
+    for (i = 0; i < ctx->nk; ++i)
+        key[i] = NextRandom(seed);
+    KalynaKeyExpand(key, ctx);
+    for (i = 0; i < length; ++i)
+        data[i] = (uint8_t)NextRandom(seed);
+    ModelTreeMac(ctx, data, length, chunk_bytes, expect);
+
+    for (threads = 1; threads <= 3; ++threads) {
+        if (KalynaTreeMac(ctx, data, length, chunk_bytes, threads, tag) != 0 ||
+                memcmp(tag, expect, block_len) != 0) {
+            printf("Mismatch: tree MAC of %lu bytes, %lu byte chunks, %lu threads\n",
+                (unsigned long)length, (unsigned long)chunk_bytes, (unsigned long)threads);
+            ++failures;
+        }
+    }
+
+    /* Set chunks in random runs, then replace one chunk. */
+    chunks = length == 0 ? 1 : (length + chunk_bytes - 1) / chunk_bytes;
+    tree = KalynaTreeMacInit(ctx, chunk_bytes, length);
+    for (i = 0; i < chunks; i += count) {
+        count = 1 + NextRandom(seed) % 6;
+        count = count < chunks - i ? count : chunks - i;
+        offset = i * chunk_bytes;
+        if (i + 1 < chunks && KalynaTreeMacFinal(tree, tag) == 0) {
+            printf("Mismatch: tree MAC with missing chunks\n");
+            ++failures;
+        }
+        KalynaTreeMacUpdate(tree, i, data + offset, i + count < chunks ?
+            count * chunk_bytes : length - offset);
+    }
+    if (length > 0) {
+        i = NextRandom(seed) % chunks;
+        data[i * chunk_bytes] ^= 1;
+        ModelTreeMac(ctx, data, length, chunk_bytes, expect);
+        KalynaTreeMacFinal(tree, tag);
+        KalynaTreeMacUpdate(tree, i, data + i * chunk_bytes, i + 1 < chunks ?
+            chunk_bytes : length - i * chunk_bytes);
+    }
+    if (KalynaTreeMacFinal(tree, tag) != 0 || memcmp(tag, expect, block_len) != 0) {
+        printf("Mismatch: incremental tree MAC of %lu bytes\n", (unsigned long)length);
+        ++failures;
+    }
+    KalynaTreeMacDelete(tree);
+    KalynaDelete(ctx);
+    return failures;
+}
+
+/* Keys of a KDF batch and the longest label and context of the check. */
+#define kKDF_KEYS 300
+#define kKDF_FIELD 40
+
+/*!
+ * SP 800-108 counter mode KDF with ModelCmac() as the PRF, one key.
+ */
+static void ModelKdf(kalyna_t* ctx, const uint8_t* label, size_t label_len,
+        const uint8_t* context, size_t context_len, uint64_t index, size_t key_bytes,
+        uint8_t* key) {
+    size_t i, b, length, block_len = ctx->nb * sizeof(uint64_t);
+    uint8_t message[4 + kKDF_FIELD + 1 + kKDF_FIELD + 8 + 4];
+    uint8_t output[kNB_512 * sizeof(uint64_t)];
+
+    for (i = 0; i * block_len < key_bytes; ++i) {
+        length = 0;
+        for (b = 0; b < 4; ++b)
+            message[length++] = (uint8_t)((i + 1) >> (24 - 8 * b));
+        memcpy(message + length, label, label_len);
+        length += label_len;
+        message[length++] = 0;
+        memcpy(message + length, context, context_len);
+        length += context_len;
+        for (b = 0; b < 8; ++b)
+            message[length++] = (uint8_t)(index >> (56 - 8 * b));
+        for (b = 0; b < 4; ++b)
+            message[length++] = (uint8_t)((key_bytes * 8) >> (24 - 8 * b));
+        ModelCmac(ctx, message, length, output);
+        memcpy(key + i * block_len, output,
+            key_bytes - i * block_len < block_len ? key_bytes - i * block_len : block_len);
+    }
+}
+
+/*!
+ * Check batched key derivation against the model, as bytes across batch
+ * boundaries and as expanded contexts.
+ *
+ * @return Number of detected mismatches.
+ */
+static int CheckKdf(uint64_t* seed) {
+    static uint8_t keys[kKDF_KEYS * kKDF_FIELD];
+    size_t i, n, r, w;
+    int failures = 0;
+    uint64_t key[kNK_512];
+    uint8_t label[kKDF_FIELD], context[kKDF_FIELD], expect[kKDF_FIELD];
+    uint8_t derived[kNK_512 * sizeof(uint64_t)];
+    size_t v = NextRandom(seed) % kVARIANTS_NUM;
+    size_t label_len = NextRandom(seed) % (kKDF_FIELD + 1);
+    size_t context_len = NextRandom(seed) % (kKDF_FIELD + 1);
+    size_t key_bytes = 1 + NextRandom(seed) % kKDF_FIELD;
+    size_t count = 1 + NextRandom(seed) % kKDF_KEYS;
+    uint64_t first = NextRandom(seed);
+    kalyna_t* master = KalynaInit(variants[v][0], variants[v][1]);
+    kalyna_t* ctxs[kKDF_KEYS];
+    kalyna_t* expect_ctx;
+
+    for (i = 0; i < master->nk; ++i)
+        key[i] = NextRandom(seed);
+    KalynaKeyExpand(key, master);
+    for (i = 0; i < kKDF_FIELD; ++i) {
+        label[i] = (uint8_t)NextRandom(seed);
+        context[i] = (uint8_t)NextRandom(seed);
+    }
+
+    if (KalynaKdfDerive(master, label, label_len, context, context_len, first, count,
+            key_bytes, keys) != 0) {
+        printf("Mismatch: KDF of %lu keys failed\n", (unsigned long)count);
+        ++failures;
+    }
+    for (n = 0; n < count && failures == 0; ++n) {
+        ModelKdf(master, label, label_len, context, context_len, first + n, key_bytes,
+            expect);
+        if (memcmp(keys + n * key_bytes, expect, key_bytes) != 0) {
+            printf("Mismatch: KDF key %lu of %lu, %lu bytes\n", (unsigned long)n,
+                (unsigned long)count, (unsigned long)key_bytes);
+            ++failures;
+        }
+    }
+
+    w = NextRandom(seed) % kVARIANTS_NUM;
+    count = 1 + NextRandom(seed) % 80;
+    if (KalynaKdfDeriveContexts(master, label, label_len, context, context_len, first,
+            count, variants[w][0], variants[w][1], ctxs) != 0) {
+        printf("Mismatch: KDF of %lu contexts failed\n", (unsigned long)count);
+        KalynaDelete(master);
+        return failures + 1;
+    }
+    expect_ctx = KalynaInit(variants[w][0], variants[w][1]);
+    for (n = 0; n < count; ++n) {
+        ModelKdf(master, label, label_len, context, context_len, first + n,
+            expect_ctx->nk * sizeof(uint64_t), derived);
+        ReadWords(expect_ctx->nk, derived, key);
+        KalynaKeyExpand(key, expect_ctx);
+        for (r = 0; r <= expect_ctx->nr; ++r) {
+            if (memcmp(ctxs[n]->round_keys[r], expect_ctx->round_keys[r],
+                    expect_ctx->nb * sizeof(uint64_t)) != 0 ||
+                    memcmp(ctxs[n]->round_keys_dec[r], expect_ctx->round_keys_dec[r],
+                    expect_ctx->nb * sizeof(uint64_t)) != 0) {
+                printf("Mismatch: KDF context %lu of %lu, round %lu\n", (unsigned long)n,
+                    (unsigned long)count, (unsigned long)r);
+                ++failures;
+                break;
+            }
+        }
+        KalynaDelete(ctxs[n]);
+    }
+    KalynaDelete(expect_ctx);
+    KalynaDelete(master);
+    return failures;
+}
+
+/*!
+ * Multiply field elements stored as little endian bytes bit by bit:
+ * shift-and-add from the top bit of `a`, reducing like the CMAC doubling.
+ */
+static void ModelGfMultiply(size_t block_len, const uint8_t* a, const uint8_t* b,
+        uint8_t* product) {
+    size_t i, j;
+    int bit;
+    uint8_t carry, z[kNB_512 * sizeof(uint64_t)];
+
+    memset(z, 0, block_len);
+    for (i = block_len; i-- > 0;) {
+        for (bit = 7; bit >= 0; --bit) {
+            carry = z[block_len - 1] >> 7;
+            for (j = block_len - 1; j > 0; --j)
+                z[j] = (uint8_t)(z[j] << 1 | z[j - 1] >> 7);
+            z[0] = (uint8_t)(z[0] << 1);
+            if (carry && block_len == 16) {
+                z[0] ^= 0x87;
+            } else if (carry) {
+                z[0] ^= 0x25;
+                z[1] ^= block_len == 32 ? 0x04 : 0x01;
+            }
+            if (a[i] >> bit & 1) {
+                for (j = 0; j < block_len; ++j)
+                    z[j] ^= b[j];
+            }
+        }
+    }
+    memcpy(product, z, block_len);
+}
+
+/* Absorb zero padded bytes into a GHASH value. */
+static void ModelGhash(size_t block_len, const uint8_t* h, const uint8_t* data,
+        size_t length, uint8_t* hash) {
+    size_t i, j;
+    for (i = 0; i < length; i += block_len) {
+        for (j = 0; j < block_len && i + j < length; ++j)
+            hash[j] ^= data[i + j];
+        ModelGfMultiply(block_len, hash, h, hash);
+    }
+}
+
+/*!
+ * GCM computed block by block from its description in kalyna_gcm.h.
+ */
+static void ModelGcm(kalyna_t* ctx, const uint8_t* nonce, const uint8_t* aad,
+        size_t aad_len, const uint8_t* input, size_t length, uint8_t* output, uint8_t* tag) {
+    size_t i, j, block_len = ctx->nb * sizeof(uint64_t);
+    unsigned int sum;
+    uint8_t h[kNB_512 * sizeof(uint64_t)], counter[kNB_512 * sizeof(uint64_t)];
+    uint8_t gamma[kNB_512 * sizeof(uint64_t)], hash[kNB_512 * sizeof(uint64_t)];
+    uint64_t words[kNB_512];
+
+    memset(words, 0, sizeof(words));
+    KalynaEncipher(words, ctx, words);
+    WriteWords(ctx->nb, words, h);
+    ReadWords(ctx->nb, nonce, words);
+    KalynaEncipher(words, ctx, words);
+    WriteWords(ctx->nb, words, counter);
+    for (i = 0; i < length; ++i) {
+        if (i % block_len == 0) {
+            for (j = 0, sum = 1; j < block_len; ++j, sum >>= 8) {
+                sum += counter[j];
+                counter[j] = (uint8_t)sum;
+            }
+            ReadWords(ctx->nb, counter, words);
+            KalynaEncipher(words, ctx, words);
+            WriteWords(ctx->nb, words, gamma);
+        }
+        output[i] = input[i] ^ gamma[i % block_len];
+    }
+
+    memset(hash, 0, block_len);
+    ModelGhash(block_len, h, aad, aad_len, hash);
+    ModelGhash(block_len, h, output, length, hash);
+    ReadWords(ctx->nb, hash, words);
+    words[0] ^= (uint64_t)aad_len * 8;
+    words[ctx->nb / 2] ^= (uint64_t)length * 8;
+    KalynaEncipher(words, ctx, words);
+    WriteWords(ctx->nb, words, tag);
+}
+
+/*!
+ * Compare GCM with the model, decrypt in place and check that altered
+ * ciphertext, additional data or tag is rejected without writing output.
+ *
+ * @return Number of detected mismatches.
+ */
+static int CheckGcm(uint64_t* seed) {
+    static uint8_t input[kGCM_BYTES], output[kGCM_BYTES], expect[kGCM_BYTES];
+    static uint8_t aad[kGCM_AAD_BYTES];
+    size_t i, target;
+    int failures = 0;
+    uint64_t key[kNK_512];
+    uint8_t nonce[kNB_512 * sizeof(uint64_t)];
+    uint8_t tag[kNB_512 * sizeof(uint64_t)], expect_tag[kNB_512 * sizeof(uint64_t)];
+    size_t v = NextRandom(seed) % kVARIANTS_NUM;
+    kalyna_t* ctx = KalynaInit(variants[v][0], variants[v][1]);
+    size_t block_len = ctx->nb * sizeof(uint64_t);
+    size_t length = NextRandom(seed) % kGCM_BYTES;
+    size_t aad_len = NextRandom(seed) % kGCM_AAD_BYTES;
+
+    for (i = 0; i < ctx->nk; ++i)
+        key[i] = NextRandom(seed);
+    KalynaKeyExpand(key, ctx);
+    /* All ones nonces exercise the carry through the whole counter. */
+    for (i = 0; i < block_len; ++i)
+        nonce[i] = NextRandom(seed) % 2 ? 0xFF : (uint8_t)NextRandom(seed);
+    for (i = 0; i < length; ++i)
+        input[i] = (uint8_t)NextRandom(seed);
+    for (i = 0; i < aad_len; ++i)
+        aad[i] = (uint8_t)NextRandom(seed);
+
+    ModelGcm(ctx, nonce, aad, aad_len, input, length, expect, expect_tag);
+    KalynaGcmEncrypt(ctx, nonce, aad, aad_len, input, length, output, tag);
+    if (memcmp(output, expect, length) != 0 || memcmp(tag, expect_tag, block_len) != 0) {
+        printf("Mismatch: GCM (%lu, %lu) of %lu bytes, %lu bytes of data\n",
+            (unsigned long)variants[v][0], (unsigned long)variants[v][1],
+            (unsigned long)length, (unsigned long)aad_len);
+        ++failures;
+    }
+    if (KalynaGcmDecrypt(ctx, nonce, aad, aad_len, output, length, tag, output) != 0 ||
+            memcmp(output, input, length) != 0) {
+        printf("Mismatch: GCM decryption of %lu bytes\n", (unsigned long)length);
+        ++failures;
+    }
+
+    memcpy(output, expect, length);
+    target = NextRandom(seed) % (length + aad_len + block_len);
+    if (target < length)
+        output[target] ^= 1 << NextRandom(seed) % 8;
+    else if (target < length + aad_len)
+        aad[target - length] ^= 1 << NextRandom(seed) % 8;
+    else
+        tag[target - length - aad_len] ^= 1 << NextRandom(seed) % 8;
+    memcpy(input, output, length);
+    if (KalynaGcmDecrypt(ctx, nonce, aad, aad_len, output, length, tag, output) == 0 ||
+            memcmp(output, input, length) != 0) {
+        printf("Mismatch: GCM accepted an altered message\n");
+        ++failures;
+    }
+    KalynaDelete(ctx);
+    return failures;
+}
+
+/*!
+ * Write a container in random pieces, read random ranges back with the
+ * reader and check that an altered byte anywhere in the file, a truncated
+ * file and a wrong key are rejected.
+ *
+ * @return Number of detected mismatches.
+ */
+static int CheckContainer(uint64_t* seed) {
+    static uint8_t data[kCONTAINER_BYTES], output[kCONTAINER_BYTES];
+    char path[] = "/tmp/kalyna-container-XXXXXX";
+    size_t i, offset, piece, size, chunk_bytes, threads;
+    int fd, result, failures = 0;
+    uint64_t key[kNK_512];
+    uint8_t byte, flip;
+    size_t v = NextRandom(seed) % kVARIANTS_NUM;
+    size_t length = NextRandom(seed) % 4 == 0 ? 0 : NextRandom(seed) % kCONTAINER_BYTES;
+    kalyna_t* ctx = KalynaInit(variants[v][0], variants[v][1]);
+    kalyna_writer_t* writer;
+    kalyna_reader_t* reader;
+
+    for (i = 0; i < ctx->nk; ++i)
+        key[i] = NextRandom(seed);
+    KalynaKeyExpand(key, ctx);
+    for (i = 0; i < length; ++i)
+        data[i] = (uint8_t)NextRandom(seed);
+    chunk_bytes = 1 + NextRandom(seed) % 700;
+    threads = 1 + NextRandom(seed) % 3;
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        perror("Could not create container file");
+        KalynaDelete(ctx);
+        return 1;
+    }
+    writer = KalynaWriterOpen(ctx, fd, chunk_bytes, threads);
+    for (offset = 0; offset < length; offset += piece) {
+        piece = 1 + NextRandom(seed) % (3 * chunk_bytes * threads * 4);
+        piece = piece < length - offset ? piece : length - offset;
+        KalynaWriterWrite(writer, data + offset, piece);
+    }
+    if (KalynaWriterClose(writer) != 0) {
+        printf("Mismatch: container writer failed\n");
+        ++failures;
+    }
+
+    if (KalynaReaderOpen(ctx, path, 1 + NextRandom(seed) % 3, &reader) != 0 ||
+            KalynaReaderLength(reader) != length) {
+        printf("Mismatch: container of %lu bytes in %lu byte chunks not opened\n",
+            (unsigned long)length, (unsigned long)chunk_bytes);
+        ++failures;
+    } else {
+        for (i = 0; i < 8; ++i) {
+            offset = i == 0 ? 0 : NextRandom(seed) % (length + 1);
+            piece = i == 0 ? length : NextRandom(seed) % (length - offset + 1);
+            if (KalynaReaderRead(reader, offset, output, piece) != 0 ||
+                    memcmp(output, data + offset, piece) != 0) {
+                printf("Mismatch: container read of %lu bytes at %lu, %lu byte chunks\n",
+                    (unsigned long)piece, (unsigned long)offset, (unsigned long)chunk_bytes);
+                ++failures;
+            }
+        }
+        if (KalynaReaderRead(reader, length, output, 1) != KALYNA_CONTAINER_ERROR) {
+            printf("Mismatch: container read past the end\n");
+            ++failures;
+        }
+    }
+    if (reader != NULL)
+        KalynaReaderClose(reader);
+
+    /*
+     * Flip a bit anywhere: opening the file must find it malformed, or
+     * opening or reading all of it corrupt.
+     */
+    size = (size_t)lseek(fd, 0, SEEK_END);
+    offset = NextRandom(seed) % size;
+    flip = (uint8_t)(1 << NextRandom(seed) % 8);
+    if (pread(fd, &byte, 1, offset) != 1 || (byte ^= flip, pwrite(fd, &byte, 1, offset)) != 1) {
+        perror("Could not alter container file");
+        ++failures;
+    }
+    result = KalynaReaderOpen(ctx, path, 1, &reader);
+    if (result == 0) {
+        result = KalynaReaderRead(reader, 0, output, length);
+        KalynaReaderClose(reader);
+    }
+    if (result != KALYNA_CONTAINER_MALFORMED && result != KALYNA_CONTAINER_CORRUPT) {
+        printf("Mismatch: container with byte %lu of %lu altered gave %d\n",
+            (unsigned long)offset, (unsigned long)size, result);
+        ++failures;
+    }
+    byte ^= flip;
+    pwrite(fd, &byte, 1, offset);
+
+    /* Another key fails on the last chunk, so does a truncated file. */
+    key[0] ^= 1;
+    KalynaKeyExpand(key, ctx);
+    result = KalynaReaderOpen(ctx, path, 1, &reader);
+    if (result != KALYNA_CONTAINER_CORRUPT) {
+        printf("Mismatch: container opened with another key gave %d\n", result);
+        if (result == 0)
+            KalynaReaderClose(reader);
+        ++failures;
+    }
+    key[0] ^= 1;
+    KalynaKeyExpand(key, ctx);
+    if (ftruncate(fd, size - 1) == 0) {
+        result = KalynaReaderOpen(ctx, path, 1, &reader);
+        if (result != KALYNA_CONTAINER_MALFORMED) {
+            printf("Mismatch: truncated container gave %d\n", result);
+            if (result == 0)
+                KalynaReaderClose(reader);
+            ++failures;
+        }
+    }
+    close(fd);
+    unlink(path);
+    if (KalynaReaderOpen(ctx, path, 1, &reader) != KALYNA_CONTAINER_IO) {
+        printf("Mismatch: missing container not reported as an I/O error\n");
+        ++failures;
+    }
+    KalynaDelete(ctx);
+    return failures;
+}
+
+/*!
+ * CFB computed segment by segment with a byte shift register.
+ *
+ * @param decrypt Nonzero to decrypt: the register takes the input.
+ */
+static void ModelCfb(kalyna_t* ctx, const uint8_t* input, size_t length, const uint8_t* iv,
+        size_t segment, int decrypt, uint8_t* output) {
+    size_t i, j, block_len = ctx->nb * sizeof(uint64_t);
+    uint8_t shift[kNB_512 * sizeof(uint64_t)], gamma[kNB_512 * sizeof(uint64_t)];
+    uint64_t words[kNB_512];
+
+    memcpy(shift, iv, block_len);
+    for (i = 0; i < length; i += segment) {
+        ReadWords(ctx->nb, shift, words);
+        KalynaEncipher(words, ctx, words);
+        WriteWords(ctx->nb, words, gamma);
+        for (j = 0; j + segment < block_len; ++j)
+            shift[j] = shift[j + segment];
+        for (j = 0; j < segment && i + j < length; ++j) {
+            shift[block_len - segment + j] = decrypt ? input[i + j] : input[i + j] ^ gamma[j];
+            output[i + j] = input[i + j] ^ gamma[j];
+        }
+    }
+}
+
+/* OFB computed block by block. */
+static void ModelOfb(kalyna_t* ctx, const uint8_t* input, size_t length, const uint8_t* iv,
+        uint8_t* output) {
+    size_t i, block_len = ctx->nb * sizeof(uint64_t);
+    uint8_t gamma[kNB_512 * sizeof(uint64_t)];
+    uint64_t words[kNB_512];
+
+    ReadWords(ctx->nb, iv, words);
+    for (i = 0; i < length; ++i) {
+        if (i % block_len == 0) {
+            KalynaEncipher(words, ctx, words);
+            WriteWords(ctx->nb, words, gamma);
+        }
+        output[i] = input[i] ^ gamma[i % block_len];
+    }
+}
+
+/* Longest buffer of the streaming check. */
+#define kSTREAMING_BYTES (64 * 1024)
+
+/*!
+ * Compare ECB and CTR over buffers past a lowered streaming threshold with
+ * the cached path, in place and not, with aligned and unaligned buffers.
+ *
+ * @return Number of detected mismatches.
+ */
+static int CheckStreaming(uint64_t* seed) {
+    static uint8_t input[kSTREAMING_BYTES + 32], output[kSTREAMING_BYTES + 32];
+    static uint8_t expect[kSTREAMING_BYTES];
+    size_t i, op;
+    int failures = 0;
+    uint64_t key[kNK_512];
+    uint8_t iv[kNB_512 * sizeof(uint64_t)];
+    size_t v = NextRandom(seed) % kVARIANTS_NUM;
+    kalyna_t* ctx = KalynaInit(variants[v][0], variants[v][1]);
+    size_t block_len = ctx->nb * sizeof(uint64_t);
+    size_t length = NextRandom(seed) % (kSTREAMING_BYTES + 1);
+    size_t in_offset = NextRandom(seed) % 2 == 0 ? 0 : NextRandom(seed) % 16;
+    size_t out_offset = NextRandom(seed) % 4 == 0 ? NextRandom(seed) % 16 : 0;
+    int in_place = NextRandom(seed) % 2;
+    size_t threshold = StreamingThreshold(0);
+    uint8_t* source = input + in_offset;
+    uint8_t* target = in_place ? source : output + out_offset;
+
+    for (i = 0; i < ctx->nk; ++i)
+        key[i] = NextRandom(seed);
+    KalynaKeyExpand(key, ctx);
+    for (i = 0; i < block_len; ++i)
+        iv[i] = (uint8_t)NextRandom(seed);
+
+    for (op = 0; op < 3; ++op) {
+        if (op < 2)
+            length -= length % block_len;
+        for (i = 0; i < length; ++i)
+            source[i] = (uint8_t)NextRandom(seed);
+        StreamingThreshold(SIZE_MAX);
+        if (op == 0)
+            KalynaEncryptBytes(source, length, ctx, expect);
+        else if (op == 1)
+            KalynaDecryptBytes(source, length, ctx, expect);
+        else
+            KalynaCtrBytes(source, length, iv, ctx, expect);
+        StreamingThreshold(1 + NextRandom(seed) % (length + 1));
+        if (op == 0)
+            KalynaEncryptBytes(source, length, ctx, target);
+        else if (op == 1)
+            KalynaDecryptBytes(source, length, ctx, target);
+        else
+            KalynaCtrBytes(source, length, iv, ctx, target);
+        if (memcmp(target, expect, length) != 0) {
+            printf("Mismatch: streaming %s of %lu bytes, offsets %lu and %lu%s\n",
+                op == 0 ? "ECB encryption" : op == 1 ? "ECB decryption" : "CTR",
+                (unsigned long)length, (unsigned long)in_offset,
+                (unsigned long)out_offset, in_place ? ", in place" : "");
+            ++failures;
+        }
+    }
+    StreamingThreshold(threshold);
+    KalynaDelete(ctx);
+    return failures;
+}
+
+/*!
+ * Compare CFB with a random segment size and OFB, one-shot and through a
+ * stream with random precomputation, with the models, in place and not.
+ *
+ * @return Number of detected mismatches.
+ */
+static int CheckFeedback(uint64_t* seed) {
+    static uint8_t input[kFEEDBACK_BYTES], output[kFEEDBACK_BYTES], expect[kFEEDBACK_BYTES];
+    size_t i, offset, chunk, segment;
+    int failures = 0;
+    uint64_t key[kNK_512];
+    uint8_t iv[kNB_512 * sizeof(uint64_t)];
+    size_t v = NextRandom(seed) % kVARIANTS_NUM;
+    kalyna_t* ctx = KalynaInit(variants[v][0], variants[v][1]);
+    size_t block_len = ctx->nb * sizeof(uint64_t);
+    size_t length = NextRandom(seed) % kFEEDBACK_BYTES;
+    kalyna_ofb_t* ofb;
+
+    for (i = 0; i < ctx->nk; ++i)
+        key[i] = NextRandom(seed);
+    KalynaKeyExpand(key, ctx);
+    for (i = 0; i < block_len; ++i)
+        iv[i] = (uint8_t)NextRandom(seed);
+    for (i = 0; i < length; ++i)
+        input[i] = (uint8_t)NextRandom(seed);
+    /* Full blocks half of the time, otherwise any segment size. */
+    segment = NextRandom(seed) % 2 ? block_len : 1 + NextRandom(seed) % block_len;
+
+    ModelCfb(ctx, input, length, iv, segment, FALSE, expect);
+    if (KalynaCfbEncrypt(input, length, iv, segment * 8, ctx, output) != 0 ||
+            memcmp(output, expect, length) != 0) {
+        printf("Mismatch: CFB-%lu encryption (%lu, %lu) of %lu bytes\n",
+            (unsigned long)segment * 8, (unsigned long)variants[v][0],
+            (unsigned long)variants[v][1], (unsigned long)length);
+        ++failures;
+    }
+    if (KalynaCfbDecrypt(output, length, iv, segment * 8, ctx, output) != 0 ||
+            memcmp(output, input, length) != 0) {
+        printf("Mismatch: CFB-%lu decryption in place of %lu bytes\n",
+            (unsigned long)segment * 8, (unsigned long)length);
+        ++failures;
+    }
+    ModelCfb(ctx, input, length, iv, segment, TRUE, expect);
+    if (KalynaCfbDecrypt(input, length, iv, segment * 8, ctx, output) != 0 ||
+            memcmp(output, expect, length) != 0) {
+        printf("Mismatch: CFB-%lu decryption of %lu bytes\n",
+            (unsigned long)segment * 8, (unsigned long)length);
+        ++failures;
+    }
+    if (KalynaCfbEncrypt(input, length, iv, 4, ctx, output) == 0 ||
+            KalynaCfbDecrypt(input, length, iv, block_len * 8 + 8, ctx, output) == 0) {
+        printf("Mismatch: CFB accepted a wrong segment size\n");
+        ++failures;
+    }
+
+    ModelOfb(ctx, input, length, iv, expect);
+    memcpy(output, input, length);
+    if (KalynaOfbBytes(output, length, iv, ctx, output) != 0 ||
+            memcmp(output, expect, length) != 0) {
+        printf("Mismatch: OFB of %lu bytes\n", (unsigned long)length);
+        ++failures;
+    }
+    ofb = KalynaOfbInit(ctx, iv, NextRandom(seed) % (4 * block_len + 50));
+    memset(output, 0, length);
+    for (offset = 0; offset < length; offset += chunk) {
+        chunk = NextRandom(seed) % (3 * block_len + 10);
+        chunk = chunk < length - offset ? chunk : length - offset;
+        if (NextRandom(seed) % 2)
+            KalynaOfbPrecompute(ofb, NextRandom(seed) % (5 * block_len));
+        KalynaOfbCrypt(ofb, input + offset, chunk, output + offset);
+    }
+    if (memcmp(output, expect, length) != 0) {
+        printf("Mismatch: precomputed OFB stream of %lu bytes\n", (unsigned long)length);
+        ++failures;
+    }
+    KalynaOfbDelete(ofb);
+    KalynaDelete(ctx);
+    return failures;
+}
+
+/*!
+ * Compare the single block Kalyna-128 path with the reference, enciphering
+ * a chain of blocks in place and deciphering it back.
+ *
+ * @return Number of detected mismatches.
+ */
+static int CheckBlock128(uint64_t* seed) {
+    size_t i, k;
+    int failures = 0;
+    uint64_t key[kNK_256], block[kNB_128], expect[kNB_128];
+    uint8_t bytes[kNB_128 * sizeof(uint64_t)];
+    kalyna_block128_t fast;
+    kalyna_t* ctx = KalynaInit(kBLOCK_128, NextRandom(seed) % 2 ? kKEY_128 : kKEY_256);
+
+    for (i = 0; i < ctx->nk; ++i)
+        key[i] = NextRandom(seed);
+    KalynaKeyExpand(key, ctx);
+    if (KalynaBlock128Load(&fast, ctx) != 0) {
+        printf("Mismatch: single block path refused Kalyna-128\n");
+        KalynaDelete(ctx);
+        return 1;
+    }
+    KalynaDelete(ctx);
+    ctx = KalynaInit(kBLOCK_256, kKEY_256);
+    if (KalynaBlock128Load(&fast, ctx) == 0) {
+        printf("Mismatch: single block path accepted Kalyna-256\n");
+        ++failures;
+    }
+    KalynaDelete(ctx);
+    ctx = KalynaInit(kBLOCK_128, fast.nr == kNR_128 ? kKEY_128 : kKEY_256);
+    KalynaKeyExpand(key, ctx);
+
+    block[0] = NextRandom(seed);
+    block[1] = NextRandom(seed);
+    WriteWords(kNB_128, block, bytes);
+    for (k = 0; k < 16; ++k) {
+        KalynaEncipher(block, ctx, expect);
+        KalynaBlock128Encipher(&fast, bytes, bytes);
+        ReadWords(kNB_128, bytes, block);
+        if (memcmp(block, expect, sizeof(block)) != 0) {
+            printf("Mismatch: single block enciphering, %lu rounds\n", (unsigned long)fast.nr);
+            ++failures;
+            break;
+        }
+    }
+    for (k = 0; k < 16; ++k) {
+        KalynaDecipher(block, ctx, expect);
+        KalynaBlock128Decipher(&fast, bytes, bytes);
+        ReadWords(kNB_128, bytes, block);
+        if (memcmp(block, expect, sizeof(block)) != 0) {
+            printf("Mismatch: single block deciphering, %lu rounds\n", (unsigned long)fast.nr);
+            ++failures;
+            break;
+        }
+    }
+    KalynaDelete(ctx);
+    return failures;
+}
+
+/*!
+ * Pass random chunks through a stream rekeyed every few blocks and compare
+ * with counter mode computed block by block, one context per epoch. Also
+ * check that a stream without the next key refuses to cross a boundary and
+ * that a stream without rekeying matches KalynaCtrBytes().
+ *
+ * @return Number of detected mismatches.
+ */
+static int CheckStream(uint64_t* seed) {
+    static uint8_t input[kSTREAM_BYTES], output[kSTREAM_BYTES], expect[kSTREAM_BYTES];
+    static uint64_t keys[kSTREAM_KEYS][kNK_512];
+    size_t i, j, offset, chunk, block_len, max_chunk;
+    int failures = 0;
+    uint8_t iv[kNB_512 * sizeof(uint64_t)], bytes[kNB_512 * sizeof(uint64_t)];
+    uint64_t counter[kNB_512], block[kNB_512];
+    size_t v = NextRandom(seed) % kVARIANTS_NUM;
+    uint64_t rekey_blocks = 1 + NextRandom(seed) % 6;
+    kalyna_t* ctx = KalynaInit(variants[v][0], variants[v][1]);
+    kalyna_stream_t* stream;
+    kalyna_stream_position_t position;
+
+    block_len = ctx->nb * sizeof(uint64_t);
+    for (i = 0; i < sizeof(iv); ++i)
+        iv[i] = (uint8_t)NextRandom(seed);
+    for (i = 0; i < kSTREAM_BYTES; ++i)
+        input[i] = (uint8_t)NextRandom(seed);
+    for (i = 0; i < kSTREAM_KEYS; ++i) {
+        for (j = 0; j < kNK_512; ++j)
+            keys[i][j] = NextRandom(seed);
+    }
+
+    /* Model: counter from the IV under the first key, block i under key i / rekey_blocks. */
+    KalynaKeyExpand(keys[0], ctx);
+    ReadWords(ctx->nb, iv, counter);
+    KalynaEncipher(counter, ctx, counter);
+    for (i = 0; i * block_len < kSTREAM_BYTES; ++i) {
+        if (i % rekey_blocks == 0)
+            KalynaKeyExpand(keys[i / rekey_blocks], ctx);
+        CtrCounters(counter, 1, ctx->nb, block);
+        KalynaEncipher(block, ctx, block);
+        WriteWords(ctx->nb, block, bytes);
+        for (j = 0; j < block_len && i * block_len + j < kSTREAM_BYTES; ++j)
+            expect[i * block_len + j] = input[i * block_len + j] ^ bytes[j];
+    }
+
+    /* Chunks never need more than rekey_blocks new blocks. */
+    max_chunk = (rekey_blocks - 1) * block_len + 1;
+    stream = KalynaStreamInit(variants[v][0], variants[v][1], keys[0], iv, rekey_blocks);
+    for (offset = 0; offset < kSTREAM_BYTES; offset += chunk) {
+        chunk = 1 + NextRandom(seed) % (max_chunk + block_len);
+        chunk = chunk < max_chunk ? chunk : max_chunk;
+        chunk = chunk < kSTREAM_BYTES - offset ? chunk : kSTREAM_BYTES - offset;
+        KalynaStreamPosition(stream, &position);
+        if (!position.next_key_ready)
+            KalynaStreamNextKey(stream, keys[position.epoch + 1]);
+        if (KalynaStreamCrypt(stream, input + offset, chunk, output + offset) != 0) {
+            printf("Mismatch: stream refused a chunk\n");
+            ++failures;
+            break;
+        }
+    }
+    KalynaStreamPosition(stream, &position);
+    if (memcmp(output, expect, kSTREAM_BYTES) != 0 ||
+            position.block != (kSTREAM_BYTES - 1) / block_len ||
+            position.epoch != position.block / rekey_blocks) {
+        printf("Mismatch: stream with rekey every %lu blocks\n", (unsigned long)rekey_blocks);
+        ++failures;
+    }
+    KalynaStreamDelete(stream);
+
+    /* The first boundary cannot be crossed without a key. */
+    stream = KalynaStreamInit(variants[v][0], variants[v][1], keys[0], iv, rekey_blocks);
+    if (KalynaStreamCrypt(stream, input, rekey_blocks * block_len + 1, output) == 0 ||
+            KalynaStreamCrypt(stream, input, rekey_blocks * block_len, output) != 0 ||
+            memcmp(output, expect, rekey_blocks * block_len) != 0) {
+        printf("Mismatch: stream crossed a boundary without a key\n");
+        ++failures;
+    }
+    KalynaStreamDelete(stream);
+
+    KalynaKeyExpand(keys[0], ctx);
+    KalynaCtrBytes(input, kSTREAM_BYTES, iv, ctx, expect);
+    stream = KalynaStreamInit(variants[v][0], variants[v][1], keys[0], iv, 0);
+    KalynaStreamCrypt(stream, input, 7, output);
+    KalynaStreamCrypt(stream, input + 7, kSTREAM_BYTES - 7, output + 7);
+    if (memcmp(output, expect, kSTREAM_BYTES) != 0) {
+        printf("Mismatch: stream without rekey\n");
+        ++failures;
+    }
+    KalynaStreamDelete(stream);
+    KalynaDelete(ctx);
+    return failures;
+}
+
+/*!
+ * Check that contexts imported from a schedule image encipher and decipher
+ * like the exported ones.
+ *
+ * @return Number of detected mismatches.
+ */
+static int CompareImported(kalyna_t* const* ctxs, kalyna_t* const* imported, size_t count,
+        uint64_t* seed) {
+    size_t i, j;
+    int failures = 0;
+    uint64_t blocks[kNB_512], expect[kNB_512], actual[kNB_512];
+
+    for (i = 0; i < count; ++i) {
+        for (j = 0; j < ctxs[i]->nb; ++j)
+            blocks[j] = NextRandom(seed);
+        KalynaEncipherBlocks(blocks, 1, ctxs[i], expect);
+        KalynaEncipherBlocks(blocks, 1, imported[i], actual);
+        failures += memcmp(expect, actual, ctxs[i]->nb * sizeof(uint64_t)) != 0;
+        KalynaDecipherBlocks(blocks, 1, ctxs[i], expect);
+        KalynaDecipherBlocks(blocks, 1, imported[i], actual);
+        failures += memcmp(expect, actual, ctxs[i]->nb * sizeof(uint64_t)) != 0;
+    }
+    return failures;
+}
+
+/*!
+ * Export contexts of all variants to plain and wrapped schedule images,
+ * import them back and check rejection of corrupt images and wrong keys.
+ *
+ * @return Number of detected mismatches.
+ */
+static int CheckSchedule(uint64_t* seed) {
+    size_t v, i, k, count = 0, length;
+    int failures = 0;
+    uint64_t key[kNK_512];
+    kalyna_t* ctxs[kVARIANTS_NUM * kSCHEDULE_KEYS];
+    kalyna_t* imported[kVARIANTS_NUM * kSCHEDULE_KEYS];
+    kalyna_t* wrap = KalynaInit(kBLOCK_256, kKEY_512);
+    kalyna_t* wrong = KalynaInit(kBLOCK_256, kKEY_512);
+    uint64_t* image;
+    uint64_t* copy;
+
+    for (i = 0; i < kNK_512; ++i)
+        key[i] = NextRandom(seed);
+    KalynaKeyExpand(key, wrap);
+    key[0] ^= 1;
+    KalynaKeyExpand(key, wrong);
+    for (v = 0; v < kVARIANTS_NUM; ++v) {
+        for (k = 0; k < kSCHEDULE_KEYS; ++k) {
+            ctxs[count] = KalynaInit(variants[v][0], variants[v][1]);
+            for (i = 0; i < ctxs[count]->nk; ++i)
+                key[i] = NextRandom(seed);
+            KalynaKeyExpand(key, ctxs[count++]);
+        }
+    }
+    length = KalynaScheduleSize(ctxs, count);
+    image = (uint64_t*)malloc(length);
+    copy = (uint64_t*)malloc(length);
+
+    /* Plain image, then a single flipped bit. */
+    if (KalynaScheduleExport(ctxs, count, NULL, image, length) != 0 ||
+            KalynaScheduleCount(image, length) != count ||
+            KalynaScheduleImport(image, length, NULL, imported) != 0) {
+        printf("Mismatch: plain schedule image rejected\n");
+        ++failures;
+    } else {
+        failures += CompareImported(ctxs, imported, count, seed);
+        for (i = 0; i < count; ++i)
+            KalynaDelete(imported[i]);
+    }
+    ((uint8_t*)image)[length - 1 - NextRandom(seed) % (length / 2)] ^= 1;
+    if (KalynaScheduleImport(image, length, NULL, imported) == 0) {
+        printf("Mismatch: corrupt schedule image accepted\n");
+        ++failures;
+    }
+
+    /* Wrapped image: only the right key opens it, a flipped bit fails the tag. */
+    if (KalynaScheduleExport(ctxs, count, wrap, image, length) != 0) {
+        printf("Mismatch: wrapped schedule export failed\n");
+        ++failures;
+    }
+    memcpy(copy, image, length);
+    if (KalynaScheduleImport(image, length, wrong, imported) == 0 ||
+            KalynaScheduleImport(image, length, NULL, imported) == 0) {
+        printf("Mismatch: wrapped schedule image opened with a wrong key\n");
+        ++failures;
+    }
+    ((uint8_t*)copy)[NextRandom(seed) % length] ^= 1;
+    if (KalynaScheduleImport(copy, length, wrap, imported) == 0) {
+        printf("Mismatch: modified wrapped schedule image accepted\n");
+        ++failures;
+    }
+    memcpy(copy, image, length);
+    if (KalynaScheduleImport(image, length, wrap, imported) != 0 ||
+            memcmp(copy, image, length) != 0) {
+        printf("Mismatch: wrapped schedule image rejected or modified\n");
+        ++failures;
+    } else {
+        /* Imported round keys are copies: the image may go away. */
+        memset(image, 0, length);
+        failures += CompareImported(ctxs, imported, count, seed);
+        for (i = 0; i < count; ++i)
+            KalynaDelete(imported[i]);
+    }
+
+    /* A plain image cannot stand in for a wrapped one. */
+    KalynaScheduleExport(ctxs, count, NULL, image, length);
+    if (KalynaScheduleImport(image, length, wrap, imported) == 0) {
+        printf("Mismatch: plain schedule image accepted as wrapped\n");
+        ++failures;
+    }
+
+    for (i = 0; i < count; ++i)
+        KalynaDelete(ctxs[i]);
+    KalynaDelete(wrap);
+    KalynaDelete(wrong);
+    free(image);
+    free(copy);
+    return failures;
+}
+
+/* Replicas and blocks shared with a thread bound to a NUMA node. */
+typedef struct {
+    kalyna_replicas_t* replicas;
+    size_t node;
+    size_t blocks;
+    const uint64_t* input;
+    uint64_t* output;
+    int bound;
+} numa_job_t;
+
+static void* RunOnNode(void* arg) {
+    numa_job_t* job = (numa_job_t*)arg;
+    job->bound = KalynaNumaBind(job->node) == 0;
+    KalynaEncipherBlocks(job->input, job->blocks, KalynaReplicasLocal(job->replicas),
+        job->output);
+    return NULL;
+}
+
+/*!
+ * Encipher with the key replica and table replica of every node, from a
+ * thread bound to it, and compare with the original context.
+ *
+ * @return Number of detected mismatches.
+ */
+static int CheckNuma(uint64_t* seed) {
+    size_t i, node, words;
+    int failures = 0;
+    uint64_t key[kNK_512];
+    uint64_t input[kMAX_BATCH * kNB_512], output[kMAX_BATCH * kNB_512];
+    uint64_t expect[kMAX_BATCH * kNB_512];
+    size_t v = NextRandom(seed) % kVARIANTS_NUM;
+    kalyna_t* ctx = KalynaInit(variants[v][0], variants[v][1]);
+    size_t blocks = 1 + NextRandom(seed) % kMAX_BATCH;
+    numa_job_t job;
+    pthread_t worker;
+
+    for (i = 0; i < ctx->nk; ++i)
+        key[i] = NextRandom(seed);
+    KalynaKeyExpand(key, ctx);
+    for (i = 0; i < blocks * ctx->nb; ++i)
+        input[i] = NextRandom(seed);
+    KalynaEncipherBlocks(input, blocks, ctx, expect);
+
+    job.replicas = KalynaReplicasInit(ctx);
+    words = blocks * ctx->nb;
+    KalynaDelete(ctx);
+    if (job.replicas == NULL) {
+        printf("Mismatch: key replicas not created\n");
+        return 1;
+    }
+    job.blocks = blocks;
+    job.input = input;
+    job.output = output;
+    for (node = 0; node < KalynaNumaNodes(); ++node) {
+        job.node = node;
+        memset(output, 0, sizeof(output));
+        if (pthread_create(&worker, NULL, RunOnNode, &job) != 0) {
+            RunOnNode(&job);
+        } else {
+            pthread_join(worker, NULL);
+        }
+        if (memcmp(output, expect, words * sizeof(uint64_t)) != 0) {
+            printf("Mismatch: replica of node %lu%s\n", (unsigned long)node,
+                job.bound ? "" : " (thread not bound)");
+            ++failures;
+        }
+    }
+    KalynaReplicasDelete(job.replicas);
+    return failures;
+}
+
+/*!
+ * Keep many contexts alive at once, check that they do not overlap and that
+ * the memory of a deleted context is wiped before it is handed out again.
+ *
+ * @return Number of detected mismatches.
+ */
+static int CheckArena(uint64_t* seed) {
+    static kalyna_t* ctxs[kARENA_CONTEXTS];
+    static uint64_t expect[kARENA_CONTEXTS][kNB_128];
+    size_t i, r;
+    int failures = 0;
+    uint64_t key[kNK_128], block[kNB_128];
+    kalyna_t* ctx;
+
+    for (i = 0; i < kARENA_CONTEXTS; ++i) {
+        ctxs[i] = KalynaInit(kBLOCK_128, kKEY_128);
+        if (ctxs[i] == NULL)
+            return 1;
+        key[0] = NextRandom(seed);
+        key[1] = NextRandom(seed);
+        KalynaKeyExpand(key, ctxs[i]);
+        memset(block, 0, sizeof(block));
+        KalynaEncipher(block, ctxs[i], expect[i]);
+    }
+    for (i = 0; i < kARENA_CONTEXTS; ++i) {
+        memset(block, 0, sizeof(block));
+        KalynaEncipher(block, ctxs[i], block);
+        if (memcmp(block, expect[i], sizeof(block)) != 0) {
+            printf("Mismatch: arena context %lu overwritten\n", (unsigned long)i);
+            ++failures;
+        }
+    }
+    for (i = 0; i < kARENA_CONTEXTS; ++i)
+        KalynaDelete(ctxs[i]);
+
+    /* The slot released last is reused first. */
+    ctx = KalynaInit(kBLOCK_512, kKEY_512);
+    for (r = 0; r <= ctx->nr; ++r) {
+        for (i = 0; i < ctx->nb; ++i) {
+            if (ctx->round_keys[r][i] != 0 || ctx->round_keys_dec[r][i] != 0) {
+                printf("Mismatch: round keys not wiped on delete\n");
+                KalynaDelete(ctx);
+                return failures + 1;
+            }
+        }
+    }
+    KalynaDelete(ctx);
+    return failures;
+}
+
+/*!
+ * Read the tuning cache at `path`, NUL terminated.
+ *
+ * @return Its length or zero if it cannot be read.
+ */
+static size_t ReadTuneCache(const char* path, char* contents) {
+    size_t length;
+    FILE* cache = fopen(path, "r");
+    if (cache == NULL)
+        return 0;
+    length = fread(contents, 1, kTUNE_CACHE_BYTES - 1, cache);
+    fclose(cache);
+    contents[length] = '\0';
+    return length;
+}
+
+/*!
+ * Run the engine auto-tuner with a fresh cache file, check that the cache
+ * is reused, that a corrupted one is replaced and that the tuned engines
+ * agree with the reference implementation.
+ *
+ * @return Number of detected mismatches.
+ */
+static int CheckTune(uint64_t* seed) {
+    char path[] = "/tmp/kalyna-tune-XXXXXX";
+    char contents[kTUNE_CACHE_BYTES];
+    char* entries;
+    size_t v, i, k, header = 0;
+    int failures = 0, fd = mkstemp(path);
+    const kalyna_engine_t* selected = KalynaEngineSelect();
+    const kalyna_engine_t* reference = KalynaEngineFind("reference");
+    uint64_t key[kNK_512], block[kNB_512], expect[kNB_512];
+    uint64_t blocks[kMAX_BATCH * kNB_512], saved[kMAX_BATCH * kNB_512];
+    kalyna_t* ctx;
+    FILE* cache;
+
+    if (fd < 0) {
+        perror("Could not create tuning cache");
+        return 1;
+    }
+    close(fd);
+    /* An empty file is not a valid cache and gets calibrated over. */
+    if (KalynaTune(path) != 0 || ReadTuneCache(path, contents) == 0 ||
+            strncmp(contents, "kalyna-tune ", 12) != 0) {
+        printf("Mismatch: tuning cache not written\n");
+        ++failures;
+    }
+
+    /* Rewrite the choice behind a valid header: it must be used as is. */
+    for (entries = contents, i = 0; i < 4 && entries != NULL; ++i) {
+        entries = strchr(entries, '\n');
+        entries = entries != NULL ? entries + 1 : NULL;
+    }
+    if (entries != NULL) {
+        header = (size_t)(entries - contents);
+        cache = fopen(path, "w");
+        if (cache != NULL) {
+            fwrite(contents, 1, header, cache);
+            for (v = 0; v < kVARIANTS_NUM; ++v)
+                fprintf(cache, "%lu %lu reference\n", (unsigned long)variants[v][0],
+                    (unsigned long)variants[v][1]);
+            fclose(cache);
+        }
+        if (KalynaTune(path) != 0) {
+            printf("Mismatch: tuning cache not reloaded\n");
+            ++failures;
+        }
+        for (v = 0; v < kVARIANTS_NUM; ++v) {
+            if (KalynaEngineFor(variants[v][0] / kBITS_IN_WORD,
+                    variants[v][1] / kBITS_IN_WORD) != reference) {
+                printf("Mismatch: cached engine of Kalyna (%lu, %lu) ignored\n",
+                    (unsigned long)variants[v][0], (unsigned long)variants[v][1]);
+                ++failures;
+            }
+        }
+    } else {
+        printf("Mismatch: tuning cache without header\n");
+        ++failures;
+    }
+
+    /* A corrupted cache is calibrated over and rewritten. */
+    cache = fopen(path, "w");
+    if (cache != NULL) {
+        fputs("kalyna-tune garbage\n", cache);
+        fclose(cache);
+    }
+    if (KalynaTune(path) != 0 || ReadTuneCache(path, contents) <= header ||
+            strncmp(contents, "kalyna-tune ", 12) != 0 || strstr(contents, "garbage") != NULL) {
+        printf("Mismatch: corrupted tuning cache not replaced\n");
+        ++failures;
+    }
+    remove(path);
+
+    for (v = 0; v < kVARIANTS_NUM; ++v) {
+        ctx = KalynaInit(variants[v][0], variants[v][1]);
+        for (k = 0; k < 4; ++k) {
+            for (i = 0; i < ctx->nk; ++i)
+                key[i] = NextRandom(seed);
+            KalynaKeyExpand(key, ctx);
+            for (i = 0; i < kMAX_BATCH * ctx->nb; ++i)
+                saved[i] = blocks[i] = NextRandom(seed);
+            memcpy(block, blocks + (kMAX_BATCH - 1) * ctx->nb, ctx->nb * sizeof(uint64_t));
+            KalynaEncipher(block, ctx, expect);
+            KalynaEncipherBlocks(blocks, kMAX_BATCH, ctx, blocks);
+            KalynaDecipherBlocks(blocks, kMAX_BATCH - 1, ctx, blocks);
+            if (memcmp(blocks + (kMAX_BATCH - 1) * ctx->nb, expect,
+                    ctx->nb * sizeof(uint64_t)) != 0 ||
+                    memcmp(blocks, saved, (kMAX_BATCH - 1) * ctx->nb * sizeof(uint64_t)) != 0) {
+                printf("Mismatch: tuned engine %s of Kalyna (%lu, %lu)\n",
+                    KalynaEngineFor(ctx->nb, ctx->nk)->name,
+                    (unsigned long)variants[v][0], (unsigned long)variants[v][1]);
+                ++failures;
+            }
+        }
+        KalynaDelete(ctx);
+    }
+    /* Back to the engine of the other checks, dropping the tuned choice. */
+    KalynaSelectEngine(selected->name);
+    return failures;
+}
+
+#endif  /* KALYNA_FUZZER */
+
+/* Build tables of every engine supported by the running CPU. */
+static void InitEngines(void) {
+    size_t e;
+    for (e = 0; kalyna_engines[e] != NULL; ++e) {
+        if (kalyna_engines[e]->available() && kalyna_engines[e]->init != NULL)
+            kalyna_engines[e]->init();
+    }
+}
+
+
+#ifdef KALYNA_FUZZER
+
+/*!
+ * libFuzzer entry point. The first input byte selects the variant, the rest
+ * is consumed as key followed by a batch of blocks; missing bytes are taken
+ * as zeros. The round keys are also compared with the model of the original
+ * key schedule.
+ */
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    size_t i, offset, count;
+    uint64_t key[kNK_512];
+    uint64_t blocks[kMAX_BATCH * kNB_512];
+    kalyna_t* ctx;
+
+    if (size == 0)
+        return 0;
+    InitEngines();
+    ctx = KalynaInit(variants[data[0] % kVARIANTS_NUM][0],
+        variants[data[0] % kVARIANTS_NUM][1]);
+
+    memset(key, 0, sizeof(key));
+    offset = 1;
+    for (i = 0; i < ctx->nk * sizeof(uint64_t) && offset < size; ++i)
+        ((uint8_t*)key)[i] = data[offset++];
+    KalynaKeyExpand(key, ctx);
+    if (CompareKeySchedule(ctx, key) != 0)
+        abort();
+
+    memset(blocks, 0, sizeof(blocks));
+    for (i = 0; i < sizeof(blocks) && offset < size; ++i)
+        ((uint8_t*)blocks)[i] = data[offset++];
+    count = (i + ctx->nb * sizeof(uint64_t) - 1) / (ctx->nb * sizeof(uint64_t));
+    if (CheckBlocks(ctx, key, blocks, count > 0 ? count : 1) != 0)
+        abort();
+
+    KalynaDelete(ctx);
+    return 0;
+}
+
+#else
+
+int main(int argc, char** argv) {
+    size_t v, i, k, lane, count;
+    int failures = 0, section;
+    uint64_t key[kNK_512];
+    uint64_t blocks[kMAX_BATCH * kNB_512];
+    kalyna_t* ctx;
+    kalyna_t* lane_ctxs[kLANES];
+    const kalyna_engine_t* selected;
+    /* Keys per variant and maximum blocks per key. */
+    unsigned long keys_num = argc > 1 ? strtoul(argv[1], NULL, 0) : 64;
+    unsigned long blocks_num = argc > 2 ? strtoul(argv[2], NULL, 0) : 16;
+    uint64_t seed = argc > 3 ? strtoull(argv[3], NULL, 0) : 0x4B616C796E61ULL;
+
+    if (blocks_num < 1 || blocks_num > kMAX_BATCH)
+        blocks_num = kMAX_BATCH;
+
+    InitEngines();
+    printf("Differential test: %lu keys x up to %lu blocks per variant, seed 0x%llx\n",
+        keys_num, blocks_num, (unsigned long long)seed);
+    printf("Engines:");
+    for (i = 0; kalyna_engines[i] != NULL; ++i) {
+        if (kalyna_engines[i]->available())
+            printf(" %s", kalyna_engines[i]->name);
+    }
+    printf("\n");
+
+    for (v = 0; v < kVARIANTS_NUM; ++v) {
+        ctx = KalynaInit(variants[v][0], variants[v][1]);
+        section = 0;
+        for (k = 0; k < keys_num; ++k) {
+            for (i = 0; i < ctx->nk; ++i)
+                key[i] = NextRandom(&seed);
+            KalynaKeyExpand(key, ctx);
+            /* Vary the batch size to exercise partial engine groups. */
+            count = 1 + NextRandom(&seed) % blocks_num;
+            for (i = 0; i < count * ctx->nb; ++i)
+                blocks[i] = NextRandom(&seed);
+            section += CheckBlocks(ctx, key, blocks, count);
+        }
+        for (lane = 0; lane < kLANES; ++lane)
+            lane_ctxs[lane] = KalynaInit(variants[v][0], variants[v][1]);
+        for (k = 0; k < keys_num / kLANES; ++k) {
+            for (lane = 0; lane < kLANES; ++lane) {
+                for (i = 0; i < ctx->nk; ++i)
+                    key[i] = NextRandom(&seed);
+                KalynaKeyExpand(key, lane_ctxs[lane]);
+            }
+            section += CheckLanes(lane_ctxs, &seed);
+        }
+        for (lane = 0; lane < kLANES; ++lane)
+            KalynaDelete(lane_ctxs[lane]);
+        printf("Kalyna (%lu, %lu): %s\n", (unsigned long)variants[v][0],
+            (unsigned long)variants[v][1], section ? "FAILED" : "ok");
+        failures += section;
+        KalynaDelete(ctx);
+    }
+
+    /* Every engine expands keys with its own table layout. */
+    selected = KalynaEngineSelect();
+    for (i = 0; kalyna_engines[i] != NULL; ++i) {
+        if (KalynaSelectEngine(kalyna_engines[i]->name) != 0)
+            continue;
+        section = 0;
+        for (k = 0; k < keys_num; ++k)
+            section += CheckKeySchedule(&seed);
+        printf("Key schedule (%s): %s\n", kalyna_engines[i]->name,
+            section ? "FAILED" : "ok");
+        failures += section;
+    }
+    KalynaSelectEngine(selected->name);
+
+    section = 0;
+    for (k = 0; k < keys_num; ++k)
+        section += CheckBlock128(&seed);
+    printf("Single block Kalyna-128: %s\n", section ? "FAILED" : "ok");
+    failures += section;
+
+    section = 0;
+    for (k = 0; k < keys_num; ++k)
+        section += CheckRing(&seed, k % 2);
+    printf("Batched ring: %s\n", section ? "FAILED" : "ok");
+    failures += section;
+
+    section = 0;
+    for (k = 0; k < 4; ++k)
+        section += CheckDrbg(&seed);
+    printf("CTR DRBG: %s\n", section ? "FAILED" : "ok");
+    failures += section;
+
+    section = 0;
+    for (k = 0; k < keys_num; ++k)
+        section += CheckStream(&seed);
+    printf("Rekeyed streams: %s\n", section ? "FAILED" : "ok");
+    failures += section;
+
+    section = 0;
+    for (k = 0; k < keys_num; ++k)
+        section += CheckTreeMac(&seed);
+    printf("Tree MAC: %s\n", section ? "FAILED" : "ok");
+    failures += section;
+
+    section = 0;
+    for (k = 0; k < 4; ++k)
+        section += CheckKdf(&seed);
+    printf("Batched KDF: %s\n", section ? "FAILED" : "ok");
+    failures += section;
+
+    section = 0;
+    for (k = 0; k < keys_num; ++k)
+        section += CheckFeedback(&seed);
+    printf("CFB and OFB: %s\n", section ? "FAILED" : "ok");
+    failures += section;
+
+    section = 0;
+    for (k = 0; k < keys_num; ++k)
+        section += CheckStreaming(&seed);
+    printf("Streaming bulk paths: %s\n", section ? "FAILED" : "ok");
+    failures += section;
+
+    section = 0;
+    for (k = 0; k < keys_num; ++k)
+        section += CheckGcm(&seed);
+    printf("GCM: %s\n", section ? "FAILED" : "ok");
+    failures += section;
+
+    section = 0;
+    for (k = 0; k < keys_num / 4 + 1; ++k)
+        section += CheckContainer(&seed);
+    printf("Chunked containers: %s\n", section ? "FAILED" : "ok");
+    failures += section;
+
+    section = 0;
+    for (k = 0; k < 4; ++k)
+        section += CheckSchedule(&seed);
+    printf("Schedule images: %s\n", section ? "FAILED" : "ok");
+    failures += section;
+
+    section = 0;
+    for (k = 0; k < 4; ++k)
+        section += CheckNuma(&seed);
+    printf("NUMA replicas (%lu nodes): %s\n", (unsigned long)KalynaNumaNodes(),
+        section ? "FAILED" : "ok");
+    failures += section;
+
+    section = CheckArena(&seed);
+    printf("Context arena (%s): %s\n", ArenaLocked() ? "locked" : "not locked",
+        section ? "FAILED" : "ok");
+    failures += section;
+
+    /* Worker threads share one context: every engine must be reentrant. */
+    selected = KalynaEngineSelect();
+    for (i = 0; kalyna_engines[i] != NULL; ++i) {
+        if (KalynaSelectEngine(kalyna_engines[i]->name) != 0)
+            continue;
+        section = 0;
+        for (k = 0; k < 4; ++k) {
+            section += CheckTreeMac(&seed);
+            section += CheckRing(&seed, TRUE);
+            section += CheckContainer(&seed);
+        }
+        printf("Threaded paths (%s): %s\n", kalyna_engines[i]->name,
+            section ? "FAILED" : "ok");
+        failures += section;
+    }
+    KalynaSelectEngine(selected->name);
+
+    section = CheckTune(&seed);
+    printf("Engine auto-tuner: %s\n", section ? "FAILED" : "ok");
+    failures += section;
+
+    if (failures != 0) {
+        printf("Failed differential test: %d mismatches\n", failures);
+        return 1;
+    }
+    printf("Success differential test\n");
+    return 0;
+}
+
+#endif  /* KALYNA_FUZZER */
@@ -0,0 +1,246 @@
+/*
+
+Runtime selection of round engines of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "engine.h"
+#include "ttable.h"
+#include "arena.h"
+
+
+static int AlwaysAvailable(void) {
+    return 1;
+}
+
+/*
+ * The reference rounds work in a state of their own on the stack: contexts
+ * are shared by the worker threads of the tree MAC, the container and the
+ * ring, which call engines concurrently.
+ */
+static void ReferenceEncipherBlocks(const uint64_t* plaintext, size_t blocks,
+        kalyna_t* ctx, uint64_t* ciphertext) {
+    size_t i;
+    uint64_t state[kNB_512];
+    for (i = 0; i < blocks; ++i) {
+        EncipherWithState(plaintext + i * ctx->nb, ctx, state, ciphertext + i * ctx->nb);
+    }
+    SecureWipe(state, sizeof(state));
+}
+
+static void ReferenceDecipherBlocks(const uint64_t* ciphertext, size_t blocks,
+        kalyna_t* ctx, uint64_t* plaintext) {
+    size_t i;
+    uint64_t state[kNB_512];
+    for (i = 0; i < blocks; ++i) {
+        DecipherWithState(ciphertext + i * ctx->nb, ctx, state, plaintext + i * ctx->nb);
+    }
+    SecureWipe(state, sizeof(state));
+}
+
+
+static const kalyna_engine_t reference_engine = {
+    "reference", AlwaysAvailable, NULL,
+    ReferenceEncipherBlocks, ReferenceDecipherBlocks, NULL, NULL,
+    TTableCompactEncipherRounds, TTableCompactInvMixColumns
+};
+
+static const kalyna_engine_t ttable_engine = {
+    "ttable", AlwaysAvailable, TTableInit,
+    TTableEncipherBlocks, TTableDecipherBlocks,
+    TTableEncipherLanes, TTableDecipherLanes,
+    TTableEncipherRounds, TTableInvMixColumns
+};
+
+static const kalyna_engine_t ttable_rotate_engine = {
+    "ttable-rotate", AlwaysAvailable, TTableInit,
+    TTableRotateEncipherBlocks, TTableRotateDecipherBlocks, NULL, NULL,
+    TTableRotateEncipherRounds, TTableRotateInvMixColumns
+};
+
+static const kalyna_engine_t ttable_compact_engine = {
+    "ttable-compact", AlwaysAvailable, NULL,
+    TTableCompactEncipherBlocks, TTableCompactDecipherBlocks, NULL, NULL,
+    TTableCompactEncipherRounds, TTableCompactInvMixColumns
+};
+
+#if KALYNA_TTABLE_X86_64_V3
+static int X8664V3Available(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("x86-64-v3");
+}
+
+static const kalyna_engine_t ttable_x86_64_v3_engine = {
+    "ttable-x86-64-v3", X8664V3Available, TTableInit,
+    TTableEncipherBlocks_x86_64_v3, TTableDecipherBlocks_x86_64_v3,
+    TTableEncipherLanes_x86_64_v3, TTableDecipherLanes_x86_64_v3,
+    TTableEncipherRounds, TTableInvMixColumns
+};
+#endif
+
+const kalyna_engine_t* const kalyna_engines[] = {
+#if KALYNA_TTABLE_X86_64_V3
+    &ttable_x86_64_v3_engine,
+#endif
+    &ttable_engine,
+    &ttable_rotate_engine,
+    &ttable_compact_engine,
+    &reference_engine,
+    NULL
+};
+
+
+static const kalyna_engine_t* selected_engine = NULL;
+static pthread_once_t select_once = PTHREAD_ONCE_INIT;
+
+/* Engines chosen by the auto-tuner for each variant, NULL for the selected one. */
+static const kalyna_engine_t* variant_engines[kENGINE_VARIANTS];
+
+/*!
+ * Pick the first available engine, then apply the overrides of the
+ * environment: KALYNA_ENGINE names an engine for all variants, otherwise
+ * KALYNA_TUNE names the cache file of KalynaTune().
+ */
+static void SelectEngine(void) {
+    int i;
+    const char* name = getenv("KALYNA_ENGINE");
+    const char* cache = getenv("KALYNA_TUNE");
+    const kalyna_engine_t* engine;
+
+    if (name != NULL && *name != '\0') {
+        engine = KalynaEngineFind(name);
+        if (engine != NULL) {
+            selected_engine = engine;
+            return;
+        }
+        fprintf(stderr, "Kalyna engine %s is not available, ignoring KALYNA_ENGINE.\n", name);
+    }
+    if (cache != NULL && *cache != '\0')
+        KalynaTune(cache);
+    for (i = 0; kalyna_engines[i] != NULL; ++i) {
+        if (kalyna_engines[i]->available()) {
+            if (kalyna_engines[i]->init != NULL)
+                kalyna_engines[i]->init();
+            selected_engine = kalyna_engines[i];
+            return;
+        }
+    }
+}
+
+const kalyna_engine_t* KalynaEngineSelect(void) {
+    pthread_once(&select_once, SelectEngine);
+    return selected_engine;
+}
+
+const kalyna_engine_t* KalynaEngineFind(const char* name) {
+    int i;
+    for (i = 0; kalyna_engines[i] != NULL; ++i) {
+        if (strcmp(kalyna_engines[i]->name, name) == 0) {
+            if (!kalyna_engines[i]->available())
+                return NULL;
+            if (kalyna_engines[i]->init != NULL)
+                kalyna_engines[i]->init();
+            return kalyna_engines[i];
+        }
+    }
+    return NULL;
+}
+
+int KalynaSelectEngine(const char* name) {
+    const kalyna_engine_t* engine = KalynaEngineFind(name);
+    if (engine == NULL)
+        return -1;
+    KalynaEngineSelect();
+    selected_engine = engine;
+    memset(variant_engines, 0, sizeof(variant_engines));
+    return 0;
+}
+
+size_t KalynaVariantIndex(size_t nb, size_t nk) {
+    if (nb == kNB_128)
+        return nk == kNK_128 ? 0 : 1;
+    if (nb == kNB_256)
+        return nk == kNK_256 ? 2 : 3;
+    return 4;
+}
+
+const kalyna_engine_t* KalynaEngineFor(size_t nb, size_t nk) {
+    const kalyna_engine_t* selected = KalynaEngineSelect();
+    const kalyna_engine_t* tuned = variant_engines[KalynaVariantIndex(nb, nk)];
+    return tuned != NULL ? tuned : selected;
+}
+
+void KalynaEngineSetVariant(size_t nb, size_t nk, const kalyna_engine_t* engine) {
+    variant_engines[KalynaVariantIndex(nb, nk)] = engine;
+}
+
+
+void KalynaEncipherBlocks(const uint64_t* plaintext, size_t blocks, kalyna_t* ctx,
+        uint64_t* ciphertext) {
+    KalynaEngineFor(ctx->nb, ctx->nk)->encipher(plaintext, blocks, ctx, ciphertext);
+}
+
+void KalynaDecipherBlocks(const uint64_t* ciphertext, size_t blocks, kalyna_t* ctx,
+        uint64_t* plaintext) {
+    KalynaEngineFor(ctx->nb, ctx->nk)->decipher(ciphertext, blocks, ctx, plaintext);
+}
+
+
+void KalynaLanesLoad(kalyna_t* const* ctxs, size_t lanes, kalyna_lanes_t* schedule) {
+    size_t lane, round, col, index;
+    schedule->lanes = lanes;
+    schedule->nb = ctxs[0]->nb;
+    schedule->nr = ctxs[0]->nr;
+    for (lane = 0; lane < lanes; ++lane) {
+        schedule->ctxs[lane] = ctxs[lane];
+        for (round = 0; round <= schedule->nr; ++round) {
+            for (col = 0; col < schedule->nb; ++col) {
+                index = (round * schedule->nb + col) * kLANES + lane;
+                schedule->round_keys[index] = ctxs[lane]->round_keys[round][col];
+                schedule->round_keys_dec[index] = ctxs[lane]->round_keys_dec[round][col];
+            }
+        }
+    }
+}
+
+/*!
+ * Run the lanes in lockstep for the number of blocks all of them have, then
+ * finish the longer ones lane by lane.
+ */
+static void ProcessLanes(const kalyna_lanes_t* schedule, const uint64_t* const* input,
+        const size_t* blocks, uint64_t* const* output, kalyna_lanes_fn lanes_fn,
+        kalyna_blocks_fn blocks_fn) {
+    size_t lane, common = 0, done;
+    if (schedule->lanes == kLANES && lanes_fn != NULL) {
+        common = blocks[0];
+        for (lane = 1; lane < kLANES; ++lane)
+            common = blocks[lane] < common ? blocks[lane] : common;
+        if (common > 0)
+            lanes_fn(schedule, input, common, output);
+    }
+    for (lane = 0; lane < schedule->lanes; ++lane) {
+        done = common * schedule->nb;
+        if (blocks[lane] > common)
+            blocks_fn(input[lane] + done, blocks[lane] - common, schedule->ctxs[lane],
+                output[lane] + done);
+    }
+}
+
+void KalynaEncipherLanes(const kalyna_lanes_t* schedule, const uint64_t* const* input,
+        const size_t* blocks, uint64_t* const* output) {
+    const kalyna_engine_t* engine = KalynaEngineFor(schedule->nb, schedule->ctxs[0]->nk);
+    ProcessLanes(schedule, input, blocks, output, engine->encipher_lanes,
+        engine->encipher);
+}
+
+void KalynaDecipherLanes(const kalyna_lanes_t* schedule, const uint64_t* const* input,
+        const size_t* blocks, uint64_t* const* output) {
+    const kalyna_engine_t* engine = KalynaEngineFor(schedule->nb, schedule->ctxs[0]->nk);
+    ProcessLanes(schedule, input, blocks, output, engine->decipher_lanes,
+        engine->decipher);
+}
@@ -0,0 +1,163 @@
+/*
+
+Header file for runtime selection of round engines of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef KALYNA_ENGINE_H
+#define KALYNA_ENGINE_H
+
+#include "kalyna.h"
+#include "transformations.h"
+
+/* Number of independent keys processed together by multi-buffer routines. */
+#define kLANES 4
+
+/* Number of block and key size combinations of the standard. */
+#define kENGINE_VARIANTS 5
+
+/*!
+ * Round keys of up to kLANES contexts of the same block and key size in
+ * lane-major order: the key word of `column` in `round` for all lanes is
+ * round_keys[(round * nb + column) * kLANES + lane], so that a round reads
+ * the keys of every lane from adjacent words.
+ */
+typedef struct {
+    size_t lanes;  /**< Number of loaded contexts. */
+    size_t nb;  /**< Number of 64-bit words in block. */
+    size_t nr;  /**< Number of enciphering rounds. */
+    kalyna_t* ctxs[kLANES];  /**< Contexts the keys were loaded from. */
+    uint64_t round_keys[(kNR_512 + 1) * kNB_512 * kLANES];
+    uint64_t round_keys_dec[(kNR_512 + 1) * kNB_512 * kLANES];
+} kalyna_lanes_t;
+
+/*!
+ * Multi-block enciphering or deciphering routine of an engine.
+ *
+ * @param input Input blocks of length `blocks` * Nb words.
+ * @param blocks Number of blocks.
+ * @param ctx Initialized cipher context with precomputed round keys.
+ * @param output Output blocks, may be the same array as `input`.
+ */
+typedef void (*kalyna_blocks_fn)(const uint64_t* input, size_t blocks,
+    kalyna_t* ctx, uint64_t* output);
+
+/*!
+ * Multi-buffer routine of an engine: advances kLANES independent streams,
+ * each under its own key, through every round together.
+ *
+ * @param schedule Round keys of exactly kLANES contexts.
+ * @param input Input blocks of each lane, `blocks` * Nb words each.
+ * @param blocks Number of blocks of every lane.
+ * @param output Output blocks of each lane, may be the same arrays as
+ * `input`.
+ */
+typedef void (*kalyna_lanes_fn)(const kalyna_lanes_t* schedule,
+    const uint64_t* const* input, size_t blocks, uint64_t* const* output);
+
+/*!
+ * Key schedule routine of an engine: one round without round key or
+ * InvMixColumns of every block of a batch, see TTableEncipherRounds().
+ *
+ * @param in Input blocks of length `blocks` * `nb` words.
+ * @param blocks Number of blocks.
+ * @param nb Number of 64-bit words in block.
+ * @param out Output blocks, must not overlap `in`.
+ */
+typedef void (*kalyna_rounds_fn)(const uint64_t* in, size_t blocks, size_t nb,
+    uint64_t* out);
+
+/*!
+ * Round engine implementing Kalyna for all block and key sizes.
+ */
+typedef struct {
+    const char* name;  /**< Short engine name, e.g. "ttable". */
+    int (*available)(void);  /**< Nonzero if the running CPU supports it. */
+    void (*init)(void);  /**< Build engine tables, NULL if none needed. */
+    kalyna_blocks_fn encipher;  /**< Multi-block enciphering. */
+    kalyna_blocks_fn decipher;  /**< Multi-block deciphering. */
+    kalyna_lanes_fn encipher_lanes;  /**< Multi-buffer enciphering or NULL. */
+    kalyna_lanes_fn decipher_lanes;  /**< Multi-buffer deciphering or NULL. */
+    kalyna_rounds_fn encipher_rounds;  /**< Key schedule rounds. */
+    kalyna_rounds_fn inv_mix_columns;  /**< Key schedule InvMixColumns. */
+} kalyna_engine_t;
+
+/*!
+ * All engines compiled in, ordered from the fastest to the reference one.
+ * The array is terminated by NULL.
+ */
+extern const kalyna_engine_t* const kalyna_engines[];
+
+/*!
+ * Select the fastest engine supported by the running CPU, unless
+ * KalynaSelectEngine() or KALYNA_ENGINE chose another one. The choice is
+ * made once, engine tables are built on the first call. If KALYNA_TUNE is
+ * set, KalynaTune() runs with it as the cache file on the first call too.
+ *
+ * @return Selected engine, never NULL (the reference engine is always
+ * available).
+ */
+const kalyna_engine_t* KalynaEngineSelect(void);
+
+/*!
+ * Find an engine by name and prepare it for use.
+ *
+ * @param name Engine name.
+ * @return The engine or NULL if it is unknown or not supported by the
+ * running CPU.
+ */
+const kalyna_engine_t* KalynaEngineFind(const char* name);
+
+/*!
+ * Index of a variant from 0 for Kalyna-128/128 to 4 for Kalyna-512/512.
+ *
+ * @param nb Number of 64-bit words in block.
+ * @param nk Number of 64-bit words in key.
+ */
+size_t KalynaVariantIndex(size_t nb, size_t nk);
+
+/*!
+ * Engine used for multi-block calls of a variant: the one KalynaTune() chose
+ * for it, otherwise KalynaEngineSelect().
+ */
+const kalyna_engine_t* KalynaEngineFor(size_t nb, size_t nk);
+
+/*!
+ * Use `engine` for a variant, NULL to go back to KalynaEngineSelect().
+ */
+void KalynaEngineSetVariant(size_t nb, size_t nk, const kalyna_engine_t* engine);
+
+/*!
+ * Transpose round keys of several contexts into lane-major order.
+ *
+ * @param ctxs Contexts with expanded keys, all of the same block and key
+ * size.
+ * @param lanes Number of contexts, 1 to kLANES.
+ * @param schedule Output schedule.
+ */
+void KalynaLanesLoad(kalyna_t* const* ctxs, size_t lanes, kalyna_lanes_t* schedule);
+
+/*!
+ * Encipher streams of blocks of every loaded lane with the engine of their
+ * variant.
+ * Full schedules go through its multi-buffer routine, others through the
+ * multi-block one lane by lane.
+ *
+ * @param schedule Schedule filled by KalynaLanesLoad().
+ * @param input Input blocks of each lane.
+ * @param blocks Number of blocks of each lane.
+ * @param output Output blocks of each lane, may be the same arrays as
+ * `input`.
+ */
+void KalynaEncipherLanes(const kalyna_lanes_t* schedule, const uint64_t* const* input,
+    const size_t* blocks, uint64_t* const* output);
+
+/*!
+ * Decipher streams of blocks of every loaded lane, see KalynaEncipherLanes().
+ */
+void KalynaDecipherLanes(const kalyna_lanes_t* schedule, const uint64_t* const* input,
+    const size_t* blocks, uint64_t* const* output);
+
+#endif  /* KALYNA_ENGINE_H */
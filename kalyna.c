@@ -6,43 +6,60 @@ Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
 
 */
 
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "transformations.h"
 #include "tables.h"
+#include "engine.h"
+#include "arena.h"
+
+
+/*
+ * A context is a single arena slot: the structure is followed by the round
+ * key pointer arrays, the state and the round keys themselves.
+ */
+#define CONTEXT_BYTES(nb, nr) (sizeof(kalyna_t) + 2 * ((nr) + 1) * sizeof(uint64_t*) + \
+    ((nb) + 2 * ((nr) + 1) * (nb)) * sizeof(uint64_t))
 
+typedef char context_fits_arena_slot[
+    CONTEXT_BYTES(kNB_512, kNR_512) <= kARENA_SLOT_BYTES ? 1 : -1];
 
 kalyna_t* KalynaInit(size_t block_size, size_t key_size) {
-    int i;
-    kalyna_t* ctx = (kalyna_t*)malloc(sizeof(kalyna_t));
+    size_t nb, nk, nr;
 
     if (block_size == kBLOCK_128) {
-        ctx->nb = kBLOCK_128 / kBITS_IN_WORD;
+        nb = kBLOCK_128 / kBITS_IN_WORD;
         if (key_size == kKEY_128) {
-            ctx->nk = kKEY_128 / kBITS_IN_WORD;
-            ctx->nr = kNR_128;
+            nk = kKEY_128 / kBITS_IN_WORD;
+            nr = kNR_128;
         } else if (key_size == kKEY_256){
-            ctx->nk =  kKEY_256 / kBITS_IN_WORD;
-            ctx->nr = kNR_256;
+            nk =  kKEY_256 / kBITS_IN_WORD;
+            nr = kNR_256;
         } else {
             fprintf(stderr, "Error: unsupported key size.\n");
             return NULL;
         }
     } else if (block_size == 256) {
-        ctx->nb = kBLOCK_256 / kBITS_IN_WORD;
+        nb = kBLOCK_256 / kBITS_IN_WORD;
         if (key_size == kKEY_256) {
-            ctx->nk = kKEY_256 / kBITS_IN_WORD;
-            ctx->nr = kNR_256;
+            nk = kKEY_256 / kBITS_IN_WORD;
+            nr = kNR_256;
         } else if (key_size == kKEY_512){
-            ctx->nk = kKEY_512 / kBITS_IN_WORD;
-            ctx->nr = kNR_512;
+            nk = kKEY_512 / kBITS_IN_WORD;
+            nr = kNR_512;
         } else {
             fprintf(stderr, "Error: unsupported key size.\n");
             return NULL;
         }
     } else if (block_size == kBLOCK_512) {
-        ctx->nb = kBLOCK_512 / kBITS_IN_WORD;
+        nb = kBLOCK_512 / kBITS_IN_WORD;
         if (key_size == kKEY_512) {
-            ctx->nk = kKEY_512 / kBITS_IN_WORD;
-            ctx->nr = kNR_512;
+            nk = kKEY_512 / kBITS_IN_WORD;
+            nr = kNR_512;
         } else {
             fprintf(stderr, "Error: unsupported key size.\n");
             return NULL;
@@ -52,32 +69,35 @@ kalyna_t* KalynaInit(size_t block_size, size_t key_size) {
         return NULL;
     }
 
-    ctx->state = (uint64_t*)calloc(ctx->nb, sizeof(uint64_t));
-    if (ctx->state == NULL)
-        perror("Could not allocate memory for cipher state.");
+    return ContextInit(nb, nk, nr, NULL);
+}
 
-    ctx->round_keys = (uint64_t**)calloc(ctx->nr + 1, sizeof(uint64_t**));
-    if (ctx->round_keys == NULL) 
-        perror("Could not allocate memory for cipher round keys.");
+kalyna_t* ContextInit(size_t nb, size_t nk, size_t nr, uint64_t* keys) {
+    size_t i;
+    kalyna_t* ctx = (kalyna_t*)ArenaAlloc();
 
-    for (i = 0; i < ctx->nr + 1; ++i) {
-        ctx->round_keys[i] = (uint64_t*)calloc(ctx->nb, sizeof(uint64_t));
-        if (ctx->round_keys[i] == NULL)
-            perror("Could not allocate memory for cipher round keys.");
+    if (ctx == NULL) {
+        perror("Could not allocate memory for cipher context.");
+        return NULL;
+    }
+    ctx->nb = nb;
+    ctx->nk = nk;
+    ctx->nr = nr;
+    ctx->round_keys = (uint64_t**)(ctx + 1);
+    ctx->round_keys_dec = ctx->round_keys + nr + 1;
+    ctx->state = (uint64_t*)(ctx->round_keys_dec + nr + 1);
+    if (keys == NULL)
+        keys = ctx->state + nb;
+    for (i = 0; i < nr + 1; ++i) {
+        ctx->round_keys[i] = keys + i * nb;
+        ctx->round_keys_dec[i] = keys + (nr + 1 + i) * nb;
     }
     return ctx;
 }
 
 
 int KalynaDelete(kalyna_t* ctx) {
-    int i;
-    free(ctx->state);
-    for (i = 0; i < ctx->nr + 1; ++i) {
-        free(ctx->round_keys[i]);
-    }
-    free(ctx->round_keys);
-    free(ctx);
-    ctx = NULL;
+    ArenaFree(ctx);  /* Wipes state and round keys. */
     return 0;
 }
 
@@ -116,39 +136,37 @@ void InvSubBytes(kalyna_t* ctx) {
 void ShiftRows(kalyna_t* ctx) {
     int row, col;
     int shift = -1;
+    uint64_t nstate[kNB_512];
 
-    uint8_t* state = WordsToBytes(ctx->nb, ctx->state);
-    uint8_t* nstate = (uint8_t*) malloc(ctx->nb * sizeof(uint64_t));
-
+    memset(nstate, 0, sizeof(nstate));
     for (row = 0; row < sizeof(uint64_t); ++row) {
         if (row % (sizeof(uint64_t) / ctx->nb) == 0)
             shift += 1;
         for (col = 0; col < ctx->nb; ++col) {
-            INDEX(nstate, row, (col + shift) % ctx->nb) = INDEX(state, row, col);
+            nstate[(col + shift) % ctx->nb] |=
+                (uint64_t)STATE_BYTE(ctx->state[col], row) << (row * kBITS_IN_BYTE);
         }
     }
 
-    ctx->state = BytesToWords(ctx->nb * sizeof(uint64_t), nstate);
-    free(state);
+    memcpy(ctx->state, nstate, ctx->nb * sizeof(uint64_t));
 }
 
 void InvShiftRows(kalyna_t* ctx) {
     int row, col;
     int shift = -1;
+    uint64_t nstate[kNB_512];
 
-    uint8_t* state = WordsToBytes(ctx->nb, ctx->state);
-    uint8_t* nstate = (uint8_t*) malloc(ctx->nb * sizeof(uint64_t));
-
+    memset(nstate, 0, sizeof(nstate));
     for (row = 0; row < sizeof(uint64_t); ++row) {
         if (row % (sizeof(uint64_t) / ctx->nb) == 0)
             shift += 1;
         for (col = 0; col < ctx->nb; ++col) {
-            INDEX(nstate, row, col) = INDEX(state, row, (col + shift) % ctx->nb);
+            nstate[col] |= (uint64_t)STATE_BYTE(ctx->state[(col + shift) % ctx->nb], row)
+                << (row * kBITS_IN_BYTE);
         }
     }
 
-    ctx->state = BytesToWords(ctx->nb * sizeof(uint64_t), nstate);
-    free(state);
+    memcpy(ctx->state, nstate, ctx->nb * sizeof(uint64_t));
 }
 
 
@@ -172,16 +190,15 @@ void MatrixMultiply(kalyna_t* ctx, uint8_t matrix[8][8]) {
     int col, row, b;
     uint8_t product;
     uint64_t result;
-    uint8_t* state = WordsToBytes(ctx->nb, ctx->state);
 
     for (col = 0; col < ctx->nb; ++col) {
         result = 0;
         for (row = sizeof(uint64_t) - 1; row >= 0; --row) {
             product = 0;
             for (b = sizeof(uint64_t) - 1; b >= 0; --b) {
-                product ^= MultiplyGF(INDEX(state, b, col), matrix[row][b]);
+                product ^= MultiplyGF(STATE_BYTE(ctx->state[col], b), matrix[row][b]);
             }
-            result |= (uint64_t)product << (row * sizeof(uint64_t));
+            result |= (uint64_t)product << (row * kBITS_IN_BYTE);
         }    
         ctx->state[col] = result;
     }
@@ -265,208 +282,467 @@ void ShiftLeft(size_t state_size, uint64_t* state_value) {
 }
 
 void RotateLeft(size_t state_size, uint64_t* state_value) {
+    size_t i;
     size_t rotate_bytes = 2 * state_size + 3;
-    size_t bytes_num = state_size * (kBITS_IN_WORD / kBITS_IN_BYTE);
+    size_t words = rotate_bytes / sizeof(uint64_t);
+    size_t shift = (rotate_bytes % sizeof(uint64_t)) * kBITS_IN_BYTE;
+    uint64_t rotated[kNB_512];
+
+    /*
+     * Byte i of the result is byte (i + rotate_bytes) of the source string:
+     * a whole word rotation followed by a funnel shift of adjacent words.
+     * The byte shift is 3 or 7 for every block size, never zero.
+     */
+    for (i = 0; i < state_size; ++i) {
+        rotated[i] = (state_value[(i + words) % state_size] >> shift) |
+            (state_value[(i + words + 1) % state_size] << (kBITS_IN_WORD - shift));
+    }
+    memcpy(state_value, rotated, state_size * sizeof(uint64_t));
+}
 
-    uint8_t* bytes = WordsToBytes(state_size, state_value);
-    uint8_t* buffer = (uint8_t*) malloc(rotate_bytes);
 
-    /* Rotate bytes in memory. */
-    memcpy(buffer, bytes, rotate_bytes);
-    memmove(bytes, bytes + rotate_bytes, bytes_num - rotate_bytes);
-    memcpy(bytes + bytes_num - rotate_bytes, buffer, rotate_bytes);
+void KeyExpandKt(uint64_t* key, kalyna_t* ctx, uint64_t* kt) {
+    size_t i;
+    uint64_t state[kNB_512], round[kNB_512];
+    const uint64_t* k0 = key;
+    const uint64_t* k1 = ctx->nb == ctx->nk ? key : key + ctx->nb;
+    kalyna_rounds_fn rounds = KalynaEngineFor(ctx->nb, ctx->nk)->encipher_rounds;
+
+    for (i = 0; i < ctx->nb; ++i)
+        state[i] = k0[i];
+    state[0] += ctx->nb + ctx->nk + 1;
+    rounds(state, 1, ctx->nb, round);
+    for (i = 0; i < ctx->nb; ++i)
+        round[i] ^= k1[i];
+    rounds(round, 1, ctx->nb, state);
+    for (i = 0; i < ctx->nb; ++i)
+        state[i] += k0[i];
+    rounds(state, 1, ctx->nb, kt);
+
+    SecureWipe(state, sizeof(state));
+    SecureWipe(round, sizeof(round));
+}
 
-    state_value = BytesToWords(bytes_num, bytes);
 
-    free(buffer);
-}
+void KeyExpandEven(uint64_t* key, uint64_t* kt, kalyna_t* ctx) {
+    size_t i, j, offset, rotation;
+    size_t count = ctx->nr / 2 + 1;
+    uint64_t kt_round[(kNR_512 / 2 + 1) * kNB_512];
+    uint64_t state[(kNR_512 / 2 + 1) * kNB_512], round[(kNR_512 / 2 + 1) * kNB_512];
+    uint64_t* words;
+    kalyna_rounds_fn rounds = KalynaEngineFor(ctx->nb, ctx->nk)->encipher_rounds;
+
+    /*
+     * Even round key 2j only depends on Kt and on j: tmv is shifted j times
+     * and the key is rotated by one word per round key if Nk = Nb, or per
+     * pair of round keys taking its halves in turn if Nk = 2 * Nb. All of
+     * them go through the rounds as one batch.
+     */
+    for (j = 0; j < count; ++j) {
+        rotation = ctx->nk == ctx->nb ? j : j / 2;
+        offset = ctx->nk == ctx->nb ? 0 : (j % 2) * ctx->nb;
+        words = kt_round + j * ctx->nb;
+        for (i = 0; i < ctx->nb; ++i) {
+            words[i] = kt[i] + (0x0001000100010001ULL << j);
+            state[j * ctx->nb + i] = key[(offset + i + rotation) % ctx->nk] + words[i];
+        }
+    }
+    rounds(state, count, ctx->nb, round);
+    for (i = 0; i < count * ctx->nb; ++i)
+        round[i] ^= kt_round[i];
+    rounds(round, count, ctx->nb, state);
+    for (j = 0; j < count; ++j) {
+        for (i = 0; i < ctx->nb; ++i)
+            ctx->round_keys[2 * j][i] = state[j * ctx->nb + i] + kt_round[j * ctx->nb + i];
+    }
 
+    SecureWipe(kt_round, sizeof(kt_round));
+    SecureWipe(state, sizeof(state));
+    SecureWipe(round, sizeof(round));
+}
 
-void KeyExpandKt(uint64_t* key, kalyna_t* ctx, uint64_t* kt) {
-    uint64_t* k0 = (uint64_t*) malloc(ctx->nb * sizeof(uint64_t));
-    uint64_t* k1 = (uint64_t*) malloc(ctx->nb * sizeof(uint64_t));
-	
-	memset(ctx->state, 0, ctx->nb * sizeof(uint64_t));
-    ctx->state[0] += ctx->nb + ctx->nk + 1;
-	   
-    if (ctx->nb == ctx->nk) {
-        memcpy(k0, key, ctx->nb * sizeof(uint64_t));
-        memcpy(k1, key, ctx->nb * sizeof(uint64_t));
-    } else {
-        memcpy(k0, key, ctx->nb * sizeof(uint64_t));
-        memcpy(k1, key + ctx->nb, ctx->nb * sizeof(uint64_t));
+void KeyExpandOdd(kalyna_t* ctx) {
+    int i;
+    for (i = 1; i < ctx->nr; i += 2) {
+        memcpy(ctx->round_keys[i], ctx->round_keys[i - 1], ctx->nb * sizeof(uint64_t));
+        RotateLeft(ctx->nb, ctx->round_keys[i]);
     }
+}
 
-    AddRoundKeyExpand(k0, ctx);
-    EncipherRound(ctx);
-    XorRoundKeyExpand(k1, ctx);
-    EncipherRound(ctx);
-    AddRoundKeyExpand(k0, ctx);
-    EncipherRound(ctx);
-    memcpy(kt, ctx->state, ctx->nb * sizeof(uint64_t));
+void KeyExpandInverse(kalyna_t* ctx) {
+    kalyna_rounds_fn inv_mix_columns = KalynaEngineFor(ctx->nb, ctx->nk)->inv_mix_columns;
+    /* Round keys of a context are contiguous, see ContextInit(). */
+    inv_mix_columns(ctx->round_keys[0], ctx->nr + 1, ctx->nb, ctx->round_keys_dec[0]);
+}
 
-    free(k0);
-    free(k1);
+void KalynaKeyExpand(uint64_t* key, kalyna_t* ctx) {
+    uint64_t kt[kNB_512];
+    KeyExpandKt(key, ctx, kt);
+    KeyExpandEven(key, kt, ctx);
+    KeyExpandOdd(ctx);
+    KeyExpandInverse(ctx);
+    SecureWipe(kt, sizeof(kt));
 }
 
 
-void KeyExpandEven(uint64_t* key, uint64_t* kt, kalyna_t* ctx) {
-    int i;
-    uint64_t* initial_data = (uint64_t*) malloc(ctx->nk * sizeof(uint64_t));
-    uint64_t* kt_round = (uint64_t*) malloc(ctx->nb * sizeof(uint64_t));
-    uint64_t* tmv = (uint64_t*) malloc(ctx->nb * sizeof(uint64_t));
-	size_t round = 0;
+void EncipherWithState(const uint64_t* plaintext, const kalyna_t* ctx, uint64_t* state,
+        uint64_t* ciphertext) {
+    int round = 0;
+    kalyna_t local = *ctx;
 
-    memcpy(initial_data, key, ctx->nk * sizeof(uint64_t));
-    for (i = 0; i < ctx->nb; ++i) {
-        tmv[i] = 0x0001000100010001;
+    local.state = state;
+    memcpy(local.state, plaintext, local.nb * sizeof(uint64_t));
+
+    AddRoundKey(round, &local);
+    for (round = 1; round < local.nr; ++round) {
+        EncipherRound(&local);
+        XorRoundKey(round, &local);
     }
+    EncipherRound(&local);
+    AddRoundKey(local.nr, &local);
+
+    memcpy(ciphertext, local.state, local.nb * sizeof(uint64_t));
+}
 
-    while(TRUE) {
-        memcpy(ctx->state, kt, ctx->nb * sizeof(uint64_t));
-        AddRoundKeyExpand(tmv, ctx);
-        memcpy(kt_round, ctx->state, ctx->nb * sizeof(uint64_t));
+void DecipherWithState(const uint64_t* ciphertext, const kalyna_t* ctx, uint64_t* state,
+        uint64_t* plaintext) {
+    int round = ctx->nr;
+    kalyna_t local = *ctx;
 
-        memcpy(ctx->state, initial_data, ctx->nb * sizeof(uint64_t));
+    local.state = state;
+    memcpy(local.state, ciphertext, local.nb * sizeof(uint64_t));
 
-        AddRoundKeyExpand(kt_round, ctx);
-        EncipherRound(ctx);
-        XorRoundKeyExpand(kt_round, ctx);
-        EncipherRound(ctx);
-        AddRoundKeyExpand(kt_round, ctx);
+    SubRoundKey(round, &local);
+    for (round = local.nr - 1; round > 0; --round) {
+        DecipherRound(&local);
+        XorRoundKey(round, &local);
+    }
+    DecipherRound(&local);
+    SubRoundKey(0, &local);
 
-        memcpy(ctx->round_keys[round], ctx->state, ctx->nb * sizeof(uint64_t));
+    memcpy(plaintext, local.state, local.nb * sizeof(uint64_t));
+}
 
-        if (ctx->nr == round)
-            break;
+void KalynaEncipher(uint64_t* plaintext, kalyna_t* ctx, uint64_t* ciphertext) {
+    EncipherWithState(plaintext, ctx, ctx->state, ciphertext);
+}
+
+void KalynaDecipher(uint64_t* ciphertext, kalyna_t* ctx, uint64_t* plaintext) {
+    DecipherWithState(ciphertext, ctx, ctx->state, plaintext);
+}
 
-        if (ctx->nk != ctx->nb) {
-            round += 2;
 
-            ShiftLeft(ctx->nb, tmv);
+/* True if the buffer may be accessed directly as 64-bit words. */
+#define IS_WORD_ALIGNED(buffer) (((size_t)(buffer) % sizeof(uint64_t)) == 0)
 
-            memcpy(ctx->state, kt, ctx->nb * sizeof(uint64_t));
-            AddRoundKeyExpand(tmv, ctx);
-            memcpy(kt_round, ctx->state, ctx->nb * sizeof(uint64_t));
+/* Bounce buffer size for unaligned or big endian byte buffers. */
+#define kBYTES_CHUNK 1024
 
-            memcpy(ctx->state, initial_data + ctx->nb, ctx->nb * sizeof(uint64_t));
+/*
+ * Buffers past the last level cache are processed through a bounce buffer
+ * in L1: the input is prefetched a few chunks ahead and the output is
+ * written with non-temporal stores, which skip the read for ownership of
+ * every output line and leave the caches to the working set of the caller.
+ */
+#if defined(__SSE2__)
+#define kSTREAM_STORES 1
+#else
+#define kSTREAM_STORES 0
+#endif
+
+/* Alignment of the output required by non-temporal stores. */
+#define kSTREAM_ALIGNMENT 16
+
+/* Distance of input prefetch ahead of the current chunk, cache line size. */
+#define kPREFETCH_BYTES (4 * kBYTES_CHUNK)
+#define kCACHE_LINE 64
+
+/* Streaming threshold if the size of the last level cache is unknown. */
+#define kDEFAULT_STREAMING_BYTES (8 * 1024 * 1024)
+
+/* Read and written with relaxed atomics: tests and benchmarks change it. */
+static size_t streaming_bytes = kDEFAULT_STREAMING_BYTES;
+static pthread_once_t streaming_once = PTHREAD_ONCE_INIT;
+
+static void DetectStreamingBytes(void) {
+    long bytes = -1;
+#if defined(_SC_LEVEL3_CACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE)
+    bytes = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (bytes <= 0)
+        bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    if (bytes > 0)
+        __atomic_store_n(&streaming_bytes, (size_t)bytes, __ATOMIC_RELAXED);
+}
 
-            AddRoundKeyExpand(kt_round, ctx);
-            EncipherRound(ctx);
-            XorRoundKeyExpand(kt_round, ctx);
-            EncipherRound(ctx);
-            AddRoundKeyExpand(kt_round, ctx);
+size_t StreamingThreshold(size_t bytes) {
+    pthread_once(&streaming_once, DetectStreamingBytes);
+    if (bytes != 0)
+        __atomic_store_n(&streaming_bytes, bytes, __ATOMIC_RELAXED);
+    return __atomic_load_n(&streaming_bytes, __ATOMIC_RELAXED);
+}
 
-            memcpy(ctx->round_keys[round], ctx->state, ctx->nb * sizeof(uint64_t));
+/* True if a call over `length` bytes writing to `output` should stream. */
+static int UseStreaming(size_t length, const uint8_t* output) {
+    return kSTREAM_STORES && length >= StreamingThreshold(0) &&
+        (size_t)output % kSTREAM_ALIGNMENT == 0;
+}
 
-            if (ctx->nr == round)
-                break;
-        }
-        round += 2;
-        ShiftLeft(ctx->nb, tmv);
-        Rotate(ctx->nk, initial_data);
+/* Prefetch the input of the chunk kPREFETCH_BYTES ahead of `offset`. */
+static inline void PrefetchAhead(const uint8_t* input, size_t offset, size_t length) {
+#if defined(__GNUC__)
+    size_t i;
+    for (i = offset + kPREFETCH_BYTES; i < offset + kPREFETCH_BYTES + kBYTES_CHUNK &&
+            i < length; i += kCACHE_LINE)
+        __builtin_prefetch(input + i, 0, 0);
+#endif
+}
+
+/*!
+ * Write bytes of the bounce buffer, optionally XORed with the input, with
+ * non-temporal stores. The output is aligned to kSTREAM_ALIGNMENT, the
+ * words are little endian as on every host with stream stores.
+ *
+ * @param input Input bytes to XOR or NULL to store the words alone.
+ */
+static void StreamWords(size_t length, const uint8_t* input, const uint64_t* words,
+        uint8_t* output) {
+#if kSTREAM_STORES
+    size_t i;
+    __m128i value;
+    for (i = 0; i + kSTREAM_ALIGNMENT <= length; i += kSTREAM_ALIGNMENT) {
+        value = _mm_loadu_si128((const __m128i*)(words + i / sizeof(uint64_t)));
+        if (input != NULL)
+            value = _mm_xor_si128(value, _mm_loadu_si128((const __m128i*)(input + i)));
+        _mm_stream_si128((__m128i*)(output + i), value);
     }
+    if (input != NULL)
+        XorGamma(length - i, input + i, words + i / sizeof(uint64_t), output + i);
+    else
+        memcpy(output + i, words + i / sizeof(uint64_t), length - i);
+#endif
+}
 
-    free(initial_data);
-    free(kt_round);
-    free(tmv);
+/* Order the non-temporal stores before any later store of the thread. */
+static void StreamFence(void) {
+#if kSTREAM_STORES
+    _mm_sfence();
+#endif
 }
 
-void KeyExpandOdd(kalyna_t* ctx) {
-    int i;
-    for (i = 1; i < ctx->nr; i += 2) {
-        memcpy(ctx->round_keys[i], ctx->round_keys[i - 1], ctx->nb * sizeof(uint64_t));
-        RotateLeft(ctx->nb, ctx->round_keys[i]);
+static void CryptStreaming(const uint8_t* input, size_t length, kalyna_t* ctx,
+        uint8_t* output, int decipher) {
+    size_t offset, chunk;
+    size_t block_len = ctx->nb * sizeof(uint64_t);
+    uint64_t buffer[kBYTES_CHUNK / sizeof(uint64_t)];
+
+    for (offset = 0; offset < length; offset += chunk) {
+        chunk = length - offset < kBYTES_CHUNK ? length - offset : kBYTES_CHUNK;
+        PrefetchAhead(input, offset, length);
+        ReadWords(chunk / sizeof(uint64_t), input + offset, buffer);
+        if (decipher)
+            KalynaDecipherBlocks(buffer, chunk / block_len, ctx, buffer);
+        else
+            KalynaEncipherBlocks(buffer, chunk / block_len, ctx, buffer);
+        StreamWords(chunk, NULL, buffer, output + offset);
     }
+    StreamFence();
 }
 
-void KalynaKeyExpand(uint64_t* key, kalyna_t* ctx) {
-    uint64_t* kt = (uint64_t*) malloc(ctx->nb * sizeof(uint64_t));
-    KeyExpandKt(key, ctx, kt);
-    KeyExpandEven(key, kt, ctx);
-    KeyExpandOdd(ctx);
-    free(kt);
+int KalynaEncryptBytes(const uint8_t* plaintext, size_t length, kalyna_t* ctx,
+        uint8_t* ciphertext) {
+    size_t offset, chunk;
+    size_t block_len = ctx->nb * sizeof(uint64_t);
+    uint64_t buffer[kBYTES_CHUNK / sizeof(uint64_t)];
+
+    if (length % block_len != 0)
+        return -1;
+
+    if (UseStreaming(length, ciphertext)) {
+        CryptStreaming(plaintext, length, ctx, ciphertext, FALSE);
+        return 0;
+    }
+    if (!kBIG_ENDIAN && IS_WORD_ALIGNED(plaintext) && IS_WORD_ALIGNED(ciphertext)) {
+        KalynaEncipherBlocks((const uint64_t*)plaintext, length / block_len, ctx,
+            (uint64_t*)ciphertext);
+        return 0;
+    }
+
+    for (offset = 0; offset < length; offset += chunk) {
+        chunk = length - offset < kBYTES_CHUNK ? length - offset : kBYTES_CHUNK;
+        ReadWords(chunk / sizeof(uint64_t), plaintext + offset, buffer);
+        KalynaEncipherBlocks(buffer, chunk / block_len, ctx, buffer);
+        WriteWords(chunk / sizeof(uint64_t), buffer, ciphertext + offset);
+    }
+    return 0;
 }
 
+int KalynaDecryptBytes(const uint8_t* ciphertext, size_t length, kalyna_t* ctx,
+        uint8_t* plaintext) {
+    size_t offset, chunk;
+    size_t block_len = ctx->nb * sizeof(uint64_t);
+    uint64_t buffer[kBYTES_CHUNK / sizeof(uint64_t)];
 
-void KalynaEncipher(uint64_t* plaintext, kalyna_t* ctx, uint64_t* ciphertext) {
-    int round = 0;
-    memcpy(ctx->state, plaintext, ctx->nb * sizeof(uint64_t));
+    if (length % block_len != 0)
+        return -1;
 
-    AddRoundKey(round, ctx);
-    for (round = 1; round < ctx->nr; ++round) {
-        EncipherRound(ctx);
-        XorRoundKey(round, ctx);
+    if (UseStreaming(length, plaintext)) {
+        CryptStreaming(ciphertext, length, ctx, plaintext, TRUE);
+        return 0;
+    }
+    if (!kBIG_ENDIAN && IS_WORD_ALIGNED(ciphertext) && IS_WORD_ALIGNED(plaintext)) {
+        KalynaDecipherBlocks((const uint64_t*)ciphertext, length / block_len, ctx,
+            (uint64_t*)plaintext);
+        return 0;
     }
-    EncipherRound(ctx);
-    AddRoundKey(ctx->nr, ctx);
 
-    memcpy(ciphertext, ctx->state, ctx->nb * sizeof(uint64_t));
+    for (offset = 0; offset < length; offset += chunk) {
+        chunk = length - offset < kBYTES_CHUNK ? length - offset : kBYTES_CHUNK;
+        ReadWords(chunk / sizeof(uint64_t), ciphertext + offset, buffer);
+        KalynaDecipherBlocks(buffer, chunk / block_len, ctx, buffer);
+        WriteWords(chunk / sizeof(uint64_t), buffer, plaintext + offset);
+    }
+    return 0;
 }
 
-void KalynaDecipher(uint64_t* ciphertext, kalyna_t* ctx, uint64_t* plaintext) {
-    int round = ctx->nr;
-    memcpy(ctx->state, ciphertext, ctx->nb * sizeof(uint64_t));
 
-    SubRoundKey(round, ctx);
-    for (round = ctx->nr - 1; round > 0; --round) {
-        DecipherRound(ctx);
-        XorRoundKey(round, ctx);
+void CtrCounters(uint64_t* counter, size_t blocks, size_t nb, uint64_t* output) {
+    size_t i, j;
+    for (i = 0; i < blocks; ++i) {
+        for (j = 0; j < nb && ++counter[j] == 0; ++j);
+        memcpy(output + i * nb, counter, nb * sizeof(uint64_t));
+    }
+}
+
+void XorGamma(size_t length, const uint8_t* input, const uint64_t* gamma,
+        uint8_t* output) {
+    size_t i;
+    uint64_t word;
+    for (i = 0; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        memcpy(&word, input + i, sizeof(uint64_t));
+        word ^= kBIG_ENDIAN ? ReverseWord(gamma[i / sizeof(uint64_t)]) :
+            gamma[i / sizeof(uint64_t)];
+        memcpy(output + i, &word, sizeof(uint64_t));
     }
-    DecipherRound(ctx);
-    SubRoundKey(0, ctx);
+    for (; i < length; ++i)
+        output[i] = input[i] ^ STATE_BYTE(gamma[i / sizeof(uint64_t)], i % sizeof(uint64_t));
+}
 
-    memcpy(plaintext, ctx->state, ctx->nb * sizeof(uint64_t));
+int KalynaCtrBytes(const uint8_t* input, size_t length, const uint8_t* iv,
+        kalyna_t* ctx, uint8_t* output) {
+    size_t offset, chunk;
+    size_t blocks, block_len = ctx->nb * sizeof(uint64_t);
+    uint64_t counter[kNB_512];
+    uint64_t gamma[kBYTES_CHUNK / sizeof(uint64_t)];
+    int streaming = UseStreaming(length, output);
+
+    ReadWords(ctx->nb, iv, counter);
+    KalynaEncipherBlocks(counter, 1, ctx, counter);
+    for (offset = 0; offset < length; offset += chunk) {
+        chunk = length - offset < kBYTES_CHUNK ? length - offset : kBYTES_CHUNK;
+        blocks = (chunk + block_len - 1) / block_len;
+        CtrCounters(counter, blocks, ctx->nb, gamma);
+        KalynaEncipherBlocks(gamma, blocks, ctx, gamma);
+        if (streaming) {
+            PrefetchAhead(input, offset, length);
+            StreamWords(chunk, input + offset, gamma, output + offset);
+        } else {
+            XorGamma(chunk, input + offset, gamma, output + offset);
+        }
+    }
+    if (streaming)
+        StreamFence();
+    return 0;
 }
 
 
 uint8_t* WordsToBytes(size_t length, uint64_t* words) {
     int i;
-	uint8_t* bytes;
-    if (IsBigEndian()) {
+    if (kBIG_ENDIAN) {
         for (i = 0; i < length; ++i) {
             words[i] = ReverseWord(words[i]);
-        }        
+        }
     }
-    bytes = (uint8_t*)words;
-    return bytes;
+    return (uint8_t*)words;
 }
 
 uint64_t* BytesToWords(size_t length, uint8_t* bytes) {
     int i;
     uint64_t* words = (uint64_t*)bytes;
-    if (IsBigEndian()) {
-        for (i = 0; i < length; ++i) {
+    if (kBIG_ENDIAN) {
+        for (i = 0; i < length / sizeof(uint64_t); ++i) {
             words[i] = ReverseWord(words[i]);
-        }        
+        }
     }
     return words;
 }
 
 
+void ReadWords(size_t length, const uint8_t* bytes, uint64_t* words) {
+    int i;
+    memcpy(words, bytes, length * sizeof(uint64_t));
+    if (kBIG_ENDIAN) {
+        for (i = 0; i < length; ++i) {
+            words[i] = ReverseWord(words[i]);
+        }
+    }
+}
+
+void WriteWords(size_t length, const uint64_t* words, uint8_t* bytes) {
+    int i;
+    uint64_t word;
+    if (kBIG_ENDIAN) {
+        for (i = 0; i < length; ++i) {
+            word = ReverseWord(words[i]);
+            memcpy(bytes + i * sizeof(uint64_t), &word, sizeof(uint64_t));
+        }
+    } else {
+        memcpy(bytes, words, length * sizeof(uint64_t));
+    }
+}
+
+
+void DoubleBlock(size_t nb, const uint64_t* input, uint64_t* output) {
+    size_t i;
+    uint64_t carry = input[nb - 1] >> 63;
+    for (i = nb - 1; i > 0; --i)
+        output[i] = (input[i] << 1) | (input[i - 1] >> 63);
+    output[0] = (input[0] << 1) ^ (carry ? REDUCTION(nb) : 0);
+}
+
 uint64_t ReverseWord(uint64_t word) {
+#if defined(__GNUC__)
+    return __builtin_bswap64(word);
+#else
     int i;
     uint64_t reversed = 0;
     uint8_t* src = (uint8_t*)&word;
     uint8_t* dst = (uint8_t*)&reversed;
 
     for (i = 0; i < sizeof(uint64_t); ++i) {
-        dst[i] = src[sizeof(uint64_t) - i];    
+        dst[i] = src[sizeof(uint64_t) - 1 - i];
     }
     return reversed;
+#endif
 }
 
 
 int IsBigEndian() {
-    unsigned int num = 1;
-    /* Check the least significant byte value to determine endianness */
-    return (*((uint8_t*)&num) == 0);
+    return kBIG_ENDIAN;
+}
+
+#define STRINGIFY_(x) #x
+#define STRINGIFY(x) STRINGIFY_(x)
+
+const char* KalynaVersion(void) {
+    return STRINGIFY(KALYNA_VERSION_MAJOR) "." STRINGIFY(KALYNA_VERSION_MINOR) "."
+        STRINGIFY(KALYNA_VERSION_PATCH);
 }
 
 void PrintState(size_t length, uint64_t* state) {
     int i;
     for (i = length - 1; i >= 0; --i) {
-        printf("%16.16llx", state[i]);
+        printf("%16.16llx", (unsigned long long)state[i]);
     } 
     printf("\n");
 }
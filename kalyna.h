@@ -12,10 +12,29 @@ Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 
-typedef unsigned char uint8_t;
-typedef unsigned long long uint64_t;
+/* Library version. The major number changes with incompatible ABI changes. */
+#define KALYNA_VERSION_MAJOR 1
+#define KALYNA_VERSION_MINOR 1
+#define KALYNA_VERSION_PATCH 0
+
+/*
+ * Functions exported from the shared library. Everything else, including
+ * transformations.h helpers, is built with hidden visibility.
+ */
+#if defined(_WIN32) && defined(KALYNA_BUILD_DLL)
+#define KALYNA_API __declspec(dllexport)
+#elif defined(__GNUC__)
+#define KALYNA_API __attribute__((visibility("default")))
+#else
+#define KALYNA_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /*!
  * Context to store Kalyna cipher parameters.
@@ -26,6 +45,8 @@ typedef struct {
     size_t nr;  /**< Number of enciphering rounds. */
     uint64_t* state;  /**< Current cipher state. */
     uint64_t** round_keys;  /**< Round key computed from enciphering key. */
+    uint64_t** round_keys_dec;  /**< Round keys with InvMixColumns applied,
+                                     used by table-driven deciphering. */
 } kalyna_t;
 
 
@@ -38,17 +59,19 @@ typedef struct {
  * block bit size.
  * @return Pointer to Kalyna context containing cipher instance
  * parameters and allocated memory for state and round keys. NULL in case of
- * error.
+ * error. The context lives in memory locked against swapping and excluded
+ * from core dumps where the system allows it.
  */
-kalyna_t* KalynaInit(size_t block_size, size_t key_size);
+KALYNA_API kalyna_t* KalynaInit(size_t block_size, size_t key_size);
 
 /*!
- * Delete Kalyna cipher context and free used memory.
+ * Delete Kalyna cipher context and free used memory. Round keys and state are
+ * overwritten with zeros first.
  *
  * @param ctx Kalyna cipher context.
  * @return Zero in case of success.
  */
-int KalynaDelete(kalyna_t* ctx);
+KALYNA_API int KalynaDelete(kalyna_t* ctx);
 
 /*!
  * Compute round keys given the enciphering key and store them in cipher
@@ -57,7 +80,7 @@ int KalynaDelete(kalyna_t* ctx);
  * @param key Kalyna enciphering key.
  * @param ctx Initialized cipher context.
  */
-void KalynaKeyExpand(uint64_t* key, kalyna_t* ctx);
+KALYNA_API void KalynaKeyExpand(uint64_t* key, kalyna_t* ctx);
 
 /*!
  * Encipher plaintext using Kalyna symmetric block cipher.
@@ -69,7 +92,7 @@ void KalynaKeyExpand(uint64_t* key, kalyna_t* ctx);
  * @param ctx Initialized cipher context with precomputed round keys.
  * @param ciphertext The result of enciphering.
  */
-void KalynaEncipher(uint64_t* plaintext, kalyna_t* ctx, uint64_t* ciphertext);
+KALYNA_API void KalynaEncipher(uint64_t* plaintext, kalyna_t* ctx, uint64_t* ciphertext);
 
 /*!
  * Decipher ciphertext using Kalyna symmetric block cipher.
@@ -81,7 +104,125 @@ void KalynaEncipher(uint64_t* plaintext, kalyna_t* ctx, uint64_t* ciphertext);
  * @param ctx Initialized cipher context with precomputed round keys.
  * @param plaintext The result of deciphering.
  */
-void KalynaDecipher(uint64_t* ciphertext, kalyna_t* ctx, uint64_t* plaintext);
+KALYNA_API void KalynaDecipher(uint64_t* ciphertext, kalyna_t* ctx, uint64_t* plaintext);
+
+/*!
+ * Encipher a sequence of blocks (ECB) using the fastest round engine available
+ * on the running CPU (see engine.h). Several blocks are processed together
+ * by the vectorized engines, so multi-block calls are much faster than
+ * repeated KalynaEncipher() calls.
+ *
+ * @param plaintext Plaintext of length `blocks` * Nb words.
+ * @param blocks Number of blocks.
+ * @param ctx Initialized cipher context with precomputed round keys.
+ * @param ciphertext The result of enciphering. May be the same array as
+ * `plaintext`.
+ */
+KALYNA_API void KalynaEncipherBlocks(const uint64_t* plaintext, size_t blocks, kalyna_t* ctx,
+    uint64_t* ciphertext);
+
+/*!
+ * Decipher a sequence of blocks (ECB) using the fastest round engine
+ * available on the running CPU.
+ *
+ * @param ciphertext Enciphered data of length `blocks` * Nb words.
+ * @param blocks Number of blocks.
+ * @param ctx Initialized cipher context with precomputed round keys.
+ * @param plaintext The result of deciphering. May be the same array as
+ * `ciphertext`.
+ */
+KALYNA_API void KalynaDecipherBlocks(const uint64_t* ciphertext, size_t blocks, kalyna_t* ctx,
+    uint64_t* plaintext);
+
+/*!
+ * Use the round engine `name` for multi-block calls instead of the fastest
+ * one. The table-driven engine comes with three table layouts trading speed
+ * for L1d footprint: "ttable" (16 KiB per direction), "ttable-rotate"
+ * (8 KiB) and "ttable-compact" (2 KiB for both directions). Call it at
+ * initialization, before other threads use the library.
+ *
+ * @return Zero in case of success, -1 if the engine is unknown or not
+ * supported by the running CPU.
+ */
+KALYNA_API int KalynaSelectEngine(const char* name);
+
+/*!
+ * Pick the fastest round engine for each block and key size by timing every
+ * engine supported by the running CPU, a few milliseconds each. The choice
+ * is used by all multi-block calls afterwards, so by every mode of contexts
+ * created with KalynaInit(). It is also made on the first multi-block call
+ * if the environment variable KALYNA_TUNE names a cache file, while
+ * KALYNA_ENGINE naming an engine overrides both, like KalynaSelectEngine(),
+ * which also drops the tuned choice. Call it at initialization, before
+ * other threads use the library.
+ *
+ * @param cache_path File keeping the choice between runs, may be NULL. It
+ * is read instead of timing if it was written on the same CPU model with
+ * the same engines, and rewritten otherwise.
+ * @return Zero in case of success, -1 in case of error. The new choice is
+ * used even if only writing the cache file failed.
+ */
+KALYNA_API int KalynaTune(const char* cache_path);
+
+/*!
+ * Encipher a byte buffer block by block (ECB) using Kalyna.
+ * Blocks are read and written as little endian words as specified by the
+ * standard, so the buffers may come straight from the network or a file and
+ * need not be aligned. On little endian hosts aligned buffers are processed
+ * in place without any conversion.
+ *
+ * @param plaintext Plaintext bytes, any alignment.
+ * @param length Byte length of the plaintext, multiple of the block size.
+ * @param ctx Initialized cipher context with precomputed round keys.
+ * @param ciphertext The result of enciphering, `length` bytes. May be the same
+ * buffer as `plaintext`.
+ * @return Zero in case of success, -1 if length is not a multiple of the
+ * block size.
+ */
+KALYNA_API int KalynaEncryptBytes(const uint8_t* plaintext, size_t length, kalyna_t* ctx,
+    uint8_t* ciphertext);
+
+/*!
+ * Decipher a byte buffer block by block (ECB) using Kalyna.
+ * See KalynaEncryptBytes() for the buffer conventions.
+ *
+ * @param ciphertext Ciphertext bytes, any alignment.
+ * @param length Byte length of the ciphertext, multiple of the block size.
+ * @param ctx Initialized cipher context with precomputed round keys.
+ * @param plaintext The result of deciphering, `length` bytes. May be the same
+ * buffer as `ciphertext`.
+ * @return Zero in case of success, -1 if length is not a multiple of the
+ * block size.
+ */
+KALYNA_API int KalynaDecryptBytes(const uint8_t* ciphertext, size_t length, kalyna_t* ctx,
+    uint8_t* plaintext);
+
+/*!
+ * Encrypt or decrypt bytes in counter mode (CTR) of DSTU 7624:2014. The
+ * initial counter is the enciphered IV, each gamma block enciphers the
+ * counter incremented as a little endian number. Encryption and decryption
+ * are the same operation.
+ *
+ * @param input Input bytes, any alignment.
+ * @param length Byte length of the input, any value.
+ * @param iv Initialization vector of the block size.
+ * @param ctx Initialized cipher context with precomputed round keys.
+ * @param output The result, `length` bytes. May be the same buffer as `input`.
+ * @return Zero.
+ */
+KALYNA_API int KalynaCtrBytes(const uint8_t* input, size_t length, const uint8_t* iv,
+    kalyna_t* ctx, uint8_t* output);
+
+/*!
+ * Get version of the library the program runs with.
+ *
+ * @return Version string "major.minor.patch".
+ */
+KALYNA_API const char* KalynaVersion(void);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif  /* KALYNA_H */
 
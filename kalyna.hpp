@@ -0,0 +1,352 @@
+/*
+
+C++ interface to the Kalyna block cipher (DSTU 7624:2014), header only
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef KALYNA_HPP
+#define KALYNA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <span>
+#include <utility>
+
+#include "kalyna.h"
+#include "kalyna_feedback.h"
+#include "kalyna_gcm.h"
+
+namespace kalyna {
+
+/*!
+ * Kalyna cipher instance owning its key schedule.
+ *
+ * The variant is fixed at compile time, so block and key lengths are
+ * constants and span extents are checked by the compiler. Instances are
+ * movable but not copyable; the round keys are overwritten with zeros before
+ * the memory is released. Operations allocate nothing and are thin inline
+ * calls to the C functions of kalyna.h, so they cost the same as the C API.
+ * A moved-from instance may only be assigned to or destroyed.
+ *
+ * @tparam BlockBits Block bit size: 128, 256 or 512.
+ * @tparam KeyBits Key bit size, equal to or double the block bit size.
+ */
+template <std::size_t BlockBits, std::size_t KeyBits>
+class Kalyna {
+    static_assert(BlockBits == 128 || BlockBits == 256 || BlockBits == 512,
+        "Kalyna block size must be 128, 256 or 512 bits");
+    static_assert(KeyBits == BlockBits || KeyBits == 2 * BlockBits,
+        "Kalyna key size must be equal to or double the block size");
+
+public:
+    static constexpr std::size_t block_bytes = BlockBits / 8;
+    static constexpr std::size_t key_bytes = KeyBits / 8;
+    static constexpr std::size_t block_words = BlockBits / 64;
+    static constexpr std::size_t key_words = KeyBits / 64;
+
+    using key_span = std::span<const std::byte, key_bytes>;
+    using block_span = std::span<const std::byte, block_bytes>;
+
+    /*!
+     * Create an instance and expand the key.
+     *
+     * @param key Key bytes in the order of the standard (little endian words).
+     * @throw std::bad_alloc if the context could not be allocated.
+     */
+    explicit Kalyna(key_span key) : ctx_(KalynaInit(BlockBits, KeyBits)) {
+        if (ctx_ == nullptr)
+            throw std::bad_alloc();
+        rekey(key);
+    }
+
+    Kalyna(const Kalyna&) = delete;
+    Kalyna& operator=(const Kalyna&) = delete;
+
+    Kalyna(Kalyna&& other) noexcept : ctx_(std::exchange(other.ctx_, nullptr)) {}
+
+    Kalyna& operator=(Kalyna&& other) noexcept {
+        if (this != &other) {
+            release();
+            ctx_ = std::exchange(other.ctx_, nullptr);
+        }
+        return *this;
+    }
+
+    ~Kalyna() { release(); }
+
+    /*! Replace the key schedule with the one of a new key. */
+    void rekey(key_span key) noexcept {
+        std::uint64_t words[key_words];
+        for (std::size_t i = 0; i < key_words; ++i)
+            words[i] = LoadWord(key.data() + i * sizeof(std::uint64_t));
+        KalynaKeyExpand(words, ctx_);
+        Zeroize(words, key_words);
+    }
+
+    /*!
+     * Encipher whole blocks (ECB). Buffers may have any alignment and may be
+     * the same.
+     *
+     * @return False if the lengths differ or are not a multiple of the block
+     * size; nothing is written then.
+     */
+    [[nodiscard]] bool encrypt(std::span<const std::byte> plaintext,
+            std::span<std::byte> ciphertext) noexcept {
+        if (plaintext.size() != ciphertext.size())
+            return false;
+        return KalynaEncryptBytes(Bytes(plaintext.data()), plaintext.size(), ctx_,
+            Bytes(ciphertext.data())) == 0;
+    }
+
+    /*! Decipher whole blocks (ECB), see encrypt(). */
+    [[nodiscard]] bool decrypt(std::span<const std::byte> ciphertext,
+            std::span<std::byte> plaintext) noexcept {
+        if (plaintext.size() != ciphertext.size())
+            return false;
+        return KalynaDecryptBytes(Bytes(ciphertext.data()), ciphertext.size(), ctx_,
+            Bytes(plaintext.data())) == 0;
+    }
+
+    /*!
+     * Encrypt or decrypt in counter mode (CTR). Any length is allowed.
+     *
+     * @return False if the lengths differ; nothing is written then.
+     */
+    [[nodiscard]] bool ctr(std::span<const std::byte, block_bytes> iv,
+            std::span<const std::byte> input, std::span<std::byte> output) noexcept {
+        if (input.size() != output.size())
+            return false;
+        return KalynaCtrBytes(Bytes(input.data()), input.size(), Bytes(iv.data()), ctx_,
+            Bytes(output.data())) == 0;
+    }
+
+    /*!
+     * Encrypt in cipher feedback mode (CFB), see KalynaCfbEncrypt(). Any
+     * length is allowed.
+     *
+     * @param segment_bits Feedback size, a multiple of 8 up to BlockBits.
+     * @return False if the lengths differ or the segment size is not
+     * allowed; nothing is written then.
+     */
+    [[nodiscard]] bool cfb_encrypt(block_span iv, std::span<const std::byte> plaintext,
+            std::span<std::byte> ciphertext, std::size_t segment_bits = BlockBits) noexcept {
+        if (plaintext.size() != ciphertext.size())
+            return false;
+        return KalynaCfbEncrypt(Bytes(plaintext.data()), plaintext.size(), Bytes(iv.data()),
+            segment_bits, ctx_, Bytes(ciphertext.data())) == 0;
+    }
+
+    /*! Decrypt in cipher feedback mode, see cfb_encrypt(). */
+    [[nodiscard]] bool cfb_decrypt(block_span iv, std::span<const std::byte> ciphertext,
+            std::span<std::byte> plaintext, std::size_t segment_bits = BlockBits) noexcept {
+        if (plaintext.size() != ciphertext.size())
+            return false;
+        return KalynaCfbDecrypt(Bytes(ciphertext.data()), ciphertext.size(), Bytes(iv.data()),
+            segment_bits, ctx_, Bytes(plaintext.data())) == 0;
+    }
+
+    /*!
+     * Encrypt or decrypt in output feedback mode (OFB). Any length is
+     * allowed; see OfbStream to generate the keystream ahead.
+     *
+     * @return False if the lengths differ; nothing is written then.
+     */
+    [[nodiscard]] bool ofb(block_span iv, std::span<const std::byte> input,
+            std::span<std::byte> output) noexcept {
+        if (input.size() != output.size())
+            return false;
+        return KalynaOfbBytes(Bytes(input.data()), input.size(), Bytes(iv.data()), ctx_,
+            Bytes(output.data())) == 0;
+    }
+
+    /*!
+     * Encrypt and authenticate (GCM), see kalyna_gcm.h.
+     *
+     * @param nonce Nonce, never repeated under one key.
+     * @return False if the lengths differ; nothing is written then.
+     */
+    [[nodiscard]] bool gcm_encrypt(block_span nonce, std::span<const std::byte> aad,
+            std::span<const std::byte> plaintext, std::span<std::byte> ciphertext,
+            std::span<std::byte, block_bytes> tag) noexcept {
+        if (plaintext.size() != ciphertext.size())
+            return false;
+        return KalynaGcmEncrypt(ctx_, Bytes(nonce.data()), Bytes(aad.data()), aad.size(),
+            Bytes(plaintext.data()), plaintext.size(), Bytes(ciphertext.data()),
+            Bytes(tag.data())) == 0;
+    }
+
+    /*!
+     * Verify and decrypt (GCM).
+     *
+     * @return False if the lengths differ or the tag does not match;
+     * nothing is written then.
+     */
+    [[nodiscard]] bool gcm_decrypt(block_span nonce, std::span<const std::byte> aad,
+            std::span<const std::byte> ciphertext, block_span tag,
+            std::span<std::byte> plaintext) noexcept {
+        if (plaintext.size() != ciphertext.size())
+            return false;
+        return KalynaGcmDecrypt(ctx_, Bytes(nonce.data()), Bytes(aad.data()), aad.size(),
+            Bytes(ciphertext.data()), ciphertext.size(), Bytes(tag.data()),
+            Bytes(plaintext.data())) == 0;
+    }
+
+    /*! Encipher a single block. */
+    void encrypt_block(std::span<const std::byte, block_bytes> plaintext,
+            std::span<std::byte, block_bytes> ciphertext) noexcept {
+        KalynaEncryptBytes(Bytes(plaintext.data()), block_bytes, ctx_,
+            Bytes(ciphertext.data()));
+    }
+
+    /*! Decipher a single block. */
+    void decrypt_block(std::span<const std::byte, block_bytes> ciphertext,
+            std::span<std::byte, block_bytes> plaintext) noexcept {
+        KalynaDecryptBytes(Bytes(ciphertext.data()), block_bytes, ctx_,
+            Bytes(plaintext.data()));
+    }
+
+    /*!
+     * Encipher blocks held as native 64-bit words, the fastest path with no
+     * byte order conversion. Sizes are in words and must be equal multiples
+     * of block_words.
+     */
+    void encrypt_blocks(std::span<const std::uint64_t> plaintext,
+            std::span<std::uint64_t> ciphertext) noexcept {
+        KalynaEncipherBlocks(plaintext.data(), Blocks(plaintext, ciphertext), ctx_,
+            ciphertext.data());
+    }
+
+    /*! Decipher blocks held as native 64-bit words, see encrypt_blocks(). */
+    void decrypt_blocks(std::span<const std::uint64_t> ciphertext,
+            std::span<std::uint64_t> plaintext) noexcept {
+        KalynaDecipherBlocks(ciphertext.data(), Blocks(ciphertext, plaintext), ctx_,
+            plaintext.data());
+    }
+
+    /*! Underlying C context, for functions without a C++ wrapper. */
+    kalyna_t* native_handle() noexcept { return ctx_; }
+
+private:
+    static const std::uint8_t* Bytes(const std::byte* p) noexcept {
+        return reinterpret_cast<const std::uint8_t*>(p);
+    }
+
+    static std::uint8_t* Bytes(std::byte* p) noexcept {
+        return reinterpret_cast<std::uint8_t*>(p);
+    }
+
+    static std::size_t Blocks(std::span<const std::uint64_t> in,
+            std::span<std::uint64_t> out) noexcept {
+        return (in.size() < out.size() ? in.size() : out.size()) / block_words;
+    }
+
+    /* Little endian load; compilers reduce it to a plain load on such hosts. */
+    static std::uint64_t LoadWord(const std::byte* p) noexcept {
+        std::uint64_t word = 0;
+        for (std::size_t i = 0; i < sizeof(word); ++i)
+            word |= static_cast<std::uint64_t>(p[i]) << (8 * i);
+        return word;
+    }
+
+    /* Volatile stores are not removed as dead by the optimizer. */
+    static void Zeroize(std::uint64_t* words, std::size_t count) noexcept {
+        volatile std::uint64_t* p = words;
+        for (std::size_t i = 0; i < count; ++i)
+            p[i] = 0;
+    }
+
+    /* KalynaDelete() wipes the round keys and state. */
+    void release() noexcept {
+        if (ctx_ == nullptr)
+            return;
+        KalynaDelete(ctx_);
+        ctx_ = nullptr;
+    }
+
+    kalyna_t* ctx_;
+};
+
+/*!
+ * OFB stream with a keystream buffer filled ahead of the data, see
+ * kalyna_ofb_t. The buffer is allocated once by the constructor; precompute()
+ * and crypt() allocate nothing. The cipher must outlive the stream and keep
+ * its key, and a stream is used by one thread at a time. Movable, not
+ * copyable; the keystream is wiped on destruction.
+ */
+template <std::size_t BlockBits, std::size_t KeyBits>
+class OfbStream {
+public:
+    /*!
+     * Start a stream at `iv`.
+     *
+     * @param capacity Byte size of the keystream buffer, rounded up to blocks.
+     * @throw std::bad_alloc if the stream could not be allocated.
+     */
+    OfbStream(Kalyna<BlockBits, KeyBits>& cipher,
+            typename Kalyna<BlockBits, KeyBits>::block_span iv, std::size_t capacity)
+            : ofb_(KalynaOfbInit(cipher.native_handle(),
+                reinterpret_cast<const std::uint8_t*>(iv.data()), capacity)) {
+        if (ofb_ == nullptr)
+            throw std::bad_alloc();
+    }
+
+    OfbStream(const OfbStream&) = delete;
+    OfbStream& operator=(const OfbStream&) = delete;
+
+    OfbStream(OfbStream&& other) noexcept : ofb_(std::exchange(other.ofb_, nullptr)) {}
+
+    OfbStream& operator=(OfbStream&& other) noexcept {
+        if (this != &other) {
+            release();
+            ofb_ = std::exchange(other.ofb_, nullptr);
+        }
+        return *this;
+    }
+
+    ~OfbStream() { release(); }
+
+    /*!
+     * Generate keystream ahead, see KalynaOfbPrecompute().
+     *
+     * @return Number of keystream bytes buffered.
+     */
+    std::size_t precompute(std::size_t length) noexcept {
+        return KalynaOfbPrecompute(ofb_, length);
+    }
+
+    /*!
+     * Encrypt or decrypt the next bytes of the stream.
+     *
+     * @return False if the lengths differ; nothing is written then.
+     */
+    [[nodiscard]] bool crypt(std::span<const std::byte> input,
+            std::span<std::byte> output) noexcept {
+        if (input.size() != output.size())
+            return false;
+        return KalynaOfbCrypt(ofb_, reinterpret_cast<const std::uint8_t*>(input.data()),
+            input.size(), reinterpret_cast<std::uint8_t*>(output.data())) == 0;
+    }
+
+private:
+    void release() noexcept {
+        if (ofb_ == nullptr)
+            return;
+        KalynaOfbDelete(ofb_);
+        ofb_ = nullptr;
+    }
+
+    kalyna_ofb_t* ofb_;
+};
+
+using Kalyna128_128 = Kalyna<128, 128>;
+using Kalyna128_256 = Kalyna<128, 256>;
+using Kalyna256_256 = Kalyna<256, 256>;
+using Kalyna256_512 = Kalyna<256, 512>;
+using Kalyna512_512 = Kalyna<512, 512>;
+
+}  // namespace kalyna
+
+#endif  /* KALYNA_HPP */
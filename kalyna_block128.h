@@ -0,0 +1,61 @@
+/*
+
+Header file for the low latency single block path of Kalyna-128 (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef KALYNA_BLOCK128_H
+#define KALYNA_BLOCK128_H
+
+#include "kalyna.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * Round keys of Kalyna-128/128 or Kalyna-128/256 stored inline, for
+ * enciphering one block at a time with the least latency: the rounds are
+ * fully unrolled for the round count, round keys are read straight from
+ * this structure and the state never leaves local variables. Nothing is
+ * allocated and the structure may be embedded in the caller's data.
+ */
+typedef struct {
+    size_t nr;  /**< Number of rounds, 10 or 14. */
+    uint64_t enc[15][2];  /**< Enciphering round keys. */
+    uint64_t dec[15][2];  /**< Deciphering round keys with InvMixColumns
+                               applied to the inner ones. */
+} kalyna_block128_t;
+
+/*!
+ * Copy the round keys of a Kalyna-128 context.
+ *
+ * @param key Destination, wiped by the caller when no longer needed.
+ * @param ctx Context with expanded key; may be deleted afterwards.
+ * @return Zero in case of success, -1 if the block size is not 128 bits.
+ */
+KALYNA_API int KalynaBlock128Load(kalyna_block128_t* key, const kalyna_t* ctx);
+
+/*!
+ * Encipher one 16-byte block, little endian words as KalynaEncryptBytes().
+ *
+ * @param output May be the same buffer as `input`.
+ */
+KALYNA_API void KalynaBlock128Encipher(const kalyna_block128_t* key, const uint8_t* input,
+    uint8_t* output);
+
+/*!
+ * Decipher one 16-byte block.
+ *
+ * @param output May be the same buffer as `input`.
+ */
+KALYNA_API void KalynaBlock128Decipher(const kalyna_block128_t* key, const uint8_t* input,
+    uint8_t* output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* KALYNA_BLOCK128_H */
@@ -0,0 +1,460 @@
+/*
+
+Seekable chunked authenticated encryption container of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "kalyna_container.h"
+#include "kalyna_gcm.h"
+#include "kalyna_drbg.h"
+#include "kalyna_numa.h"
+#include "transformations.h"
+
+#define kHEADER_BYTES 128
+#define kFOOTER_BYTES 32
+#define kNONCE_OFFSET 64
+
+/* Bytes of chunk additional data after the header: index and last flag. */
+#define kAAD_BYTES (kHEADER_BYTES + 16)
+
+/* Chunks sealed per batch and thread by the writer. */
+#define kWRITER_BATCH 4
+
+/* Maximum number of threads of a writer or reader. */
+#define kMAX_THREADS 64
+
+static const uint8_t kHeaderMagic[8] = {'K', 'A', 'L', 'Y', 'N', 'A', 'C', 'F'};
+static const uint8_t kFooterMagic[8] = {'K', 'A', 'L', 'Y', 'N', 'A', 'I', 'X'};
+
+struct kalyna_writer {
+    kalyna_t* ctx;
+    kalyna_replicas_t* replicas;  /* Key per NUMA node if there are several. */
+    int fd;
+    size_t chunk_bytes;
+    size_t threads;
+    uint8_t header[kHEADER_BYTES];
+    uint64_t chunks;  /* Chunks written so far. */
+    uint64_t length;  /* Plaintext bytes written so far. */
+    uint64_t last_chunk;  /* Index of the final chunk once known. */
+    uint8_t* batch;  /* Plaintext of chunks not sealed yet. */
+    size_t batch_bytes;  /* Capacity of `batch`. */
+    size_t filled;
+    uint8_t* tags;  /* Tags of all chunks. */
+    size_t tags_capacity;  /* In chunks. */
+};
+
+struct kalyna_reader {
+    kalyna_t* ctx;
+    kalyna_replicas_t* replicas;  /* Key per NUMA node if there are several. */
+    size_t threads;
+    const uint8_t* map;
+    size_t map_bytes;
+    size_t chunk_bytes;
+    uint64_t length;
+    uint64_t chunks;
+    const uint8_t* index;
+};
+
+/* Work on one chunk, from a batch of the writer or a read. */
+typedef int (*chunk_fn)(void* arg, uint64_t chunk);
+
+typedef struct {
+    chunk_fn fn;
+    void* arg;
+    uint64_t first;
+    uint64_t end;
+    size_t node;  /* NUMA node of the worker running the range. */
+    int bind;  /* Nonzero to pin the worker to `node`. */
+    int result;
+} chunk_range_t;
+
+/* Arguments of a read. */
+typedef struct {
+    kalyna_reader_t* reader;
+    uint64_t offset;
+    uint8_t* output;
+    size_t length;
+} read_job_t;
+
+
+static void Store64(uint64_t value, uint8_t* bytes) {
+    int i;
+    for (i = 0; i < 8; ++i)
+        bytes[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint64_t Load64(const uint8_t* bytes) {
+    int i;
+    uint64_t value = 0;
+    for (i = 0; i < 8; ++i)
+        value |= (uint64_t)bytes[i] << (8 * i);
+    return value;
+}
+
+/* Key for the NUMA node the calling thread runs on. */
+static kalyna_t* LocalKey(kalyna_t* ctx, kalyna_replicas_t* replicas) {
+    return replicas != NULL ? KalynaReplicasLocal(replicas) : ctx;
+}
+
+/*!
+ * Derive the nonce and additional data of a chunk.
+ */
+static void ChunkParameters(kalyna_t* ctx, const uint8_t* header, uint64_t chunk, int last,
+        uint8_t* nonce, uint8_t* aad) {
+    uint64_t words[kNB_512];
+
+    ReadWords(ctx->nb, header + kNONCE_OFFSET, words);
+    words[0] ^= chunk;
+    KalynaEncipherBlocks(words, 1, ctx, words);
+    WriteWords(ctx->nb, words, nonce);
+    memcpy(aad, header, kHEADER_BYTES);
+    Store64(chunk, aad + kHEADER_BYTES);
+    Store64(last ? 1 : 0, aad + kHEADER_BYTES + 8);
+}
+
+static void* RunRange(void* arg) {
+    chunk_range_t* range = (chunk_range_t*)arg;
+    uint64_t chunk;
+    if (range->bind)
+        KalynaNumaBind(range->node);
+    for (chunk = range->first; chunk < range->end; ++chunk) {
+        if (range->result == 0)
+            range->result = range->fn(range->arg, chunk);
+    }
+    return NULL;
+}
+
+/*!
+ * Run `fn` on chunks [first, end) split into contiguous ranges over threads.
+ * On NUMA hosts the workers are spread over the nodes, so that each node
+ * gets whole ranges of chunks to work on with its local tables and keys.
+ *
+ * @return Zero if every call succeeded, otherwise the error of a failed one.
+ */
+static int ForEachChunk(size_t threads, uint64_t first, uint64_t end, chunk_fn fn,
+        void* arg) {
+    size_t t, started = 0, nodes = KalynaNumaNodes();
+    int result = 0;
+    chunk_range_t ranges[kMAX_THREADS];
+    pthread_t workers[kMAX_THREADS];
+
+    if (threads < 1 || threads > end - first)
+        threads = end - first > 0 ? (size_t)(end - first) : 1;
+    for (t = 0; t < threads; ++t) {
+        ranges[t].fn = fn;
+        ranges[t].arg = arg;
+        ranges[t].first = first + (end - first) * t / threads;
+        ranges[t].end = first + (end - first) * (t + 1) / threads;
+        ranges[t].node = t % nodes;
+        ranges[t].bind = nodes > 1 && t > 0;
+        ranges[t].result = 0;
+    }
+    for (t = 1; t < threads; ++t) {
+        if (pthread_create(&workers[t], NULL, RunRange, &ranges[t]) != 0)
+            break;
+        ++started;
+    }
+    RunRange(&ranges[0]);
+    for (t = started + 1; t < threads; ++t)
+        RunRange(&ranges[t]);
+    for (t = 1; t <= started; ++t)
+        pthread_join(workers[t], NULL);
+    for (t = 0; t < threads && result == 0; ++t)
+        result = ranges[t].result;
+    return result;
+}
+
+/* Write all bytes, retrying short writes. */
+static int WriteAll(int fd, const uint8_t* data, size_t length) {
+    ssize_t result;
+    while (length > 0) {
+        result = write(fd, data, length);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0) {
+            perror("Could not write container");
+            return -1;
+        }
+        data += result;
+        length -= result;
+    }
+    return 0;
+}
+
+
+kalyna_writer_t* KalynaWriterOpen(kalyna_t* ctx, int fd, size_t chunk_bytes,
+        size_t threads) {
+    kalyna_writer_t* writer;
+
+    if (chunk_bytes == 0 || chunk_bytes > SIZE_MAX / kWRITER_BATCH / kMAX_THREADS)
+        return NULL;
+    writer = (kalyna_writer_t*)calloc(1, sizeof(kalyna_writer_t));
+    if (writer == NULL) {
+        perror("Could not allocate memory for container writer");
+        return NULL;
+    }
+    writer->ctx = ctx;
+    writer->fd = fd;
+    writer->chunk_bytes = chunk_bytes;
+    writer->last_chunk = UINT64_MAX;
+    writer->threads = threads < 1 ? 1 : threads > kMAX_THREADS ? kMAX_THREADS : threads;
+    writer->batch_bytes = chunk_bytes * kWRITER_BATCH * writer->threads;
+    writer->batch = (uint8_t*)malloc(writer->batch_bytes);
+    if (writer->batch == NULL) {
+        perror("Could not allocate memory for container writer");
+        free(writer);
+        return NULL;
+    }
+
+    memcpy(writer->header, kHeaderMagic, sizeof(kHeaderMagic));
+    Store64(KALYNA_CONTAINER_VERSION, writer->header + 8);
+    Store64(ctx->nb * kBITS_IN_WORD, writer->header + 16);
+    Store64(ctx->nk * kBITS_IN_WORD, writer->header + 24);
+    Store64(chunk_bytes, writer->header + 32);
+    if (KalynaRandomBytes(writer->header + kNONCE_OFFSET, ctx->nb * sizeof(uint64_t)) != 0 ||
+            WriteAll(fd, writer->header, kHEADER_BYTES) != 0) {
+        free(writer->batch);
+        free(writer);
+        return NULL;
+    }
+    if (KalynaNumaNodes() > 1 && writer->threads > 1)
+        writer->replicas = KalynaReplicasInit(ctx);
+    return writer;
+}
+
+/* Seal one chunk of the batch in place; the last chunk of the batch may be short. */
+static int SealChunk(void* arg, uint64_t chunk) {
+    kalyna_writer_t* writer = (kalyna_writer_t*)arg;
+    size_t tag_len = writer->ctx->nb * sizeof(uint64_t);
+    size_t offset = (size_t)(chunk - writer->chunks) * writer->chunk_bytes;
+    size_t length = writer->filled - offset < writer->chunk_bytes ?
+        writer->filled - offset : writer->chunk_bytes;
+    uint8_t nonce[kNB_512 * sizeof(uint64_t)], aad[kAAD_BYTES];
+    kalyna_t* ctx = LocalKey(writer->ctx, writer->replicas);
+
+    ChunkParameters(ctx, writer->header, chunk, chunk == writer->last_chunk, nonce, aad);
+    return KalynaGcmEncrypt(ctx, nonce, aad, sizeof(aad), writer->batch + offset,
+        length, writer->batch + offset, writer->tags + chunk * tag_len);
+}
+
+/*!
+ * Seal the chunks of the batch and write them out.
+ *
+ * @param last Nonzero if the batch ends the file.
+ */
+static int FlushBatch(kalyna_writer_t* writer, int last) {
+    size_t tag_len = writer->ctx->nb * sizeof(uint64_t);
+    uint64_t count = writer->filled == 0 ? 1 :
+        (writer->filled + writer->chunk_bytes - 1) / writer->chunk_bytes;
+    size_t capacity;
+    uint8_t* tags;
+
+    if (writer->chunks + count > writer->tags_capacity) {
+        capacity = writer->tags_capacity * 2 + count + 64;
+        tags = (uint8_t*)realloc(writer->tags, capacity * tag_len);
+        if (tags == NULL) {
+            perror("Could not allocate memory for container index");
+            return -1;
+        }
+        writer->tags = tags;
+        writer->tags_capacity = capacity;
+    }
+    if (last)
+        writer->last_chunk = writer->chunks + count - 1;
+    if (ForEachChunk(writer->threads, writer->chunks, writer->chunks + count, SealChunk,
+            writer) != 0)
+        return -1;
+    if (WriteAll(writer->fd, writer->batch, writer->filled) != 0)
+        return -1;
+    writer->chunks += count;
+    writer->length += writer->filled;
+    writer->filled = 0;
+    return 0;
+}
+
+int KalynaWriterWrite(kalyna_writer_t* writer, const uint8_t* data, size_t length) {
+    size_t chunk;
+    while (length > 0) {
+        /* A full batch is sealed only once more data shows it is not the last. */
+        if (writer->filled == writer->batch_bytes && FlushBatch(writer, FALSE) != 0)
+            return -1;
+        chunk = writer->batch_bytes - writer->filled;
+        chunk = length < chunk ? length : chunk;
+        memcpy(writer->batch + writer->filled, data, chunk);
+        writer->filled += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+    return 0;
+}
+
+int KalynaWriterClose(kalyna_writer_t* writer) {
+    size_t tag_len = writer->ctx->nb * sizeof(uint64_t);
+    uint8_t footer[kFOOTER_BYTES];
+    int result = -1;
+
+    if (FlushBatch(writer, TRUE) == 0 &&
+            WriteAll(writer->fd, writer->tags, writer->chunks * tag_len) == 0) {
+        memset(footer, 0, sizeof(footer));
+        memcpy(footer, kFooterMagic, sizeof(kFooterMagic));
+        Store64(writer->length, footer + 8);
+        Store64(writer->chunks, footer + 16);
+        result = WriteAll(writer->fd, footer, sizeof(footer));
+    }
+    if (writer->replicas != NULL)
+        KalynaReplicasDelete(writer->replicas);
+    free(writer->batch);
+    free(writer->tags);
+    free(writer);
+    return result;
+}
+
+
+/* Open one chunk and copy the part inside the read range. */
+static int OpenChunk(void* arg, uint64_t chunk) {
+    read_job_t* job = (read_job_t*)arg;
+    kalyna_reader_t* reader = job->reader;
+    size_t tag_len = reader->ctx->nb * sizeof(uint64_t);
+    uint64_t begin = chunk * reader->chunk_bytes;
+    size_t length = reader->length - begin < reader->chunk_bytes ?
+        (size_t)(reader->length - begin) : reader->chunk_bytes;
+    uint64_t from = job->offset > begin ? job->offset : begin;
+    uint64_t to = job->offset + job->length < begin + length ?
+        job->offset + job->length : begin + length;
+    uint8_t nonce[kNB_512 * sizeof(uint64_t)], aad[kAAD_BYTES];
+    uint8_t* plain;
+    int result;
+    kalyna_t* ctx = LocalKey(reader->ctx, reader->replicas);
+
+    ChunkParameters(ctx, reader->map, chunk, chunk + 1 == reader->chunks, nonce, aad);
+    if (from == begin && to == begin + length) {
+        /* The whole chunk is wanted: decrypt straight into the output. */
+        result = KalynaGcmDecrypt(ctx, nonce, aad, sizeof(aad),
+            reader->map + kHEADER_BYTES + begin, length, reader->index + chunk * tag_len,
+            job->output + (begin - job->offset));
+        return result == 0 ? 0 : KALYNA_CONTAINER_CORRUPT;
+    }
+    plain = (uint8_t*)malloc(length);
+    if (plain == NULL)
+        return KALYNA_CONTAINER_ERROR;
+    result = KalynaGcmDecrypt(ctx, nonce, aad, sizeof(aad),
+        reader->map + kHEADER_BYTES + begin, length, reader->index + chunk * tag_len, plain);
+    if (result == 0)
+        memcpy(job->output + (from - job->offset), plain + (from - begin), (size_t)(to - from));
+    free(plain);
+    return result == 0 ? 0 : KALYNA_CONTAINER_CORRUPT;
+}
+
+int KalynaReaderOpen(kalyna_t* ctx, const char* path, size_t threads,
+        kalyna_reader_t** opened) {
+    int fd, result;
+    struct stat st;
+    size_t tag_len = ctx->nb * sizeof(uint64_t);
+    uint64_t chunks;
+    const uint8_t* footer;
+    uint8_t unused;
+    read_job_t job;
+    kalyna_reader_t* reader;
+
+    *opened = NULL;
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0)
+            close(fd);
+        return KALYNA_CONTAINER_IO;
+    }
+    if (st.st_size < kHEADER_BYTES + kFOOTER_BYTES) {
+        close(fd);
+        return KALYNA_CONTAINER_MALFORMED;
+    }
+    reader = (kalyna_reader_t*)calloc(1, sizeof(kalyna_reader_t));
+    if (reader == NULL) {
+        perror("Could not allocate memory for container reader");
+        close(fd);
+        return KALYNA_CONTAINER_ERROR;
+    }
+    reader->map_bytes = (size_t)st.st_size;
+    reader->map = (const uint8_t*)mmap(NULL, reader->map_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (reader->map == MAP_FAILED) {
+        free(reader);
+        return KALYNA_CONTAINER_IO;
+    }
+    reader->ctx = ctx;
+    reader->threads = threads < 1 ? 1 : threads > kMAX_THREADS ? kMAX_THREADS : threads;
+
+    /* The footer and header must agree with the file size and the key. */
+    footer = reader->map + reader->map_bytes - kFOOTER_BYTES;
+    reader->chunk_bytes = (size_t)Load64(reader->map + 32);
+    reader->length = Load64(footer + 8);
+    reader->chunks = Load64(footer + 16);
+    chunks = reader->chunk_bytes == 0 ? 0 : reader->length == 0 ? 1 :
+        (reader->length - 1) / reader->chunk_bytes + 1;
+    if (memcmp(reader->map, kHeaderMagic, sizeof(kHeaderMagic)) != 0 ||
+            memcmp(footer, kFooterMagic, sizeof(kFooterMagic)) != 0 ||
+            Load64(footer + 24) != 0 ||
+            Load64(reader->map + 8) != KALYNA_CONTAINER_VERSION ||
+            Load64(reader->map + 16) != ctx->nb * kBITS_IN_WORD ||
+            Load64(reader->map + 24) != ctx->nk * kBITS_IN_WORD ||
+            chunks == 0 || reader->chunks != chunks ||
+            reader->length > reader->map_bytes ||
+            chunks > reader->map_bytes / tag_len ||
+            kHEADER_BYTES + reader->length + chunks * tag_len + kFOOTER_BYTES !=
+                reader->map_bytes) {
+        KalynaReaderClose(reader);
+        return KALYNA_CONTAINER_MALFORMED;
+    }
+    reader->index = reader->map + kHEADER_BYTES + reader->length;
+    if (KalynaNumaNodes() > 1 && reader->threads > 1)
+        reader->replicas = KalynaReplicasInit(ctx);
+
+    /* Opening the last chunk authenticates the header and the length. */
+    job.reader = reader;
+    job.offset = (chunks - 1) * reader->chunk_bytes;
+    job.output = &unused;
+    job.length = 0;
+    result = OpenChunk(&job, chunks - 1);
+    if (result != 0) {
+        KalynaReaderClose(reader);
+        return result;
+    }
+    *opened = reader;
+    return 0;
+}
+
+uint64_t KalynaReaderLength(const kalyna_reader_t* reader) {
+    return reader->length;
+}
+
+int KalynaReaderRead(kalyna_reader_t* reader, uint64_t offset, uint8_t* output,
+        size_t length) {
+    read_job_t job;
+
+    if (offset > reader->length || length > reader->length - offset)
+        return KALYNA_CONTAINER_ERROR;
+    if (length == 0)
+        return 0;
+    job.reader = reader;
+    job.offset = offset;
+    job.output = output;
+    job.length = length;
+    return ForEachChunk(reader->threads, offset / reader->chunk_bytes,
+        (offset + length - 1) / reader->chunk_bytes + 1, OpenChunk, &job);
+}
+
+int KalynaReaderClose(kalyna_reader_t* reader) {
+    if (reader->replicas != NULL)
+        KalynaReplicasDelete(reader->replicas);
+    munmap((void*)reader->map, reader->map_bytes);
+    free(reader);
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+
+Header file for the seekable chunked authenticated encryption container of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef KALYNA_CONTAINER_H
+#define KALYNA_CONTAINER_H
+
+#include "kalyna.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Version of the container format. */
+#define KALYNA_CONTAINER_VERSION 2
+
+/* Default chunk size of the container, bytes. */
+#define KALYNA_CONTAINER_CHUNK (64 * 1024)
+
+/*!
+ * Container of a file encrypted with KalynaGcmEncrypt() in fixed size
+ * chunks, so that any byte range can be read by decrypting only the chunks
+ * it touches. Integers are stored as 64-bit little endian numbers.
+ *
+ *   header   128 bytes: "KALYNACF", version, block bits, key bits, chunk
+ *            size, 24 reserved bytes, random file nonce of the block size
+ *            zero padded to 64 bytes.
+ *   chunks   Ciphertext of every chunk, at header + index * chunk size; the
+ *            last chunk may be shorter, an empty file has one empty chunk.
+ *   index    Tag of every chunk, block size each.
+ *   footer   32 bytes: "KALYNAIX", plaintext length, number of chunks, 8
+ *            reserved bytes.
+ *
+ * The nonce of chunk i is the encipherment of the file nonce with i added
+ * to its first word by XOR. The additional data of a chunk is the header,
+ * the chunk index and a flag set for the last chunk only, so chunks cannot
+ * be moved, dropped or appended and the header cannot be altered.
+ */
+typedef struct kalyna_writer kalyna_writer_t;
+typedef struct kalyna_reader kalyna_reader_t;
+
+/*!
+ * Start writing a container to a file descriptor; output is sequential, so
+ * pipes are supported.
+ *
+ * @param ctx Cipher context with the key; must stay valid until the
+ * container is closed.
+ * @param fd Output file descriptor, not closed by the writer.
+ * @param chunk_bytes Chunk size, e.g. KALYNA_CONTAINER_CHUNK.
+ * @param threads Number of threads sealing chunks, including the calling
+ * one.
+ * @return Writer or NULL in case of error.
+ */
+KALYNA_API kalyna_writer_t* KalynaWriterOpen(kalyna_t* ctx, int fd, size_t chunk_bytes,
+    size_t threads);
+
+/*!
+ * Append plaintext. Full chunks are sealed and written in batches.
+ *
+ * @return Zero in case of success, -1 if writing failed.
+ */
+KALYNA_API int KalynaWriterWrite(kalyna_writer_t* writer, const uint8_t* data, size_t length);
+
+/*!
+ * Seal the last chunk, write the index and footer and release the writer.
+ *
+ * @return Zero in case of success, -1 if writing failed.
+ */
+KALYNA_API int KalynaWriterClose(kalyna_writer_t* writer);
+
+/*!
+ * Errors of the container reader. The library prints none of them, so that
+ * callers can report them their own way.
+ */
+typedef enum {
+    KALYNA_CONTAINER_ERROR = -1,  /**< Out of memory or range out of bounds. */
+    KALYNA_CONTAINER_IO = -2,  /**< File cannot be opened or mapped, see errno. */
+    KALYNA_CONTAINER_MALFORMED = -3,  /**< Not a container of this version and variant. */
+    KALYNA_CONTAINER_CORRUPT = -4  /**< A chunk fails verification: altered or another key. */
+} kalyna_container_error_t;
+
+/*!
+ * Map a container file for reading and check its header and footer.
+ *
+ * @param ctx Cipher context with the key of the variant in the header.
+ * @param path Container file.
+ * @param threads Number of threads opening chunks, including the calling
+ * one.
+ * @param reader Output of the reader, NULL in case of error.
+ * @return Zero in case of success or a kalyna_container_error_t.
+ */
+KALYNA_API int KalynaReaderOpen(kalyna_t* ctx, const char* path, size_t threads,
+    kalyna_reader_t** reader);
+
+/*!
+ * Plaintext byte length of a container.
+ */
+KALYNA_API uint64_t KalynaReaderLength(const kalyna_reader_t* reader);
+
+/*!
+ * Read a byte range, decrypting and verifying only the chunks it touches.
+ *
+ * @return Zero in case of success, KALYNA_CONTAINER_ERROR if the range is
+ * out of bounds or KALYNA_CONTAINER_CORRUPT if a chunk fails verification;
+ * `output` is unspecified then.
+ */
+KALYNA_API int KalynaReaderRead(kalyna_reader_t* reader, uint64_t offset,
+    uint8_t* output, size_t length);
+
+/*!
+ * Unmap the file and release the reader.
+ *
+ * @return Zero in case of success.
+ */
+KALYNA_API int KalynaReaderClose(kalyna_reader_t* reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* KALYNA_CONTAINER_H */
@@ -0,0 +1,300 @@
+/*
+
+Counter mode deterministic random bit generator based on the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/random.h>
+#endif
+
+#include "kalyna_drbg.h"
+#include "transformations.h"
+#include "arena.h"
+
+/* Pregenerated output per refill; refills are the generate requests. */
+#define kDRBG_BUFFER_BYTES (16 * 1024)
+
+/* Refills allowed between reseeds. */
+#define kDRBG_RESEED_INTERVAL (1ULL << 32)
+
+/* Refills between reseeds from the operating system by KalynaRandomBytes(). */
+#define kRANDOM_RESEED_INTERVAL 1024
+
+#define kDRBG_BLOCK_BYTES (kNB_256 * sizeof(uint64_t))
+#define kDRBG_KEY_BYTES (kNK_512 * sizeof(uint64_t))
+
+struct kalyna_drbg {
+    kalyna_t* ctx;  /* Kalyna-256/512 with the current key. */
+    uint64_t v[kNB_256];  /* Counter block. */
+    uint64_t reseed_counter;
+    size_t available;  /* Unread bytes at the end of the buffer. */
+    uint64_t buffer[kDRBG_BUFFER_BYTES / sizeof(uint64_t)];  /* Output bytes. */
+};
+
+/* Next unread output byte of a generator. */
+#define UNREAD(drbg) ((uint8_t*)(drbg)->buffer + kDRBG_BUFFER_BYTES - (drbg)->available)
+
+
+/*!
+ * CTR_DRBG_Update: encipher the next counter blocks, XOR the provided data
+ * into them and take the result as new key and counter.
+ *
+ * @param provided KALYNA_DRBG_SEED_BYTES bytes.
+ */
+static void Update(kalyna_drbg_t* drbg, const uint8_t* provided) {
+    size_t i;
+    uint64_t temp[KALYNA_DRBG_SEED_BYTES / sizeof(uint64_t)];
+    uint8_t bytes[KALYNA_DRBG_SEED_BYTES];
+
+    CtrCounters(drbg->v, KALYNA_DRBG_SEED_BYTES / kDRBG_BLOCK_BYTES, kNB_256, temp);
+    KalynaEncipherBlocks(temp, KALYNA_DRBG_SEED_BYTES / kDRBG_BLOCK_BYTES, drbg->ctx, temp);
+    WriteWords(KALYNA_DRBG_SEED_BYTES / sizeof(uint64_t), temp, bytes);
+    for (i = 0; i < KALYNA_DRBG_SEED_BYTES; ++i)
+        bytes[i] ^= provided[i];
+
+    ReadWords(kNK_512, bytes, temp);
+    KalynaKeyExpand(temp, drbg->ctx);
+    ReadWords(kNB_256, bytes + kDRBG_KEY_BYTES, drbg->v);
+    SecureWipe(temp, sizeof(temp));
+    SecureWipe(bytes, sizeof(bytes));
+}
+
+/*!
+ * Combine two inputs of up to KALYNA_DRBG_SEED_BYTES into seed material.
+ *
+ * @return Zero in case of success, -1 if an input is too long.
+ */
+static int SeedMaterial(const uint8_t* a, size_t a_len, const uint8_t* b, size_t b_len,
+        uint8_t* material) {
+    size_t i;
+    if (a_len > KALYNA_DRBG_SEED_BYTES || b_len > KALYNA_DRBG_SEED_BYTES ||
+            (a == NULL && a_len > 0) || (b == NULL && b_len > 0))
+        return -1;
+    memset(material, 0, KALYNA_DRBG_SEED_BYTES);
+    for (i = 0; i < a_len; ++i)
+        material[i] = a[i];
+    for (i = 0; i < b_len; ++i)
+        material[i] ^= b[i];
+    return 0;
+}
+
+
+kalyna_drbg_t* KalynaDrbgInit(const uint8_t* seed, size_t seed_len,
+        const uint8_t* personalization, size_t personalization_len) {
+    uint64_t zero_key[kNK_512];
+    uint8_t material[KALYNA_DRBG_SEED_BYTES];
+    kalyna_drbg_t* drbg;
+
+    if (seed_len == 0 || SeedMaterial(seed, seed_len, personalization,
+            personalization_len, material) != 0) {
+        fprintf(stderr, "Malformed DRBG seed or personalization string\n");
+        return NULL;
+    }
+    drbg = (kalyna_drbg_t*)calloc(1, sizeof(kalyna_drbg_t));
+    if (drbg == NULL) {
+        perror("Could not allocate memory for DRBG");
+        return NULL;
+    }
+    drbg->ctx = KalynaInit(kBLOCK_256, kKEY_512);
+    if (drbg->ctx == NULL) {
+        free(drbg);
+        return NULL;
+    }
+    memset(zero_key, 0, sizeof(zero_key));
+    KalynaKeyExpand(zero_key, drbg->ctx);
+    Update(drbg, material);
+    SecureWipe(material, sizeof(material));
+    drbg->reseed_counter = 1;
+    return drbg;
+}
+
+int KalynaDrbgDelete(kalyna_drbg_t* drbg) {
+    KalynaDelete(drbg->ctx);
+    SecureWipe(drbg, sizeof(kalyna_drbg_t));
+    free(drbg);
+    return 0;
+}
+
+int KalynaDrbgReseed(kalyna_drbg_t* drbg, const uint8_t* entropy, size_t entropy_len,
+        const uint8_t* additional, size_t additional_len) {
+    uint8_t material[KALYNA_DRBG_SEED_BYTES];
+    if (entropy_len == 0 || SeedMaterial(entropy, entropy_len, additional,
+            additional_len, material) != 0)
+        return -1;
+    Update(drbg, material);
+    SecureWipe(material, sizeof(material));
+    SecureWipe(drbg->buffer, sizeof(drbg->buffer));
+    drbg->available = 0;
+    drbg->reseed_counter = 1;
+    return 0;
+}
+
+/*!
+ * Generate a buffer of output with the multi-block path and update the key
+ * for backtracking resistance.
+ *
+ * @return Zero in case of success, -1 if reseed is required.
+ */
+static int Refill(kalyna_drbg_t* drbg) {
+    static const uint8_t zeros[KALYNA_DRBG_SEED_BYTES];
+    size_t i;
+
+    if (drbg->reseed_counter > kDRBG_RESEED_INTERVAL)
+        return -1;
+    CtrCounters(drbg->v, kDRBG_BUFFER_BYTES / kDRBG_BLOCK_BYTES, kNB_256, drbg->buffer);
+    KalynaEncipherBlocks(drbg->buffer, kDRBG_BUFFER_BYTES / kDRBG_BLOCK_BYTES, drbg->ctx,
+        drbg->buffer);
+    if (kBIG_ENDIAN) {
+        for (i = 0; i < kDRBG_BUFFER_BYTES / sizeof(uint64_t); ++i)
+            drbg->buffer[i] = ReverseWord(drbg->buffer[i]);
+    }
+    Update(drbg, zeros);
+    ++drbg->reseed_counter;
+    drbg->available = kDRBG_BUFFER_BYTES;
+    return 0;
+}
+
+int KalynaDrbgGenerate(kalyna_drbg_t* drbg, uint8_t* output, size_t length) {
+    size_t chunk;
+    uint8_t* start;
+
+    while (length > 0) {
+        if (drbg->available == 0 && Refill(drbg) != 0)
+            return -1;
+        chunk = length < drbg->available ? length : drbg->available;
+        start = UNREAD(drbg);
+        memcpy(output, start, chunk);
+        SecureWipe(start, chunk);  /* Handed out bytes are not kept. */
+        drbg->available -= chunk;
+        output += chunk;
+        length -= chunk;
+    }
+    return 0;
+}
+
+
+/*!
+ * Read entropy from the operating system.
+ *
+ * @return Zero in case of success.
+ */
+static int SystemEntropy(uint8_t* output, size_t length) {
+    ssize_t result;
+    int fd;
+#if defined(__linux__)
+    while (length > 0) {
+        result = getrandom(output, length, 0);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result < 0)
+            break;
+        output += result;
+        length -= result;
+    }
+    if (length == 0)
+        return 0;
+#endif
+    fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0) {
+        perror("Could not open /dev/urandom");
+        return -1;
+    }
+    while (length > 0) {
+        result = read(fd, output, length);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            break;
+        output += result;
+        length -= result;
+    }
+    close(fd);
+    return length == 0 ? 0 : -1;
+}
+
+/*
+ * Each thread owns a generator. The pointer is kept in a thread local
+ * variable for the lock-free fast path and in a pthread key whose destructor
+ * releases the generator when the thread exits.
+ */
+static __thread kalyna_drbg_t* thread_drbg = NULL;
+static __thread uint64_t thread_refills = 0;
+static pthread_key_t thread_drbg_key;
+static pthread_once_t thread_drbg_once = PTHREAD_ONCE_INIT;
+
+static void ReleaseThreadDrbg(void* drbg) {
+    KalynaDrbgDelete((kalyna_drbg_t*)drbg);
+}
+
+/* A forked child must not repeat the output buffered by its parent. */
+static void ForgetAfterFork(void) {
+    if (thread_drbg != NULL) {
+        SecureWipe(thread_drbg->buffer, sizeof(thread_drbg->buffer));
+        thread_drbg->available = 0;
+        thread_refills = kRANDOM_RESEED_INTERVAL;
+    }
+}
+
+static void CreateThreadDrbgKey(void) {
+    pthread_key_create(&thread_drbg_key, ReleaseThreadDrbg);
+    pthread_atfork(NULL, NULL, ForgetAfterFork);
+}
+
+/*!
+ * Serve a request the thread's buffer cannot: create or reseed the
+ * generator as needed and refill.
+ */
+static int RandomBytesSlow(uint8_t* output, size_t length) {
+    uint8_t entropy[KALYNA_DRBG_SEED_BYTES];
+    size_t chunk;
+    kalyna_drbg_t* drbg = thread_drbg;
+
+    pthread_once(&thread_drbg_once, CreateThreadDrbgKey);
+    while (length > 0) {
+        if (drbg == NULL || (drbg->available == 0 &&
+                thread_refills >= kRANDOM_RESEED_INTERVAL)) {
+            if (SystemEntropy(entropy, sizeof(entropy)) != 0)
+                return -1;
+            if (drbg == NULL) {
+                drbg = KalynaDrbgInit(entropy, sizeof(entropy), NULL, 0);
+                if (drbg == NULL)
+                    return -1;
+                thread_drbg = drbg;
+                pthread_setspecific(thread_drbg_key, drbg);
+            } else {
+                KalynaDrbgReseed(drbg, entropy, sizeof(entropy), NULL, 0);
+            }
+            SecureWipe(entropy, sizeof(entropy));
+            thread_refills = 0;
+        }
+        chunk = length < kDRBG_BUFFER_BYTES ? length : kDRBG_BUFFER_BYTES;
+        if (drbg->available < chunk)
+            ++thread_refills;
+        if (KalynaDrbgGenerate(drbg, output, chunk) != 0)
+            return -1;
+        output += chunk;
+        length -= chunk;
+    }
+    return 0;
+}
+
+int KalynaRandomBytes(uint8_t* output, size_t length) {
+    kalyna_drbg_t* drbg = thread_drbg;
+    uint8_t* start;
+
+    if (drbg != NULL && length <= drbg->available) {
+        start = UNREAD(drbg);
+        memcpy(output, start, length);
+        SecureWipe(start, length);
+        drbg->available -= length;
+        return 0;
+    }
+    return RandomBytesSlow(output, length);
+}
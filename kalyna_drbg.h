@@ -0,0 +1,84 @@
+/*
+
+Header file for the counter mode deterministic random bit generator based on the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef KALYNA_DRBG_H
+#define KALYNA_DRBG_H
+
+#include "kalyna.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Seed length of the generator: Kalyna-256/512 key and block, bytes. */
+#define KALYNA_DRBG_SEED_BYTES 96
+
+/*!
+ * CTR_DRBG of NIST SP 800-90A without derivation function, instantiated
+ * with Kalyna-256/512. Output is produced by the multi-block path into an
+ * internal buffer; each buffer refill counts as one generate request, after
+ * which the key and counter are updated.
+ */
+typedef struct kalyna_drbg kalyna_drbg_t;
+
+/*!
+ * Instantiate a generator. The same seed and personalization always give
+ * the same output.
+ *
+ * @param seed Seed material, 1 to KALYNA_DRBG_SEED_BYTES bytes, zero padded.
+ * Shorter seeds give proportionally less security.
+ * @param seed_len Byte length of the seed.
+ * @param personalization Optional personalization string or NULL.
+ * @param personalization_len Byte length, up to KALYNA_DRBG_SEED_BYTES.
+ * @return Generator or NULL in case of error.
+ */
+KALYNA_API kalyna_drbg_t* KalynaDrbgInit(const uint8_t* seed, size_t seed_len,
+    const uint8_t* personalization, size_t personalization_len);
+
+/*!
+ * Wipe and release a generator.
+ *
+ * @return Zero in case of success.
+ */
+KALYNA_API int KalynaDrbgDelete(kalyna_drbg_t* drbg);
+
+/*!
+ * Mix fresh entropy into the generator state, discard buffered output and
+ * reset the reseed counter.
+ *
+ * @param entropy Entropy input, 1 to KALYNA_DRBG_SEED_BYTES bytes.
+ * @param additional Optional additional input or NULL.
+ * @return Zero in case of success, -1 for malformed input.
+ */
+KALYNA_API int KalynaDrbgReseed(kalyna_drbg_t* drbg, const uint8_t* entropy,
+    size_t entropy_len, const uint8_t* additional, size_t additional_len);
+
+/*!
+ * Produce pseudorandom bytes. Not thread safe: use one generator per thread
+ * or KalynaRandomBytes().
+ *
+ * @return Zero in case of success, -1 if the generator must be reseeded
+ * first; no output is produced then.
+ */
+KALYNA_API int KalynaDrbgGenerate(kalyna_drbg_t* drbg, uint8_t* output, size_t length);
+
+/*!
+ * Fill a buffer with random bytes from a generator owned by the calling
+ * thread, seeded and periodically reseeded from the operating system. Small
+ * requests are served from the thread's buffer without locks or system
+ * calls. The generator is released when the thread exits.
+ *
+ * @return Zero in case of success, -1 if no entropy could be obtained.
+ */
+KALYNA_API int KalynaRandomBytes(uint8_t* output, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* KALYNA_DRBG_H */
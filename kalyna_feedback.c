@@ -0,0 +1,187 @@
+/*
+
+Cipher and output feedback modes of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <stdio.h>
+
+#include "kalyna_feedback.h"
+#include "transformations.h"
+#include "arena.h"
+
+/* Bytes of shift registers or gamma enciphered by one engine call. */
+#define kFEEDBACK_CHUNK 1024
+
+struct kalyna_ofb {
+    kalyna_t* ctx;
+    uint64_t block[kNB_512];  /* Last gamma block. */
+    uint8_t* keystream;  /* Ring of precomputed gamma bytes. */
+    size_t capacity;  /* Byte size of `keystream`, whole blocks. */
+    size_t head;  /* Position of the next unused gamma byte. */
+    size_t filled;  /* Unused gamma bytes from `head` on. */
+};
+
+
+/* Segment byte length for a feedback size, 0 if not allowed. */
+static size_t SegmentBytes(kalyna_t* ctx, size_t segment_bits) {
+    if (segment_bits == 0 || segment_bits % kBITS_IN_BYTE != 0 ||
+            segment_bits > ctx->nb * kBITS_IN_WORD)
+        return 0;
+    return segment_bits / kBITS_IN_BYTE;
+}
+
+int KalynaCfbEncrypt(const uint8_t* input, size_t length, const uint8_t* iv,
+        size_t segment_bits, kalyna_t* ctx, uint8_t* output) {
+    size_t offset, chunk, block_len = ctx->nb * sizeof(uint64_t);
+    size_t segment = SegmentBytes(ctx, segment_bits);
+    uint8_t shift[kNB_512 * sizeof(uint64_t)];
+    uint64_t gamma[kNB_512];
+
+    if (segment == 0)
+        return -1;
+    memcpy(shift, iv, block_len);
+    for (offset = 0; offset < length; offset += chunk) {
+        chunk = length - offset < segment ? length - offset : segment;
+        ReadWords(ctx->nb, shift, gamma);
+        KalynaEncipherBlocks(gamma, 1, ctx, gamma);
+        XorGamma(chunk, input + offset, gamma, output + offset);
+        memmove(shift, shift + segment, block_len - segment);
+        memcpy(shift + block_len - segment, output + offset, chunk);
+    }
+    return 0;
+}
+
+int KalynaCfbDecrypt(const uint8_t* input, size_t length, const uint8_t* iv,
+        size_t segment_bits, kalyna_t* ctx, uint8_t* output) {
+    size_t i, j, offset, chunk, segments, block_len = ctx->nb * sizeof(uint64_t);
+    size_t segment = SegmentBytes(ctx, segment_bits);
+    /* Previous register followed by the ciphertext of the current chunk. */
+    uint8_t window[kNB_512 * sizeof(uint64_t) + kFEEDBACK_CHUNK];
+    uint64_t gamma[kFEEDBACK_CHUNK / sizeof(uint64_t)];
+    const uint64_t* block;
+
+    if (segment == 0)
+        return -1;
+    memcpy(window, iv, block_len);
+    for (offset = 0; offset < length; offset += chunk) {
+        chunk = kFEEDBACK_CHUNK / block_len * segment;
+        chunk = length - offset < chunk ? length - offset : chunk;
+        segments = (chunk + segment - 1) / segment;
+        /* Copied first, so that decryption in place keeps the registers. */
+        memcpy(window + block_len, input + offset, chunk);
+        for (j = 0; j < segments; ++j)
+            ReadWords(ctx->nb, window + j * segment, gamma + j * ctx->nb);
+        KalynaEncipherBlocks(gamma, segments, ctx, gamma);
+        if (segment == block_len) {
+            XorGamma(chunk, window + block_len, gamma, output + offset);
+            memmove(window, window + chunk, block_len);
+            continue;
+        }
+        for (j = 0; j < segments; ++j) {
+            block = gamma + j * ctx->nb;
+            for (i = 0; i < segment && j * segment + i < chunk; ++i)
+                output[offset + j * segment + i] = window[block_len + j * segment + i] ^
+                    STATE_BYTE(block[i / sizeof(uint64_t)], i % sizeof(uint64_t));
+        }
+        memmove(window, window + chunk, block_len);
+    }
+    return 0;
+}
+
+int KalynaOfbBytes(const uint8_t* input, size_t length, const uint8_t* iv,
+        kalyna_t* ctx, uint8_t* output) {
+    size_t i, offset, chunk, blocks, block_len = ctx->nb * sizeof(uint64_t);
+    uint64_t gamma[kFEEDBACK_CHUNK / sizeof(uint64_t)];
+    uint64_t* block;
+    const uint64_t* previous;
+    uint64_t register_words[kNB_512];
+
+    ReadWords(ctx->nb, iv, register_words);
+    previous = register_words;
+    for (offset = 0; offset < length; offset += chunk) {
+        chunk = length - offset < kFEEDBACK_CHUNK ? length - offset : kFEEDBACK_CHUNK;
+        blocks = (chunk + block_len - 1) / block_len;
+        for (i = 0; i < blocks; ++i) {
+            block = gamma + i * ctx->nb;
+            KalynaEncipherBlocks(previous, 1, ctx, block);
+            previous = block;
+        }
+        XorGamma(chunk, input + offset, gamma, output + offset);
+        memcpy(register_words, previous, block_len);
+        previous = register_words;
+    }
+    return 0;
+}
+
+
+kalyna_ofb_t* KalynaOfbInit(kalyna_t* ctx, const uint8_t* iv, size_t capacity) {
+    size_t block_len = ctx->nb * sizeof(uint64_t);
+    kalyna_ofb_t* ofb;
+
+    capacity = capacity < block_len ? block_len :
+        (capacity + block_len - 1) / block_len * block_len;
+    ofb = (kalyna_ofb_t*)calloc(1, sizeof(kalyna_ofb_t));
+    if (ofb == NULL) {
+        perror("Could not allocate memory for OFB stream");
+        return NULL;
+    }
+    ofb->keystream = (uint8_t*)malloc(capacity);
+    if (ofb->keystream == NULL) {
+        perror("Could not allocate memory for OFB keystream");
+        free(ofb);
+        return NULL;
+    }
+    ofb->ctx = ctx;
+    ofb->capacity = capacity;
+    ReadWords(ctx->nb, iv, ofb->block);
+    return ofb;
+}
+
+int KalynaOfbDelete(kalyna_ofb_t* ofb) {
+    SecureWipe(ofb->keystream, ofb->capacity);
+    free(ofb->keystream);
+    SecureWipe(ofb, sizeof(kalyna_ofb_t));
+    free(ofb);
+    return 0;
+}
+
+size_t KalynaOfbPrecompute(kalyna_ofb_t* ofb, size_t length) {
+    size_t tail, first, block_len = ofb->ctx->nb * sizeof(uint64_t);
+    uint8_t bytes[kNB_512 * sizeof(uint64_t)];
+
+    while (ofb->filled < length && ofb->capacity - ofb->filled >= block_len) {
+        KalynaEncipherBlocks(ofb->block, 1, ofb->ctx, ofb->block);
+        WriteWords(ofb->ctx->nb, ofb->block, bytes);
+        /* The ring position of a block need not be block aligned. */
+        tail = (ofb->head + ofb->filled) % ofb->capacity;
+        first = ofb->capacity - tail < block_len ? ofb->capacity - tail : block_len;
+        memcpy(ofb->keystream + tail, bytes, first);
+        memcpy(ofb->keystream, bytes + first, block_len - first);
+        ofb->filled += block_len;
+    }
+    SecureWipe(bytes, sizeof(bytes));
+    return ofb->filled;
+}
+
+int KalynaOfbCrypt(kalyna_ofb_t* ofb, const uint8_t* input, size_t length,
+        uint8_t* output) {
+    size_t i, chunk;
+
+    while (length > 0) {
+        if (ofb->filled == 0)
+            KalynaOfbPrecompute(ofb, length);
+        chunk = length < ofb->filled ? length : ofb->filled;
+        chunk = chunk < ofb->capacity - ofb->head ? chunk : ofb->capacity - ofb->head;
+        for (i = 0; i < chunk; ++i)
+            output[i] = input[i] ^ ofb->keystream[ofb->head + i];
+        ofb->head = (ofb->head + chunk) % ofb->capacity;
+        ofb->filled -= chunk;
+        input += chunk;
+        output += chunk;
+        length -= chunk;
+    }
+    return 0;
+}
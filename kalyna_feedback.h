@@ -0,0 +1,106 @@
+/*
+
+Header file for the cipher and output feedback modes of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef KALYNA_FEEDBACK_H
+#define KALYNA_FEEDBACK_H
+
+#include "kalyna.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * Encrypt bytes in cipher feedback mode (CFB) with s-bit segments. The
+ * shift register starts as the IV; each segment is masked with the first
+ * s / 8 bytes of the encipherment of the register, then the register drops
+ * its first s / 8 bytes and takes the ciphertext segment at its end. The
+ * last segment may be short.
+ *
+ * @param input Plaintext bytes, any alignment.
+ * @param length Byte length of the input, any value.
+ * @param iv Initialization vector of the block size.
+ * @param segment_bits Feedback size s, a multiple of 8 up to the block size.
+ * @param ctx Initialized cipher context with precomputed round keys.
+ * @param output Ciphertext, `length` bytes. May be the same buffer as `input`.
+ * @return Zero in case of success, -1 if the segment size is not allowed.
+ */
+KALYNA_API int KalynaCfbEncrypt(const uint8_t* input, size_t length, const uint8_t* iv,
+    size_t segment_bits, kalyna_t* ctx, uint8_t* output);
+
+/*!
+ * Decrypt bytes in cipher feedback mode. All shift registers are known from
+ * the ciphertext, so they are enciphered many blocks per engine call.
+ * Parameters are the same as for KalynaCfbEncrypt().
+ *
+ * @return Zero in case of success, -1 if the segment size is not allowed.
+ */
+KALYNA_API int KalynaCfbDecrypt(const uint8_t* input, size_t length, const uint8_t* iv,
+    size_t segment_bits, kalyna_t* ctx, uint8_t* output);
+
+/*!
+ * Encrypt or decrypt bytes in output feedback mode (OFB): gamma block i is
+ * the encipherment of gamma block i - 1, block 0 being the IV. Encryption
+ * and decryption are the same operation.
+ *
+ * @param output The result, `length` bytes. May be the same buffer as `input`.
+ * @return Zero.
+ */
+KALYNA_API int KalynaOfbBytes(const uint8_t* input, size_t length, const uint8_t* iv,
+    kalyna_t* ctx, uint8_t* output);
+
+/*!
+ * OFB stream with a keystream buffer filled ahead of the data, so that a
+ * latency sensitive path only XORs the payload when it arrives. Output is
+ * the same as KalynaOfbBytes() over the concatenation of all calls.
+ *
+ * A stream is used by one thread at a time.
+ */
+typedef struct kalyna_ofb kalyna_ofb_t;
+
+/*!
+ * Create an OFB stream.
+ *
+ * @param ctx Cipher context with expanded key; must stay valid until the
+ * stream is deleted.
+ * @param iv Initialization vector of the block size.
+ * @param capacity Byte size of the keystream buffer, rounded up to blocks.
+ * @return Stream or NULL in case of error.
+ */
+KALYNA_API kalyna_ofb_t* KalynaOfbInit(kalyna_t* ctx, const uint8_t* iv, size_t capacity);
+
+/*!
+ * Wipe the keystream and release the stream.
+ *
+ * @return Zero in case of success.
+ */
+KALYNA_API int KalynaOfbDelete(kalyna_ofb_t* ofb);
+
+/*!
+ * Generate keystream ahead until at least `length` bytes are buffered or
+ * the buffer is full.
+ *
+ * @return Number of keystream bytes buffered.
+ */
+KALYNA_API size_t KalynaOfbPrecompute(kalyna_ofb_t* ofb, size_t length);
+
+/*!
+ * Encrypt or decrypt the next bytes of the stream, using buffered keystream
+ * first and generating the rest on the spot.
+ *
+ * @param output `length` bytes, may be the same as `input`.
+ * @return Zero.
+ */
+KALYNA_API int KalynaOfbCrypt(kalyna_ofb_t* ofb, const uint8_t* input, size_t length,
+    uint8_t* output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* KALYNA_FEEDBACK_H */
@@ -0,0 +1,172 @@
+/*
+
+Galois/counter mode of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include "kalyna_gcm.h"
+#include "arena.h"
+#include "transformations.h"
+
+/* Bytes enciphered by one engine call, a multiple of every block size. */
+#define kGCM_CHUNK 1024
+
+/*
+ * GHASH with 4-bit tables (Shoup's method): multiples of the hash key by
+ * every polynomial of degree below 4, and the reductions of the 4 bits
+ * shifted out of the top.
+ */
+typedef struct {
+    size_t nb;
+    uint64_t table[16][kNB_512];
+    uint64_t reduce[16];
+    uint64_t hash[kNB_512];
+} ghash_t;
+
+
+static void GhashInit(ghash_t* ghash, kalyna_t* ctx) {
+    size_t i, j, bit, nb = ctx->nb;
+    uint64_t power[kNB_512];
+
+    ghash->nb = nb;
+    memset(ghash->table, 0, sizeof(ghash->table));
+    memset(ghash->hash, 0, sizeof(ghash->hash));
+    memset(power, 0, sizeof(power));
+    KalynaEncipherBlocks(power, 1, ctx, power);
+    for (bit = 1; bit < 16; bit <<= 1) {
+        for (i = 0; i < nb; ++i)
+            ghash->table[bit][i] = power[i];
+        DoubleBlock(nb, power, power);
+    }
+    for (i = 3; i < 16; ++i) {
+        if ((i & (i - 1)) == 0)
+            continue;
+        for (j = 0; j < nb; ++j)
+            ghash->table[i][j] = ghash->table[i & (i - 1)][j] ^ ghash->table[i & -i][j];
+    }
+    /* Carry-less product of the shifted out bits with the reduction. */
+    for (i = 0; i < 16; ++i) {
+        ghash->reduce[i] = 0;
+        for (bit = 0; bit < 4; ++bit) {
+            if (i >> bit & 1)
+                ghash->reduce[i] ^= (uint64_t)REDUCTION(nb) << bit;
+        }
+    }
+}
+
+/* hash = (hash ^ block) * H, Horner's scheme from the top nibble. */
+static void GhashBlock(ghash_t* ghash, const uint64_t* block) {
+    size_t w, i, nb = ghash->nb;
+    int nibble;
+    uint64_t x[kNB_512], z[kNB_512], top;
+    const uint64_t* t;
+
+    for (i = 0; i < nb; ++i) {
+        x[i] = ghash->hash[i] ^ block[i];
+        z[i] = 0;
+    }
+    for (w = nb; w-- > 0;) {
+        for (nibble = 60; nibble >= 0; nibble -= 4) {
+            top = z[nb - 1] >> 60;
+            for (i = nb - 1; i > 0; --i)
+                z[i] = (z[i] << 4) | (z[i - 1] >> 60);
+            z[0] = (z[0] << 4) ^ ghash->reduce[top];
+            t = ghash->table[(x[w] >> nibble) & 15];
+            for (i = 0; i < nb; ++i)
+                z[i] ^= t[i];
+        }
+    }
+    memcpy(ghash->hash, z, nb * sizeof(uint64_t));
+}
+
+/* Hash bytes, zero padding the last block. */
+static void GhashBytes(ghash_t* ghash, const uint8_t* data, size_t length) {
+    size_t offset, block_len = ghash->nb * sizeof(uint64_t);
+    uint8_t padded[kNB_512 * sizeof(uint64_t)];
+    uint64_t block[kNB_512];
+
+    for (offset = 0; offset + block_len <= length; offset += block_len) {
+        ReadWords(ghash->nb, data + offset, block);
+        GhashBlock(ghash, block);
+    }
+    if (offset < length) {
+        memset(padded, 0, block_len);
+        memcpy(padded, data + offset, length - offset);
+        ReadWords(ghash->nb, padded, block);
+        GhashBlock(ghash, block);
+    }
+}
+
+/* Add the bit lengths to the hash and encipher the sum into the tag. */
+static void GhashFinal(ghash_t* ghash, kalyna_t* ctx, size_t aad_len, size_t length,
+        uint8_t* tag) {
+    uint64_t block[kNB_512];
+
+    memcpy(block, ghash->hash, ghash->nb * sizeof(uint64_t));
+    block[0] ^= (uint64_t)aad_len * kBITS_IN_BYTE;
+    block[ghash->nb / 2] ^= (uint64_t)length * kBITS_IN_BYTE;
+    KalynaEncipherBlocks(block, 1, ctx, block);
+    WriteWords(ghash->nb, block, tag);
+    SecureWipe(block, sizeof(block));
+}
+
+/*
+ * Counter mode of the standard from the encipherment of the IV, hashing the
+ * ciphertext when encrypting.
+ */
+static void GcmCtr(kalyna_t* ctx, const uint8_t* iv, const uint8_t* input, size_t length,
+        uint8_t* output, ghash_t* ghash) {
+    size_t offset, chunk, blocks, block_len = ctx->nb * sizeof(uint64_t);
+    uint64_t counter[kNB_512];
+    uint64_t gamma[kGCM_CHUNK / sizeof(uint64_t)];
+
+    ReadWords(ctx->nb, iv, counter);
+    KalynaEncipherBlocks(counter, 1, ctx, counter);
+    for (offset = 0; offset < length; offset += chunk) {
+        chunk = length - offset < kGCM_CHUNK ? length - offset : kGCM_CHUNK;
+        blocks = (chunk + block_len - 1) / block_len;
+        CtrCounters(counter, blocks, ctx->nb, gamma);
+        KalynaEncipherBlocks(gamma, blocks, ctx, gamma);
+        XorGamma(chunk, input + offset, gamma, output + offset);
+        if (ghash != NULL)
+            GhashBytes(ghash, output + offset, chunk);
+    }
+    SecureWipe(gamma, sizeof(gamma));
+    SecureWipe(counter, sizeof(counter));
+}
+
+
+int KalynaGcmEncrypt(kalyna_t* ctx, const uint8_t* nonce, const uint8_t* aad,
+        size_t aad_len, const uint8_t* input, size_t length, uint8_t* output, uint8_t* tag) {
+    ghash_t ghash;
+
+    GhashInit(&ghash, ctx);
+    GhashBytes(&ghash, aad, aad_len);
+    GcmCtr(ctx, nonce, input, length, output, &ghash);
+    GhashFinal(&ghash, ctx, aad_len, length, tag);
+    SecureWipe(&ghash, sizeof(ghash));
+    return 0;
+}
+
+int KalynaGcmDecrypt(kalyna_t* ctx, const uint8_t* nonce, const uint8_t* aad,
+        size_t aad_len, const uint8_t* input, size_t length, const uint8_t* tag,
+        uint8_t* output) {
+    size_t i;
+    uint8_t expect[kNB_512 * sizeof(uint64_t)], diff = 0;
+    ghash_t ghash;
+
+    GhashInit(&ghash, ctx);
+    GhashBytes(&ghash, aad, aad_len);
+    GhashBytes(&ghash, input, length);
+    GhashFinal(&ghash, ctx, aad_len, length, expect);
+    SecureWipe(&ghash, sizeof(ghash));
+    for (i = 0; i < ctx->nb * sizeof(uint64_t); ++i)
+        diff |= expect[i] ^ tag[i];
+    SecureWipe(expect, sizeof(expect));
+    if (diff != 0)
+        return -1;
+    GcmCtr(ctx, nonce, input, length, output, NULL);
+    return 0;
+}
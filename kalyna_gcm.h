@@ -0,0 +1,64 @@
+/*
+
+Header file for the Galois/counter mode of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef KALYNA_GCM_H
+#define KALYNA_GCM_H
+
+#include "kalyna.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * Galois/counter mode of DSTU 7624:2014 for all block sizes. Blocks are read
+ * as little endian words. The data is enciphered in the counter mode of the
+ * standard (see KalynaCtrBytes) from the IV. GHASH multiplies in
+ * GF(2^{block bits}) with the little endian bit order and the polynomials
+ * x^128 + x^7 + x^2 + x + 1, x^256 + x^10 + x^5 + x^2 + 1 and
+ * x^512 + x^8 + x^5 + x^2 + 1 by H, the encipherment of the zero block; it
+ * absorbs the zero padded additional data and then the ciphertext. The bit
+ * lengths of the two are added to words 0 and Nb/2 of the hash without a
+ * further multiplication, and the tag is the encipherment of that sum. Tags
+ * have the block size.
+ *
+ * GMAC of the standard is this mode with empty plaintext: pass the message
+ * as `aad` and a zero `length`.
+ */
+
+/*!
+ * Encrypt and authenticate.
+ *
+ * @param ctx Cipher context with expanded key.
+ * @param nonce Block size IV, never repeated under one key.
+ * @param aad Additional authenticated data or NULL if `aad_len` is zero.
+ * @param input Plaintext.
+ * @param output Ciphertext of `length` bytes, may be the same as `input`.
+ * @param tag Output tag of the block size.
+ * @return Zero in case of success.
+ */
+KALYNA_API int KalynaGcmEncrypt(kalyna_t* ctx, const uint8_t* nonce, const uint8_t* aad,
+    size_t aad_len, const uint8_t* input, size_t length, uint8_t* output, uint8_t* tag);
+
+/*!
+ * Verify and decrypt. The tag is checked in constant time before any
+ * plaintext is written.
+ *
+ * @param output Plaintext of `length` bytes, may be the same as `input`.
+ * @return Zero in case of success, -1 if the tag does not match; `output`
+ * is not written then.
+ */
+KALYNA_API int KalynaGcmDecrypt(kalyna_t* ctx, const uint8_t* nonce, const uint8_t* aad,
+    size_t aad_len, const uint8_t* input, size_t length, const uint8_t* tag,
+    uint8_t* output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* KALYNA_GCM_H */
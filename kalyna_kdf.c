@@ -0,0 +1,250 @@
+/*
+
+Key derivation function based on the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "kalyna_kdf.h"
+#include "transformations.h"
+#include "arena.h"
+
+/* PRF runs advanced together by one engine call. */
+#define kKDF_RUNS 256
+
+/* Byte lengths of the counter, the key index and the output length. */
+#define kCOUNTER_BYTES 4
+#define kINDEX_BYTES 8
+#define kLENGTH_BYTES 4
+
+typedef struct {
+    kalyna_t* master;
+    size_t nb;
+    size_t block_len;
+    size_t outputs;  /* PRF runs per key. */
+    size_t batch;  /* Keys per batch. */
+    size_t message_len;  /* Byte length of the PRF input. */
+    size_t index_offset;  /* Offset of the key index in the PRF input. */
+    uint8_t* messages;  /* PRF inputs of a batch, `message_len` bytes each. */
+    uint64_t k1[kNB_512];  /* CMAC subkey of a complete last block. */
+    uint64_t k2[kNB_512];  /* CMAC subkey of a padded last block. */
+} kdf_t;
+
+/* Keys of a batch expanded by the helper thread. */
+typedef struct {
+    kalyna_t** ctxs;
+    size_t count;
+    uint64_t* words;  /* Key `n` starts at `n` * `stride` words. */
+    size_t stride;
+} kdf_expand_job_t;
+
+
+static void StoreBigEndian(uint64_t value, size_t bytes, uint8_t* output) {
+    size_t i;
+    for (i = 0; i < bytes; ++i)
+        output[i] = (uint8_t)(value >> ((bytes - 1 - i) * kBITS_IN_BYTE));
+}
+
+/*!
+ * Prepare the PRF inputs and CMAC subkeys for keys of `key_bytes`.
+ *
+ * @return Zero in case of success, -1 in case of error.
+ */
+static int KdfInit(kdf_t* kdf, kalyna_t* master, const uint8_t* label, size_t label_len,
+        const uint8_t* context, size_t context_len, size_t key_bytes) {
+    size_t run;
+    uint8_t* message;
+
+    memset(kdf, 0, sizeof(kdf_t));
+    if (key_bytes == 0 || key_bytes > UINT32_MAX / kBITS_IN_BYTE)
+        return -1;
+    kdf->master = master;
+    kdf->nb = master->nb;
+    kdf->block_len = master->nb * sizeof(uint64_t);
+    kdf->outputs = (key_bytes + kdf->block_len - 1) / kdf->block_len;
+    kdf->batch = kdf->outputs < kKDF_RUNS ? kKDF_RUNS / kdf->outputs : 1;
+    kdf->index_offset = kCOUNTER_BYTES + label_len + 1 + context_len;
+    kdf->message_len = kdf->index_offset + kINDEX_BYTES + kLENGTH_BYTES;
+    kdf->messages = (uint8_t*)malloc(kdf->batch * kdf->outputs * kdf->message_len);
+    if (kdf->messages == NULL) {
+        perror("Could not allocate memory for key derivation");
+        return -1;
+    }
+    for (run = 0; run < kdf->batch * kdf->outputs; ++run) {
+        message = kdf->messages + run * kdf->message_len;
+        StoreBigEndian(run % kdf->outputs + 1, kCOUNTER_BYTES, message);
+        if (label_len > 0)
+            memcpy(message + kCOUNTER_BYTES, label, label_len);
+        message[kCOUNTER_BYTES + label_len] = 0x00;
+        if (context_len > 0)
+            memcpy(message + kCOUNTER_BYTES + label_len + 1, context, context_len);
+        StoreBigEndian((uint64_t)key_bytes * kBITS_IN_BYTE, kLENGTH_BYTES,
+            message + kdf->index_offset + kINDEX_BYTES);
+    }
+    KalynaEncipherBlocks(kdf->k1, 1, master, kdf->k1);
+    DoubleBlock(kdf->nb, kdf->k1, kdf->k1);
+    DoubleBlock(kdf->nb, kdf->k1, kdf->k2);
+    return 0;
+}
+
+static void KdfDelete(kdf_t* kdf) {
+    free(kdf->messages);
+    SecureWipe(kdf, sizeof(kdf_t));
+}
+
+/*!
+ * Run the PRF for keys `first` to `first` + `count` - 1, `count` at most
+ * `batch`. The outputs of key `n` are the `outputs` * Nb words at `words`
+ * + `n` * `outputs` * Nb.
+ */
+static void DeriveBatch(kdf_t* kdf, uint64_t first, size_t count, uint64_t* words) {
+    size_t run, j, i, tail;
+    size_t runs = count * kdf->outputs;
+    size_t blocks = (kdf->message_len + kdf->block_len - 1) / kdf->block_len;
+    uint64_t block[kNB_512];
+    uint8_t padded[kNB_512 * sizeof(uint64_t)];
+    const uint8_t* message;
+
+    for (run = 0; run < runs; run += kdf->outputs) {
+        StoreBigEndian(first + run / kdf->outputs, kINDEX_BYTES,
+            kdf->messages + run * kdf->message_len + kdf->index_offset);
+        for (i = 1; i < kdf->outputs; ++i)
+            memcpy(kdf->messages + (run + i) * kdf->message_len + kdf->index_offset,
+                kdf->messages + run * kdf->message_len + kdf->index_offset, kINDEX_BYTES);
+    }
+    memset(words, 0, runs * kdf->nb * sizeof(uint64_t));
+    for (j = 0; j < blocks; ++j) {
+        tail = kdf->message_len - j * kdf->block_len;
+        for (run = 0; run < runs; ++run) {
+            message = kdf->messages + run * kdf->message_len + j * kdf->block_len;
+            if (tail >= kdf->block_len) {
+                ReadWords(kdf->nb, message, block);
+            } else {
+                memset(padded, 0, kdf->block_len);
+                memcpy(padded, message, tail);
+                padded[tail] = 0x80;
+                ReadWords(kdf->nb, padded, block);
+            }
+            for (i = 0; i < kdf->nb; ++i) {
+                words[run * kdf->nb + i] ^= block[i];
+                if (j + 1 == blocks)
+                    words[run * kdf->nb + i] ^= tail >= kdf->block_len ? kdf->k1[i] : kdf->k2[i];
+            }
+        }
+        KalynaEncipherBlocks(words, runs, kdf->master, words);
+    }
+}
+
+int KalynaKdfDerive(kalyna_t* master, const uint8_t* label, size_t label_len,
+        const uint8_t* context, size_t context_len, uint64_t first, size_t count,
+        size_t key_bytes, uint8_t* keys) {
+    size_t done, n, chunk, words_len;
+    uint64_t* words;
+    uint8_t* bytes;
+    kdf_t kdf;
+
+    if (count == 0)
+        return 0;
+    if (KdfInit(&kdf, master, label, label_len, context, context_len, key_bytes) != 0)
+        return -1;
+    words_len = kdf.batch * kdf.outputs * kdf.nb;
+    words = (uint64_t*)malloc(words_len * sizeof(uint64_t));
+    bytes = (uint8_t*)malloc(kdf.outputs * kdf.block_len);
+    if (words == NULL || bytes == NULL) {
+        perror("Could not allocate memory for key derivation");
+        free(words);
+        free(bytes);
+        KdfDelete(&kdf);
+        return -1;
+    }
+    for (done = 0; done < count; done += chunk) {
+        chunk = count - done < kdf.batch ? count - done : kdf.batch;
+        DeriveBatch(&kdf, first + done, chunk, words);
+        for (n = 0; n < chunk; ++n) {
+            WriteWords(kdf.outputs * kdf.nb, words + n * kdf.outputs * kdf.nb, bytes);
+            memcpy(keys + (done + n) * key_bytes, bytes, key_bytes);
+        }
+    }
+    SecureWipe(words, words_len * sizeof(uint64_t));
+    SecureWipe(bytes, kdf.outputs * kdf.block_len);
+    free(words);
+    free(bytes);
+    KdfDelete(&kdf);
+    return 0;
+}
+
+
+static void* ExpandKeys(void* arg) {
+    kdf_expand_job_t* job = (kdf_expand_job_t*)arg;
+    size_t n;
+    for (n = 0; n < job->count; ++n)
+        KalynaKeyExpand(job->words + n * job->stride, job->ctxs[n]);
+    SecureWipe(job->words, job->count * job->stride * sizeof(uint64_t));
+    return NULL;
+}
+
+int KalynaKdfDeriveContexts(kalyna_t* master, const uint8_t* label, size_t label_len,
+        const uint8_t* context, size_t context_len, uint64_t first, size_t count,
+        size_t block_size, size_t key_size, kalyna_t** ctxs) {
+    size_t n, done, chunk, words_len, current = 0;
+    uint64_t* words[2];
+    pthread_t expander;
+    int expanding = FALSE;
+    kdf_expand_job_t job;
+    kdf_t kdf;
+
+    if (count == 0)
+        return 0;
+    for (n = 0; n < count; ++n) {
+        ctxs[n] = KalynaInit(block_size, key_size);
+        if (ctxs[n] == NULL) {
+            while (n > 0)
+                KalynaDelete(ctxs[--n]);
+            return -1;
+        }
+    }
+    if (KdfInit(&kdf, master, label, label_len, context, context_len,
+            key_size / kBITS_IN_BYTE) != 0) {
+        for (n = 0; n < count; ++n)
+            KalynaDelete(ctxs[n]);
+        return -1;
+    }
+    /* Two buffers: one batch is expanded while the next one is derived. */
+    words_len = kdf.batch * kdf.outputs * kdf.nb;
+    words[0] = (uint64_t*)malloc(2 * words_len * sizeof(uint64_t));
+    if (words[0] == NULL) {
+        perror("Could not allocate memory for key derivation");
+        KdfDelete(&kdf);
+        for (n = 0; n < count; ++n)
+            KalynaDelete(ctxs[n]);
+        return -1;
+    }
+    words[1] = words[0] + words_len;
+
+    for (done = 0; done < count; done += chunk) {
+        chunk = count - done < kdf.batch ? count - done : kdf.batch;
+        DeriveBatch(&kdf, first + done, chunk, words[current]);
+        if (expanding) {
+            pthread_join(expander, NULL);
+            expanding = FALSE;
+        }
+        job.ctxs = ctxs + done;
+        job.count = chunk;
+        job.words = words[current];
+        job.stride = kdf.outputs * kdf.nb;
+        if (pthread_create(&expander, NULL, ExpandKeys, &job) == 0)
+            expanding = TRUE;
+        else
+            ExpandKeys(&job);
+        current ^= 1;
+    }
+    if (expanding)
+        pthread_join(expander, NULL);
+    free(words[0]);
+    KdfDelete(&kdf);
+    return 0;
+}
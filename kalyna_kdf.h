@@ -0,0 +1,71 @@
+/*
+
+Header file for the key derivation function based on the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef KALYNA_KDF_H
+#define KALYNA_KDF_H
+
+#include "kalyna.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * Key derivation in counter mode (NIST SP 800-108) with CMAC over Kalyna as
+ * the PRF, using the CMAC conventions of kalyna_tree_mac.h.
+ *
+ * Keys are derived in batches from one master key. Key `n` of a batch is
+ * the KDF output for the fixed input data
+ *
+ *     label || 0x00 || context || [first + n]_64 || [L]_32
+ *
+ * where L is the key length in bits: the PRF is run on [i]_32 followed by
+ * these bytes for i = 1, 2, ... and the outputs are concatenated and cut to
+ * L bits. Integers are big endian. PRF runs of the whole batch advance
+ * together, one multi-block engine call per CMAC block.
+ */
+
+/*!
+ * Derive a batch of keys as bytes.
+ *
+ * @param master Context with the master key.
+ * @param label Label of the keys' purpose, may be NULL if `label_len` is 0.
+ * @param context Context shared by the batch, may be NULL if `context_len`
+ * is 0.
+ * @param first Index of the first key.
+ * @param count Number of keys.
+ * @param key_bytes Byte length of every key.
+ * @param keys Output of `count` * `key_bytes` bytes.
+ * @return Zero in case of success, -1 in case of error.
+ */
+KALYNA_API int KalynaKdfDerive(kalyna_t* master, const uint8_t* label, size_t label_len,
+    const uint8_t* context, size_t context_len, uint64_t first, size_t count,
+    size_t key_bytes, uint8_t* keys);
+
+/*!
+ * Derive a batch of keys straight into expanded contexts, the same keys as
+ * KalynaKdfDerive() with `key_bytes` = `key_size` / 8 read as little endian
+ * words. Key expansion of a batch runs on a helper thread while the next
+ * batch is derived, and the derived keys are wiped once expanded.
+ *
+ * @param block_size Block size of the contexts in bits.
+ * @param key_size Key size of the contexts in bits.
+ * @param ctxs Output of `count` new contexts, to be deleted by the caller
+ * with KalynaDelete().
+ * @return Zero in case of success, -1 in case of error, when no context is
+ * left allocated.
+ */
+KALYNA_API int KalynaKdfDeriveContexts(kalyna_t* master, const uint8_t* label,
+    size_t label_len, const uint8_t* context, size_t context_len, uint64_t first,
+    size_t count, size_t block_size, size_t key_size, kalyna_t** ctxs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* KALYNA_KDF_H */
@@ -0,0 +1,91 @@
+/*
+
+Per NUMA node key replicas of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <stdio.h>
+#include <sys/mman.h>
+
+#include "kalyna_numa.h"
+#include "transformations.h"
+#include "ttable.h"
+#include "topology.h"
+#include "arena.h"
+
+struct kalyna_replicas {
+    size_t nodes;
+    size_t key_bytes;  /* Round keys of one replica, both directions. */
+    kalyna_t* ctxs[kMAX_NODES];
+    uint64_t* keys[kMAX_NODES];  /* Node local round keys of `ctxs`. */
+};
+
+
+size_t KalynaNumaNodes(void) {
+    return NodeCount();
+}
+
+int KalynaNumaBind(size_t node) {
+    if (NodeBindThread(node) != 0)
+        return -1;
+    TTableResetLocal();
+    return 0;
+}
+
+kalyna_replicas_t* KalynaReplicasInit(const kalyna_t* ctx) {
+    size_t node, round, round_bytes = ctx->nb * sizeof(uint64_t);
+    kalyna_replicas_t* replicas;
+
+    replicas = (kalyna_replicas_t*)calloc(1, sizeof(kalyna_replicas_t));
+    if (replicas == NULL) {
+        perror("Could not allocate memory for key replicas");
+        return NULL;
+    }
+    replicas->nodes = NodeCount();
+    replicas->key_bytes = 2 * (ctx->nr + 1) * round_bytes;
+    for (node = 0; node < replicas->nodes; ++node) {
+        replicas->keys[node] = (uint64_t*)NodeAlloc(replicas->key_bytes, node);
+        if (replicas->keys[node] == NULL) {
+            KalynaReplicasDelete(replicas);
+            return NULL;
+        }
+        /* Kept out of swap and core dumps like contexts of the arena. */
+        mlock(replicas->keys[node], replicas->key_bytes);
+#ifdef MADV_DONTDUMP
+        madvise(replicas->keys[node], replicas->key_bytes, MADV_DONTDUMP);
+#endif
+        replicas->ctxs[node] = ContextInit(ctx->nb, ctx->nk, ctx->nr, replicas->keys[node]);
+        if (replicas->ctxs[node] == NULL) {
+            KalynaReplicasDelete(replicas);
+            return NULL;
+        }
+        for (round = 0; round <= ctx->nr; ++round) {
+            memcpy(replicas->ctxs[node]->round_keys[round], ctx->round_keys[round],
+                round_bytes);
+            memcpy(replicas->ctxs[node]->round_keys_dec[round], ctx->round_keys_dec[round],
+                round_bytes);
+        }
+    }
+    return replicas;
+}
+
+int KalynaReplicasDelete(kalyna_replicas_t* replicas) {
+    size_t node;
+    for (node = 0; node < replicas->nodes; ++node) {
+        if (replicas->ctxs[node] != NULL)
+            KalynaDelete(replicas->ctxs[node]);
+        if (replicas->keys[node] != NULL) {
+            SecureWipe(replicas->keys[node], replicas->key_bytes);
+            munlock(replicas->keys[node], replicas->key_bytes);
+            NodeFree(replicas->keys[node], replicas->key_bytes);
+        }
+    }
+    free(replicas);
+    return 0;
+}
+
+kalyna_t* KalynaReplicasLocal(kalyna_replicas_t* replicas) {
+    return replicas->ctxs[NodeCurrent()];
+}
@@ -0,0 +1,66 @@
+/*
+
+Header file for the per NUMA node key replicas of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef KALYNA_NUMA_H
+#define KALYNA_NUMA_H
+
+#include "kalyna.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * Copies of a key schedule, one per NUMA node, each with its round keys on
+ * the pages of its node. The lookup tables of the table-driven engine are
+ * replicated the same way on their own: every thread reads the tables of
+ * the node it first ran the engine on.
+ */
+typedef struct kalyna_replicas kalyna_replicas_t;
+
+/*!
+ * Number of NUMA nodes with their own replicas, 1 on single node hosts and
+ * other systems.
+ */
+KALYNA_API size_t KalynaNumaNodes(void);
+
+/*!
+ * Restrict the calling thread to the CPUs of a node and switch it to the
+ * table replica of that node.
+ *
+ * @return Zero in case of success, -1 if the node is unknown.
+ */
+KALYNA_API int KalynaNumaBind(size_t node);
+
+/*!
+ * Replicate an expanded key on every node.
+ *
+ * @param ctx Context with expanded key; may be deleted afterwards.
+ * @return Replicas or NULL in case of error.
+ */
+KALYNA_API kalyna_replicas_t* KalynaReplicasInit(const kalyna_t* ctx);
+
+/*!
+ * Wipe and release all replicas.
+ *
+ * @return Zero in case of success.
+ */
+KALYNA_API int KalynaReplicasDelete(kalyna_replicas_t* replicas);
+
+/*!
+ * Replica of the node the calling thread runs on. It is a regular context
+ * for all functions taking one, except that it must not be deleted or
+ * rekeyed.
+ */
+KALYNA_API kalyna_t* KalynaReplicasLocal(kalyna_replicas_t* replicas);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* KALYNA_NUMA_H */
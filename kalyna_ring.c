@@ -0,0 +1,410 @@
+/*
+
+Batched submission/completion ring of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <pthread.h>
+
+#include "kalyna_ring.h"
+#include "arena.h"
+#include "transformations.h"
+#include "engine.h"
+
+/* Words of the batch buffer of a lane passed to a single engine call. */
+#define kRING_BATCH_WORDS 512
+
+/*!
+ * Job taken from the submission queue for processing.
+ */
+typedef struct {
+    kalyna_job_t job;
+    size_t sequence;  /**< Submission order, keeps sorting stable. */
+    int result;
+    uint64_t counter[kNB_512];  /**< CTR counter. */
+} ring_work_t;
+
+/*!
+ * Part of a job placed into the batch buffer.
+ */
+typedef struct {
+    ring_work_t* work;
+    size_t offset;  /**< Byte offset in the job buffers. */
+    size_t length;  /**< Byte length. */
+    size_t word;  /**< First word in the batch buffer. */
+} ring_segment_t;
+
+/*!
+ * Jobs of one context packed into a batch buffer. Lanes of different
+ * contexts of the same variant are run together by the multi-buffer
+ * routines.
+ */
+typedef struct {
+    ring_work_t** group;  /**< Jobs sharing the context. */
+    size_t count;  /**< Number of jobs in the group. */
+    size_t job, offset;  /**< Packing position in the group. */
+    ring_segment_t segments[kRING_BATCH_WORDS / kNB_128];
+    size_t segments_num;
+    size_t words;  /**< Used words of the batch. */
+    uint64_t batch[kRING_BATCH_WORDS];
+} ring_lane_t;
+
+struct kalyna_ring {
+    size_t entries;
+    kalyna_job_t* submissions;
+    kalyna_completion_t* completions;
+    size_t sq_head, sq_tail;  /* Free-running indices, taken modulo entries. */
+    size_t cq_head, cq_tail;
+    size_t in_flight;  /* Submitted and not reaped jobs. */
+    size_t sequence;
+    pthread_mutex_t lock;
+    pthread_cond_t submitted;
+    pthread_cond_t completed;
+    pthread_t worker;
+    int running, stop;
+
+    /* Processing state, owned by the holder of process_lock. */
+    pthread_mutex_t process_lock;
+    ring_work_t* work;
+    ring_work_t** order;
+    ring_lane_t lanes[kLANES];
+    ring_lane_t* active[kLANES];  /* Lanes having a group, first active_num. */
+    size_t active_num;
+    kalyna_lanes_t schedule;
+};
+
+
+kalyna_ring_t* KalynaRingInit(size_t entries) {
+    kalyna_ring_t* ring;
+    if (entries == 0) {
+        fprintf(stderr, "Ring must have at least one entry\n");
+        return NULL;
+    }
+    ring = (kalyna_ring_t*)calloc(1, sizeof(kalyna_ring_t));
+    if (ring == NULL) {
+        perror("Could not allocate memory for ring");
+        return NULL;
+    }
+    ring->entries = entries;
+    ring->submissions = (kalyna_job_t*)calloc(entries, sizeof(kalyna_job_t));
+    ring->completions = (kalyna_completion_t*)calloc(entries, sizeof(kalyna_completion_t));
+    ring->work = (ring_work_t*)calloc(entries, sizeof(ring_work_t));
+    ring->order = (ring_work_t**)calloc(entries, sizeof(ring_work_t*));
+    if (ring->submissions == NULL || ring->completions == NULL ||
+            ring->work == NULL || ring->order == NULL) {
+        perror("Could not allocate memory for ring queues");
+        free(ring->submissions);
+        free(ring->completions);
+        free(ring->work);
+        free(ring->order);
+        free(ring);
+        return NULL;
+    }
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_mutex_init(&ring->process_lock, NULL);
+    pthread_cond_init(&ring->submitted, NULL);
+    pthread_cond_init(&ring->completed, NULL);
+    return ring;
+}
+
+int KalynaRingDelete(kalyna_ring_t* ring) {
+    if (ring->running) {
+        pthread_mutex_lock(&ring->lock);
+        ring->stop = TRUE;
+        pthread_cond_signal(&ring->submitted);
+        pthread_mutex_unlock(&ring->lock);
+        pthread_join(ring->worker, NULL);
+    }
+    pthread_mutex_destroy(&ring->lock);
+    pthread_mutex_destroy(&ring->process_lock);
+    pthread_cond_destroy(&ring->submitted);
+    pthread_cond_destroy(&ring->completed);
+    free(ring->submissions);
+    free(ring->completions);
+    /* CTR counters, copied round keys and batched data. */
+    SecureWipe(ring->work, ring->entries * sizeof(ring_work_t));
+    free(ring->work);
+    free(ring->order);
+    SecureWipe(ring, sizeof(kalyna_ring_t));
+    free(ring);
+    return 0;
+}
+
+int KalynaRingSubmit(kalyna_ring_t* ring, const kalyna_job_t* job) {
+    pthread_mutex_lock(&ring->lock);
+    if (ring->in_flight == ring->entries) {
+        pthread_mutex_unlock(&ring->lock);
+        return -1;
+    }
+    ring->submissions[ring->sq_tail++ % ring->entries] = *job;
+    ++ring->in_flight;
+    pthread_cond_signal(&ring->submitted);
+    pthread_mutex_unlock(&ring->lock);
+    return 0;
+}
+
+
+/* Order jobs by variant and mode, then by context and submission. */
+static int CompareWork(const void* a, const void* b) {
+    const ring_work_t* x = *(ring_work_t* const*)a;
+    const ring_work_t* y = *(ring_work_t* const*)b;
+    if (x->job.ctx->nb != y->job.ctx->nb)
+        return x->job.ctx->nb < y->job.ctx->nb ? -1 : 1;
+    if (x->job.ctx->nk != y->job.ctx->nk)
+        return x->job.ctx->nk < y->job.ctx->nk ? -1 : 1;
+    if (x->job.mode != y->job.mode)
+        return x->job.mode < y->job.mode ? -1 : 1;
+    if (x->job.ctx != y->job.ctx)
+        return (size_t)x->job.ctx < (size_t)y->job.ctx ? -1 : 1;
+    return x->sequence < y->sequence ? -1 : (x->sequence > y->sequence);
+}
+
+/*!
+ * Give a lane the next group of jobs: validate them and, for CTR, encipher
+ * the initial counters of all of them in one call.
+ */
+static void StartLane(ring_lane_t* lane, ring_work_t** group, size_t count) {
+    size_t i, first, blocks;
+    kalyna_t* ctx = group[0]->job.ctx;
+    kalyna_job_mode_t mode = group[0]->job.mode;
+    size_t block_len = ctx->nb * sizeof(uint64_t);
+    ring_work_t* work;
+
+    lane->group = group;
+    lane->count = count;
+    lane->job = 0;
+    lane->offset = 0;
+    for (i = 0; i < count; ++i) {
+        work = group[i];
+        if ((mode == KALYNA_JOB_CTR && work->job.iv == NULL) ||
+                (mode != KALYNA_JOB_CTR && work->job.length % block_len != 0) ||
+                (unsigned)mode > KALYNA_JOB_CTR)
+            work->result = -1;
+    }
+    if (mode != KALYNA_JOB_CTR)
+        return;
+    for (first = 0; first < count; first += blocks) {
+        blocks = count - first < kRING_BATCH_WORDS / ctx->nb ?
+            count - first : kRING_BATCH_WORDS / ctx->nb;
+        for (i = 0; i < blocks; ++i) {
+            if (group[first + i]->result == 0)
+                ReadWords(ctx->nb, group[first + i]->job.iv, lane->batch + i * ctx->nb);
+            else
+                memset(lane->batch + i * ctx->nb, 0, block_len);
+        }
+        KalynaEncipherBlocks(lane->batch, blocks, ctx, lane->batch);
+        for (i = 0; i < blocks; ++i)
+            memcpy(group[first + i]->counter, lane->batch + i * ctx->nb, block_len);
+    }
+}
+
+/*!
+ * Pack blocks of the lane jobs, or their counter blocks for CTR, one after
+ * another into the lane batch until it is full or the group is done.
+ */
+static void FillLane(ring_lane_t* lane) {
+    size_t length, blocks;
+    kalyna_t* ctx = lane->group[0]->job.ctx;
+    kalyna_job_mode_t mode = lane->group[0]->job.mode;
+    size_t block_len = ctx->nb * sizeof(uint64_t);
+    ring_work_t* work;
+    ring_segment_t* segment;
+
+    while (lane->job < lane->count && lane->words < kRING_BATCH_WORDS) {
+        work = lane->group[lane->job];
+        if (work->result != 0 || lane->offset == work->job.length) {
+            ++lane->job;
+            lane->offset = 0;
+            continue;
+        }
+        length = (kRING_BATCH_WORDS - lane->words) * sizeof(uint64_t);
+        if (length > work->job.length - lane->offset)
+            length = work->job.length - lane->offset;
+        blocks = (length + block_len - 1) / block_len;
+
+        segment = &lane->segments[lane->segments_num++];
+        segment->work = work;
+        segment->offset = lane->offset;
+        segment->length = length;
+        segment->word = lane->words;
+        if (mode == KALYNA_JOB_CTR)
+            CtrCounters(work->counter, blocks, ctx->nb, lane->batch + lane->words);
+        else
+            ReadWords(length / sizeof(uint64_t), work->job.input + lane->offset,
+                lane->batch + lane->words);
+        lane->words += blocks * ctx->nb;
+        lane->offset += length;
+    }
+}
+
+/*!
+ * Run the engine over the batches of all active lanes at once and move the
+ * results out to the job buffers.
+ */
+static void FlushLanes(kalyna_ring_t* ring, kalyna_job_mode_t mode) {
+    size_t i, j, blocks[kLANES];
+    const uint64_t* input[kLANES];
+    uint64_t* output[kLANES];
+    ring_lane_t* lane;
+    ring_segment_t* segment;
+
+    for (i = 0; i < ring->active_num; ++i) {
+        lane = ring->active[i];
+        input[i] = output[i] = lane->batch;
+        blocks[i] = lane->words / ring->schedule.nb;
+    }
+    if (mode == KALYNA_JOB_ECB_DECRYPT)
+        KalynaDecipherLanes(&ring->schedule, input, blocks, output);
+    else
+        KalynaEncipherLanes(&ring->schedule, input, blocks, output);
+
+    for (i = 0; i < ring->active_num; ++i) {
+        lane = ring->active[i];
+        for (j = 0; j < lane->segments_num; ++j) {
+            segment = &lane->segments[j];
+            if (mode == KALYNA_JOB_CTR)
+                XorGamma(segment->length, segment->work->job.input + segment->offset,
+                    lane->batch + segment->word, segment->work->job.output + segment->offset);
+            else
+                WriteWords(segment->length / sizeof(uint64_t), lane->batch + segment->word,
+                    segment->work->job.output + segment->offset);
+        }
+        lane->words = 0;
+        lane->segments_num = 0;
+    }
+}
+
+/*!
+ * Process jobs of the same variant and mode. Each context gets a lane; up
+ * to kLANES contexts are enciphered together and a lane whose jobs are done
+ * takes the next context.
+ */
+static void ProcessClass(kalyna_ring_t* ring, ring_work_t** works, size_t count) {
+    size_t i, next = 0, end;
+    int reload = TRUE;
+    kalyna_t* ctxs[kLANES];
+    kalyna_job_mode_t mode = works[0]->job.mode;
+    ring_lane_t* lane;
+
+    ring->active_num = 0;
+    for (;;) {
+        for (i = 0; ring->active_num < kLANES && next < count; next = end) {
+            for (end = next + 1; end < count && works[end]->job.ctx == works[next]->job.ctx;
+                    ++end);
+            while (ring->lanes[i].group != NULL)
+                ++i;
+            lane = &ring->lanes[i];
+            StartLane(lane, works + next, end - next);
+            FillLane(lane);
+            if (lane->words == 0) {
+                lane->group = NULL;  /* Nothing to encipher. */
+                continue;
+            }
+            ring->active[ring->active_num++] = lane;
+            reload = TRUE;
+        }
+        if (ring->active_num == 0)
+            break;
+        if (reload) {
+            for (i = 0; i < ring->active_num; ++i)
+                ctxs[i] = ring->active[i]->group[0]->job.ctx;
+            KalynaLanesLoad(ctxs, ring->active_num, &ring->schedule);
+            reload = FALSE;
+        }
+
+        FlushLanes(ring, mode);
+
+        /* Refill the lanes, releasing those whose jobs are all done. */
+        for (i = 0; i < ring->active_num;) {
+            FillLane(ring->active[i]);
+            if (ring->active[i]->words == 0) {
+                ring->active[i]->group = NULL;
+                ring->active[i] = ring->active[--ring->active_num];
+                reload = TRUE;
+            } else {
+                ++i;
+            }
+        }
+    }
+}
+
+size_t KalynaRingProcess(kalyna_ring_t* ring) {
+    size_t i, first, count;
+    ring_work_t* work;
+
+    pthread_mutex_lock(&ring->process_lock);
+    pthread_mutex_lock(&ring->lock);
+    for (count = 0; ring->sq_head != ring->sq_tail; ++count) {
+        work = &ring->work[count];
+        work->job = ring->submissions[ring->sq_head++ % ring->entries];
+        work->sequence = ring->sequence++;
+        work->result = 0;
+        ring->order[count] = work;
+    }
+    pthread_mutex_unlock(&ring->lock);
+
+    qsort(ring->order, count, sizeof(ring_work_t*), CompareWork);
+    for (first = 0; first < count; first = i) {
+        for (i = first + 1; i < count &&
+                ring->order[i]->job.ctx->nb == ring->order[first]->job.ctx->nb &&
+                ring->order[i]->job.ctx->nk == ring->order[first]->job.ctx->nk &&
+                ring->order[i]->job.mode == ring->order[first]->job.mode; ++i);
+        ProcessClass(ring, ring->order + first, i - first);
+    }
+
+    pthread_mutex_lock(&ring->lock);
+    for (i = 0; i < count; ++i) {
+        ring->completions[ring->cq_tail % ring->entries].user_data = ring->work[i].job.user_data;
+        ring->completions[ring->cq_tail++ % ring->entries].result = ring->work[i].result;
+    }
+    if (count > 0)
+        pthread_cond_broadcast(&ring->completed);
+    pthread_mutex_unlock(&ring->lock);
+    pthread_mutex_unlock(&ring->process_lock);
+    return count;
+}
+
+size_t KalynaRingReap(kalyna_ring_t* ring, kalyna_completion_t* completions,
+        size_t max, int wait) {
+    size_t count = 0;
+
+    if (!ring->running)
+        KalynaRingProcess(ring);
+    pthread_mutex_lock(&ring->lock);
+    while (wait && ring->cq_head == ring->cq_tail && ring->in_flight > 0)
+        pthread_cond_wait(&ring->completed, &ring->lock);
+    for (; count < max && ring->cq_head != ring->cq_tail; ++count)
+        completions[count] = ring->completions[ring->cq_head++ % ring->entries];
+    ring->in_flight -= count;
+    pthread_mutex_unlock(&ring->lock);
+    return count;
+}
+
+
+static void* RingWorker(void* arg) {
+    kalyna_ring_t* ring = (kalyna_ring_t*)arg;
+    for (;;) {
+        pthread_mutex_lock(&ring->lock);
+        while (ring->sq_head == ring->sq_tail && !ring->stop)
+            pthread_cond_wait(&ring->submitted, &ring->lock);
+        if (ring->stop) {
+            pthread_mutex_unlock(&ring->lock);
+            return NULL;
+        }
+        pthread_mutex_unlock(&ring->lock);
+        KalynaRingProcess(ring);
+    }
+}
+
+int KalynaRingStart(kalyna_ring_t* ring) {
+    if (ring->running)
+        return 0;
+    if (pthread_create(&ring->worker, NULL, RingWorker, ring) != 0) {
+        fprintf(stderr, "Could not start ring worker thread\n");
+        return -1;
+    }
+    ring->running = TRUE;
+    return 0;
+}
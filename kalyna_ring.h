@@ -0,0 +1,111 @@
+/*
+
+Header file for the batched submission/completion ring of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef KALYNA_RING_H
+#define KALYNA_RING_H
+
+#include "kalyna.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * Operation of a ring job.
+ */
+typedef enum {
+    KALYNA_JOB_ECB_ENCRYPT,  /**< KalynaEncryptBytes(). */
+    KALYNA_JOB_ECB_DECRYPT,  /**< KalynaDecryptBytes(). */
+    KALYNA_JOB_CTR           /**< KalynaCtrBytes(), both directions. */
+} kalyna_job_mode_t;
+
+/*!
+ * Encryption request. The context and buffers must stay valid and the
+ * context must not be used or rekeyed by other threads until the job
+ * completes.
+ */
+typedef struct {
+    kalyna_t* ctx;  /**< Key schedule; jobs sharing it are batched together. */
+    kalyna_job_mode_t mode;
+    const uint8_t* iv;  /**< Block size IV for CTR, ignored by ECB. */
+    const uint8_t* input;
+    size_t length;  /**< Input byte length; a block multiple for ECB. */
+    uint8_t* output;  /**< `length` bytes, may be the same as `input`. */
+    void* user_data;  /**< Returned unchanged in the completion. */
+} kalyna_job_t;
+
+/*!
+ * Result of a finished job.
+ */
+typedef struct {
+    void* user_data;  /**< Copied from the job. */
+    int result;  /**< Zero in case of success, -1 for a malformed job. */
+} kalyna_completion_t;
+
+typedef struct kalyna_ring kalyna_ring_t;
+
+/*!
+ * Create a ring. Jobs are processed either by a worker thread started with
+ * KalynaRingStart() or by any thread calling KalynaRingProcess().
+ *
+ * @param entries Maximum number of submitted and not yet reaped jobs.
+ * @return Ring or NULL in case of error.
+ */
+KALYNA_API kalyna_ring_t* KalynaRingInit(size_t entries);
+
+/*!
+ * Stop the worker thread, if any, and release the ring. Jobs not processed
+ * yet are dropped.
+ *
+ * @return Zero in case of success.
+ */
+KALYNA_API int KalynaRingDelete(kalyna_ring_t* ring);
+
+/*!
+ * Start a worker thread that processes jobs as they are submitted.
+ *
+ * @return Zero in case of success, -1 if the thread could not be started.
+ */
+KALYNA_API int KalynaRingStart(kalyna_ring_t* ring);
+
+/*!
+ * Queue a job, thread safe. The job descriptor is copied.
+ *
+ * @return Zero in case of success, -1 if the ring is full: reap completions
+ * and retry.
+ */
+KALYNA_API int KalynaRingSubmit(kalyna_ring_t* ring, const kalyna_job_t* job);
+
+/*!
+ * Process all queued jobs in the calling thread. Jobs sharing a context and
+ * mode are gathered into common multi-block engine calls, so that many
+ * short messages are enciphered as one long batch.
+ *
+ * @return Number of processed jobs.
+ */
+KALYNA_API size_t KalynaRingProcess(kalyna_ring_t* ring);
+
+/*!
+ * Take completions of finished jobs, thread safe. Completions come in no
+ * particular order. Without a worker thread queued jobs are processed first
+ * by the caller.
+ *
+ * @param completions Output array.
+ * @param max Capacity of `completions`.
+ * @param wait Nonzero to block until at least one job completes, unless
+ * nothing is in flight.
+ * @return Number of completions stored.
+ */
+KALYNA_API size_t KalynaRingReap(kalyna_ring_t* ring, kalyna_completion_t* completions,
+    size_t max, int wait);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* KALYNA_RING_H */
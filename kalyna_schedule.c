@@ -0,0 +1,270 @@
+/*
+
+Serialized key schedules of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <stdint.h>
+
+#include "kalyna_schedule.h"
+#include "kalyna_drbg.h"
+#include "kalyna_kdf.h"
+#include "arena.h"
+#include "transformations.h"
+
+/* "KALYNAKS" read as a word on a little endian host. */
+#define kSCHEDULE_MAGIC 0x534B414E594C414BULL
+
+/* Header flag: round keys are enciphered in counter mode. */
+#define kSCHEDULE_WRAPPED 1
+
+/* Words of a record before the round keys. */
+#define kRECORD_HEADER_WORDS 4
+
+/* Label of the keys derived from the wrapping context. */
+static const uint8_t kSCHEDULE_LABEL[] = "kalyna-schedule";
+
+typedef struct {
+    uint64_t magic;
+    uint64_t version;
+    uint8_t tag[kNB_512 * sizeof(uint64_t)];  /* CMAC of the rest of the image. */
+    uint64_t count;  /* Number of records. */
+    uint64_t body_bytes;  /* Byte length of all records. */
+    uint64_t flags;
+    uint64_t wrap_nb;  /* Variant of the wrapping context in words. */
+    uint64_t wrap_nk;
+    uint64_t reserved;
+    uint8_t iv[kNB_512 * sizeof(uint64_t)];
+} schedule_header_t;
+
+/* Record layout: nb, nk, nr, reserved, encipher and decipher round keys. */
+#define RECORD_WORDS(nb, nr) (kRECORD_HEADER_WORDS + 2 * ((nr) + 1) * (nb))
+
+
+/*!
+ * Number of rounds of a variant given in words.
+ *
+ * @return Rounds or zero if the variant does not exist.
+ */
+static size_t VariantRounds(uint64_t nb, uint64_t nk) {
+    if (nb != kNB_128 && nb != kNB_256 && nb != kNB_512)
+        return 0;
+    if (nk != nb && (nk != 2 * nb || nk > kNK_512))
+        return 0;
+    return nk == kNK_128 ? kNR_128 : nk == kNK_256 ? kNR_256 : kNR_512;
+}
+
+/*!
+ * Check that the records exactly fill the body.
+ *
+ * @return Zero in case of success.
+ */
+static int CheckRecords(const uint64_t* body, size_t words, size_t count) {
+    size_t i, offset = 0, nr;
+    for (i = 0; i < count; ++i) {
+        if (words - offset < kRECORD_HEADER_WORDS)
+            return -1;
+        nr = VariantRounds(body[offset], body[offset + 1]);
+        if (nr == 0 || body[offset + 2] != nr ||
+                words - offset < RECORD_WORDS(body[offset], nr))
+            return -1;
+        offset += RECORD_WORDS(body[offset], nr);
+    }
+    return offset == words ? 0 : -1;
+}
+
+/*!
+ * Validate the header of an image.
+ *
+ * @return Header or NULL if malformed.
+ */
+static const schedule_header_t* Header(const void* image, size_t length) {
+    const schedule_header_t* header = (const schedule_header_t*)image;
+    if (image == NULL || (uintptr_t)image % sizeof(uint64_t) != 0 ||
+            length < sizeof(schedule_header_t) || header->magic != kSCHEDULE_MAGIC ||
+            header->version != KALYNA_SCHEDULE_VERSION ||
+            header->body_bytes > length - sizeof(schedule_header_t) ||
+            header->body_bytes % sizeof(uint64_t) != 0 ||
+            header->count > header->body_bytes / sizeof(uint64_t))
+        return NULL;
+    if ((header->flags & kSCHEDULE_WRAPPED) && VariantRounds(header->wrap_nb,
+            header->wrap_nk) == 0)
+        return NULL;
+    return header;
+}
+
+/*!
+ * Create the contexts that tag and encipher an image. Wrapped images use two
+ * keys derived from `wrap` and the IV, so every image has fresh keys; plain
+ * images are tagged under the all-zero Kalyna-128/128 key, which detects
+ * corruption but authenticates nothing.
+ *
+ * @param keys Output of the MAC context and, if `wrap` is given, the cipher
+ * context, both to be deleted with KalynaDelete().
+ * @return Zero in case of success, -1 if memory is exhausted.
+ */
+static int ImageKeys(kalyna_t* wrap, const uint8_t* iv, kalyna_t** keys) {
+    uint64_t zero[kNK_128];
+
+    if (wrap != NULL)
+        return KalynaKdfDeriveContexts(wrap, kSCHEDULE_LABEL, sizeof(kSCHEDULE_LABEL) - 1,
+            iv, wrap->nb * sizeof(uint64_t), 0, 2, wrap->nb * kBITS_IN_WORD,
+            wrap->nk * kBITS_IN_WORD, keys);
+    keys[0] = KalynaInit(kBLOCK_128, kKEY_128);
+    if (keys[0] == NULL)
+        return -1;
+    memset(zero, 0, sizeof(zero));
+    KalynaKeyExpand(zero, keys[0]);
+    return 0;
+}
+
+static void DeleteImageKeys(kalyna_t** keys, int wrapped) {
+    KalynaDelete(keys[0]);
+    if (wrapped)
+        KalynaDelete(keys[1]);
+}
+
+/*!
+ * Tag of everything after the tag field: the rest of the header, then the
+ * records as stored.
+ */
+static void ImageTag(const schedule_header_t* header, kalyna_t* mac, uint64_t* tag) {
+    const uint8_t* covered = (const uint8_t*)&header->count;
+    size_t length = sizeof(schedule_header_t) - (size_t)(covered - (const uint8_t*)header) +
+        header->body_bytes;
+    Cmac(mac, covered, length, tag);
+}
+
+/*!
+ * Counter mode over the round keys of record `index`; the IV of the image
+ * with the record index added to its first word keeps the key streams of
+ * the records apart.
+ */
+static void CipherRecord(const uint64_t* input, size_t words, const uint8_t* iv,
+        uint64_t index, kalyna_t* cipher, uint64_t* output) {
+    uint64_t block[kNB_512];
+    ReadWords(cipher->nb, iv, block);
+    block[0] += index;
+    KalynaCtrBytes((const uint8_t*)input, words * sizeof(uint64_t),
+        WordsToBytes(cipher->nb, block), cipher, (uint8_t*)output);
+}
+
+
+size_t KalynaScheduleSize(kalyna_t* const* ctxs, size_t count) {
+    size_t i, length = sizeof(schedule_header_t);
+    for (i = 0; i < count; ++i)
+        length += RECORD_WORDS(ctxs[i]->nb, ctxs[i]->nr) * sizeof(uint64_t);
+    return length;
+}
+
+int KalynaScheduleExport(kalyna_t* const* ctxs, size_t count, kalyna_t* wrap,
+        void* image, size_t length) {
+    size_t i, round, keys_words, offset = 0;
+    schedule_header_t* header = (schedule_header_t*)image;
+    uint64_t* body = (uint64_t*)(header + 1);
+    uint64_t tag[kNB_512];
+    kalyna_t* keys[2];
+    const kalyna_t* ctx;
+
+    if ((uintptr_t)image % sizeof(uint64_t) != 0 || length < KalynaScheduleSize(ctxs, count))
+        return -1;
+    memset(header, 0, sizeof(schedule_header_t));
+    if (wrap != NULL) {
+        if (KalynaRandomBytes(header->iv, wrap->nb * sizeof(uint64_t)) != 0)
+            return -1;
+        header->flags = kSCHEDULE_WRAPPED;
+        header->wrap_nb = wrap->nb;
+        header->wrap_nk = wrap->nk;
+    }
+    if (ImageKeys(wrap, header->iv, keys) != 0)
+        return -1;
+    for (i = 0; i < count; ++i) {
+        ctx = ctxs[i];
+        body[offset] = ctx->nb;
+        body[offset + 1] = ctx->nk;
+        body[offset + 2] = ctx->nr;
+        body[offset + 3] = 0;
+        offset += kRECORD_HEADER_WORDS;
+        keys_words = (ctx->nr + 1) * ctx->nb;
+        for (round = 0; round <= ctx->nr; ++round) {
+            memcpy(body + offset + round * ctx->nb, ctx->round_keys[round],
+                ctx->nb * sizeof(uint64_t));
+            memcpy(body + offset + keys_words + round * ctx->nb, ctx->round_keys_dec[round],
+                ctx->nb * sizeof(uint64_t));
+        }
+        if (wrap != NULL)
+            CipherRecord(body + offset, 2 * keys_words, header->iv, i, keys[1], body + offset);
+        offset += 2 * keys_words;
+    }
+    header->magic = kSCHEDULE_MAGIC;
+    header->version = KALYNA_SCHEDULE_VERSION;
+    header->count = count;
+    header->body_bytes = offset * sizeof(uint64_t);
+    ImageTag(header, keys[0], tag);
+    memcpy(header->tag, WordsToBytes(keys[0]->nb, tag), keys[0]->nb * sizeof(uint64_t));
+    DeleteImageKeys(keys, wrap != NULL);
+    return 0;
+}
+
+size_t KalynaScheduleCount(const void* image, size_t length) {
+    const schedule_header_t* header = Header(image, length);
+    return header != NULL ? header->count : 0;
+}
+
+/*!
+ * Create contexts for verified records. Plain round keys are used where they
+ * are; enciphered ones are deciphered straight into the arena slots of new
+ * contexts, so the plain keys never reach the image.
+ *
+ * @return Zero in case of success; no contexts are left on failure.
+ */
+static int AttachRecords(const schedule_header_t* header, kalyna_t* cipher, kalyna_t** ctxs) {
+    size_t i, keys_words, offset = 0;
+    uint64_t* body = (uint64_t*)(header + 1);
+
+    for (i = 0; i < header->count; ++i) {
+        keys_words = 2 * (body[offset + 2] + 1) * body[offset];
+        ctxs[i] = ContextInit(body[offset], body[offset + 1], body[offset + 2],
+            cipher == NULL ? body + offset + kRECORD_HEADER_WORDS : NULL);
+        if (ctxs[i] == NULL) {
+            while (i > 0)
+                KalynaDelete(ctxs[--i]);
+            return -1;
+        }
+        if (cipher != NULL)
+            CipherRecord(body + offset + kRECORD_HEADER_WORDS, keys_words, header->iv, i,
+                cipher, ctxs[i]->round_keys[0]);
+        offset += kRECORD_HEADER_WORDS + keys_words;
+    }
+    return 0;
+}
+
+int KalynaScheduleImport(void* image, size_t length, kalyna_t* wrap, kalyna_t** ctxs) {
+    size_t i;
+    int wrapped, result = -1;
+    const schedule_header_t* header = Header(image, length);
+    uint64_t tag[kNB_512];
+    uint8_t diff = 0;
+    kalyna_t* keys[2];
+
+    if (header == NULL)
+        return -1;
+    wrapped = (header->flags & kSCHEDULE_WRAPPED) != 0;
+    /* A caller with a wrapping key expects an authenticated image. */
+    if (wrapped != (wrap != NULL) || (wrapped && (wrap->nb != header->wrap_nb ||
+            wrap->nk != header->wrap_nk)))
+        return -1;
+    if (ImageKeys(wrap, header->iv, keys) != 0)
+        return -1;
+    ImageTag(header, keys[0], tag);
+    WordsToBytes(keys[0]->nb, tag);
+    for (i = 0; i < keys[0]->nb * sizeof(uint64_t); ++i)
+        diff |= ((uint8_t*)tag)[i] ^ header->tag[i];
+    if (diff == 0 && CheckRecords((const uint64_t*)(header + 1),
+            header->body_bytes / sizeof(uint64_t), header->count) == 0)
+        result = AttachRecords(header, wrapped ? keys[1] : NULL, ctxs);
+    DeleteImageKeys(keys, wrapped);
+    return result;
+}
@@ -0,0 +1,100 @@
+/*
+
+Header file for the serialized key schedules of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef KALYNA_SCHEDULE_H
+#define KALYNA_SCHEDULE_H
+
+#include "kalyna.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Version of the schedule image format written by KalynaScheduleExport(). */
+#define KALYNA_SCHEDULE_VERSION 2
+
+/*!
+ * A schedule image holds expanded round keys of many contexts, so that a
+ * process can restore them at start without running the key expansion.
+ *
+ * The image is a header followed by one record per context: the variant and
+ * the encipher and decipher round keys as 64-bit words in host byte order.
+ * Images are only portable between hosts of the same byte order.
+ *
+ * Round keys may be enciphered in counter mode under a wrapping context.
+ * Such an image is tagged with CMAC, and both the counter mode and the CMAC
+ * key are derived from the wrapping context and the random IV stored in the
+ * header with KalynaKdfDerive(). Any modification of the image fails the
+ * import. A plain image is tagged with CMAC under a fixed public key: this
+ * detects corruption and truncation but not deliberate modification, which
+ * must be prevented by file permissions.
+ */
+
+/*!
+ * Compute the byte length of the image of contexts.
+ *
+ * @param ctxs Contexts with expanded keys.
+ * @param count Number of contexts.
+ * @return Image byte length.
+ */
+KALYNA_API size_t KalynaScheduleSize(kalyna_t* const* ctxs, size_t count);
+
+/*!
+ * Write the round keys of contexts into an image.
+ *
+ * @param ctxs Contexts with expanded keys.
+ * @param count Number of contexts.
+ * @param wrap Context to encipher the records with or NULL to store them in
+ * plain.
+ * @param image Output of KalynaScheduleSize() bytes, aligned to 8 bytes.
+ * @param length Byte length of `image`.
+ * @return Zero in case of success, -1 if `image` is too short or misaligned
+ * or no IV could be generated.
+ */
+KALYNA_API int KalynaScheduleExport(kalyna_t* const* ctxs, size_t count, kalyna_t* wrap,
+    void* image, size_t length);
+
+/*!
+ * Read the number of contexts of an image, e.g. to size the array passed to
+ * KalynaScheduleImport().
+ *
+ * @return Number of contexts, zero if the header is malformed.
+ */
+KALYNA_API size_t KalynaScheduleCount(const void* image, size_t length);
+
+/*!
+ * Verify an image and create contexts from it without running the key
+ * expansion. The image is only read.
+ *
+ * Contexts of a plain image point their round keys into the image, which
+ * stays owned by the caller. It is typically a file mapped with mmap() and
+ * must stay mapped until all the contexts are deleted with KalynaDelete(),
+ * which does not touch it. The library does not lock these round keys in
+ * memory, exclude them from core dumps or wipe them.
+ *
+ * Round keys of a wrapped image are deciphered into the memory of new
+ * contexts, locked and wiped like that of contexts from KalynaInit(). The
+ * plain keys never reach the image, which may be unmapped after the import.
+ *
+ * @param image Image, aligned to 8 bytes.
+ * @param length Byte length of `image`.
+ * @param wrap Context the round keys were enciphered with, of the same
+ * variant; NULL for plain images. A plain image is rejected if `wrap` is
+ * given, so that it cannot stand in for a wrapped one.
+ * @param ctxs Output of KalynaScheduleCount() contexts in export order.
+ * @return Zero in case of success, -1 if the image is malformed, the tag
+ * does not match or memory is exhausted; no contexts are created then.
+ */
+KALYNA_API int KalynaScheduleImport(void* image, size_t length, kalyna_t* wrap,
+    kalyna_t** ctxs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* KALYNA_SCHEDULE_H */
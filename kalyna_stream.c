@@ -0,0 +1,162 @@
+/*
+
+Counter mode streams with rolling rekey of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <pthread.h>
+
+#include "kalyna_stream.h"
+#include "transformations.h"
+#include "arena.h"
+
+/* Keystream bytes produced by one engine call. */
+#define kSTREAM_CHUNK 1024
+
+struct kalyna_stream {
+    kalyna_t* ctx;  /* Key of the current epoch. */
+    kalyna_t* next;  /* Key of the next epoch, NULL until supplied. */
+    pthread_t expander;  /* Thread expanding `next_key` into `next`. */
+    int expanding;  /* Nonzero until `expander` is joined. */
+    uint64_t next_key[kNK_512];
+    uint64_t counter[kNB_512];
+    uint64_t blocks;  /* Keystream blocks generated. */
+    uint64_t rekey_blocks;
+    uint64_t rekey_block;
+    uint64_t epoch;
+    size_t unused;  /* Bytes of the last block not used yet. */
+    uint8_t tail[kNB_512 * sizeof(uint64_t)];  /* Last keystream block. */
+};
+
+
+static void* ExpandNextKey(void* arg) {
+    kalyna_stream_t* stream = (kalyna_stream_t*)arg;
+    KalynaKeyExpand(stream->next_key, stream->next);
+    SecureWipe(stream->next_key, sizeof(stream->next_key));
+    return NULL;
+}
+
+/* Wait for the background key expansion, if any. */
+static void JoinExpander(kalyna_stream_t* stream) {
+    if (stream->expanding) {
+        pthread_join(stream->expander, NULL);
+        stream->expanding = FALSE;
+    }
+}
+
+/* Replace the key at a boundary. */
+static void SwitchKey(kalyna_stream_t* stream) {
+    JoinExpander(stream);
+    KalynaDelete(stream->ctx);
+    stream->ctx = stream->next;
+    stream->next = NULL;
+    stream->rekey_block += stream->rekey_blocks;
+    ++stream->epoch;
+}
+
+
+kalyna_stream_t* KalynaStreamInit(size_t block_size, size_t key_size,
+        uint64_t* key, const uint8_t* iv, uint64_t rekey_blocks) {
+    kalyna_stream_t* stream;
+    kalyna_t* ctx = KalynaInit(block_size, key_size);
+
+    if (ctx == NULL)
+        return NULL;
+    stream = (kalyna_stream_t*)calloc(1, sizeof(kalyna_stream_t));
+    if (stream == NULL) {
+        perror("Could not allocate memory for stream");
+        KalynaDelete(ctx);
+        return NULL;
+    }
+    KalynaKeyExpand(key, ctx);
+    stream->ctx = ctx;
+    ReadWords(ctx->nb, iv, stream->counter);
+    KalynaEncipherBlocks(stream->counter, 1, ctx, stream->counter);
+    stream->rekey_blocks = rekey_blocks;
+    stream->rekey_block = rekey_blocks;
+    return stream;
+}
+
+int KalynaStreamDelete(kalyna_stream_t* stream) {
+    JoinExpander(stream);
+    if (stream->next != NULL)
+        KalynaDelete(stream->next);
+    KalynaDelete(stream->ctx);
+    SecureWipe(stream, sizeof(kalyna_stream_t));
+    free(stream);
+    return 0;
+}
+
+int KalynaStreamNextKey(kalyna_stream_t* stream, uint64_t* key) {
+    if (stream->rekey_blocks == 0 || stream->next != NULL)
+        return -1;
+    stream->next = KalynaInit(stream->ctx->nb * kBITS_IN_WORD,
+        stream->ctx->nk * kBITS_IN_WORD);
+    if (stream->next == NULL)
+        return -1;
+    memcpy(stream->next_key, key, stream->ctx->nk * sizeof(uint64_t));
+    if (pthread_create(&stream->expander, NULL, ExpandNextKey, stream) == 0)
+        stream->expanding = TRUE;
+    else
+        ExpandNextKey(stream);
+    return 0;
+}
+
+int KalynaStreamCrypt(kalyna_stream_t* stream, const uint8_t* input,
+        size_t length, uint8_t* output) {
+    size_t i, chunk, blocks, bytes;
+    size_t block_len = stream->ctx->nb * sizeof(uint64_t);
+    uint64_t needed, last;
+    uint64_t gamma[kSTREAM_CHUNK / sizeof(uint64_t)];
+
+    /* Refuse up front to cross a boundary without a key for it. */
+    needed = length > stream->unused ?
+        (length - stream->unused + block_len - 1) / block_len : 0;
+    last = stream->blocks + needed;
+    if (stream->rekey_blocks != 0 && needed > 0 && last > stream->rekey_block &&
+            (stream->next == NULL || last > stream->rekey_block + stream->rekey_blocks))
+        return -1;
+
+    while (length > 0) {
+        if (stream->unused > 0) {
+            chunk = length < stream->unused ? length : stream->unused;
+            for (i = 0; i < chunk; ++i)
+                output[i] = input[i] ^ stream->tail[block_len - stream->unused + i];
+            stream->unused -= chunk;
+        } else {
+            if (stream->rekey_blocks != 0 && stream->blocks == stream->rekey_block)
+                SwitchKey(stream);
+            blocks = (length + block_len - 1) / block_len;
+            if (blocks > kSTREAM_CHUNK / block_len)
+                blocks = kSTREAM_CHUNK / block_len;
+            if (stream->rekey_blocks != 0 && blocks > stream->rekey_block - stream->blocks)
+                blocks = stream->rekey_block - stream->blocks;
+            CtrCounters(stream->counter, blocks, stream->ctx->nb, gamma);
+            KalynaEncipherBlocks(gamma, blocks, stream->ctx, gamma);
+            stream->blocks += blocks;
+            bytes = blocks * block_len;
+            chunk = length < bytes ? length : bytes;
+            XorGamma(chunk, input, gamma, output);
+            if (chunk < bytes) {
+                /* Keep the rest of the last block for the next call. */
+                WriteWords(stream->ctx->nb, gamma + (blocks - 1) * stream->ctx->nb,
+                    stream->tail);
+                stream->unused = bytes - chunk;
+            }
+        }
+        input += chunk;
+        output += chunk;
+        length -= chunk;
+    }
+    return 0;
+}
+
+void KalynaStreamPosition(const kalyna_stream_t* stream,
+        kalyna_stream_position_t* position) {
+    position->block = stream->unused > 0 ? stream->blocks - 1 : stream->blocks;
+    position->rekey_block = stream->rekey_blocks != 0 ? stream->rekey_block : 0;
+    position->epoch = stream->epoch;
+    position->next_key_ready = stream->next != NULL;
+}
@@ -0,0 +1,96 @@
+/*
+
+Header file for the counter mode streams with rolling rekey of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef KALYNA_STREAM_H
+#define KALYNA_STREAM_H
+
+#include "kalyna.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * Long running CTR stream whose key is replaced every `rekey_blocks`
+ * keystream blocks. The counter continues across key changes: block `i` of
+ * the keystream is the encipherment of the counter value `i` + 1 under the
+ * key of its epoch, counting from the enciphered IV as KalynaCtrBytes()
+ * does. Without key changes the output equals KalynaCtrBytes().
+ *
+ * The next key is expanded by a background thread as soon as it is given,
+ * so the switch at the boundary only swaps schedules. A receiver creates a
+ * stream with the same initial key, IV and interval and supplies the same
+ * keys in the same order to follow the sender.
+ *
+ * A stream is used by one thread at a time.
+ */
+typedef struct kalyna_stream kalyna_stream_t;
+
+/*!
+ * Position of a stream, for a receiver to follow key changes.
+ */
+typedef struct {
+    uint64_t block;  /**< Keystream block the next byte is taken from. */
+    uint64_t rekey_block;  /**< First block under the next key, 0 if never. */
+    uint64_t epoch;  /**< Key changes so far. */
+    int next_key_ready;  /**< Nonzero if the next key has been supplied. */
+} kalyna_stream_position_t;
+
+/*!
+ * Create a stream.
+ *
+ * @param block_size Block bit size.
+ * @param key_size Key bit size.
+ * @param key Initial key of `key_size` bits.
+ * @param iv Block size IV.
+ * @param rekey_blocks Keystream blocks per key, 0 to keep the initial key.
+ * @return Stream or NULL in case of error.
+ */
+KALYNA_API kalyna_stream_t* KalynaStreamInit(size_t block_size, size_t key_size,
+    uint64_t* key, const uint8_t* iv, uint64_t rekey_blocks);
+
+/*!
+ * Wait for a pending key expansion, wipe and release the stream.
+ *
+ * @return Zero in case of success.
+ */
+KALYNA_API int KalynaStreamDelete(kalyna_stream_t* stream);
+
+/*!
+ * Supply the key taking effect at the next boundary and start expanding it
+ * in the background. Supply it well before the boundary: a stream reaching
+ * the boundary waits for the expansion to finish.
+ *
+ * @param key Next key of the stream key size.
+ * @return Zero in case of success, -1 if a next key is already pending or
+ * the stream never changes keys.
+ */
+KALYNA_API int KalynaStreamNextKey(kalyna_stream_t* stream, uint64_t* key);
+
+/*!
+ * Encrypt or decrypt the next bytes of the stream. Calls may have any
+ * length; the keys change at the boundaries inside.
+ *
+ * @param output `length` bytes, may be the same as `input`.
+ * @return Zero in case of success, -1 if the bytes reach past a boundary
+ * with no key supplied for it; nothing is processed then.
+ */
+KALYNA_API int KalynaStreamCrypt(kalyna_stream_t* stream, const uint8_t* input,
+    size_t length, uint8_t* output);
+
+/*!
+ * Read the position of a stream.
+ */
+KALYNA_API void KalynaStreamPosition(const kalyna_stream_t* stream,
+    kalyna_stream_position_t* position);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* KALYNA_STREAM_H */
@@ -0,0 +1,343 @@
+/*
+
+Parallel tree message authentication code based on the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <pthread.h>
+
+#include "kalyna_tree_mac.h"
+#include "engine.h"
+#include "arena.h"
+
+/* Domains of prefix blocks, in the low byte of their first word. */
+#define kPREFIX_LEAF 0
+#define kPREFIX_NODE 1
+#define kPREFIX_ROOT 2
+
+/* Levels of a tree over at most 2^64 chunks. */
+#define kMAX_LEVELS 65
+
+struct kalyna_tree_mac {
+    kalyna_t* ctx;
+    size_t nb;
+    size_t chunk_bytes;
+    uint64_t length;
+    size_t levels;
+    size_t level_start[kMAX_LEVELS];  /* First node of each level, leaves first. */
+    size_t level_count[kMAX_LEVELS];
+    uint64_t* tags;  /* Nb words per node. */
+    uint8_t* dirty;  /* Per node: recompute in the next KalynaTreeMacFinal(). */
+    uint8_t* present;  /* Per leaf: chunk was set. */
+    uint64_t k1[kNB_512];  /* CMAC subkey of a complete last block. */
+    uint64_t k2[kNB_512];  /* CMAC subkey of a padded last block. */
+    kalyna_lanes_t schedule;  /* The key in every lane. */
+};
+
+/* Chunks of a worker of KalynaTreeMac(). */
+typedef struct {
+    kalyna_tree_mac_t* tree;
+    uint64_t first;
+    const uint8_t* data;
+    size_t length;
+} tree_mac_job_t;
+
+
+static void Prefix(size_t nb, uint64_t domain, uint64_t parameter, uint64_t value,
+        uint64_t* block) {
+    memset(block, 0, nb * sizeof(uint64_t));
+    block[0] = domain | (parameter << 8);
+    block[1] = value;
+}
+
+static void XorBlock(size_t nb, const uint64_t* input, uint64_t* output) {
+    size_t i;
+    for (i = 0; i < nb; ++i)
+        output[i] ^= input[i];
+}
+
+/*!
+ * CMAC of a prefix block followed by whole blocks of words.
+ */
+static void MacWords(const kalyna_tree_mac_t* tree, const uint64_t* prefix,
+        const uint64_t* words, size_t blocks, uint64_t* tag) {
+    size_t i;
+    memcpy(tag, prefix, tree->nb * sizeof(uint64_t));
+    for (i = 0; i < blocks; ++i) {
+        KalynaEncipherBlocks(tag, 1, tree->ctx, tag);
+        XorBlock(tree->nb, words + i * tree->nb, tag);
+    }
+    XorBlock(tree->nb, tree->k1, tag);
+    KalynaEncipherBlocks(tag, 1, tree->ctx, tag);
+}
+
+/*!
+ * CMAC of up to kLANES leaves of equal length, chained in lockstep through
+ * the multi-buffer routine.
+ *
+ * @param first Index of the first leaf.
+ * @param count Number of leaves.
+ * @param data Bytes of the leaves, consecutive.
+ * @param length Byte length of every leaf.
+ */
+static void MacLeaves(kalyna_tree_mac_t* tree, uint64_t first, size_t count,
+        const uint8_t* data, size_t length) {
+    size_t lane, j, tail;
+    size_t block_len = tree->nb * sizeof(uint64_t);
+    size_t blocks = (length + block_len - 1) / block_len;
+    uint64_t chain[kLANES][kNB_512], block[kNB_512];
+    uint8_t padded[kNB_512 * sizeof(uint64_t)];
+    const uint64_t* input[kLANES];
+    uint64_t* output[kLANES];
+    size_t lane_blocks[kLANES];
+
+    for (lane = 0; lane < kLANES; ++lane) {
+        input[lane] = chain[lane];
+        output[lane] = chain[lane];
+        lane_blocks[lane] = lane < count ? 1 : 0;
+    }
+    for (lane = 0; lane < count; ++lane) {
+        Prefix(tree->nb, kPREFIX_LEAF, 0, first + lane, chain[lane]);
+        if (blocks == 0)
+            XorBlock(tree->nb, tree->k1, chain[lane]);
+    }
+    KalynaEncipherLanes(&tree->schedule, input, lane_blocks, output);
+
+    for (j = 0; j < blocks; ++j) {
+        tail = length - j * block_len;
+        for (lane = 0; lane < count; ++lane) {
+            if (tail >= block_len) {
+                ReadWords(tree->nb, data + lane * length + j * block_len, block);
+            } else {
+                memset(padded, 0, block_len);
+                memcpy(padded, data + lane * length + j * block_len, tail);
+                padded[tail] = 0x80;
+                ReadWords(tree->nb, padded, block);
+            }
+            XorBlock(tree->nb, block, chain[lane]);
+            if (j + 1 == blocks)
+                XorBlock(tree->nb, tail >= block_len ? tree->k1 : tree->k2, chain[lane]);
+        }
+        KalynaEncipherLanes(&tree->schedule, input, lane_blocks, output);
+    }
+    for (lane = 0; lane < count; ++lane) {
+        memcpy(tree->tags + (first + lane) * tree->nb, chain[lane],
+            tree->nb * sizeof(uint64_t));
+        tree->dirty[first + lane] = TRUE;
+        tree->present[first + lane] = TRUE;
+    }
+}
+
+
+void Cmac(kalyna_t* ctx, const uint8_t* data, size_t length, uint64_t* tag) {
+    size_t j, tail;
+    size_t block_len = ctx->nb * sizeof(uint64_t);
+    size_t blocks = length == 0 ? 1 : (length + block_len - 1) / block_len;
+    uint64_t k1[kNB_512], k2[kNB_512], block[kNB_512];
+    uint8_t padded[kNB_512 * sizeof(uint64_t)];
+
+    memset(k1, 0, sizeof(k1));
+    KalynaEncipherBlocks(k1, 1, ctx, k1);
+    DoubleBlock(ctx->nb, k1, k1);
+    DoubleBlock(ctx->nb, k1, k2);
+    memset(tag, 0, block_len);
+    for (j = 0; j < blocks; ++j) {
+        tail = length - j * block_len;
+        if (tail >= block_len) {
+            ReadWords(ctx->nb, data + j * block_len, block);
+        } else {
+            memset(padded, 0, block_len);
+            memcpy(padded, data + j * block_len, tail);
+            padded[tail] = 0x80;
+            ReadWords(ctx->nb, padded, block);
+        }
+        XorBlock(ctx->nb, block, tag);
+        if (j + 1 == blocks)
+            XorBlock(ctx->nb, tail >= block_len ? k1 : k2, tag);
+        KalynaEncipherBlocks(tag, 1, ctx, tag);
+    }
+    SecureWipe(k1, sizeof(k1));
+    SecureWipe(k2, sizeof(k2));
+}
+
+
+kalyna_tree_mac_t* KalynaTreeMacInit(kalyna_t* ctx, size_t chunk_bytes, uint64_t length) {
+    size_t level, nodes, lane;
+    size_t block_len = ctx->nb * sizeof(uint64_t);
+    uint64_t chunks;
+    kalyna_t* lane_ctxs[kLANES];
+    kalyna_tree_mac_t* tree;
+
+    if (chunk_bytes == 0 || chunk_bytes % block_len != 0)
+        return NULL;
+    chunks = length == 0 ? 1 : (length - 1) / chunk_bytes + 1;
+    if (chunks > SIZE_MAX / 2 / block_len)
+        return NULL;
+    tree = (kalyna_tree_mac_t*)calloc(1, sizeof(kalyna_tree_mac_t));
+    if (tree == NULL) {
+        perror("Could not allocate memory for tree MAC");
+        return NULL;
+    }
+    tree->ctx = ctx;
+    tree->nb = ctx->nb;
+    tree->chunk_bytes = chunk_bytes;
+    tree->length = length;
+
+    nodes = 0;
+    tree->level_count[0] = (size_t)chunks;
+    for (level = 0; ; ++level) {
+        tree->level_start[level] = nodes;
+        nodes += tree->level_count[level];
+        if (tree->level_count[level] == 1)
+            break;
+        tree->level_count[level + 1] = (tree->level_count[level] + 1) / 2;
+    }
+    tree->levels = level + 1;
+    tree->tags = (uint64_t*)malloc(nodes * block_len);
+    tree->dirty = (uint8_t*)calloc(nodes, 1);
+    tree->present = (uint8_t*)calloc(tree->level_count[0], 1);
+    if (tree->tags == NULL || tree->dirty == NULL || tree->present == NULL) {
+        perror("Could not allocate memory for tree MAC");
+        KalynaTreeMacDelete(tree);
+        return NULL;
+    }
+
+    for (lane = 0; lane < kLANES; ++lane)
+        lane_ctxs[lane] = ctx;
+    KalynaLanesLoad(lane_ctxs, kLANES, &tree->schedule);
+    memset(tree->k1, 0, sizeof(tree->k1));
+    KalynaEncipherBlocks(tree->k1, 1, ctx, tree->k1);
+    DoubleBlock(tree->nb, tree->k1, tree->k1);
+    DoubleBlock(tree->nb, tree->k1, tree->k2);
+    return tree;
+}
+
+int KalynaTreeMacDelete(kalyna_tree_mac_t* tree) {
+    free(tree->tags);
+    free(tree->dirty);
+    free(tree->present);
+    SecureWipe(tree, sizeof(kalyna_tree_mac_t));
+    free(tree);
+    return 0;
+}
+
+int KalynaTreeMacUpdate(kalyna_tree_mac_t* tree, uint64_t first,
+        const uint8_t* data, size_t length) {
+    size_t count, tail;
+    uint64_t chunks = tree->level_count[0];
+    uint64_t offset;
+
+    if (first >= chunks)
+        return -1;
+    offset = first * tree->chunk_bytes;
+    if (length > tree->length - offset || (length % tree->chunk_bytes != 0 &&
+            length != tree->length - offset))
+        return -1;
+
+    /* Full chunks in groups of kLANES, then the short last one. */
+    while (length >= tree->chunk_bytes) {
+        count = length / tree->chunk_bytes;
+        count = count < kLANES ? count : kLANES;
+        MacLeaves(tree, first, count, data, tree->chunk_bytes);
+        first += count;
+        data += count * tree->chunk_bytes;
+        length -= count * tree->chunk_bytes;
+    }
+    tail = (size_t)(tree->length - first * tree->chunk_bytes);
+    if (first < chunks && length == tail)
+        MacLeaves(tree, first, 1, data, length);
+    return 0;
+}
+
+int KalynaTreeMacFinal(kalyna_tree_mac_t* tree, uint8_t* tag) {
+    size_t level, i, node, child;
+    uint64_t prefix[kNB_512], root[kNB_512];
+    size_t nb = tree->nb;
+
+    for (i = 0; i < tree->level_count[0]; ++i) {
+        if (!tree->present[i])
+            return -1;
+    }
+    for (level = 1; level < tree->levels; ++level) {
+        for (i = 0; i < tree->level_count[level]; ++i) {
+            node = tree->level_start[level] + i;
+            child = tree->level_start[level - 1] + 2 * i;
+            if (!tree->dirty[child] && (2 * i + 1 >= tree->level_count[level - 1] ||
+                    !tree->dirty[child + 1]))
+                continue;
+            if (2 * i + 1 < tree->level_count[level - 1]) {
+                Prefix(nb, kPREFIX_NODE, level, i, prefix);
+                MacWords(tree, prefix, tree->tags + child * nb, 2, tree->tags + node * nb);
+            } else {
+                memcpy(tree->tags + node * nb, tree->tags + child * nb, nb * sizeof(uint64_t));
+            }
+            tree->dirty[node] = TRUE;
+        }
+        memset(tree->dirty + tree->level_start[level - 1], 0, tree->level_count[level - 1]);
+    }
+    memset(tree->dirty + tree->level_start[tree->levels - 1], 0, 1);
+
+    Prefix(nb, kPREFIX_ROOT, tree->chunk_bytes, tree->length, prefix);
+    MacWords(tree, prefix, tree->tags + tree->level_start[tree->levels - 1] * nb, 1, root);
+    WriteWords(nb, root, tag);
+    return 0;
+}
+
+
+static void* TreeMacWorker(void* arg) {
+    tree_mac_job_t* job = (tree_mac_job_t*)arg;
+    KalynaTreeMacUpdate(job->tree, job->first, job->data, job->length);
+    return NULL;
+}
+
+int KalynaTreeMac(kalyna_t* ctx, const uint8_t* data, uint64_t length,
+        size_t chunk_bytes, size_t threads, uint8_t* tag) {
+    size_t t, started = 0;
+    uint64_t chunks, begin, end;
+    int result;
+    pthread_t* workers;
+    tree_mac_job_t* jobs;
+    kalyna_tree_mac_t* tree = KalynaTreeMacInit(ctx, chunk_bytes, length);
+
+    if (tree == NULL)
+        return -1;
+    chunks = tree->level_count[0];
+    threads = threads < 1 ? 1 : threads > chunks ? (size_t)chunks : threads;
+    workers = (pthread_t*)malloc(threads * sizeof(pthread_t));
+    jobs = (tree_mac_job_t*)malloc(threads * sizeof(tree_mac_job_t));
+    if (workers == NULL || jobs == NULL) {
+        free(workers);
+        free(jobs);
+        KalynaTreeMacDelete(tree);
+        return -1;
+    }
+
+    /* Contiguous ranges of chunks; the calling thread takes the first one. */
+    for (t = 0; t < threads; ++t) {
+        begin = chunks * t / threads;
+        end = chunks * (t + 1) / threads;
+        jobs[t].tree = tree;
+        jobs[t].first = begin;
+        jobs[t].data = data + begin * chunk_bytes;
+        jobs[t].length = (size_t)((end * chunk_bytes < length ? end * chunk_bytes : length) -
+            begin * chunk_bytes);
+    }
+    for (t = 1; t < threads; ++t) {
+        if (pthread_create(&workers[t], NULL, TreeMacWorker, &jobs[t]) != 0)
+            break;
+        ++started;
+    }
+    TreeMacWorker(&jobs[0]);
+    for (t = started + 1; t < threads; ++t)
+        TreeMacWorker(&jobs[t]);
+    for (t = 1; t <= started; ++t)
+        pthread_join(workers[t], NULL);
+
+    result = KalynaTreeMacFinal(tree, tag);
+    free(workers);
+    free(jobs);
+    KalynaTreeMacDelete(tree);
+    return result;
+}
@@ -0,0 +1,96 @@
+/*
+
+Header file for the parallel tree message authentication code based on the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef KALYNA_TREE_MAC_H
+#define KALYNA_TREE_MAC_H
+
+#include "kalyna.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * Tree MAC: an extension of this library, not a mode of DSTU 7624:2014 and
+ * not interoperable with other implementations.
+ *
+ * The object is split into chunks of a fixed size; the last one may be
+ * shorter, an empty object has one empty chunk. Every chunk gets a CMAC
+ * (NIST SP 800-38B over Kalyna, blocks read as little endian words, subkey
+ * polynomials x^128 + x^7 + x^2 + x + 1, x^256 + x^10 + x^5 + x^2 + 1 and
+ * x^512 + x^8 + x^5 + x^2 + 1) of a prefix block with the chunk index
+ * followed by the chunk. Pairs of tags are combined level by level with
+ * CMAC of a prefix with level and position followed by both tags; an
+ * unpaired tag moves up unchanged. The tag is the CMAC of a prefix with the
+ * chunk size and object length followed by the root.
+ *
+ * Chunks are independent, so they are processed in parallel, and replacing
+ * a chunk only recomputes the nodes on its path to the root.
+ */
+typedef struct kalyna_tree_mac kalyna_tree_mac_t;
+
+/*!
+ * Create a tree for an object of a given length.
+ *
+ * @param ctx Context with the MAC key; used without being modified and must
+ * stay valid until the tree is deleted.
+ * @param chunk_bytes Chunk size, a positive multiple of the block size.
+ * @param length Object byte length.
+ * @return Tree or NULL in case of error.
+ */
+KALYNA_API kalyna_tree_mac_t* KalynaTreeMacInit(kalyna_t* ctx, size_t chunk_bytes,
+    uint64_t length);
+
+/*!
+ * Release a tree.
+ *
+ * @return Zero in case of success.
+ */
+KALYNA_API int KalynaTreeMacDelete(kalyna_tree_mac_t* tree);
+
+/*!
+ * Set or replace consecutive chunks. Threads may update distinct chunks of
+ * the same tree concurrently.
+ *
+ * @param first Index of the first chunk.
+ * @param data Chunk bytes.
+ * @param length A multiple of the chunk size, or reaching exactly the end of
+ * the object.
+ * @return Zero in case of success, -1 if the range does not fit the object.
+ */
+KALYNA_API int KalynaTreeMacUpdate(kalyna_tree_mac_t* tree, uint64_t first,
+    const uint8_t* data, size_t length);
+
+/*!
+ * Recompute the nodes above changed chunks and output the tag. The tree
+ * keeps its state, so chunks can be replaced and the tag computed again.
+ *
+ * @param tag Output of the block size.
+ * @return Zero in case of success, -1 if some chunk was never set.
+ */
+KALYNA_API int KalynaTreeMacFinal(kalyna_tree_mac_t* tree, uint8_t* tag);
+
+/*!
+ * Compute the tag of an object in memory with several threads.
+ *
+ * @param ctx Context with the MAC key.
+ * @param data Object bytes.
+ * @param length Object byte length.
+ * @param chunk_bytes Chunk size, a positive multiple of the block size.
+ * @param threads Number of threads, including the calling one.
+ * @param tag Output of the block size.
+ * @return Zero in case of success, -1 in case of error.
+ */
+KALYNA_API int KalynaTreeMac(kalyna_t* ctx, const uint8_t* data, uint64_t length,
+    size_t chunk_bytes, size_t threads, uint8_t* tag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* KALYNA_TREE_MAC_H */
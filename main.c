@@ -1,326 +1,386 @@
-/*
-
-main.c, printing test vectors of reference implementation of the Kalyna block cipher (DSTU 7624:2014), all block and key length variants
-
-Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
-
-*/
-
-#include <stdio.h>
-#include <memory.h>
-
-#include "kalyna.h"
-#include "transformations.h"
-
-void print (int data_size, uint64_t data []);
-
-int main(int argc, char** argv) {
-   
-	int i;
-	kalyna_t* ctx22_e = KalynaInit(128, 128);
-	kalyna_t* ctx24_e = KalynaInit(128, 256);
-	kalyna_t* ctx44_e = KalynaInit(256, 256);
-	kalyna_t* ctx48_e = KalynaInit(256, 512);
-	kalyna_t* ctx88_e = KalynaInit(512, 512);
-
-    uint64_t pt22_e[2] = {0x1716151413121110ULL, 0x1f1e1d1c1b1a1918ULL};
-	uint64_t ct22_e[2];
-    uint64_t key22_e[2] = {0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL};
-    uint64_t expect22_e[2] = {0x20ac9b777d1cbf81ULL, 0x06add2b439eac9e1ULL};
-
-    uint64_t pt24_e[2] = {0x2726252423222120ULL, 0x2f2e2d2c2b2a2928ULL};
-	uint64_t ct24_e[2];
-    uint64_t key24_e[4] = {0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL, 0x1716151413121110ULL, 0x1f1e1d1c1b1a1918ULL};
-    uint64_t expect24_e[2] = { 0x8a150010093eec58ULL, 0x144f336f16f74811ULL};
-
-    uint64_t pt44_e[4] = {0x2726252423222120ULL, 0x2f2e2d2c2b2a2928ULL, 0x3736353433323130ULL, 0x3f3e3d3c3b3a3938ULL};
-	uint64_t ct44_e[4];
-    uint64_t key44_e[4] = {0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL, 0x1716151413121110ULL, 0x1f1e1d1c1b1a1918ULL};
-    uint64_t expect44_e[4] = {0x3521c90e573d6ef6ULL, 0x8c2abddc23e3daaeULL, 0x5a0d6a20ec6339a0ULL, 0x2cd97f61245c3888ULL};
-
-    uint64_t pt48_e[4] = {0x4746454443424140ULL, 0x4f4e4d4c4b4a4948ULL, 0x5756555453525150ULL, 0x5f5e5d5c5b5a5958ULL};
-	uint64_t ct48_e[4];
-    uint64_t key48_e[8] = {0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL, 0x1716151413121110ULL, 0x1f1e1d1c1b1a1918ULL,
-							0x2726252423222120ULL, 0x2f2e2d2c2b2a2928ULL, 0x3736353433323130ULL, 0x3f3e3d3c3b3a3938ULL};
-    uint64_t expect48_e[4] = {0x7ab6b7e6e9906960ULL, 0xb76822d793d8d64bULL, 0x02e1d73c3cc8028eULL, 0xd95dfefda8742efdULL};
-
-
-    uint64_t pt88_e[8] = {  0x4746454443424140ULL, 0x4f4e4d4c4b4a4948ULL, 0x5756555453525150ULL, 0x5f5e5d5c5b5a5958ULL,
-									0x6766656463626160ULL, 0x6f6e6d6c6b6a6968ULL, 0x7776757473727170ULL, 0x7f7e7d7c7b7a7978ULL};
-	uint64_t ct88_e[8];
-    uint64_t key88_e[8] = {		0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL, 0x1716151413121110ULL, 0x1f1e1d1c1b1a1918ULL,
-									0x2726252423222120ULL, 0x2f2e2d2c2b2a2928ULL, 0x3736353433323130ULL, 0x3f3e3d3c3b3a3938ULL};
-    uint64_t expect88_e[8] = {     0x6a351c811be3264aULL, 0x1a239605cad61da6ULL, 0xa1f347aa5483ba67ULL, 0xb856eb20c3ee1d3eULL,
-									0x66ab5b1717f4d095ULL, 0x6cc815bb34f1d62fULL, 0xb7fe6e85266a90cbULL, 0xd9d90d947264bcc5ULL};
-
-	uint64_t ct22_d[2] = {0x18191a1b1c1d1e1fULL, 0x1011121314151617ULL};
-	uint64_t pt22_d[2];
-    uint64_t key22_d[2] = {0x08090a0b0c0d0e0fULL, 0x0001020304050607ULL};
-    uint64_t expect22_d[2] = {0x84c70c472bef9172ULL, 0xd7da733930c2096fULL};
-
-	uint64_t ct24_d[2] = {0x28292a2b2c2d2e2fULL, 0x2021222324252627ULL};
-	uint64_t pt24_d[2];
-    uint64_t key24_d[4] = {0x18191a1b1c1d1e1fULL, 0x1011121314151617ULL, 0x08090a0b0c0d0e0fULL, 0x0001020304050607ULL};
-    uint64_t expect24_d[2] = {0xe1dffdce56b46df3ULL, 0x96d9ca30705f5bb4ULL};
-
-	uint64_t ct44_d[4] = {0x38393a3b3c3d3e3fULL, 0x3031323334353637ULL, 0x28292a2b2c2d2e2fULL, 0x2021222324252627ULL};
-	uint64_t pt44_d[4];
-    uint64_t key44_d[4] = {0x18191a1b1c1d1e1fULL, 0x1011121314151617ULL, 0x08090a0b0c0d0e0fULL, 0x0001020304050607ULL};
-    uint64_t expect44_d[4] = {0x864e67967823c57fULL, 0xa34b8b3fb0e9c103ULL, 0xd3c33f2c597c5babULL, 0xe30fb28625d1ed61ULL};
-
-	uint64_t ct48_d[4] = {0x58595a5b5c5d5e5fULL, 0x5051525354555657ULL, 0x48494a4b4c4d4e4fULL, 0x4041424344454647ULL};
-	uint64_t pt48_d[4];
-    uint64_t key48_d[8] = {0x38393a3b3c3d3e3fULL, 0x3031323334353637ULL, 0x28292a2b2c2d2e2fULL, 0x2021222324252627ULL,
-						0x18191a1b1c1d1e1fULL, 0x1011121314151617ULL, 0x08090a0b0c0d0e0fULL, 0x0001020304050607ULL};
-    uint64_t expect48_d[4] = {0x82d4da67277a3118ULL, 0x078d78a1b907cdbcULL, 0x97845f9e1898705eULL, 0xe06aba796d910b2dULL};
-
-	uint64_t ct88_d[8] = {0x78797a7b7c7d7e7fULL, 0x7071727374757677ULL, 0x68696a6b6c6d6e6fULL, 0x6061626364656667ULL,
-						0x58595a5b5c5d5e5fULL, 0x5051525354555657ULL, 0x48494a4b4c4d4e4fULL, 0x4041424344454647ULL};
-	uint64_t pt88_d[8];
-    uint64_t key88_d[8] = {0x38393a3b3c3d3e3fULL, 0x3031323334353637ULL, 0x28292a2b2c2d2e2fULL, 0x2021222324252627ULL,
-						0x18191a1b1c1d1e1fULL, 0x1011121314151617ULL, 0x08090a0b0c0d0e0fULL, 0x0001020304050607ULL};
-    uint64_t expect88_d[8] = {0x5252a025338480ceULL, 0x29d8a9e614d7ea1bULL, 0xbd45a8e90e1e38fdULL, 0xa346fad954450492ULL,
-						0xf2b13b85dbef7f75ULL, 0x6ae6753b839dff97ULL, 0xdc1b29b5ab5741afULL, 0x22ff5aaa13bb94f0ULL };
-
-	kalyna_t* ctx22_d = KalynaInit(128, 128);
-	kalyna_t* ctx24_d = KalynaInit(128, 256);
-	kalyna_t* ctx44_d = KalynaInit(256, 256);
-	kalyna_t* ctx48_d = KalynaInit(256, 512);
-	kalyna_t* ctx88_d = KalynaInit(512, 512);
-
-	// kalyna 22 enc
-	KalynaKeyExpand(key22_e, ctx22_e);
-
-    printf("\n=============\n");
-    printf("Kalyna (%lu, %lu)\n", ctx22_e->nb * 64, ctx22_e->nk * 64);
-   
-	printf("\n--- ENCIPHERING ---\n");
-    printf("Key:\n");
-    print(ctx22_e->nk, key22_e);
-
-    printf("Plaintext:\n");
-    print(ctx22_e->nb, pt22_e);
-
-    KalynaEncipher(pt22_e, ctx22_e, ct22_e);
-    printf("Ciphertext:\n");
-    print(ctx22_e->nb, ct22_e);
-
-	if (memcmp(ct22_e, expect22_e, sizeof(ct22_e)) != 0) printf("Failed enciphering\n");
-	else printf("Success enciphering\n\n");
-
-	KalynaDelete(ctx22_e);
-
-	// kalyna 22 dec
-	KalynaKeyExpand(key22_d, ctx22_d);
-
-    printf("\n=============\n");
-    printf("Kalyna (%lu, %lu)\n", ctx22_d->nb * 64, ctx22_d->nk * 64);
-   
-	printf("\n--- DECIPHERING ---\n");
-    printf("Key:\n");
-    print(ctx22_d->nk, key22_d);
-
-	printf("Ciphertext:\n");
-    print(ctx22_d->nb, ct22_d);
-
-	KalynaDecipher(ct22_d, ctx22_d, pt22_d);
-    printf("Plaintext:\n");
-    print(ctx22_d->nb, pt22_d);
-
-	if (memcmp(pt22_d, expect22_d, sizeof(pt22_d)) != 0) printf("Failed deciphering\n");
-	else printf("Success deciphering\n\n");
-
-	KalynaDelete(ctx22_d);
-	
-	// kalyna 24 enc
-	KalynaKeyExpand(key24_e, ctx24_e);
-
-    printf("\n=============\n");
-    printf("Kalyna (%lu, %lu)\n", ctx24_e->nb * 64, ctx24_e->nk * 64);
-
-    printf("\n--- ENCIPHERING ---\n");
-    printf("Key:\n");
-    print(ctx24_e->nk, key24_e);
-
-    printf("Plaintext:\n");
-    print(ctx24_e->nb, pt24_e);
-
-    KalynaEncipher(pt24_e, ctx24_e, ct24_e);
-    printf("Ciphertext:\n");
-    print(ctx24_e->nb, ct24_e);
-
-	if (memcmp(ct24_e, expect24_e, sizeof(ct24_e)) != 0) printf("Failed enciphering\n");
-	else printf("Success enciphering\n\n");
-
-	KalynaDelete(ctx24_e);
-
-	// kalyna 24 dec
-	KalynaKeyExpand(key24_d, ctx24_d);
-
-    printf("\n=============\n");
-    printf("Kalyna (%lu, %lu)\n", ctx24_d->nb * 64, ctx24_d->nk * 64);
-   
-	printf("\n--- DECIPHERING ---\n");
-    printf("Key:\n");
-    print(ctx24_d->nk, key24_d);
-
-	printf("Ciphertext:\n");
-    print(ctx24_d->nb, ct24_d);
-
-	KalynaDecipher(ct24_d, ctx24_d, pt24_d);
-    printf("Plaintext:\n");
-    print(ctx24_d->nb, pt24_d);
-
-	if (memcmp(pt24_d, expect24_d, sizeof(pt24_d)) != 0) printf("Failed deciphering\n");
-	else printf("Success deciphering\n\n");
-
-	KalynaDelete(ctx24_d);
-
-	// kalyna 44 enc
-	KalynaKeyExpand(key44_e, ctx44_e);
-
-    printf("\n=============\n");
-    printf("Kalyna (%lu, %lu)\n", ctx44_e->nb * 64, ctx44_e->nk * 64);
-
-    printf("\n--- ENCIPHERING ---\n");
-    printf("Key:\n");
-    print(ctx44_e->nk, key44_e);
-
-    printf("Plaintext:\n");
-    print(ctx44_e->nb, pt44_e);
-
-    KalynaEncipher(pt44_e, ctx44_e, ct44_e);
-    printf("Ciphertext:\n");
-    print(ctx44_e->nb, ct44_e);
-
-	if (memcmp(ct44_e, expect44_e, sizeof(ct44_e)) != 0) printf("Failed enciphering\n");
-	else printf("Success enciphering\n\n");
-
-	KalynaDelete(ctx44_e);
-
-	// kalyna 44 dec
-	KalynaKeyExpand(key44_d, ctx44_d);
-
-    printf("\n=============\n");
-    printf("Kalyna (%lu, %lu)\n", ctx44_d->nb * 64, ctx44_d->nk * 64);
-   
-	printf("\n--- DECIPHERING ---\n");
-    printf("Key:\n");
-    print(ctx44_d->nk, key44_d);
-
-	printf("Ciphertext:\n");
-    print(ctx44_d->nb, ct44_d);
-
-	KalynaDecipher(ct44_d, ctx44_d, pt44_d);
-    printf("Plaintext:\n");
-    print(ctx44_d->nb, pt44_d);
-
-	if (memcmp(pt44_d, expect44_d, sizeof(pt44_d)) != 0) printf("Failed deciphering\n");
-	else printf("Success deciphering\n\n");
-
-	KalynaDelete(ctx44_d);
-
-	// kalyna 48 enc
-	KalynaKeyExpand(key48_e, ctx48_e);
-
-    printf("\n=============\n");
-    printf("Kalyna (%lu, %lu)\n", ctx48_e->nb * 64, ctx48_e->nk * 64);
-   
-    printf("\n--- ENCIPHERING ---\n");
-    printf("Key:\n");
-    print(ctx48_e->nk, key48_e);
-
-    printf("Plaintext:\n");
-    print(ctx48_e->nb, pt48_e);
-
-    KalynaEncipher(pt48_e, ctx48_e, ct48_e);
-    printf("Ciphertext:\n");
-    print(ctx48_e->nb, ct48_e);
-
-	if (memcmp(ct48_e, expect48_e, sizeof(ct48_e)) != 0) printf("Failed enciphering\n");
-	else printf("Success enciphering\n\n");
-
-	KalynaDelete(ctx48_e);
-
-	// kalyna 48 dec
-	KalynaKeyExpand(key48_d, ctx48_d);
-
-    printf("\n=============\n");
-    printf("Kalyna (%lu, %lu)\n", ctx48_d->nb * 64, ctx48_d->nk * 64);
-   
-	printf("\n--- DECIPHERING ---\n");
-    printf("Key:\n");
-    print(ctx48_d->nk, key48_d);
-
-	printf("Ciphertext:\n");
-    print(ctx48_d->nb, ct48_d);
-
-	KalynaDecipher(ct48_d, ctx48_d, pt48_d);
-    printf("Plaintext:\n");
-    print(ctx48_d->nb, pt48_d);
-
-	if (memcmp(pt48_d, expect48_d, sizeof(pt48_d)) != 0) printf("Failed deciphering\n");
-	else printf("Success deciphering\n\n");
-
-	KalynaDelete(ctx48_d);
-
-	// kalyna 88 enc
-	KalynaKeyExpand(key88_e, ctx88_e);
-
-    printf("\n=============\n");
-    printf("Kalyna (%lu, %lu)\n", ctx88_e->nb * 64, ctx88_e->nk * 64);
-
-    printf("\n--- ENCIPHERING ---\n");
-    printf("Key:\n");
-    print(ctx88_e->nk, key88_e);
-
-    printf("Plaintext:\n");
-    print(ctx88_e->nb, pt88_e);
-
-    KalynaEncipher(pt88_e, ctx88_e, ct88_e);
-    printf("Ciphertext:\n");
-    print(ctx88_e->nb, ct88_e);
-
-	if (memcmp(ct88_e, expect88_e, sizeof(ct88_e)) != 0) printf("Failed enciphering\n");
-	else printf("Success enciphering\n\n");
-
-	KalynaDelete(ctx88_e);
-
-	// kalyna 88 dec
-	KalynaKeyExpand(key88_d, ctx88_d);
-
-    printf("\n=============\n");
-    printf("Kalyna (%lu, %lu)\n", ctx88_d->nb * 64, ctx88_d->nk * 64);
-   
-	printf("\n--- DECIPHERING ---\n");
-    printf("Key:\n");
-    print(ctx88_d->nk, key88_d);
-
-	printf("Ciphertext:\n");
-    print(ctx88_d->nb, ct88_d);
-
-	KalynaDecipher(ct88_d, ctx88_d, pt88_d);
-    printf("Plaintext:\n");
-    print(ctx88_d->nb, pt88_d);
-
-	if (memcmp(pt88_d, expect88_d, sizeof(pt88_d)) != 0) printf("Failed deciphering\n");
-	else printf("Success deciphering\n\n");
-
-	KalynaDelete(ctx88_d);
-
-    return 0;
-}
-
-
-void print (int data_size, uint64_t data [])
-{
-	int i;
-	uint8_t * tmp = (uint8_t *) data; 
-	for (i = 0; i < data_size * 8; i ++)
-	{
-		if (! (i % 16)) printf ("    ");
-		printf ("%02X", (unsigned int) tmp [i]);
-		if (!((i + 1) % 16)) printf ("\n");
-	};
-	printf ("\n");
-};
+/*
+
+main.c, checking reference implementation of the Kalyna block cipher (DSTU 7624:2014) against test vectors, all block and key length variants
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <stdio.h>
+#include <memory.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "kalyna.h"
+#include "transformations.h"
+#include "kalyna_feedback.h"
+#include "kalyna_gcm.h"
+#include "engine.h"
+
+#define kVECTORS_FILE "test_vectors.txt"
+
+#define kMAX_LINE 4096
+#define kMAX_DATA 1024  /* Maximum byte length of plaintext or ciphertext. */
+#define kMAX_PARAM 64  /* Maximum byte length of key, IV and tag. */
+
+/*!
+ * Single test vector as read from the vectors file.
+ */
+typedef struct {
+    int line;  /**< Line of the vectors file where the record starts. */
+    char mode[16];
+    size_t block_size;
+    uint8_t key[kMAX_PARAM];
+    size_t key_len;
+    uint8_t iv[kMAX_PARAM];
+    size_t iv_len;
+    uint8_t aad[kMAX_DATA];
+    size_t aad_len;
+    uint8_t plaintext[kMAX_DATA];
+    size_t plaintext_len;
+    uint8_t ciphertext[kMAX_DATA];
+    size_t ciphertext_len;
+    uint8_t tag[kMAX_PARAM];
+    size_t tag_len;
+} vector_t;
+
+/*!
+ * Check of a single mode of operation against a test vector.
+ *
+ * @param vector Test vector.
+ * @param ctx Cipher context with round keys expanded from the vector key.
+ * @return Zero in case of success.
+ */
+typedef int (*mode_check_t)(const vector_t* vector, kalyna_t* ctx);
+
+typedef struct {
+    const char* name;
+    mode_check_t check;
+} mode_runner_t;
+
+
+static int CheckEcb(const vector_t* vector, kalyna_t* ctx) {
+    int result = 0;
+    size_t block_len = ctx->nb * sizeof(uint64_t);
+    uint8_t data[kMAX_DATA];
+
+    if (vector->plaintext_len != vector->ciphertext_len ||
+            vector->plaintext_len % block_len != 0) {
+        printf("Malformed ECB vector at line %d\n", vector->line);
+        return -1;
+    }
+
+    KalynaEncryptBytes(vector->plaintext, vector->plaintext_len, ctx, data);
+    if (memcmp(data, vector->ciphertext, vector->ciphertext_len) != 0) {
+        printf("Failed enciphering\n");
+        result = -1;
+    }
+
+    KalynaDecryptBytes(vector->ciphertext, vector->ciphertext_len, ctx, data);
+    if (memcmp(data, vector->plaintext, vector->plaintext_len) != 0) {
+        printf("Failed deciphering\n");
+        result = -1;
+    }
+    return result;
+}
+
+
+/*!
+ * Check a mode taking an IV and any length, with full block feedback for CFB.
+ */
+static int CheckFeedbackMode(const vector_t* vector, kalyna_t* ctx, int ofb) {
+    int result = 0;
+    size_t block_len = ctx->nb * sizeof(uint64_t);
+    uint8_t data[kMAX_DATA];
+
+    if (vector->plaintext_len != vector->ciphertext_len || vector->iv_len != block_len) {
+        printf("Malformed %s vector at line %d\n", vector->mode, vector->line);
+        return -1;
+    }
+
+    if (ofb)
+        KalynaOfbBytes(vector->plaintext, vector->plaintext_len, vector->iv, ctx, data);
+    else
+        KalynaCfbEncrypt(vector->plaintext, vector->plaintext_len, vector->iv,
+            block_len * kBITS_IN_BYTE, ctx, data);
+    if (memcmp(data, vector->ciphertext, vector->ciphertext_len) != 0) {
+        printf("Failed encryption\n");
+        result = -1;
+    }
+
+    if (ofb)
+        KalynaOfbBytes(vector->ciphertext, vector->ciphertext_len, vector->iv, ctx, data);
+    else
+        KalynaCfbDecrypt(vector->ciphertext, vector->ciphertext_len, vector->iv,
+            block_len * kBITS_IN_BYTE, ctx, data);
+    if (memcmp(data, vector->plaintext, vector->plaintext_len) != 0) {
+        printf("Failed decryption\n");
+        result = -1;
+    }
+    return result;
+}
+
+static int CheckCfb(const vector_t* vector, kalyna_t* ctx) {
+    return CheckFeedbackMode(vector, ctx, FALSE);
+}
+
+static int CheckOfb(const vector_t* vector, kalyna_t* ctx) {
+    return CheckFeedbackMode(vector, ctx, TRUE);
+}
+
+/*!
+ * Check counter mode, the same operation in both directions.
+ */
+static int CheckCtr(const vector_t* vector, kalyna_t* ctx) {
+    int result = 0;
+    uint8_t data[kMAX_DATA];
+
+    if (vector->plaintext_len != vector->ciphertext_len ||
+            vector->iv_len != ctx->nb * sizeof(uint64_t)) {
+        printf("Malformed CTR vector at line %d\n", vector->line);
+        return -1;
+    }
+
+    KalynaCtrBytes(vector->plaintext, vector->plaintext_len, vector->iv, ctx, data);
+    if (memcmp(data, vector->ciphertext, vector->ciphertext_len) != 0) {
+        printf("Failed encryption\n");
+        result = -1;
+    }
+
+    KalynaCtrBytes(vector->ciphertext, vector->ciphertext_len, vector->iv, ctx, data);
+    if (memcmp(data, vector->plaintext, vector->plaintext_len) != 0) {
+        printf("Failed decryption\n");
+        result = -1;
+    }
+    return result;
+}
+
+/*!
+ * Check GCM: the ciphertext and tag of encryption, and decryption with the
+ * expected tag.
+ */
+static int CheckGcm(const vector_t* vector, kalyna_t* ctx) {
+    int result = 0;
+    uint8_t data[kMAX_DATA];
+    uint8_t tag[kMAX_PARAM];
+
+    if (vector->plaintext_len != vector->ciphertext_len ||
+            vector->iv_len != ctx->nb * sizeof(uint64_t) ||
+            vector->tag_len != ctx->nb * sizeof(uint64_t)) {
+        printf("Malformed GCM vector at line %d\n", vector->line);
+        return -1;
+    }
+
+    KalynaGcmEncrypt(ctx, vector->iv, vector->aad, vector->aad_len, vector->plaintext,
+        vector->plaintext_len, data, tag);
+    if (memcmp(data, vector->ciphertext, vector->ciphertext_len) != 0 ||
+            memcmp(tag, vector->tag, vector->tag_len) != 0) {
+        printf("Failed encryption\n");
+        result = -1;
+    }
+
+    if (KalynaGcmDecrypt(ctx, vector->iv, vector->aad, vector->aad_len,
+            vector->ciphertext, vector->ciphertext_len, vector->tag, data) != 0 ||
+            memcmp(data, vector->plaintext, vector->plaintext_len) != 0) {
+        printf("Failed decryption\n");
+        result = -1;
+    }
+    return result;
+}
+
+
+static const mode_runner_t modes[] = {
+    {"ECB", CheckEcb},
+    {"CFB", CheckCfb},
+    {"OFB", CheckOfb},
+    {"CTR", CheckCtr},
+    {"GCM", CheckGcm},
+};
+
+#define kMODES_NUM (sizeof(modes) / sizeof(modes[0]))
+
+
+/*!
+ * Parse a hexadecimal string into bytes.
+ *
+ * @return Number of parsed bytes or -1 in case of malformed or too long
+ * string.
+ */
+static int ParseHex(const char* hex, uint8_t* bytes, size_t max_length) {
+    size_t length = 0;
+    unsigned int byte;
+    while (isxdigit((unsigned char)hex[0]) && isxdigit((unsigned char)hex[1])) {
+        if (length == max_length || sscanf(hex, "%2x", &byte) != 1)
+            return -1;
+        bytes[length++] = (uint8_t)byte;
+        hex += 2;
+    }
+    return (*hex == '\0') ? (int)length : -1;
+}
+
+/*!
+ * Store a single "field = value" pair into the vector.
+ *
+ * @return Zero in case of success.
+ */
+static int ParseField(vector_t* vector, const char* field, const char* value) {
+    int length = 0;
+    if (strcmp(field, "mode") == 0) {
+        if (strlen(value) >= sizeof(vector->mode))
+            return -1;
+        strcpy(vector->mode, value);
+    } else if (strcmp(field, "block") == 0) {
+        vector->block_size = strtoul(value, NULL, 10);
+    } else if (strcmp(field, "key") == 0) {
+        length = ParseHex(value, vector->key, sizeof(vector->key));
+        vector->key_len = length;
+    } else if (strcmp(field, "iv") == 0) {
+        length = ParseHex(value, vector->iv, sizeof(vector->iv));
+        vector->iv_len = length;
+    } else if (strcmp(field, "aad") == 0) {
+        length = ParseHex(value, vector->aad, sizeof(vector->aad));
+        vector->aad_len = length;
+    } else if (strcmp(field, "plaintext") == 0) {
+        length = ParseHex(value, vector->plaintext, sizeof(vector->plaintext));
+        vector->plaintext_len = length;
+    } else if (strcmp(field, "ciphertext") == 0) {
+        length = ParseHex(value, vector->ciphertext, sizeof(vector->ciphertext));
+        vector->ciphertext_len = length;
+    } else if (strcmp(field, "tag") == 0) {
+        length = ParseHex(value, vector->tag, sizeof(vector->tag));
+        vector->tag_len = length;
+    } else {
+        return -1;
+    }
+    return length < 0 ? -1 : 0;
+}
+
+/*!
+ * Read the next record from the vectors file.
+ *
+ * @return 1 if a record was read, 0 at the end of file, -1 on malformed
+ * input.
+ */
+static int ReadVector(FILE* file, int* line_num, vector_t* vector) {
+    char line[kMAX_LINE];
+    char* value;
+    char* end;
+    int started = 0;
+
+    memset(vector, 0, sizeof(vector_t));
+    while (fgets(line, sizeof(line), file) != NULL) {
+        ++*line_num;
+        end = line + strlen(line);
+        while (end > line && isspace((unsigned char)end[-1]))
+            *--end = '\0';
+        if (line[0] == '#')
+            continue;
+        if (line[0] == '\0') {
+            if (started)
+                return 1;
+            continue;
+        }
+        if (!started) {
+            vector->line = *line_num;
+            started = 1;
+        }
+        value = strchr(line, '=');
+        if (value == NULL) {
+            printf("Malformed line %d\n", *line_num);
+            return -1;
+        }
+        for (end = value; end > line && isspace((unsigned char)end[-1]); --end);
+        *end = '\0';
+        for (++value; isspace((unsigned char)*value); ++value);
+        if (ParseField(vector, line, value) != 0) {
+            printf("Malformed field '%s' at line %d\n", line, *line_num);
+            return -1;
+        }
+    }
+    return started;
+}
+
+/*!
+ * Run a test vector through the matching mode of operation with every round
+ * engine available on the host, key expansion included.
+ *
+ * @return Zero in case of success.
+ */
+static int RunVector(const vector_t* vector) {
+    size_t i, e;
+    int result = 0;
+    uint64_t key[kNK_512];
+    kalyna_t* ctx;
+
+    for (i = 0; i < kMODES_NUM; ++i) {
+        if (strcmp(modes[i].name, vector->mode) == 0)
+            break;
+    }
+    if (i == kMODES_NUM) {
+        printf("Unsupported mode '%s' at line %d\n", vector->mode, vector->line);
+        return -1;
+    }
+    if (vector->key_len % sizeof(uint64_t) != 0 ||
+            vector->key_len > sizeof(key)) {
+        printf("Malformed key at line %d\n", vector->line);
+        return -1;
+    }
+
+    printf("Kalyna (%lu, %lu) %s, line %d\n", (unsigned long)vector->block_size,
+        (unsigned long)(vector->key_len * kBITS_IN_BYTE), vector->mode,
+        vector->line);
+
+    for (e = 0; kalyna_engines[e] != NULL; ++e) {
+        if (KalynaSelectEngine(kalyna_engines[e]->name) != 0)
+            continue;
+        ctx = KalynaInit(vector->block_size, vector->key_len * kBITS_IN_BYTE);
+        if (ctx == NULL)
+            return -1;
+        ReadWords(ctx->nk, vector->key, key);
+        KalynaKeyExpand(key, ctx);
+        if (modes[i].check(vector, ctx) != 0) {
+            printf("Failed with engine %s\n", kalyna_engines[e]->name);
+            result = -1;
+        }
+        KalynaDelete(ctx);
+    }
+    return result;
+}
+
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : kVECTORS_FILE;
+    int line_num = 0;
+    int status;
+    int total = 0, failed = 0;
+    clock_t start;
+    vector_t vector;
+    const kalyna_engine_t* default_engine;
+    FILE* file = fopen(path, "r");
+
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    default_engine = KalynaEngineSelect();
+    start = clock();
+    while ((status = ReadVector(file, &line_num, &vector)) > 0) {
+        ++total;
+        if (RunVector(&vector) != 0)
+            ++failed;
+    }
+    fclose(file);
+    KalynaSelectEngine(default_engine->name);
+    if (status < 0)
+        ++failed;
+
+    printf("\n%d vectors, %d failed, %.3f ms\n", total, failed,
+        (clock() - start) * 1000.0 / CLOCKS_PER_SEC);
+    if (failed != 0 || total == 0) {
+        printf("Failed test vectors\n");
+        return 1;
+    }
+    printf("Success test vectors\n");
+    return 0;
+}
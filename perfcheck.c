@@ -0,0 +1,624 @@
+/*
+
+Performance regression check of the Kalyna block cipher (DSTU 7624:2014) engines and modes
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "kalyna.h"
+#include "transformations.h"
+#include "engine.h"
+#include "kalyna_gcm.h"
+#include "kalyna_feedback.h"
+
+/* Size of the buffer processed by a single call. */
+#define kBUFFER_BYTES (16 * 1024)
+
+/* Repetitions of every case; time is their median, instructions their minimum. */
+#define kREPETITIONS 21
+
+/* Measured time of one repetition, nanoseconds. */
+#define kREPETITION_NS 1000000
+
+/*
+ * Passes over all cases. Interleaving them spreads a slow phase of the
+ * machine over different cases instead of failing the one it hit.
+ */
+#define kPASSES 3
+
+#define kMAX_CASES 256
+#define kMAX_HOSTS 16
+#define kMAX_NAME 48
+#define kMAX_LINE 256
+
+/*
+ * Allowed slowdown before a case fails. Instruction counts barely move
+ * between runs, times do on shared and frequency scaled machines.
+ */
+#define kINSTR_THRESHOLD 0.03
+#define kTIME_THRESHOLD 0.25
+
+/* Block and key bit sizes of all Kalyna variants. */
+static const size_t variants[][2] = {
+    {128, 128}, {128, 256}, {256, 256}, {256, 512}, {512, 512}
+};
+
+#define kVARIANTS_NUM (sizeof(variants) / sizeof(variants[0]))
+
+/* Modes checked with the default engine. */
+#define kMODE_ECB 0
+#define kMODE_CTR 1
+#define kMODE_CFB 2
+#define kMODE_OFB 3
+#define kMODE_GCM 4
+#define kMODE_KEY_SETUP 5
+#define kMODES_NUM 6
+
+static const char* const mode_names[kMODES_NUM] = {
+    "ECB", "CTR", "CFB", "OFB", "GCM", "key setup"
+};
+
+static const char kUsage[] =
+    "Usage: kalyna-perfcheck [-u] [-c CPU] BASELINE\n"
+    "  -u  measure and record the CPU model in BASELINE instead of checking\n"
+    "  -c  CPU to pin the measuring thread to, the current one by default\n"
+    "Exits with 1 on regressions, 2 on errors and 3 if no case could be compared.\n"
+    "Exits with 0 without measuring if BASELINE has no record of the CPU model.\n";
+
+/*!
+ * One checked routine: processes `blocks` blocks of `buffer` per call.
+ * `engine` is set for engine cases and NULL for modes.
+ */
+typedef struct {
+    const kalyna_engine_t* engine;
+    int decipher;
+    int mode;
+    kalyna_t* ctx;
+    uint64_t* key;
+    uint8_t* buffer;
+    size_t blocks;
+} check_case_t;
+
+/*!
+ * Measurement of a case per block; `instr` is negative if instructions
+ * cannot be counted, `threshold` negative for the default one.
+ */
+typedef struct {
+    char name[kMAX_NAME];
+    double instr;
+    double ns;
+    double threshold;
+} result_t;
+
+/* Cases recorded on one CPU model. */
+typedef struct {
+    char host[kMAX_LINE];
+    size_t count;
+    result_t results[kMAX_CASES];
+} host_baseline_t;
+
+typedef struct {
+    double instr_threshold;
+    double time_threshold;
+    size_t hosts;
+    host_baseline_t host[kMAX_HOSTS];
+} baseline_t;
+
+/* Counter of retired user space instructions, -1 if not available. */
+static int instr_fd = -1;
+
+
+static double NowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void OpenCounter(void) {
+#if defined(__linux__) && defined(SYS_perf_event_open)
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    instr_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+/*!
+ * Pin the calling thread to `cpu`, or to the CPU it runs on if negative, so
+ * that neither caches nor clock domains change during the check.
+ *
+ * @return The CPU or -1 if the thread could not be pinned.
+ */
+static int PinThread(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+
+    if (cpu < 0)
+        cpu = sched_getcpu();
+    if (cpu < 0)
+        return -1;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        return -1;
+    return cpu;
+#else
+    return -1;
+#endif
+}
+
+/*!
+ * Copy the CPU model of /proc/cpuinfo to `model`, "unknown" elsewhere.
+ * Baselines are recorded and checked per model.
+ */
+static void CpuModel(char* model, size_t size) {
+    char line[kMAX_LINE];
+    char* value;
+    FILE* cpuinfo = fopen("/proc/cpuinfo", "r");
+
+    snprintf(model, size, "unknown");
+    if (cpuinfo == NULL)
+        return;
+    while (fgets(line, sizeof(line), cpuinfo) != NULL) {
+        if (strncmp(line, "model name", 10) != 0 && strncmp(line, "Model", 5) != 0)
+            continue;
+        value = strchr(line, ':');
+        if (value == NULL)
+            continue;
+        ++value;
+        while (*value == ' ' || *value == '\t')
+            ++value;
+        /* Quotes and backslashes would need escaping in the baseline. */
+        snprintf(model, size, "%.*s", (int)strcspn(value, "\n\"\\"), value);
+        break;
+    }
+    fclose(cpuinfo);
+}
+
+static void RunCase(const check_case_t* c) {
+    uint8_t iv[kNB_512 * sizeof(uint64_t)], tag[kNB_512 * sizeof(uint64_t)];
+    size_t block_len = c->ctx->nb * sizeof(uint64_t);
+    size_t length = c->blocks * block_len;
+
+    memset(iv, 0, sizeof(iv));
+    if (c->engine != NULL) {
+        if (c->decipher)
+            c->engine->decipher((uint64_t*)c->buffer, c->blocks, c->ctx, (uint64_t*)c->buffer);
+        else
+            c->engine->encipher((uint64_t*)c->buffer, c->blocks, c->ctx, (uint64_t*)c->buffer);
+        return;
+    }
+    switch (c->mode) {
+    case kMODE_ECB:
+        KalynaEncryptBytes(c->buffer, length, c->ctx, c->buffer);
+        break;
+    case kMODE_CTR:
+        KalynaCtrBytes(c->buffer, length, iv, c->ctx, c->buffer);
+        break;
+    case kMODE_CFB:
+        KalynaCfbEncrypt(c->buffer, length, iv, block_len * kBITS_IN_BYTE, c->ctx, c->buffer);
+        break;
+    case kMODE_OFB:
+        KalynaOfbBytes(c->buffer, length, iv, c->ctx, c->buffer);
+        break;
+    case kMODE_GCM:
+        KalynaGcmEncrypt(c->ctx, iv, NULL, 0, c->buffer, length, c->buffer, tag);
+        break;
+    default:
+        KalynaKeyExpand(c->key, c->ctx);
+        break;
+    }
+}
+
+static int CompareDoubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+/*!
+ * Warm up, size a repetition to about kREPETITION_NS and run kREPETITIONS
+ * of them. Time is the median over repetitions, instructions the minimum,
+ * which drops interrupts and page faults counted into some of them.
+ */
+static void MeasureCase(const check_case_t* c, size_t units, result_t* result) {
+    size_t r;
+    unsigned long i, calls = 0;
+    double start, elapsed, times[kREPETITIONS];
+    double instr = -1.0;
+    uint64_t count;
+
+    start = NowNs();
+    do {
+        RunCase(c);
+        ++calls;
+        elapsed = NowNs() - start;
+    } while (elapsed < kREPETITION_NS);
+
+    for (r = 0; r < kREPETITIONS; ++r) {
+        if (instr_fd >= 0) {
+            ioctl(instr_fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(instr_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        start = NowNs();
+        for (i = 0; i < calls; ++i)
+            RunCase(c);
+        times[r] = (NowNs() - start) / ((double)calls * units);
+        if (instr_fd >= 0) {
+            ioctl(instr_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(instr_fd, &count, sizeof(count)) == sizeof(count) &&
+                    (instr < 0 || count / ((double)calls * units) < instr))
+                instr = count / ((double)calls * units);
+        }
+    }
+    qsort(times, kREPETITIONS, sizeof(double), CompareDoubles);
+    result->ns = times[kREPETITIONS / 2];
+    result->instr = instr;
+    result->threshold = -1.0;
+}
+
+/*!
+ * Measure every fast engine in both directions and the modes on the default
+ * engine for all variants.
+ *
+ * @return Number of results.
+ */
+static size_t MeasureAll(uint8_t* buffer, result_t* results) {
+    size_t v, e, m, i, count = 0;
+    uint64_t key[kNK_512];
+    check_case_t c;
+
+    for (i = 0; i < kNK_512; ++i)
+        key[i] = i * 0x0101010101010101ULL;
+    memset(&c, 0, sizeof(c));
+    c.buffer = buffer;
+    c.key = key;
+    for (v = 0; v < kVARIANTS_NUM; ++v) {
+        c.ctx = KalynaInit(variants[v][0], variants[v][1]);
+        KalynaKeyExpand(key, c.ctx);
+        c.blocks = kBUFFER_BYTES / (c.ctx->nb * sizeof(uint64_t));
+
+        for (e = 0; kalyna_engines[e] != NULL; ++e) {
+            /* The reference engine is the slow path by design. */
+            c.engine = KalynaEngineFind(kalyna_engines[e]->name);
+            if (c.engine == NULL || strcmp(c.engine->name, "reference") == 0)
+                continue;
+            for (c.decipher = 0; c.decipher <= 1; ++c.decipher) {
+                snprintf(results[count].name, kMAX_NAME, "%s %s %lu/%lu", c.engine->name,
+                    c.decipher ? "dec" : "enc", (unsigned long)variants[v][0],
+                    (unsigned long)variants[v][1]);
+                MeasureCase(&c, c.blocks, &results[count++]);
+            }
+        }
+
+        c.engine = NULL;
+        for (m = 0; m < kMODES_NUM; ++m) {
+            c.mode = (int)m;
+            snprintf(results[count].name, kMAX_NAME, "%s %lu/%lu", mode_names[m],
+                (unsigned long)variants[v][0], (unsigned long)variants[v][1]);
+            /* Key setup is measured per call, modes per block. */
+            MeasureCase(&c, m == kMODE_KEY_SETUP ? 1 : c.blocks, &results[count++]);
+        }
+        KalynaDelete(c.ctx);
+    }
+    return count;
+}
+
+/*!
+ * Merge the passes of case `i`: a baseline keeps the median of each metric,
+ * a check the best, so that only a case slower in every pass than usual
+ * counts as a regression.
+ */
+static void CombinePasses(result_t passes[kPASSES][kMAX_CASES], size_t i, int median,
+        result_t* result) {
+    size_t pass;
+    double ns[kPASSES], instr[kPASSES];
+
+    for (pass = 0; pass < kPASSES; ++pass) {
+        ns[pass] = passes[pass][i].ns;
+        instr[pass] = passes[pass][i].instr;
+    }
+    qsort(ns, kPASSES, sizeof(double), CompareDoubles);
+    qsort(instr, kPASSES, sizeof(double), CompareDoubles);
+    *result = passes[0][i];
+    result->ns = median ? ns[kPASSES / 2] : ns[0];
+    result->instr = median ? instr[kPASSES / 2] : instr[0];
+}
+
+static int WriteBaseline(const char* path, const baseline_t* baseline) {
+    size_t h, i;
+    const host_baseline_t* host;
+    FILE* file = fopen(path, "w");
+
+    if (file == NULL) {
+        perror("Could not write baseline");
+        return -1;
+    }
+    fprintf(file, "{\n  \"format\": 2,\n");
+    fprintf(file, "  \"instr_threshold\": %.2f,\n  \"time_threshold\": %.2f,\n",
+        baseline->instr_threshold, baseline->time_threshold);
+    fprintf(file, "  \"hosts\": [\n");
+    for (h = 0; h < baseline->hosts; ++h) {
+        host = &baseline->host[h];
+        fprintf(file, "    {\n      \"host\": \"%s\",\n      \"cases\": [\n", host->host);
+        for (i = 0; i < host->count; ++i) {
+            fprintf(file, "        {\"case\": \"%s\", \"instr\": ", host->results[i].name);
+            if (host->results[i].instr < 0)
+                fprintf(file, "null");
+            else
+                fprintf(file, "%.1f", host->results[i].instr);
+            fprintf(file, ", \"ns\": %.2f", host->results[i].ns);
+            if (host->results[i].threshold >= 0)
+                fprintf(file, ", \"threshold\": %.2f", host->results[i].threshold);
+            fprintf(file, "}%s\n", i + 1 < host->count ? "," : "");
+        }
+        fprintf(file, "      ]\n    }%s\n", h + 1 < baseline->hosts ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    if (fclose(file) != 0) {
+        perror("Could not write baseline");
+        return -1;
+    }
+    return 0;
+}
+
+/* Number following `"key": ` on a line, `fallback` if absent or null. */
+static double ReadField(const char* line, const char* key, double fallback) {
+    double value;
+    const char* found = strstr(line, key);
+    if (found == NULL || sscanf(found + strlen(key), " : %lf", &value) != 1)
+        return fallback;
+    return value;
+}
+
+/*!
+ * Read a baseline written by WriteBaseline(), one value or case per line.
+ * Cases belong to the last "host" above them. Cases may carry their own
+ * "threshold" overriding the one of their metric.
+ *
+ * @param missing_ok Nonzero to start an empty baseline if there is no file.
+ * @return Zero in case of success, -1 if the file cannot be read.
+ */
+static int ReadBaseline(const char* path, int missing_ok, baseline_t* baseline) {
+    char line[kMAX_LINE];
+    const char* value;
+    host_baseline_t* host = NULL;
+    result_t* result;
+    FILE* file;
+
+    memset(baseline, 0, sizeof(baseline_t));
+    baseline->instr_threshold = kINSTR_THRESHOLD;
+    baseline->time_threshold = kTIME_THRESHOLD;
+    file = fopen(path, "r");
+    if (file == NULL) {
+        if (missing_ok && errno == ENOENT)
+            return 0;
+        perror("Could not read baseline");
+        return -1;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if ((value = strstr(line, "\"case\"")) != NULL) {
+            if (host == NULL || host->count == kMAX_CASES)
+                continue;
+            result = &host->results[host->count];
+            if (sscanf(value, "\"case\" : \"%47[^\"]\"", result->name) != 1)
+                continue;
+            result->instr = ReadField(line, "\"instr\"", -1.0);
+            result->ns = ReadField(line, "\"ns\"", -1.0);
+            result->threshold = ReadField(line, "\"threshold\"", -1.0);
+            ++host->count;
+        } else if ((value = strstr(line, "\"host\"")) != NULL) {
+            if (baseline->hosts == kMAX_HOSTS) {
+                host = NULL;
+                continue;
+            }
+            host = &baseline->host[baseline->hosts++];
+            sscanf(value, "\"host\" : \"%255[^\"]\"", host->host);
+        } else {
+            baseline->instr_threshold = ReadField(line, "\"instr_threshold\"",
+                baseline->instr_threshold);
+            baseline->time_threshold = ReadField(line, "\"time_threshold\"",
+                baseline->time_threshold);
+        }
+    }
+    fclose(file);
+    return 0;
+}
+
+/* Record of the CPU model `host` in the baseline, NULL if there is none. */
+static host_baseline_t* FindHost(baseline_t* baseline, const char* host) {
+    size_t h;
+    for (h = 0; h < baseline->hosts; ++h) {
+        if (strcmp(baseline->host[h].host, host) == 0)
+            return &baseline->host[h];
+    }
+    return NULL;
+}
+
+/*!
+ * Compare every case present in both runs of the same CPU model: by
+ * instructions where both counted them, otherwise by time. Print a row per
+ * case.
+ *
+ * @param compared Output of the number of cases actually compared.
+ * @return Number of regressions.
+ */
+static int CheckBaseline(const baseline_t* baseline, const host_baseline_t* host,
+        const result_t* results, size_t count, size_t* compared) {
+    size_t i, b;
+    int regressions = 0;
+    double before, after, threshold, change;
+    const char* metric;
+    const char* verdict;
+
+    *compared = 0;
+    printf("%-34s %6s %11s %11s %8s  %s\n", "case", "metric", "baseline", "current",
+        "change", "verdict");
+    for (i = 0; i < count; ++i) {
+        for (b = 0; b < host->count; ++b) {
+            if (strcmp(host->results[b].name, results[i].name) == 0)
+                break;
+        }
+        if (b == host->count) {
+            printf("%-34s %6s %11s %11.2f %8s  new\n", results[i].name, "ns", "-",
+                results[i].ns, "-");
+            continue;
+        }
+        if (host->results[b].instr >= 0 && results[i].instr >= 0) {
+            metric = "instr";
+            before = host->results[b].instr;
+            after = results[i].instr;
+            threshold = baseline->instr_threshold;
+        } else {
+            metric = "ns";
+            before = host->results[b].ns;
+            after = results[i].ns;
+            threshold = baseline->time_threshold;
+        }
+        if (host->results[b].threshold >= 0)
+            threshold = host->results[b].threshold;
+        change = before > 0 ? after / before - 1.0 : 0.0;
+        if (change > threshold) {
+            verdict = "REGRESSION";
+            ++regressions;
+        } else {
+            verdict = "ok";
+        }
+        ++*compared;
+        printf("%-34s %6s %11.2f %11.2f %+7.1f%%  %s\n", results[i].name, metric, before,
+            after, change * 100, verdict);
+    }
+    return regressions;
+}
+
+int main(int argc, char** argv) {
+    size_t i, b, pass, compared, count = 0;
+    int option, regressions, update = FALSE, cpu = -1;
+    char host[kMAX_LINE];
+    uint8_t* buffer;
+    host_baseline_t* recorded;
+    static result_t results[kMAX_CASES], passes[kPASSES][kMAX_CASES];
+    static baseline_t baseline;
+
+    while ((option = getopt(argc, argv, "uc:")) != -1) {
+        switch (option) {
+        case 'u':
+            update = TRUE;
+            break;
+        case 'c':
+            cpu = atoi(optarg);
+            break;
+        default:
+            fputs(kUsage, stderr);
+            return 2;
+        }
+    }
+    if (optind + 1 != argc) {
+        fputs(kUsage, stderr);
+        return 2;
+    }
+    if (ReadBaseline(argv[optind], update, &baseline) != 0)
+        return 2;
+    CpuModel(host, sizeof(host));
+    recorded = FindHost(&baseline, host);
+    if (!update && recorded == NULL) {
+        /* Times of other models say nothing about this one. */
+        printf("No baseline for %s in %s, skipping the performance check.\n"
+            "Run \"make perf-baseline\" on this CPU model to record one.\n", host,
+            argv[optind]);
+        return 0;
+    }
+    if (update && recorded == NULL) {
+        if (baseline.hosts == kMAX_HOSTS) {
+            fprintf(stderr, "Baseline already records %d CPU models.\n", kMAX_HOSTS);
+            return 2;
+        }
+        recorded = &baseline.host[baseline.hosts++];
+        snprintf(recorded->host, sizeof(recorded->host), "%s", host);
+    }
+    buffer = (uint8_t*)malloc(kBUFFER_BYTES);
+    if (buffer == NULL) {
+        perror("Could not allocate check buffer.");
+        return 2;
+    }
+    for (i = 0; i < kBUFFER_BYTES; ++i)
+        buffer[i] = (uint8_t)(i * 131);
+
+    /* Modes run on the default engine, whatever the environment asks for. */
+    unsetenv("KALYNA_ENGINE");
+    unsetenv("KALYNA_TUNE");
+    cpu = PinThread(cpu);
+    OpenCounter();
+    printf("Performance check on %s, default engine %s\n", host, KalynaEngineSelect()->name);
+    if (cpu >= 0)
+        printf("Pinned to CPU %d, ", cpu);
+    else
+        printf("Not pinned, ");
+    printf("%s\n\n", instr_fd >= 0 ? "counting instructions" :
+        "timing only (perf counters not available)");
+
+    for (pass = 0; pass < kPASSES; ++pass)
+        count = MeasureAll(buffer, passes[pass]);
+    for (i = 0; i < count; ++i)
+        CombinePasses(passes, i, update, &results[i]);
+    free(buffer);
+    if (instr_fd >= 0)
+        close(instr_fd);
+
+    if (update) {
+        /* Keep the thresholds set by hand on cases of this model. */
+        for (i = 0; i < count; ++i) {
+            for (b = 0; b < recorded->count; ++b) {
+                if (strcmp(recorded->results[b].name, results[i].name) == 0)
+                    results[i].threshold = recorded->results[b].threshold;
+            }
+        }
+        memcpy(recorded->results, results, count * sizeof(result_t));
+        recorded->count = count;
+        if (WriteBaseline(argv[optind], &baseline) != 0)
+            return 2;
+        printf("Wrote baseline of %lu cases for %s to %s\n", (unsigned long)count, host,
+            argv[optind]);
+        return 0;
+    }
+    regressions = CheckBaseline(&baseline, recorded, results, count, &compared);
+    if (compared < count)
+        printf("\n%lu of %lu cases compared with the baseline\n", (unsigned long)compared,
+            (unsigned long)count);
+    if (compared == 0) {
+        /* A check that compares nothing must not pass. */
+        fprintf(stderr, "No case of %s matches this build. Run \"make perf-baseline\" "
+            "to record it again.\n", host);
+        printf("Failed performance check: nothing compared\n");
+        return 3;
+    }
+    if (regressions != 0) {
+        printf("Failed performance check: %d regressions\n", regressions);
+        return 1;
+    }
+    printf("Success performance check\n");
+    return 0;
+}
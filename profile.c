@@ -0,0 +1,321 @@
+/*
+
+Hardware performance counter profile of the Kalyna block cipher (DSTU 7624:2014) engines and modes
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "kalyna.h"
+#include "transformations.h"
+#include "engine.h"
+#include "kalyna_gcm.h"
+#include "kalyna_feedback.h"
+#include "kalyna_block128.h"
+
+/* Size of the buffer processed by a single call. */
+#define kBUFFER_BYTES (16 * 1024)
+
+/* Counters of generic events and raw events given on the command line. */
+#define kGENERIC_EVENTS 5
+#define kMAX_EVENTS (kGENERIC_EVENTS + 4)
+
+/* Indices of the generic events, see events[]. */
+#define kCYCLES 0
+#define kINSTRUCTIONS 1
+
+/* Block and key bit sizes of all Kalyna variants. */
+static const size_t variants[][2] = {
+    {128, 128}, {128, 256}, {256, 256}, {256, 512}, {512, 512}
+};
+
+#define kVARIANTS_NUM (sizeof(variants) / sizeof(variants[0]))
+
+static const char kUsage[] =
+    "Usage: kalyna-profile [-t SECONDS] [-r CONFIG[=NAME]]...\n"
+    "  -t  minimum measured time of each case, 0.2 s by default\n"
+    "  -r  count a raw PMU event, e.g. an L2 miss or port dispatch event of\n"
+    "      the microarchitecture, given as the hex config of perf_event_open\n";
+
+typedef struct {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+    int fd;  /* -1 if the event cannot be counted here. */
+} event_t;
+
+/* Generic events; L2 and port events have no generic encoding, see -r. */
+static event_t events[kMAX_EVENTS] = {
+    { "cyc", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1 },
+    { "instr", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1 },
+    { "L1d miss", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), -1 },
+    { "LLC miss", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), -1 },
+    { "br miss", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1 }
+};
+
+static size_t events_num = kGENERIC_EVENTS;
+
+/* Minimum measured time of a single case, seconds. */
+static double min_time = 0.2;
+
+/*!
+ * One profiled routine: processes `blocks` blocks of `buffer` per call.
+ * `engine` is set for engine cases and NULL for modes.
+ */
+typedef struct {
+    const char* name;
+    const kalyna_engine_t* engine;
+    int decipher;
+    int mode;
+    kalyna_t* ctx;
+    kalyna_block128_t* fast;
+    uint8_t* buffer;
+    size_t blocks;
+} profile_case_t;
+
+/* Modes profiled with the selected engine. */
+#define kMODE_ECB 0
+#define kMODE_CTR 1
+#define kMODE_CFB_ENCRYPT 2
+#define kMODE_CFB_DECRYPT 3
+#define kMODE_OFB 4
+#define kMODE_GCM 5
+#define kMODE_BLOCK128 6
+#define kMODES_NUM 7
+
+static const char* const mode_names[kMODES_NUM] = {
+    "ECB bytes", "CTR", "CFB enc", "CFB dec", "OFB", "GCM enc", "block128"
+};
+
+
+static double Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*!
+ * Open every event counting the calling thread in user space. Events the
+ * kernel or the PMU refuse are left closed and printed as "n/a".
+ */
+static void OpenEvents(void) {
+#if defined(__linux__) && defined(SYS_perf_event_open)
+    size_t e;
+    struct perf_event_attr attr;
+
+    for (e = 0; e < events_num; ++e) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[e].type;
+        attr.config = events[e].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        events[e].fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+}
+
+static void CloseEvents(void) {
+    size_t e;
+    for (e = 0; e < events_num; ++e) {
+        if (events[e].fd >= 0)
+            close(events[e].fd);
+    }
+}
+
+static void RunCase(const profile_case_t* c) {
+    uint8_t iv[kNB_512 * sizeof(uint64_t)], tag[kNB_512 * sizeof(uint64_t)];
+    size_t i, block_len = c->ctx->nb * sizeof(uint64_t);
+    size_t length = c->blocks * block_len;
+
+    memset(iv, 0, sizeof(iv));
+    if (c->engine != NULL) {
+        if (c->decipher)
+            c->engine->decipher((uint64_t*)c->buffer, c->blocks, c->ctx, (uint64_t*)c->buffer);
+        else
+            c->engine->encipher((uint64_t*)c->buffer, c->blocks, c->ctx, (uint64_t*)c->buffer);
+        return;
+    }
+    switch (c->mode) {
+    case kMODE_ECB:
+        KalynaEncryptBytes(c->buffer, length, c->ctx, c->buffer);
+        break;
+    case kMODE_CTR:
+        KalynaCtrBytes(c->buffer, length, iv, c->ctx, c->buffer);
+        break;
+    case kMODE_CFB_ENCRYPT:
+        KalynaCfbEncrypt(c->buffer, length, iv, block_len * kBITS_IN_BYTE, c->ctx, c->buffer);
+        break;
+    case kMODE_CFB_DECRYPT:
+        KalynaCfbDecrypt(c->buffer, length, iv, block_len * kBITS_IN_BYTE, c->ctx, c->buffer);
+        break;
+    case kMODE_OFB:
+        KalynaOfbBytes(c->buffer, length, iv, c->ctx, c->buffer);
+        break;
+    case kMODE_GCM:
+        KalynaGcmEncrypt(c->ctx, iv, NULL, 0, c->buffer, length, c->buffer, tag);
+        break;
+    default:
+        for (i = 0; i < length; i += block_len)
+            KalynaBlock128Encipher(c->fast, c->buffer + i, c->buffer + i);
+        break;
+    }
+}
+
+/*!
+ * Run a case until the minimum time elapses with all counters enabled and
+ * print its row: time and every event per block, and instructions per
+ * cycle. Counts are scaled up if the kernel multiplexed the counters.
+ */
+static void ProfileCase(const profile_case_t* c) {
+    size_t e;
+    unsigned long calls = 0;
+    double start, elapsed, blocks, scaled[kMAX_EVENTS];
+    uint64_t values[3];  /* Count, time enabled, time running. */
+
+    RunCase(c);  /* Warm up caches. */
+    for (e = 0; e < events_num; ++e) {
+        if (events[e].fd >= 0) {
+            ioctl(events[e].fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(events[e].fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    start = Now();
+    do {
+        RunCase(c);
+        ++calls;
+        elapsed = Now() - start;
+    } while (elapsed < min_time);
+    blocks = (double)calls * c->blocks;
+    for (e = 0; e < events_num; ++e) {
+        scaled[e] = -1.0;
+        if (events[e].fd < 0)
+            continue;
+        ioctl(events[e].fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(events[e].fd, values, sizeof(values)) == sizeof(values) && values[2] > 0)
+            scaled[e] = (double)values[0] * values[1] / values[2] / blocks;
+    }
+
+    printf("%-22s %9.1f", c->name, elapsed * 1e9 / blocks);
+    for (e = 0; e < events_num; ++e) {
+        if (scaled[e] < 0)
+            printf(" %10s", "n/a");
+        else
+            printf(" %10.2f", scaled[e]);
+    }
+    if (scaled[kCYCLES] > 0 && scaled[kINSTRUCTIONS] >= 0)
+        printf(" %6.2f\n", scaled[kINSTRUCTIONS] / scaled[kCYCLES]);
+    else
+        printf(" %6s\n", "n/a");
+}
+
+static void PrintHeader(size_t block_size, size_t key_size) {
+    size_t e;
+    printf("\nKalyna-%lu/%lu, per block:\n", (unsigned long)block_size,
+        (unsigned long)key_size);
+    printf("%-22s %9s", "case", "ns");
+    for (e = 0; e < events_num; ++e)
+        printf(" %10s", events[e].name);
+    printf(" %6s\n", "IPC");
+}
+
+int main(int argc, char** argv) {
+    size_t v, e, m, i;
+    int option;
+    char* name;
+    uint64_t key[kNK_512];
+    uint8_t* buffer = (uint8_t*)malloc(kBUFFER_BYTES);
+    char label[kMAX_EVENTS][32];
+    char case_names[2][32];
+    kalyna_block128_t fast;
+    profile_case_t c;
+
+    while ((option = getopt(argc, argv, "t:r:")) != -1) {
+        switch (option) {
+        case 't':
+            min_time = strtod(optarg, NULL);
+            break;
+        case 'r':
+            if (events_num == kMAX_EVENTS) {
+                fputs("Too many raw events.\n", stderr);
+                return 2;
+            }
+            events[events_num].type = PERF_TYPE_RAW;
+            events[events_num].config = strtoull(optarg, &name, 16);
+            snprintf(label[events_num], sizeof(label[events_num]), "%s",
+                *name == '=' ? name + 1 : optarg);
+            events[events_num].name = label[events_num];
+            events[events_num].fd = -1;
+            ++events_num;
+            break;
+        default:
+            fputs(kUsage, stderr);
+            return 2;
+        }
+    }
+    if (buffer == NULL) {
+        perror("Could not allocate profile buffer.");
+        return 1;
+    }
+    for (i = 0; i < kBUFFER_BYTES; ++i)
+        buffer[i] = (uint8_t)(i * 131);
+    for (i = 0; i < kNK_512; ++i)
+        key[i] = i * 0x0101010101010101ULL;
+
+    OpenEvents();
+    if (events[kCYCLES].fd < 0)
+        printf("Hardware counters are not available (perf_event_paranoid, container or "
+            "virtual machine), only time is measured.\n");
+    printf("Selected engine: %s\n", KalynaEngineSelect()->name);
+
+    memset(&c, 0, sizeof(c));
+    c.buffer = buffer;
+    c.fast = &fast;
+    for (v = 0; v < kVARIANTS_NUM; ++v) {
+        c.ctx = KalynaInit(variants[v][0], variants[v][1]);
+        KalynaKeyExpand(key, c.ctx);
+        c.blocks = kBUFFER_BYTES / (c.ctx->nb * sizeof(uint64_t));
+        PrintHeader(variants[v][0], variants[v][1]);
+
+        for (e = 0; kalyna_engines[e] != NULL; ++e) {
+            c.engine = KalynaEngineFind(kalyna_engines[e]->name);
+            if (c.engine == NULL)
+                continue;
+            for (c.decipher = 0; c.decipher <= 1; ++c.decipher) {
+                snprintf(case_names[c.decipher], sizeof(case_names[c.decipher]), "%s %s",
+                    c.engine->name, c.decipher ? "dec" : "enc");
+                c.name = case_names[c.decipher];
+                ProfileCase(&c);
+            }
+        }
+
+        c.engine = NULL;
+        for (m = 0; m < kMODES_NUM; ++m) {
+            if (m == kMODE_BLOCK128 && KalynaBlock128Load(&fast, c.ctx) != 0)
+                continue;
+            c.mode = (int)m;
+            c.name = mode_names[m];
+            ProfileCase(&c);
+        }
+        KalynaDelete(c.ctx);
+    }
+
+    CloseEvents();
+    free(buffer);
+    return 0;
+}
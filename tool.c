@@ -0,0 +1,229 @@
+/*
+
+kalyna-tool, sealing and opening seekable containers of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#include "kalyna.h"
+#include "kalyna_container.h"
+#include "arena.h"
+
+#define kMAX_KEY 64  /* Maximum byte length of a key. */
+#define kMAX_HEX_LINE 256
+#define kIO_BYTES (1024 * 1024)  /* Bytes moved per read or write. */
+
+static const char kUsage[] =
+    "Usage: kalyna-tool seal [-b block bits] [-k key bits] [-c chunk bytes] [-t threads] KEYFILE\n"
+    "           < plaintext > container\n"
+    "       kalyna-tool open [-b block bits] [-k key bits] [-t threads] [-o offset] [-n length]\n"
+    "           KEYFILE CONTAINER > plaintext\n"
+    "KEYFILE holds the key in hexadecimal, bytes of 64-bit words little endian.\n";
+
+
+/*!
+ * Read a hexadecimal key from a file and create a context with it.
+ *
+ * @return Cipher context or NULL in case of error.
+ */
+static kalyna_t* LoadKey(const char* path, size_t block_bits, size_t key_bits) {
+    FILE* file;
+    char line[kMAX_HEX_LINE];
+    char* hex = line;
+    uint8_t bytes[kMAX_KEY];
+    uint64_t key[kMAX_KEY / sizeof(uint64_t)];
+    size_t i, length = 0;
+    unsigned int byte;
+    kalyna_t* ctx;
+
+    file = fopen(path, "r");
+    if (file == NULL) {
+        perror("Could not open key file");
+        return NULL;
+    }
+    memset(bytes, 0, sizeof(bytes));
+    if (fgets(line, sizeof(line), file) == NULL)
+        line[0] = '\0';
+    fclose(file);
+    while (isxdigit((unsigned char)hex[0]) && isxdigit((unsigned char)hex[1]) &&
+            length < sizeof(bytes) && sscanf(hex, "%2x", &byte) == 1) {
+        bytes[length++] = (uint8_t)byte;
+        hex += 2;
+    }
+    if (length * 8 != key_bits || !(*hex == '\0' || isspace((unsigned char)*hex))) {
+        fprintf(stderr, "Key file must hold a %zu-bit hexadecimal key\n", key_bits);
+        ctx = NULL;
+    } else {
+        ctx = KalynaInit(block_bits, key_bits);
+    }
+    if (ctx != NULL) {
+        memset(key, 0, sizeof(key));
+        for (i = 0; i < length; ++i)
+            key[i / sizeof(uint64_t)] |= (uint64_t)bytes[i] << (8 * (i % sizeof(uint64_t)));
+        KalynaKeyExpand(key, ctx);
+    }
+    /* A plain memset of buffers not read afterwards may be dropped. */
+    SecureWipe(bytes, sizeof(bytes));
+    SecureWipe(key, sizeof(key));
+    SecureWipe(line, sizeof(line));
+    return ctx;
+}
+
+/* Stream standard input into a container on standard output. */
+static int Seal(kalyna_t* ctx, size_t chunk_bytes, size_t threads) {
+    ssize_t length;
+    int result = 0;
+    uint8_t* buffer;
+    kalyna_writer_t* writer;
+
+    buffer = (uint8_t*)malloc(kIO_BYTES);
+    if (buffer == NULL) {
+        perror("Could not allocate memory for input");
+        return -1;
+    }
+    writer = KalynaWriterOpen(ctx, STDOUT_FILENO, chunk_bytes, threads);
+    if (writer == NULL) {
+        free(buffer);
+        return -1;
+    }
+    while ((length = read(STDIN_FILENO, buffer, kIO_BYTES)) != 0) {
+        if (length < 0) {
+            perror("Could not read input");
+            result = -1;
+            break;
+        }
+        if (KalynaWriterWrite(writer, buffer, (size_t)length) != 0) {
+            result = -1;
+            break;
+        }
+    }
+    if (KalynaWriterClose(writer) != 0)
+        result = -1;
+    free(buffer);
+    return result;
+}
+
+/* Print an error of the container reader. */
+static void ReportReader(int error, const char* path) {
+    switch (error) {
+    case KALYNA_CONTAINER_IO:
+        fprintf(stderr, "Could not open container %s: %s\n", path, strerror(errno));
+        break;
+    case KALYNA_CONTAINER_MALFORMED:
+        fprintf(stderr, "Malformed container %s\n", path);
+        break;
+    case KALYNA_CONTAINER_CORRUPT:
+        fprintf(stderr, "Corrupt container %s\n", path);
+        break;
+    default:
+        fprintf(stderr, "Could not read container %s\n", path);
+        break;
+    }
+}
+
+/* Write a byte range of a container to standard output. */
+static int Open(kalyna_t* ctx, const char* path, size_t threads, uint64_t offset,
+        uint64_t length) {
+    uint64_t total, end, chunk;
+    int error, result = 0;
+    uint8_t* buffer;
+    kalyna_reader_t* reader;
+
+    error = KalynaReaderOpen(ctx, path, threads, &reader);
+    if (error != 0) {
+        ReportReader(error, path);
+        return -1;
+    }
+    total = KalynaReaderLength(reader);
+    if (offset > total) {
+        fprintf(stderr, "Offset is beyond the end of %s\n", path);
+        KalynaReaderClose(reader);
+        return -1;
+    }
+    end = length > total - offset ? total : offset + length;
+    buffer = (uint8_t*)malloc(kIO_BYTES);
+    if (buffer == NULL) {
+        perror("Could not allocate memory for output");
+        KalynaReaderClose(reader);
+        return -1;
+    }
+    for (; offset < end && result == 0; offset += chunk) {
+        chunk = end - offset < kIO_BYTES ? end - offset : kIO_BYTES;
+        error = KalynaReaderRead(reader, offset, buffer, (size_t)chunk);
+        if (error != 0) {
+            ReportReader(error, path);
+            result = -1;
+        } else if (fwrite(buffer, 1, (size_t)chunk, stdout) != chunk) {
+            perror("Could not write output");
+            result = -1;
+        }
+    }
+    free(buffer);
+    KalynaReaderClose(reader);
+    return result;
+}
+
+
+int main(int argc, char** argv) {
+    int option, result;
+    size_t block_bits = 128, key_bits = 128, threads = 1;
+    size_t chunk_bytes = KALYNA_CONTAINER_CHUNK;
+    uint64_t offset = 0, length = UINT64_MAX;
+    int seal;
+    kalyna_t* ctx;
+
+    if (argc < 2 || (strcmp(argv[1], "seal") != 0 && strcmp(argv[1], "open") != 0)) {
+        fputs(kUsage, stderr);
+        return 2;
+    }
+    seal = strcmp(argv[1], "seal") == 0;
+    optind = 2;
+    while ((option = getopt(argc, argv, "b:k:c:t:o:n:")) != -1) {
+        switch (option) {
+        case 'b':
+            block_bits = strtoul(optarg, NULL, 10);
+            break;
+        case 'k':
+            key_bits = strtoul(optarg, NULL, 10);
+            break;
+        case 'c':
+            chunk_bytes = strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            threads = strtoul(optarg, NULL, 10);
+            break;
+        case 'o':
+            offset = strtoull(optarg, NULL, 10);
+            break;
+        case 'n':
+            length = strtoull(optarg, NULL, 10);
+            break;
+        default:
+            fputs(kUsage, stderr);
+            return 2;
+        }
+    }
+    if (argc - optind != (seal ? 1 : 2)) {
+        fputs(kUsage, stderr);
+        return 2;
+    }
+
+    ctx = LoadKey(argv[optind], block_bits, key_bits);
+    if (ctx == NULL)
+        return 1;
+    if (seal)
+        result = Seal(ctx, chunk_bytes, threads);
+    else
+        result = Open(ctx, argv[optind + 1], threads, offset, length);
+    KalynaDelete(ctx);
+    if (fflush(stdout) != 0)
+        result = -1;
+    return result == 0 ? 0 : 1;
+}
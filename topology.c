@@ -0,0 +1,176 @@
+/*
+
+NUMA topology helpers of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "topology.h"
+
+/* Size of a huge page on common systems. */
+#define kHUGE_PAGE_BYTES (2 * 1024 * 1024)
+
+/* Memory policy of mbind(2) placing pages on a node while it has room. */
+#define kMPOL_PREFERRED 1
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+static size_t node_count = 1;
+#ifdef CPU_SETSIZE
+static uint8_t cpu_node[CPU_SETSIZE];
+#endif
+static pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+
+
+#ifdef __linux__
+/*!
+ * Read a sysfs list such as "0-3,8-11" into a CPU set.
+ *
+ * @param last Largest number of the list.
+ * @return Zero in case of success.
+ */
+static int ReadList(const char* path, cpu_set_t* set, size_t* last) {
+    FILE* file = fopen(path, "r");
+    unsigned long first, end;
+    int separator, result = -1;
+
+    if (file == NULL)
+        return -1;
+    CPU_ZERO(set);
+    *last = 0;
+    while (fscanf(file, "%lu", &first) == 1) {
+        end = first;
+        separator = fgetc(file);
+        if (separator == '-') {
+            if (fscanf(file, "%lu", &end) != 1)
+                break;
+            separator = fgetc(file);
+        }
+        for (; first <= end && first < CPU_SETSIZE; ++first)
+            CPU_SET(first, set);
+        *last = end > *last ? end : *last;
+        result = 0;
+        if (separator != ',')
+            break;
+    }
+    fclose(file);
+    return result;
+}
+
+static void LoadTopology(void) {
+    char path[64];
+    size_t node, cpu, last;
+    cpu_set_t set;
+
+    if (ReadList("/sys/devices/system/node/online", &set, &last) != 0)
+        return;
+    node_count = last + 1 < kMAX_NODES ? last + 1 : kMAX_NODES;
+    for (node = 1; node < node_count; ++node) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%lu/cpulist",
+            (unsigned long)node);
+        if (ReadList(path, &set, &last) != 0)
+            continue;
+        for (cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set))
+                cpu_node[cpu] = (uint8_t)node;
+        }
+    }
+}
+#else
+static void LoadTopology(void) {
+}
+#endif
+
+size_t NodeCount(void) {
+    pthread_once(&topology_once, LoadTopology);
+    return node_count;
+}
+
+size_t NodeCurrent(void) {
+#ifdef __linux__
+    int cpu;
+    if (NodeCount() == 1)
+        return 0;
+    cpu = sched_getcpu();
+    return cpu < 0 || cpu >= CPU_SETSIZE ? 0 : cpu_node[cpu];
+#else
+    return 0;
+#endif
+}
+
+/* Byte length of the mapping holding `bytes`. */
+static size_t MappedBytes(size_t bytes) {
+#ifdef KALYNA_HUGE_TABLES
+    size_t page = kHUGE_PAGE_BYTES;
+#else
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+    return (bytes + page - 1) / page * page;
+}
+
+void* NodeAlloc(size_t bytes, size_t node) {
+    void* data = MAP_FAILED;
+#ifdef __linux__
+    unsigned long mask = 1UL << node;
+#endif
+
+    bytes = MappedBytes(bytes);
+#if defined(KALYNA_HUGE_TABLES) && defined(MAP_HUGETLB)
+    data = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (data == MAP_FAILED) {
+        data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED)
+            return NULL;
+#if defined(KALYNA_HUGE_TABLES) && defined(MADV_HUGEPAGE)
+        madvise(data, bytes, MADV_HUGEPAGE);
+#endif
+    }
+#if defined(__linux__) && defined(SYS_mbind)
+    /* Pages are placed when first touched; fails harmlessly without NUMA. */
+    if (NodeCount() > 1)
+        syscall(SYS_mbind, data, bytes, kMPOL_PREFERRED, &mask, sizeof(mask) * 8, 0);
+#endif
+    return data;
+}
+
+void NodeFree(void* data, size_t bytes) {
+    munmap(data, MappedBytes(bytes));
+}
+
+int NodeBindThread(size_t node) {
+#ifdef __linux__
+    char path[64];
+    size_t last;
+    cpu_set_t set;
+
+    if (node >= NodeCount())
+        return -1;
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%lu/cpulist",
+        (unsigned long)node);
+    if (ReadList(path, &set, &last) != 0)
+        return -1;
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 ? 0 : -1;
+#else
+    return -1;
+#endif
+}
@@ -0,0 +1,49 @@
+/*
+
+Header file for the NUMA topology helpers of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef KALYNA_TOPOLOGY_H
+#define KALYNA_TOPOLOGY_H
+
+#include <stddef.h>
+
+/* Maximum number of NUMA nodes given their own replicas. */
+#define kMAX_NODES 8
+
+/*!
+ * Number of NUMA nodes of the host, 1 if unknown or on other systems.
+ * Nodes past kMAX_NODES are folded onto node 0.
+ */
+size_t NodeCount(void);
+
+/*!
+ * Node of the CPU the calling thread runs on, below NodeCount().
+ */
+size_t NodeCurrent(void);
+
+/*!
+ * Map zeroed memory preferring the pages of `node`. With KALYNA_HUGE_TABLES
+ * defined ("make HUGE_TABLES=1") the mapping is backed by 2 MiB pages where
+ * the system allows it.
+ *
+ * @return Page aligned memory or NULL in case of error.
+ */
+void* NodeAlloc(size_t bytes, size_t node);
+
+/*!
+ * Unmap memory of NodeAlloc().
+ */
+void NodeFree(void* data, size_t bytes);
+
+/*!
+ * Restrict the calling thread to the CPUs of `node`.
+ *
+ * @return Zero in case of success, -1 if the node or its CPUs are unknown.
+ */
+int NodeBindThread(size_t node);
+
+#endif  /* KALYNA_TOPOLOGY_H */
@@ -30,6 +30,23 @@ Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
 
 #define kBITS_IN_BYTE 8
 
+/* Host byte order, resolved at compile time. */
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__)
+#if (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define kBIG_ENDIAN 1
+#else
+#define kBIG_ENDIAN 0
+#endif
+#elif defined(__BIG_ENDIAN__) || defined(__ARMEB__) || defined(__MIPSEB__) || \
+    defined(__s390__) || defined(__sparc__)
+#define kBIG_ENDIAN 1
+#elif defined(__LITTLE_ENDIAN__) || defined(__x86_64__) || defined(__i386__) || \
+    defined(_M_X64) || defined(_M_IX86) || defined(_M_ARM64) || defined(__aarch64__)
+#define kBIG_ENDIAN 0
+#else
+#error "Unknown byte order. Define kBIG_ENDIAN to 0 or 1."
+#endif
+
 #define TRUE 1
 #define FALSE 0
 
@@ -65,6 +82,13 @@ Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
  */
 #define INDEX(table, row, col) table[(row) + (col) * sizeof(uint64_t)]
 
+/*!
+ * Extract a byte of the cipher state column word. The state matrix row
+ * number is the byte number of the word in little endian, so the shift-based
+ * access works on native words regardless of the host byte order.
+ */
+#define STATE_BYTE(word, row) ((uint8_t)((word) >> ((row) * kBITS_IN_BYTE)))
+
 
 /*!
  * Substitute each byte of the cipher state using corresponding S-Boxes.
@@ -272,6 +296,33 @@ void KeyExpandEven(uint64_t* key, uint64_t* kt, kalyna_t* ctx);
  */
 void KeyExpandOdd(kalyna_t* ctx);
 
+/*!
+ * Compute deciphering round keys for table-driven engines by applying
+ * InvMixColumns to each round key and store them in cipher context `ctx`.
+ *
+ * @param ctx Initialized cipher context with round keys computed.
+ */
+void KeyExpandInverse(kalyna_t* ctx);
+
+/*!
+ * KalynaEncipher() working in `state` instead of the state of `ctx`, so that
+ * threads sharing a context may call it concurrently.
+ *
+ * @param plaintext Plaintext of length Nb words.
+ * @param ctx Initialized cipher context with precomputed round keys, only
+ * read.
+ * @param state Scratch state of Nb words.
+ * @param ciphertext The result of enciphering.
+ */
+void EncipherWithState(const uint64_t* plaintext, const kalyna_t* ctx, uint64_t* state,
+    uint64_t* ciphertext);
+
+/*!
+ * KalynaDecipher() working in `state`, see EncipherWithState().
+ */
+void DecipherWithState(const uint64_t* ciphertext, const kalyna_t* ctx, uint64_t* state,
+    uint64_t* plaintext);
+
 /*!
  * Convert array of 64-bit words to array of bytes.
  * Each word is interpreted as byte sequence following little endian
@@ -296,6 +347,106 @@ uint8_t* WordsToBytes(size_t length, uint64_t* words);
  */
 uint64_t* BytesToWords(size_t length, uint8_t* bytes);
 
+/*!
+ * Copy little endian bytes into an array of 64-bit words.
+ * Unlike BytesToWords() the source buffer is left intact and may have any
+ * alignment.
+ *
+ * @param length Length of 64-bit words array.
+ * @param bytes Source bytes array of length * 8 bytes.
+ * @param words Destination 64-bit words array.
+ */
+void ReadWords(size_t length, const uint8_t* bytes, uint64_t* words);
+
+/*!
+ * Copy an array of 64-bit words into little endian bytes.
+ * Unlike WordsToBytes() the source words are left intact and the destination
+ * buffer may have any alignment.
+ *
+ * @param length Length of 64-bit words array.
+ * @param words Source 64-bit words array.
+ * @param bytes Destination bytes array of length * 8 bytes.
+ */
+void WriteWords(size_t length, const uint64_t* words, uint8_t* bytes);
+
+/*!
+ * Create a context of a valid variant in an arena slot.
+ *
+ * @param nb Number of words in block.
+ * @param nk Number of words in key.
+ * @param nr Number of rounds.
+ * @param keys 2 * (`nr` + 1) * `nb` words holding the encipher round keys
+ * followed by the decipher round keys, used in place and not released with
+ * the context; NULL to keep the round keys in the slot.
+ * @return Cipher context or NULL if no memory is available.
+ */
+kalyna_t* ContextInit(size_t nb, size_t nk, size_t nr, uint64_t* keys);
+
+/*!
+ * Fill counter mode input blocks: for each block increment the counter as a
+ * little endian number modulo 2^{block bits} and copy it out. Enciphering
+ * the blocks gives the gamma.
+ *
+ * @param counter Counter of `nb` words, advanced by `blocks`.
+ * @param blocks Number of blocks.
+ * @param nb Number of words in block.
+ * @param output Output of `blocks` * `nb` words.
+ */
+void CtrCounters(uint64_t* counter, size_t blocks, size_t nb, uint64_t* output);
+
+/*!
+ * Byte length from which KalynaEncryptBytes(), KalynaDecryptBytes() and
+ * KalynaCtrBytes() prefetch the input and write the output with
+ * non-temporal stores, the size of the last level cache by default. The
+ * output must also be 16-byte aligned, and the stores need SSE2.
+ *
+ * @param bytes New threshold, for tests and benchmarks, or 0 to keep it.
+ * It may be changed while other threads encrypt; calls already running keep
+ * the threshold they read.
+ * @return Threshold in effect.
+ */
+size_t StreamingThreshold(size_t bytes);
+
+/*!
+ * XOR bytes with the little endian bytes of gamma words.
+ *
+ * @param length Number of bytes, need not be a multiple of the word size.
+ * @param input Input bytes, any alignment.
+ * @param gamma Gamma words covering at least `length` bytes.
+ * @param output Output bytes, may be the same buffer as `input`.
+ */
+void XorGamma(size_t length, const uint8_t* input, const uint64_t* gamma,
+    uint8_t* output);
+
+/*!
+ * Multiply a block by x in GF(2^{64 nb}), the block taken as a little endian
+ * number, with the polynomials x^128 + x^7 + x^2 + x + 1,
+ * x^256 + x^10 + x^5 + x^2 + 1 and x^512 + x^8 + x^5 + x^2 + 1.
+ *
+ * @param nb Number of words in block.
+ * @param input Block of `nb` words.
+ * @param output Product, may be the same array as `input`.
+ */
+void DoubleBlock(size_t nb, const uint64_t* input, uint64_t* output);
+
+/*!
+ * CMAC (NIST SP 800-38B) of bytes with the conventions of kalyna_tree_mac.h:
+ * blocks are read as little endian words and subkeys come from
+ * DoubleBlock().
+ *
+ * @param ctx Context with the MAC key.
+ * @param data Message bytes, may be NULL if `length` is 0.
+ * @param length Byte length of the message.
+ * @param tag Output of Nb words.
+ */
+void Cmac(kalyna_t* ctx, const uint8_t* data, size_t length, uint64_t* tag);
+
+/*!
+ * Low word of the reduction polynomial of GF(2^{64 nb}) used by
+ * DoubleBlock(), without the leading term.
+ */
+#define REDUCTION(nb) ((nb) == kNB_128 ? 0x87 : (nb) == kNB_256 ? 0x425 : 0x125)
+
 /*!
  * Reverse bytes ordering that form the word.
  *
@@ -307,6 +458,8 @@ uint64_t ReverseWord(uint64_t word);
 
 /*!
  * Check if architecture follows big endian convention.
+ * The byte order is known at compile time (see kBIG_ENDIAN), so the function
+ * is kept for API compatibility only.
  *
  * @return 1 if architecture is big endian, 0 if it is little endian.
  */
@@ -0,0 +1,710 @@
+/*
+
+Table-driven round engine of the Kalyna block cipher (DSTU 7624:2014), all block and key length variants
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <pthread.h>
+
+#include "ttable.h"
+#include "transformations.h"
+#include "tables.h"
+#include "kalyna_block128.h"
+#include "topology.h"
+
+
+/* Names of the multi-block kernels carry the suffix of the -march variant. */
+#define TTABLE_CONCAT_(name, suffix) name##suffix
+#define TTABLE_CONCAT(name, suffix) TTABLE_CONCAT_(name, suffix)
+#ifdef TTABLE_VARIANT
+#define TTABLE_KERNEL(name) TTABLE_CONCAT(name, TTABLE_VARIANT)
+#else
+#define TTABLE_KERNEL(name) name
+#endif
+
+/* ShiftRows offset of the state row for a block of `nb` columns. */
+#define SHIFT(row, nb) ((row) * (nb) / sizeof(uint64_t))
+
+/* Column from which ShiftRows moves the byte at `row` into column `col`. */
+#define SHIFTED(col, row, nb) (((col) + (nb) - SHIFT(row, nb)) % (nb))
+
+/*
+ * Round functions are inlined with a constant block size; unrolling the
+ * loops over state columns and rows turns all state indices into constants.
+ */
+#if defined(__GNUC__) && (__GNUC__ >= 8) && !defined(__clang__)
+#define UNROLL _Pragma("GCC unroll 8")
+#define UNROLL_ROUNDS _Pragma("GCC unroll 16")
+#elif defined(__clang__)
+#define UNROLL _Pragma("unroll")
+#define UNROLL_ROUNDS _Pragma("unroll")
+#else
+#define UNROLL
+#define UNROLL_ROUNDS
+#endif
+
+/*
+ * The multi-buffer routines are too large for the inlining heuristics, but
+ * are only fast once specialized for a constant block size.
+ */
+#if defined(__GNUC__)
+#define FORCE_INLINE inline __attribute__((always_inline))
+#else
+#define FORCE_INLINE inline
+#endif
+
+/* Column from which InvShiftRows moves the byte at `row` into column `col`. */
+#define INV_SHIFTED(col, row, nb) (((col) + SHIFT(row, nb)) % (nb))
+
+/*
+ * Table layouts of the round functions, fixed per kernel at compile time:
+ * all eight tables, the tables of rows 0-3 with rows 4-7 obtained by a
+ * 32-bit rotation (the MDS matrix is circulant and rows 4-7 use the S-boxes
+ * of rows 0-3), or byte S-boxes with MixColumns computed on the fly.
+ */
+#define kLAYOUT_FULL 0
+#define kLAYOUT_ROTATE 1
+#define kLAYOUT_COMPACT 2
+
+/* Rotation of a word to the right, `bits` below 64. */
+#define ROTATE_RIGHT(word, bits) (((word) >> (bits)) | ((word) << ((64 - (bits)) & 63)))
+
+/* First rows of the MDS matrices, the other rows are their rotations. */
+static const uint8_t mds_row[8] = { 0x01, 0x01, 0x05, 0x01, 0x08, 0x06, 0x07, 0x04 };
+static const uint8_t mds_inv_row[8] = { 0xAD, 0x95, 0x76, 0xA8, 0x2F, 0x49, 0xD7, 0xCA };
+
+
+/* Multiply every byte of a word by x in GF(2^8). */
+static inline uint64_t MultiplyX(uint64_t word) {
+    uint64_t high = word & 0x8080808080808080ULL;
+    return ((word ^ high) << 1) ^ ((high >> 7) * (kREDUCTION_POLYNOMIAL & 0xFF));
+}
+
+/*
+ * Multiply one state column by a circulant MDS matrix without tables: byte
+ * `row` of the result collects row[d] * byte (row + d) for all d.
+ */
+static FORCE_INLINE uint64_t MixColumnWord(uint64_t column, const uint8_t* row) {
+    uint64_t powers[kBITS_IN_BYTE], product, result = 0;
+    int d, bit;
+    powers[0] = column;
+    UNROLL
+    for (bit = 1; bit < kBITS_IN_BYTE; ++bit)
+        powers[bit] = MultiplyX(powers[bit - 1]);
+    UNROLL
+    for (d = 0; d < sizeof(uint64_t); ++d) {
+        product = 0;
+        UNROLL
+        for (bit = 0; bit < kBITS_IN_BYTE; ++bit) {
+            if ((row[d] >> bit) & 1)
+                product ^= powers[bit];
+        }
+        result ^= ROTATE_RIGHT(product, d * kBITS_IN_BYTE);
+    }
+    return result;
+}
+
+
+/* SubBytes, ShiftRows and MixColumns of the whole state. */
+static inline void EncipherRoundT(const ttable_set_t* tt, const uint64_t* in, uint64_t* out,
+        size_t nb, int layout) {
+    size_t col;
+    int row;
+    uint64_t column;
+    UNROLL
+    for (col = 0; col < nb; ++col) {
+        if (layout == kLAYOUT_FULL) {
+            out[col] = tt->enc[0][STATE_BYTE(in[SHIFTED(col, 0, nb)], 0)] ^
+                tt->enc[1][STATE_BYTE(in[SHIFTED(col, 1, nb)], 1)] ^
+                tt->enc[2][STATE_BYTE(in[SHIFTED(col, 2, nb)], 2)] ^
+                tt->enc[3][STATE_BYTE(in[SHIFTED(col, 3, nb)], 3)] ^
+                tt->enc[4][STATE_BYTE(in[SHIFTED(col, 4, nb)], 4)] ^
+                tt->enc[5][STATE_BYTE(in[SHIFTED(col, 5, nb)], 5)] ^
+                tt->enc[6][STATE_BYTE(in[SHIFTED(col, 6, nb)], 6)] ^
+                tt->enc[7][STATE_BYTE(in[SHIFTED(col, 7, nb)], 7)];
+        } else if (layout == kLAYOUT_ROTATE) {
+            column = tt->enc[0][STATE_BYTE(in[SHIFTED(col, 4, nb)], 4)] ^
+                tt->enc[1][STATE_BYTE(in[SHIFTED(col, 5, nb)], 5)] ^
+                tt->enc[2][STATE_BYTE(in[SHIFTED(col, 6, nb)], 6)] ^
+                tt->enc[3][STATE_BYTE(in[SHIFTED(col, 7, nb)], 7)];
+            out[col] = tt->enc[0][STATE_BYTE(in[SHIFTED(col, 0, nb)], 0)] ^
+                tt->enc[1][STATE_BYTE(in[SHIFTED(col, 1, nb)], 1)] ^
+                tt->enc[2][STATE_BYTE(in[SHIFTED(col, 2, nb)], 2)] ^
+                tt->enc[3][STATE_BYTE(in[SHIFTED(col, 3, nb)], 3)] ^
+                ROTATE_RIGHT(column, 32);
+        } else {
+            column = 0;
+            UNROLL
+            for (row = 0; row < sizeof(uint64_t); ++row) {
+                column |= (uint64_t)sboxes_enc[row % 4][STATE_BYTE(in[SHIFTED(col, row, nb)], row)]
+                    << (row * kBITS_IN_BYTE);
+            }
+            out[col] = MixColumnWord(column, mds_row);
+        }
+    }
+}
+
+/* InvShiftRows, InvSubBytes and InvMixColumns of the whole state. */
+static inline void DecipherRoundT(const ttable_set_t* tt, const uint64_t* in, uint64_t* out,
+        size_t nb, int layout) {
+    size_t col;
+    int row;
+    uint64_t column;
+    UNROLL
+    for (col = 0; col < nb; ++col) {
+        if (layout == kLAYOUT_FULL) {
+            out[col] = tt->dec[0][STATE_BYTE(in[INV_SHIFTED(col, 0, nb)], 0)] ^
+                tt->dec[1][STATE_BYTE(in[INV_SHIFTED(col, 1, nb)], 1)] ^
+                tt->dec[2][STATE_BYTE(in[INV_SHIFTED(col, 2, nb)], 2)] ^
+                tt->dec[3][STATE_BYTE(in[INV_SHIFTED(col, 3, nb)], 3)] ^
+                tt->dec[4][STATE_BYTE(in[INV_SHIFTED(col, 4, nb)], 4)] ^
+                tt->dec[5][STATE_BYTE(in[INV_SHIFTED(col, 5, nb)], 5)] ^
+                tt->dec[6][STATE_BYTE(in[INV_SHIFTED(col, 6, nb)], 6)] ^
+                tt->dec[7][STATE_BYTE(in[INV_SHIFTED(col, 7, nb)], 7)];
+        } else if (layout == kLAYOUT_ROTATE) {
+            column = tt->dec[0][STATE_BYTE(in[INV_SHIFTED(col, 4, nb)], 4)] ^
+                tt->dec[1][STATE_BYTE(in[INV_SHIFTED(col, 5, nb)], 5)] ^
+                tt->dec[2][STATE_BYTE(in[INV_SHIFTED(col, 6, nb)], 6)] ^
+                tt->dec[3][STATE_BYTE(in[INV_SHIFTED(col, 7, nb)], 7)];
+            out[col] = tt->dec[0][STATE_BYTE(in[INV_SHIFTED(col, 0, nb)], 0)] ^
+                tt->dec[1][STATE_BYTE(in[INV_SHIFTED(col, 1, nb)], 1)] ^
+                tt->dec[2][STATE_BYTE(in[INV_SHIFTED(col, 2, nb)], 2)] ^
+                tt->dec[3][STATE_BYTE(in[INV_SHIFTED(col, 3, nb)], 3)] ^
+                ROTATE_RIGHT(column, 32);
+        } else {
+            column = 0;
+            UNROLL
+            for (row = 0; row < sizeof(uint64_t); ++row) {
+                column |= (uint64_t)sboxes_dec[row % 4][STATE_BYTE(in[INV_SHIFTED(col, row, nb)], row)]
+                    << (row * kBITS_IN_BYTE);
+            }
+            out[col] = MixColumnWord(column, mds_inv_row);
+        }
+    }
+}
+
+/*
+ * InvMixColumns alone: the forward S-box cancels the inverse one built into
+ * ttables.dec.
+ */
+static inline void InvMixColumnsT(const ttable_set_t* tt, const uint64_t* in, uint64_t* out,
+        size_t nb, int layout) {
+    size_t col;
+    int row;
+    UNROLL
+    for (col = 0; col < nb; ++col) {
+        if (layout == kLAYOUT_COMPACT) {
+            out[col] = MixColumnWord(in[col], mds_inv_row);
+            continue;
+        }
+        out[col] = 0;
+        UNROLL
+        for (row = 0; row < sizeof(uint64_t); ++row) {
+            if (layout == kLAYOUT_FULL || row < 4)
+                out[col] ^= tt->dec[row][sboxes_enc[row % 4][STATE_BYTE(in[col], row)]];
+            else
+                out[col] ^= ROTATE_RIGHT(
+                    tt->dec[row % 4][sboxes_enc[row % 4][STATE_BYTE(in[col], row)]], 32);
+        }
+    }
+}
+
+/* InvShiftRows and InvSubBytes of the last deciphering round. */
+static inline void InvSubShiftT(const uint64_t* in, uint64_t* out, size_t nb) {
+    size_t col;
+    int row;
+    UNROLL
+    for (col = 0; col < nb; ++col) {
+        out[col] = 0;
+        UNROLL
+        for (row = 0; row < sizeof(uint64_t); ++row) {
+            out[col] |= (uint64_t)sboxes_dec[row % 4][STATE_BYTE(in[INV_SHIFTED(col, row, nb)], row)]
+                << (row * kBITS_IN_BYTE);
+        }
+    }
+}
+
+
+/*
+ * Block routines are written for a generic block size and instantiated below
+ * for each of them, so that all state indices are compile time constants.
+ */
+static inline void EncipherBlockT(const ttable_set_t* tt, const uint64_t* in,
+        const kalyna_t* ctx, uint64_t* out, size_t nb, int layout) {
+    size_t i, round;
+    uint64_t s[kNB_512], t[kNB_512];
+
+    for (i = 0; i < nb; ++i)
+        s[i] = in[i] + ctx->round_keys[0][i];
+    for (round = 1; round < ctx->nr; ++round) {
+        EncipherRoundT(tt, s, t, nb, layout);
+        for (i = 0; i < nb; ++i)
+            s[i] = t[i] ^ ctx->round_keys[round][i];
+    }
+    EncipherRoundT(tt, s, t, nb, layout);
+    for (i = 0; i < nb; ++i)
+        out[i] = t[i] + ctx->round_keys[ctx->nr][i];
+}
+
+/*
+ * Deciphering keeps the state with InvMixColumns applied, so that the
+ * inverse round maps onto ttables.dec and round keys are injected through
+ * their InvMixColumns images (InvMixColumns is linear over XOR).
+ */
+static inline void DecipherBlockT(const ttable_set_t* tt, const uint64_t* in,
+        const kalyna_t* ctx, uint64_t* out, size_t nb, int layout) {
+    size_t i, round;
+    uint64_t s[kNB_512], t[kNB_512];
+
+    for (i = 0; i < nb; ++i)
+        s[i] = in[i] - ctx->round_keys[ctx->nr][i];
+    InvMixColumnsT(tt, s, t, nb, layout);
+    for (round = ctx->nr - 1; round > 0; --round) {
+        DecipherRoundT(tt, t, s, nb, layout);
+        for (i = 0; i < nb; ++i)
+            t[i] = s[i] ^ ctx->round_keys_dec[round][i];
+    }
+    InvSubShiftT(t, s, nb);
+    for (i = 0; i < nb; ++i)
+        out[i] = s[i] - ctx->round_keys[0][i];
+}
+
+/*
+ * Multi-buffer routines run the same rounds as above for kLANES blocks under
+ * different keys at once. Round keys are read in lane-major order, see
+ * kalyna_lanes_t.
+ */
+static FORCE_INLINE void EncipherLanesT(const ttable_set_t* tt,
+        const kalyna_lanes_t* schedule, const uint64_t* const* in, size_t offset,
+        uint64_t* const* out, size_t nb) {
+    size_t lane, i, round;
+    uint64_t s[kLANES][kNB_512], t[kLANES][kNB_512];
+    const uint64_t* key = schedule->round_keys;
+
+    UNROLL
+    for (lane = 0; lane < kLANES; ++lane) {
+        UNROLL
+        for (i = 0; i < nb; ++i)
+            s[lane][i] = in[lane][offset + i] + key[i * kLANES + lane];
+    }
+    for (round = 1; round < schedule->nr; ++round) {
+        key += nb * kLANES;
+        UNROLL
+        for (lane = 0; lane < kLANES; ++lane)
+            EncipherRoundT(tt, s[lane], t[lane], nb, kLAYOUT_FULL);
+        UNROLL
+        for (lane = 0; lane < kLANES; ++lane) {
+            UNROLL
+        for (i = 0; i < nb; ++i)
+                s[lane][i] = t[lane][i] ^ key[i * kLANES + lane];
+        }
+    }
+    key += nb * kLANES;
+    UNROLL
+    for (lane = 0; lane < kLANES; ++lane) {
+        EncipherRoundT(tt, s[lane], t[lane], nb, kLAYOUT_FULL);
+        UNROLL
+        for (i = 0; i < nb; ++i)
+            out[lane][offset + i] = t[lane][i] + key[i * kLANES + lane];
+    }
+}
+
+static FORCE_INLINE void DecipherLanesT(const ttable_set_t* tt,
+        const kalyna_lanes_t* schedule, const uint64_t* const* in, size_t offset,
+        uint64_t* const* out, size_t nb) {
+    size_t lane, i, round;
+    uint64_t s[kLANES][kNB_512], t[kLANES][kNB_512];
+    const uint64_t* key = schedule->round_keys + schedule->nr * nb * kLANES;
+    const uint64_t* key_dec = schedule->round_keys_dec + schedule->nr * nb * kLANES;
+
+    UNROLL
+    for (lane = 0; lane < kLANES; ++lane) {
+        UNROLL
+        for (i = 0; i < nb; ++i)
+            s[lane][i] = in[lane][offset + i] - key[i * kLANES + lane];
+        InvMixColumnsT(tt, s[lane], t[lane], nb, kLAYOUT_FULL);
+    }
+    for (round = schedule->nr - 1; round > 0; --round) {
+        key_dec -= nb * kLANES;
+        UNROLL
+        for (lane = 0; lane < kLANES; ++lane)
+            DecipherRoundT(tt, t[lane], s[lane], nb, kLAYOUT_FULL);
+        UNROLL
+        for (lane = 0; lane < kLANES; ++lane) {
+            UNROLL
+        for (i = 0; i < nb; ++i)
+                t[lane][i] = s[lane][i] ^ key_dec[i * kLANES + lane];
+        }
+    }
+    key = schedule->round_keys;
+    UNROLL
+    for (lane = 0; lane < kLANES; ++lane) {
+        InvSubShiftT(t[lane], s[lane], nb);
+        UNROLL
+        for (i = 0; i < nb; ++i)
+            out[lane][offset + i] = s[lane][i] - key[i * kLANES + lane];
+    }
+}
+
+
+/* Multi-block routines of one table layout. */
+static FORCE_INLINE void EncipherBlocksT(const ttable_set_t* tt, const uint64_t* plaintext,
+        size_t blocks, kalyna_t* ctx, uint64_t* ciphertext, int layout) {
+    size_t i;
+    switch (ctx->nb) {
+    case kNB_128:
+        for (i = 0; i < blocks * kNB_128; i += kNB_128)
+            EncipherBlockT(tt, plaintext + i, ctx, ciphertext + i, kNB_128, layout);
+        break;
+    case kNB_256:
+        for (i = 0; i < blocks * kNB_256; i += kNB_256)
+            EncipherBlockT(tt, plaintext + i, ctx, ciphertext + i, kNB_256, layout);
+        break;
+    default:
+        for (i = 0; i < blocks * kNB_512; i += kNB_512)
+            EncipherBlockT(tt, plaintext + i, ctx, ciphertext + i, kNB_512, layout);
+        break;
+    }
+}
+
+static FORCE_INLINE void DecipherBlocksT(const ttable_set_t* tt, const uint64_t* ciphertext,
+        size_t blocks, kalyna_t* ctx, uint64_t* plaintext, int layout) {
+    size_t i;
+    switch (ctx->nb) {
+    case kNB_128:
+        for (i = 0; i < blocks * kNB_128; i += kNB_128)
+            DecipherBlockT(tt, ciphertext + i, ctx, plaintext + i, kNB_128, layout);
+        break;
+    case kNB_256:
+        for (i = 0; i < blocks * kNB_256; i += kNB_256)
+            DecipherBlockT(tt, ciphertext + i, ctx, plaintext + i, kNB_256, layout);
+        break;
+    default:
+        for (i = 0; i < blocks * kNB_512; i += kNB_512)
+            DecipherBlockT(tt, ciphertext + i, ctx, plaintext + i, kNB_512, layout);
+        break;
+    }
+}
+
+
+void TTABLE_KERNEL(TTableEncipherBlocks)(const uint64_t* plaintext, size_t blocks,
+        kalyna_t* ctx, uint64_t* ciphertext) {
+    EncipherBlocksT(TTableLocal(), plaintext, blocks, ctx, ciphertext, kLAYOUT_FULL);
+}
+
+void TTABLE_KERNEL(TTableDecipherBlocks)(const uint64_t* ciphertext, size_t blocks,
+        kalyna_t* ctx, uint64_t* plaintext) {
+    DecipherBlocksT(TTableLocal(), ciphertext, blocks, ctx, plaintext, kLAYOUT_FULL);
+}
+
+void TTABLE_KERNEL(TTableEncipherLanes)(const kalyna_lanes_t* schedule,
+        const uint64_t* const* input, size_t blocks, uint64_t* const* output) {
+    size_t i;
+    const ttable_set_t* tt = TTableLocal();
+    switch (schedule->nb) {
+    case kNB_128:
+        for (i = 0; i < blocks * kNB_128; i += kNB_128)
+            EncipherLanesT(tt, schedule, input, i, output, kNB_128);
+        break;
+    case kNB_256:
+        for (i = 0; i < blocks * kNB_256; i += kNB_256)
+            EncipherLanesT(tt, schedule, input, i, output, kNB_256);
+        break;
+    default:
+        /* Columns of a 512-bit block already give enough independent work. */
+        for (i = 0; i < kLANES; ++i)
+            TTABLE_KERNEL(TTableEncipherBlocks)(input[i], blocks, schedule->ctxs[i],
+                output[i]);
+        break;
+    }
+}
+
+void TTABLE_KERNEL(TTableDecipherLanes)(const kalyna_lanes_t* schedule,
+        const uint64_t* const* input, size_t blocks, uint64_t* const* output) {
+    size_t i;
+    const ttable_set_t* tt = TTableLocal();
+    switch (schedule->nb) {
+    case kNB_128:
+        for (i = 0; i < blocks * kNB_128; i += kNB_128)
+            DecipherLanesT(tt, schedule, input, i, output, kNB_128);
+        break;
+    case kNB_256:
+        for (i = 0; i < blocks * kNB_256; i += kNB_256)
+            DecipherLanesT(tt, schedule, input, i, output, kNB_256);
+        break;
+    default:
+        /* Columns of a 512-bit block already give enough independent work. */
+        for (i = 0; i < kLANES; ++i)
+            TTABLE_KERNEL(TTableDecipherBlocks)(input[i], blocks, schedule->ctxs[i],
+                output[i]);
+        break;
+    }
+}
+
+
+#ifndef TTABLE_VARIANT
+
+/*
+ * ttables.enc[row][x] is the state column produced by MixColumns from a column
+ * having S-box output for byte `x` at `row` and zeros elsewhere. ttables.dec is
+ * built the same way from inverse S-boxes and inverse MDS matrix.
+ */
+ttable_set_t ttables;
+
+static pthread_once_t ttable_once = PTHREAD_ONCE_INIT;
+
+static void BuildTables(void) {
+    int row, b, x;
+    uint64_t enc, dec;
+
+    for (row = 0; row < sizeof(uint64_t); ++row) {
+        for (x = 0; x < 256; ++x) {
+            enc = 0;
+            dec = 0;
+            for (b = 0; b < sizeof(uint64_t); ++b) {
+                enc |= (uint64_t)MultiplyGF(sboxes_enc[row % 4][x], mds_matrix[b][row])
+                    << (b * kBITS_IN_BYTE);
+                dec |= (uint64_t)MultiplyGF(sboxes_dec[row % 4][x], mds_inv_matrix[b][row])
+                    << (b * kBITS_IN_BYTE);
+            }
+            ttables.enc[row][x] = enc;
+            ttables.dec[row][x] = dec;
+        }
+    }
+}
+
+void TTableInit(void) {
+    pthread_once(&ttable_once, BuildTables);
+}
+
+/* Replicas of the tables per NUMA node, created on first use and kept. */
+static ttable_set_t* node_tables[kMAX_NODES];
+static pthread_mutex_t node_tables_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread const ttable_set_t* local_tables = NULL;
+
+const ttable_set_t* TTableLocal(void) {
+    size_t node;
+
+    if (local_tables != NULL)
+        return local_tables;
+    TTableInit();
+#ifndef KALYNA_HUGE_TABLES
+    if (NodeCount() == 1) {
+        local_tables = &ttables;
+        return local_tables;
+    }
+#endif
+    node = NodeCurrent();
+    pthread_mutex_lock(&node_tables_lock);
+    if (node_tables[node] == NULL) {
+        node_tables[node] = (ttable_set_t*)NodeAlloc(sizeof(ttable_set_t), node);
+        if (node_tables[node] != NULL)
+            memcpy(node_tables[node], &ttables, sizeof(ttable_set_t));
+    }
+    local_tables = node_tables[node] != NULL ? node_tables[node] : &ttables;
+    pthread_mutex_unlock(&node_tables_lock);
+    return local_tables;
+}
+
+void TTableResetLocal(void) {
+    local_tables = NULL;
+}
+
+void TTableRotateEncipherBlocks(const uint64_t* plaintext, size_t blocks, kalyna_t* ctx,
+        uint64_t* ciphertext) {
+    EncipherBlocksT(TTableLocal(), plaintext, blocks, ctx, ciphertext, kLAYOUT_ROTATE);
+}
+
+void TTableRotateDecipherBlocks(const uint64_t* ciphertext, size_t blocks, kalyna_t* ctx,
+        uint64_t* plaintext) {
+    DecipherBlocksT(TTableLocal(), ciphertext, blocks, ctx, plaintext, kLAYOUT_ROTATE);
+}
+
+void TTableCompactEncipherBlocks(const uint64_t* plaintext, size_t blocks, kalyna_t* ctx,
+        uint64_t* ciphertext) {
+    EncipherBlocksT(NULL, plaintext, blocks, ctx, ciphertext, kLAYOUT_COMPACT);
+}
+
+void TTableCompactDecipherBlocks(const uint64_t* ciphertext, size_t blocks, kalyna_t* ctx,
+        uint64_t* plaintext) {
+    DecipherBlocksT(NULL, ciphertext, blocks, ctx, plaintext, kLAYOUT_COMPACT);
+}
+
+void TTableEncipher(uint64_t* plaintext, kalyna_t* ctx, uint64_t* ciphertext) {
+    TTableEncipherBlocks(plaintext, 1, ctx, ciphertext);
+}
+
+void TTableDecipher(uint64_t* ciphertext, kalyna_t* ctx, uint64_t* plaintext) {
+    TTableDecipherBlocks(ciphertext, 1, ctx, plaintext);
+}
+
+/*
+ * Key schedule helpers. All blocks of a batch are independent, so a round
+ * of one block overlaps with the table loads of the next. Each engine runs
+ * them with its own table layout, so that key setup touches no tables
+ * beyond those of the engine.
+ */
+static FORCE_INLINE void EncipherRoundsT(const ttable_set_t* tt, const uint64_t* in,
+        size_t blocks, uint64_t* out, size_t nb, int layout) {
+    size_t i;
+    for (i = 0; i < blocks * nb; i += nb)
+        EncipherRoundT(tt, in + i, out + i, nb, layout);
+}
+
+static FORCE_INLINE void InvMixColumnsBlocksT(const ttable_set_t* tt, const uint64_t* in,
+        size_t blocks, uint64_t* out, size_t nb, int layout) {
+    size_t i;
+    for (i = 0; i < blocks * nb; i += nb)
+        InvMixColumnsT(tt, in + i, out + i, nb, layout);
+}
+
+static FORCE_INLINE void EncipherRoundsLayout(const uint64_t* in, size_t blocks, size_t nb,
+        uint64_t* out, int layout) {
+    const ttable_set_t* tt = layout == kLAYOUT_COMPACT ? NULL : TTableLocal();
+    switch (nb) {
+    case kNB_128:
+        EncipherRoundsT(tt, in, blocks, out, kNB_128, layout);
+        break;
+    case kNB_256:
+        EncipherRoundsT(tt, in, blocks, out, kNB_256, layout);
+        break;
+    default:
+        EncipherRoundsT(tt, in, blocks, out, kNB_512, layout);
+        break;
+    }
+}
+
+static FORCE_INLINE void InvMixColumnsLayout(const uint64_t* in, size_t blocks, size_t nb,
+        uint64_t* out, int layout) {
+    const ttable_set_t* tt = layout == kLAYOUT_COMPACT ? NULL : TTableLocal();
+    switch (nb) {
+    case kNB_128:
+        InvMixColumnsBlocksT(tt, in, blocks, out, kNB_128, layout);
+        break;
+    case kNB_256:
+        InvMixColumnsBlocksT(tt, in, blocks, out, kNB_256, layout);
+        break;
+    default:
+        InvMixColumnsBlocksT(tt, in, blocks, out, kNB_512, layout);
+        break;
+    }
+}
+
+void TTableEncipherRounds(const uint64_t* in, size_t blocks, size_t nb, uint64_t* out) {
+    EncipherRoundsLayout(in, blocks, nb, out, kLAYOUT_FULL);
+}
+
+void TTableInvMixColumns(const uint64_t* in, size_t blocks, size_t nb, uint64_t* out) {
+    InvMixColumnsLayout(in, blocks, nb, out, kLAYOUT_FULL);
+}
+
+void TTableRotateEncipherRounds(const uint64_t* in, size_t blocks, size_t nb,
+        uint64_t* out) {
+    EncipherRoundsLayout(in, blocks, nb, out, kLAYOUT_ROTATE);
+}
+
+void TTableRotateInvMixColumns(const uint64_t* in, size_t blocks, size_t nb,
+        uint64_t* out) {
+    InvMixColumnsLayout(in, blocks, nb, out, kLAYOUT_ROTATE);
+}
+
+void TTableCompactEncipherRounds(const uint64_t* in, size_t blocks, size_t nb,
+        uint64_t* out) {
+    EncipherRoundsLayout(in, blocks, nb, out, kLAYOUT_COMPACT);
+}
+
+void TTableCompactInvMixColumns(const uint64_t* in, size_t blocks, size_t nb,
+        uint64_t* out) {
+    InvMixColumnsLayout(in, blocks, nb, out, kLAYOUT_COMPACT);
+}
+
+
+/*
+ * Single block Kalyna-128 path: the round loop is unrolled for a constant
+ * round count, so every round key is a fixed offset into the caller's
+ * structure and the two state words stay in registers.
+ */
+static inline uint64_t LoadWord(const uint8_t* bytes) {
+    uint64_t word;
+    memcpy(&word, bytes, sizeof(word));
+    return kBIG_ENDIAN ? ReverseWord(word) : word;
+}
+
+static inline void StoreWord(uint64_t word, uint8_t* bytes) {
+    word = kBIG_ENDIAN ? ReverseWord(word) : word;
+    memcpy(bytes, &word, sizeof(word));
+}
+
+static FORCE_INLINE void Encipher128(const ttable_set_t* tt, const uint64_t (*keys)[kNB_128],
+        const uint8_t* in, uint8_t* out, size_t nr) {
+    size_t round;
+    uint64_t s[kNB_128], t[kNB_128];
+
+    s[0] = LoadWord(in) + keys[0][0];
+    s[1] = LoadWord(in + sizeof(uint64_t)) + keys[0][1];
+    UNROLL_ROUNDS
+    for (round = 1; round < nr; ++round) {
+        EncipherRoundT(tt, s, t, kNB_128, kLAYOUT_FULL);
+        s[0] = t[0] ^ keys[round][0];
+        s[1] = t[1] ^ keys[round][1];
+    }
+    EncipherRoundT(tt, s, t, kNB_128, kLAYOUT_FULL);
+    StoreWord(t[0] + keys[nr][0], out);
+    StoreWord(t[1] + keys[nr][1], out + sizeof(uint64_t));
+}
+
+static FORCE_INLINE void Decipher128(const ttable_set_t* tt, const uint64_t (*keys)[kNB_128],
+        const uint8_t* in, uint8_t* out, size_t nr) {
+    size_t round;
+    uint64_t s[kNB_128], t[kNB_128];
+
+    s[0] = LoadWord(in) - keys[nr][0];
+    s[1] = LoadWord(in + sizeof(uint64_t)) - keys[nr][1];
+    InvMixColumnsT(tt, s, t, kNB_128, kLAYOUT_FULL);
+    UNROLL_ROUNDS
+    for (round = nr - 1; round > 0; --round) {
+        DecipherRoundT(tt, t, s, kNB_128, kLAYOUT_FULL);
+        t[0] = s[0] ^ keys[round][0];
+        t[1] = s[1] ^ keys[round][1];
+    }
+    InvSubShiftT(t, s, kNB_128);
+    StoreWord(s[0] - keys[0][0], out);
+    StoreWord(s[1] - keys[0][1], out + sizeof(uint64_t));
+}
+
+int KalynaBlock128Load(kalyna_block128_t* key, const kalyna_t* ctx) {
+    size_t round;
+
+    if (ctx->nb != kNB_128)
+        return -1;
+    TTableInit();
+    key->nr = ctx->nr;
+    for (round = 0; round <= ctx->nr; ++round) {
+        memcpy(key->enc[round], ctx->round_keys[round], sizeof(key->enc[round]));
+        memcpy(key->dec[round], round == 0 || round == ctx->nr ? ctx->round_keys[round] :
+            ctx->round_keys_dec[round], sizeof(key->dec[round]));
+    }
+    return 0;
+}
+
+void KalynaBlock128Encipher(const kalyna_block128_t* key, const uint8_t* input,
+        uint8_t* output) {
+    const ttable_set_t* tt = TTableLocal();
+    if (key->nr == kNR_128)
+        Encipher128(tt, key->enc, input, output, kNR_128);
+    else
+        Encipher128(tt, key->enc, input, output, kNR_256);
+}
+
+void KalynaBlock128Decipher(const kalyna_block128_t* key, const uint8_t* input,
+        uint8_t* output) {
+    const ttable_set_t* tt = TTableLocal();
+    if (key->nr == kNR_128)
+        Decipher128(tt, key->dec, input, output, kNR_128);
+    else
+        Decipher128(tt, key->dec, input, output, kNR_256);
+}
+
+#endif  /* TTABLE_VARIANT */
@@ -0,0 +1,172 @@
+/*
+
+Header file for the table-driven round engine of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#ifndef KALYNA_TTABLE_H
+#define KALYNA_TTABLE_H
+
+#include "kalyna.h"
+#include "engine.h"
+
+/*
+ * Lookup tables shared by all compiled copies of the engine, see
+ * TTableInit(). Kernels read them through TTableLocal().
+ */
+typedef struct {
+    uint64_t enc[8][256];
+    uint64_t dec[8][256];
+} ttable_set_t;
+
+extern ttable_set_t ttables;
+
+/*!
+ * Build lookup tables combining S-boxes with MDS matrix multiplication.
+ * Must be called before any other function of the table-driven engine. It is
+ * safe to call the function several times and from several threads.
+ */
+void TTableInit(void);
+
+/*!
+ * Tables for the calling thread: a replica on the NUMA node the thread
+ * first ran the engine on, on 2 MiB pages with KALYNA_HUGE_TABLES, or
+ * `ttables` itself on single node hosts. Builds the tables if needed.
+ */
+const ttable_set_t* TTableLocal(void);
+
+/*!
+ * Forget the replica of the calling thread, e.g. after it moved to another
+ * node, so that the next call of TTableLocal() picks the local one again.
+ */
+void TTableResetLocal(void);
+
+/*!
+ * Encipher a block with the table-driven round engine.
+ * Each round is computed as 8 table lookups per state column. Bytes are
+ * extracted from native 64-bit words with shifts, so no byte reversal is
+ * needed on big endian hosts.
+ *
+ * @param plaintext Plaintext of length Nb words for enciphering.
+ * @param ctx Initialized cipher context with precomputed round keys.
+ * @param ciphertext The result of enciphering.
+ */
+void TTableEncipher(uint64_t* plaintext, kalyna_t* ctx, uint64_t* ciphertext);
+
+/*!
+ * Decipher a block with the table-driven round engine.
+ * Uses the inverse round keys (`round_keys_dec`) computed by
+ * KalynaKeyExpand().
+ *
+ * @param ciphertext Enciphered data of length Nb words.
+ * @param ctx Initialized cipher context with precomputed round keys.
+ * @param plaintext The result of deciphering.
+ */
+void TTableDecipher(uint64_t* ciphertext, kalyna_t* ctx, uint64_t* plaintext);
+
+/*!
+ * One enciphering round without round key (SubBytes, ShiftRows and
+ * MixColumns) of every block of a batch, for the key schedule.
+ *
+ * @param in Input blocks of length `blocks` * `nb` words.
+ * @param blocks Number of blocks.
+ * @param nb Number of 64-bit words in block.
+ * @param out Output blocks, must not overlap `in`.
+ */
+void TTableEncipherRounds(const uint64_t* in, size_t blocks, size_t nb, uint64_t* out);
+
+/*!
+ * InvMixColumns of every block of a batch, see TTableEncipherRounds().
+ */
+void TTableInvMixColumns(const uint64_t* in, size_t blocks, size_t nb, uint64_t* out);
+
+/*!
+ * Encipher a sequence of blocks with the table-driven round engine.
+ *
+ * @param plaintext Plaintext of length `blocks` * Nb words.
+ * @param blocks Number of blocks.
+ * @param ctx Initialized cipher context with precomputed round keys.
+ * @param ciphertext The result of enciphering, may be the same array as
+ * `plaintext`.
+ */
+void TTableEncipherBlocks(const uint64_t* plaintext, size_t blocks, kalyna_t* ctx,
+    uint64_t* ciphertext);
+
+/*!
+ * Decipher a sequence of blocks with the table-driven round engine.
+ *
+ * @param ciphertext Enciphered data of length `blocks` * Nb words.
+ * @param blocks Number of blocks.
+ * @param ctx Initialized cipher context with precomputed round keys.
+ * @param plaintext The result of deciphering, may be the same array as
+ * `ciphertext`.
+ */
+void TTableDecipherBlocks(const uint64_t* ciphertext, size_t blocks, kalyna_t* ctx,
+    uint64_t* plaintext);
+
+/*!
+ * Encipher kLANES streams under different keys, interleaving the rounds of
+ * all lanes so that their independent table lookups overlap.
+ *
+ * @param schedule Round keys of kLANES contexts, see KalynaLanesLoad().
+ * @param input Input blocks of each lane, `blocks` * Nb words each.
+ * @param blocks Number of blocks of every lane.
+ * @param output Output blocks of each lane, may be the same arrays as
+ * `input`.
+ */
+void TTableEncipherLanes(const kalyna_lanes_t* schedule, const uint64_t* const* input,
+    size_t blocks, uint64_t* const* output);
+
+/*!
+ * Decipher kLANES streams under different keys, see TTableEncipherLanes().
+ */
+void TTableDecipherLanes(const kalyna_lanes_t* schedule, const uint64_t* const* input,
+    size_t blocks, uint64_t* const* output);
+
+/*!
+ * Multi-block routines reading only the tables of rows 0-3, 8 KiB per
+ * direction: rows 4-7 use the same S-boxes and a circulant MDS matrix, so
+ * their table entries are the row 0-3 entries rotated by 32 bits.
+ */
+void TTableRotateEncipherBlocks(const uint64_t* plaintext, size_t blocks, kalyna_t* ctx,
+    uint64_t* ciphertext);
+void TTableRotateDecipherBlocks(const uint64_t* ciphertext, size_t blocks, kalyna_t* ctx,
+    uint64_t* plaintext);
+void TTableRotateEncipherRounds(const uint64_t* in, size_t blocks, size_t nb,
+    uint64_t* out);
+void TTableRotateInvMixColumns(const uint64_t* in, size_t blocks, size_t nb,
+    uint64_t* out);
+
+/*!
+ * Multi-block routines reading only the byte S-boxes, 2 KiB for both
+ * directions, and computing MixColumns with shifts and XORs on whole
+ * columns. Slower per block, but leaves L1d to the code around the cipher.
+ */
+void TTableCompactEncipherBlocks(const uint64_t* plaintext, size_t blocks, kalyna_t* ctx,
+    uint64_t* ciphertext);
+void TTableCompactDecipherBlocks(const uint64_t* ciphertext, size_t blocks, kalyna_t* ctx,
+    uint64_t* plaintext);
+void TTableCompactEncipherRounds(const uint64_t* in, size_t blocks, size_t nb,
+    uint64_t* out);
+void TTableCompactInvMixColumns(const uint64_t* in, size_t blocks, size_t nb,
+    uint64_t* out);
+
+/*
+ * The multi-block kernels are also compiled with -march=x86-64-v3 (AVX2,
+ * BMI2) on x86-64 hosts, see makefile. The copy gets the suffix given by
+ * TTABLE_VARIANT and is picked at run time if the CPU supports it.
+ */
+#if KALYNA_TTABLE_X86_64_V3
+void TTableEncipherBlocks_x86_64_v3(const uint64_t* plaintext, size_t blocks,
+    kalyna_t* ctx, uint64_t* ciphertext);
+void TTableDecipherBlocks_x86_64_v3(const uint64_t* ciphertext, size_t blocks,
+    kalyna_t* ctx, uint64_t* plaintext);
+void TTableEncipherLanes_x86_64_v3(const kalyna_lanes_t* schedule,
+    const uint64_t* const* input, size_t blocks, uint64_t* const* output);
+void TTableDecipherLanes_x86_64_v3(const kalyna_lanes_t* schedule,
+    const uint64_t* const* input, size_t blocks, uint64_t* const* output);
+#endif
+
+#endif  /* KALYNA_TTABLE_H */
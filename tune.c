@@ -0,0 +1,237 @@
+/*
+
+Runtime auto-tuning of round engines of the Kalyna block cipher (DSTU 7624:2014)
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "engine.h"
+
+/* Format version of the cache file, bumped when its layout changes. */
+#define kTUNE_FORMAT 1
+
+/* Measured time of each engine, variant and direction, nanoseconds. */
+#define kTUNE_NS 2000000
+
+/* Blocks of one timed call: 1 KiB, the chunk size of the modes. */
+#define kTUNE_BYTES 1024
+
+/* Upper bound of the cache file and its header lines. */
+#define kTUNE_FILE_BYTES 4096
+#define kTUNE_LINE 256
+
+/* Block and key bit sizes in the order of KalynaVariantIndex(). */
+static const size_t variants[kENGINE_VARIANTS][2] = {
+    {128, 128}, {128, 256}, {256, 256}, {256, 512}, {512, 512}
+};
+
+
+static uint64_t NowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*!
+ * Copy the CPU model of /proc/cpuinfo to `model`, "unknown" elsewhere.
+ */
+static void CpuModel(char* model, size_t size) {
+    char line[kTUNE_LINE];
+    char* value;
+    size_t length;
+    FILE* cpuinfo = fopen("/proc/cpuinfo", "r");
+
+    snprintf(model, size, "unknown");
+    if (cpuinfo == NULL)
+        return;
+    while (fgets(line, sizeof(line), cpuinfo) != NULL) {
+        if (strncmp(line, "model name", 10) != 0 && strncmp(line, "Model", 5) != 0)
+            continue;
+        value = strchr(line, ':');
+        if (value == NULL)
+            continue;
+        ++value;
+        while (*value == ' ' || *value == '\t')
+            ++value;
+        length = strcspn(value, "\n");
+        snprintf(model, size, "%.*s", (int)length, value);
+        break;
+    }
+    fclose(cpuinfo);
+}
+
+/*!
+ * Header of a cache file valid on this host: any change of the library,
+ * the CPU model or the available engines invalidates the cached choice.
+ */
+static void CacheHeader(char* header, size_t size) {
+    char model[kTUNE_LINE];
+    size_t i, length;
+
+    CpuModel(model, sizeof(model));
+    length = (size_t)snprintf(header, size, "kalyna-tune %d\nversion %s\ncpu %s\nengines",
+        kTUNE_FORMAT, KalynaVersion(), model);
+    for (i = 0; kalyna_engines[i] != NULL && length < size; ++i) {
+        if (kalyna_engines[i]->available())
+            length += (size_t)snprintf(header + length, size - length, " %s",
+                kalyna_engines[i]->name);
+    }
+    if (length < size)
+        snprintf(header + length, size - length, "\n");
+}
+
+/*!
+ * Read the engine of every variant from the cache file.
+ *
+ * @return Zero in case of success, -1 if the file is missing, was written
+ * for another host or names an unavailable engine.
+ */
+static int LoadCache(const char* path, const char* header,
+        const kalyna_engine_t** chosen) {
+    char contents[kTUNE_FILE_BYTES];
+    char name[64];
+    size_t length, v, block_size, key_size, found = 0;
+    const char* line;
+    const kalyna_engine_t* engine;
+    FILE* cache = fopen(path, "r");
+
+    if (cache == NULL)
+        return -1;
+    length = fread(contents, 1, sizeof(contents) - 1, cache);
+    fclose(cache);
+    contents[length] = '\0';
+    if (strncmp(contents, header, strlen(header)) != 0)
+        return -1;
+    memset(chosen, 0, kENGINE_VARIANTS * sizeof(const kalyna_engine_t*));
+    for (line = contents + strlen(header); *line != '\0'; line = strchr(line, '\n') + 1) {
+        if (sscanf(line, "%lu %lu %63s", (unsigned long*)&block_size,
+                (unsigned long*)&key_size, name) != 3)
+            return -1;
+        engine = KalynaEngineFind(name);
+        if (engine == NULL)
+            return -1;
+        for (v = 0; v < kENGINE_VARIANTS; ++v) {
+            if (variants[v][0] == block_size && variants[v][1] == key_size && chosen[v] == NULL) {
+                chosen[v] = engine;
+                ++found;
+            }
+        }
+        if (strchr(line, '\n') == NULL)
+            break;
+    }
+    return found == kENGINE_VARIANTS ? 0 : -1;
+}
+
+/*!
+ * Write the choice to a temporary file renamed over `path`, so concurrent
+ * processes read either the old or the new cache.
+ */
+static int SaveCache(const char* path, const char* header,
+        const kalyna_engine_t* const* chosen) {
+    char temporary[kTUNE_FILE_BYTES];
+    size_t v;
+    int failed;
+    FILE* cache;
+
+    if ((size_t)snprintf(temporary, sizeof(temporary), "%s.tmp", path) >= sizeof(temporary))
+        return -1;
+    cache = fopen(temporary, "w");
+    if (cache == NULL) {
+        perror("Could not write engine tuning cache");
+        return -1;
+    }
+    fputs(header, cache);
+    for (v = 0; v < kENGINE_VARIANTS; ++v)
+        fprintf(cache, "%lu %lu %s\n", (unsigned long)variants[v][0],
+            (unsigned long)variants[v][1], chosen[v]->name);
+    failed = ferror(cache);
+    if (fclose(cache) != 0 || failed || rename(temporary, path) != 0) {
+        perror("Could not write engine tuning cache");
+        remove(temporary);
+        return -1;
+    }
+    return 0;
+}
+
+/*!
+ * Best time of one kTUNE_BYTES call of `fn` within the time budget.
+ */
+static uint64_t TimeCalls(kalyna_blocks_fn fn, kalyna_t* ctx, uint64_t* buffer, size_t blocks) {
+    uint64_t start, finish, elapsed, best = UINT64_MAX, spent = 0;
+
+    fn(buffer, blocks, ctx, buffer);  /* Warm up caches and tables. */
+    while (spent < kTUNE_NS) {
+        start = NowNs();
+        fn(buffer, blocks, ctx, buffer);
+        finish = NowNs();
+        elapsed = finish - start;
+        best = elapsed < best ? elapsed : best;
+        spent += elapsed;
+    }
+    return best;
+}
+
+/*!
+ * Time both directions of every available engine on each variant. Contexts
+ * are filled with arbitrary round keys rather than expanded, since key
+ * expansion itself goes through the engine being selected.
+ */
+static int Calibrate(const kalyna_engine_t** chosen) {
+    uint64_t buffer[kTUNE_BYTES / sizeof(uint64_t)];
+    uint64_t time, best;
+    size_t v, e, i, round, blocks;
+    const kalyna_engine_t* engine;
+    kalyna_t* ctx;
+
+    for (i = 0; i < kTUNE_BYTES / sizeof(uint64_t); ++i)
+        buffer[i] = i * 0x9E3779B97F4A7C15ULL;
+    for (v = 0; v < kENGINE_VARIANTS; ++v) {
+        ctx = KalynaInit(variants[v][0], variants[v][1]);
+        if (ctx == NULL)
+            return -1;
+        for (round = 0; round <= ctx->nr; ++round) {
+            for (i = 0; i < ctx->nb; ++i) {
+                ctx->round_keys[round][i] = (round * ctx->nb + i) * 0x0123456789ABCDEFULL;
+                ctx->round_keys_dec[round][i] = ~ctx->round_keys[round][i];
+            }
+        }
+        blocks = kTUNE_BYTES / (ctx->nb * sizeof(uint64_t));
+        best = UINT64_MAX;
+        for (e = 0; kalyna_engines[e] != NULL; ++e) {
+            engine = KalynaEngineFind(kalyna_engines[e]->name);
+            if (engine == NULL)
+                continue;
+            time = TimeCalls(engine->encipher, ctx, buffer, blocks) +
+                TimeCalls(engine->decipher, ctx, buffer, blocks);
+            if (time < best) {
+                best = time;
+                chosen[v] = engine;
+            }
+        }
+        KalynaDelete(ctx);
+    }
+    return 0;
+}
+
+int KalynaTune(const char* cache_path) {
+    char header[kTUNE_FILE_BYTES / 2];
+    const kalyna_engine_t* chosen[kENGINE_VARIANTS];
+    size_t v;
+    int result = 0;
+
+    CacheHeader(header, sizeof(header));
+    if (cache_path == NULL || LoadCache(cache_path, header, chosen) != 0) {
+        if (Calibrate(chosen) != 0)
+            return -1;
+        if (cache_path != NULL)
+            result = SaveCache(cache_path, header, chosen);
+    }
+    for (v = 0; v < kENGINE_VARIANTS; ++v)
+        KalynaEngineSetVariant(variants[v][0] / kBITS_IN_WORD, variants[v][1] / kBITS_IN_WORD,
+            chosen[v]);
+    return result;
+}
@@ -0,0 +1,188 @@
+/*
+
+Checking the C++ interface (kalyna.hpp) of the Kalyna block cipher (DSTU 7624:2014) against the C interface
+
+Authors: Ruslan Kiianchuk, Ruslan Mordvinov, Roman Oliynykov
+
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+#include "kalyna.hpp"
+
+static_assert(!std::is_copy_constructible_v<kalyna::Kalyna128_128>);
+static_assert(!std::is_copy_assignable_v<kalyna::Kalyna128_128>);
+static_assert(std::is_nothrow_move_constructible_v<kalyna::Kalyna128_128>);
+static_assert(std::is_nothrow_move_assignable_v<kalyna::Kalyna128_128>);
+
+/* Number of blocks enciphered by each check. */
+static constexpr std::size_t kBLOCKS = 5;
+
+static int failures = 0;
+
+static void Expect(bool condition, const char* what, std::size_t block_bits,
+        std::size_t key_bits) {
+    if (!condition) {
+        std::printf("Failed: %s, Kalyna (%zu, %zu)\n", what, block_bits, key_bits);
+        ++failures;
+    }
+}
+
+/*!
+ * Compare the wrapper with the C functions on the same key and data, then
+ * check moves and length validation.
+ */
+template <std::size_t BlockBits, std::size_t KeyBits>
+static void CheckVariant() {
+    using Cipher = kalyna::Kalyna<BlockBits, KeyBits>;
+    std::byte key[Cipher::key_bytes];
+    std::byte data[kBLOCKS * Cipher::block_bytes];
+    std::byte wrapped[sizeof(data)];
+    std::uint8_t expect[sizeof(data)];
+    std::uint64_t key_words[Cipher::key_words];
+    std::uint64_t words[kBLOCKS * Cipher::block_words];
+
+    for (std::size_t i = 0; i < sizeof(key); ++i)
+        key[i] = static_cast<std::byte>(i * 7 + 1);
+    for (std::size_t i = 0; i < sizeof(data); ++i)
+        data[i] = static_cast<std::byte>(i * 13 + 5);
+    for (std::size_t i = 0; i < Cipher::key_words; ++i) {
+        key_words[i] = 0;
+        for (std::size_t j = 0; j < sizeof(std::uint64_t); ++j)
+            key_words[i] |= std::to_integer<std::uint64_t>(key[i * 8 + j]) << (8 * j);
+    }
+
+    kalyna_t* ctx = KalynaInit(BlockBits, KeyBits);
+    KalynaKeyExpand(key_words, ctx);
+    KalynaEncryptBytes(reinterpret_cast<const std::uint8_t*>(data), sizeof(data), ctx,
+        expect);
+    KalynaDelete(ctx);
+
+    Cipher cipher(key);
+    Expect(cipher.encrypt(data, wrapped), "encrypt status", BlockBits, KeyBits);
+    Expect(std::memcmp(wrapped, expect, sizeof(data)) == 0, "encrypt", BlockBits,
+        KeyBits);
+
+    Cipher moved(std::move(cipher));
+    Expect(moved.decrypt(wrapped, wrapped), "decrypt status", BlockBits, KeyBits);
+    Expect(std::memcmp(wrapped, data, sizeof(data)) == 0, "decrypt in place",
+        BlockBits, KeyBits);
+
+    cipher = std::move(moved);
+    cipher.encrypt_block(std::span<const std::byte, Cipher::block_bytes>(data,
+        Cipher::block_bytes), std::span<std::byte, Cipher::block_bytes>(wrapped,
+        Cipher::block_bytes));
+    Expect(std::memcmp(wrapped, expect, Cipher::block_bytes) == 0, "encrypt_block",
+        BlockBits, KeyBits);
+
+    /* Native words round trip, comparable with the bytes on any host. */
+    std::memcpy(words, data, sizeof(data));
+    cipher.encrypt_blocks(words, words);
+    Expect(std::memcmp(words, data, sizeof(data)) != 0, "encrypt_blocks",
+        BlockBits, KeyBits);
+    cipher.decrypt_blocks(words, words);
+    Expect(std::memcmp(words, data, sizeof(data)) == 0, "decrypt_blocks",
+        BlockBits, KeyBits);
+
+    std::span<const std::byte, Cipher::block_bytes> iv(data, Cipher::block_bytes);
+    KalynaCtrBytes(reinterpret_cast<const std::uint8_t*>(data), sizeof(data) - 1,
+        reinterpret_cast<const std::uint8_t*>(data), cipher.native_handle(), expect);
+    Expect(cipher.ctr(iv, std::span<const std::byte>(data, sizeof(data) - 1),
+        std::span<std::byte>(wrapped, sizeof(data) - 1)), "ctr status", BlockBits, KeyBits);
+    Expect(std::memcmp(wrapped, expect, sizeof(data) - 1) == 0, "ctr", BlockBits,
+        KeyBits);
+
+    /* Feedback modes over a partial last block, CFB also with 8-bit segments. */
+    const std::uint8_t* input = reinterpret_cast<const std::uint8_t*>(data);
+    std::span<const std::byte> message(data, sizeof(data) - 1);
+    std::span<std::byte> output(wrapped, sizeof(data) - 1);
+    KalynaCfbEncrypt(input, message.size(), input, BlockBits, cipher.native_handle(), expect);
+    Expect(cipher.cfb_encrypt(iv, message, output) &&
+        std::memcmp(wrapped, expect, message.size()) == 0, "cfb_encrypt", BlockBits, KeyBits);
+    Expect(cipher.cfb_decrypt(iv, output, output) &&
+        std::memcmp(wrapped, data, message.size()) == 0, "cfb_decrypt", BlockBits, KeyBits);
+    KalynaCfbEncrypt(input, message.size(), input, 8, cipher.native_handle(), expect);
+    Expect(cipher.cfb_encrypt(iv, message, output, 8) &&
+        std::memcmp(wrapped, expect, message.size()) == 0, "cfb_encrypt 8-bit", BlockBits,
+        KeyBits);
+    Expect(!cipher.cfb_encrypt(iv, message, output, 12), "cfb segment rejected", BlockBits,
+        KeyBits);
+
+    KalynaOfbBytes(input, message.size(), input, cipher.native_handle(), expect);
+    Expect(cipher.ofb(iv, message, output) &&
+        std::memcmp(wrapped, expect, message.size()) == 0, "ofb", BlockBits, KeyBits);
+    {
+        /* Two calls, the first one served from the precomputed keystream. */
+        kalyna::OfbStream stream(cipher, iv, 2 * Cipher::block_bytes);
+        std::size_t split = Cipher::block_bytes + 3;
+        Expect(stream.precompute(split) >= split, "ofb precompute", BlockBits, KeyBits);
+        Expect(stream.crypt(message.first(split), output.first(split)) &&
+            stream.crypt(message.subspan(split), output.subspan(split)) &&
+            std::memcmp(wrapped, expect, message.size()) == 0, "ofb stream", BlockBits,
+            KeyBits);
+        kalyna::OfbStream moved_stream(std::move(stream));
+        Expect(!moved_stream.crypt(message, output.first(1)), "ofb length mismatch rejected",
+            BlockBits, KeyBits);
+    }
+
+    /* GCM against the C functions, then a tampered tag. */
+    std::byte tag[Cipher::block_bytes];
+    std::uint8_t expect_tag[Cipher::block_bytes];
+    std::span<const std::byte> aad(data, 7);
+    KalynaGcmEncrypt(cipher.native_handle(), input, input, aad.size(), input, message.size(),
+        expect, expect_tag);
+    Expect(cipher.gcm_encrypt(iv, aad, message, output, tag) &&
+        std::memcmp(wrapped, expect, message.size()) == 0 &&
+        std::memcmp(tag, expect_tag, sizeof(tag)) == 0, "gcm_encrypt", BlockBits, KeyBits);
+    Expect(cipher.gcm_decrypt(iv, aad, output, tag, output) &&
+        std::memcmp(wrapped, data, message.size()) == 0, "gcm_decrypt", BlockBits, KeyBits);
+    std::memcpy(wrapped, expect, message.size());
+    tag[0] ^= std::byte{1};
+    Expect(!cipher.gcm_decrypt(iv, aad, output, tag, output) &&
+        std::memcmp(wrapped, expect, message.size()) == 0, "gcm tampered tag rejected",
+        BlockBits, KeyBits);
+
+    Expect(!cipher.encrypt(std::span<const std::byte>(data, sizeof(data) - 1),
+        std::span<std::byte>(wrapped, sizeof(data) - 1)), "partial block rejected",
+        BlockBits, KeyBits);
+    Expect(!cipher.encrypt(data, std::span<std::byte>(wrapped,
+        Cipher::block_bytes)), "length mismatch rejected", BlockBits, KeyBits);
+}
+
+
+int main() {
+    /* Kalyna (128, 128) enciphering example of the standard. */
+    static const std::uint8_t key[16] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+    };
+    static const std::uint8_t plaintext[16] = {
+        0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+        0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f
+    };
+    static const std::uint8_t ciphertext[16] = {
+        0x81, 0xbf, 0x1c, 0x7d, 0x77, 0x9b, 0xac, 0x20,
+        0xe1, 0xc9, 0xea, 0x39, 0xb4, 0xd2, 0xad, 0x06
+    };
+    std::byte block[16];
+
+    kalyna::Kalyna128_128 cipher(std::as_bytes(std::span(key)));
+    cipher.encrypt_block(std::as_bytes(std::span(plaintext)), block);
+    Expect(std::memcmp(block, ciphertext, sizeof(block)) == 0, "standard example",
+        128, 128);
+
+    CheckVariant<128, 128>();
+    CheckVariant<128, 256>();
+    CheckVariant<256, 256>();
+    CheckVariant<256, 512>();
+    CheckVariant<512, 512>();
+
+    if (failures != 0) {
+        std::printf("Failed C++ interface test\n");
+        return 1;
+    }
+    std::printf("Success C++ interface test\n");
+    return 0;
+}